@@ -1,70 +1,260 @@
+#include <memory>
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <string>
+#include <vector>
+#include <cstdint>
 #include <cstdlib>
+#include <stdexcept>
 
-#include "lexing.hpp"
-#include "ast.hpp"
-#include "codegen.hpp"
+#include "driver.hpp"
+#include "server.hpp"
+#include "serialization.hpp"
 
 using namespace pebkac;
 
-int main(int argc, const char** argv)
+
+int usage()
 {
-	//Check argument count
-	if (argc != 3)
+	std::cerr << "Usage:" << std::endl
+		<< "\tpebkacc [options] <source> <output_type>" << std::endl
+		<< "\tpebkacc [options] --batch <output_type> [-j <threads>] [-o <output_dir>] <sources...|@manifest>" << std::endl
+		<< "\tpebkacc [options] --server <socket_path>" << std::endl
+		<< "Options:" << std::endl
+		<< "\t--line-directives\tEmit #line directives pointing back at the source" << std::endl
+		<< "\t--profile\t\tMake the generated program report calls and time spent per function, disabling every optimization" << std::endl
+		<< "\t--no-constexpr\t\tDo not declare pure functions and constants constexpr" << std::endl
+		<< "\t--inline-budget=<nodes>\tLargest function body to inline, 0 disables inlining (default 16)" << std::endl
+		<< "\t--specialize-budget=<nodes>\tMost nodes to add cloning higher-order functions, 0 disables it (default 1024)" << std::endl
+		<< "\t--no-closure-conversion\tPass every function value as a std::function" << std::endl
+		<< "\t--no-simd-reductions\tCompute every fold by calling its function" << std::endl
+		<< "\t--parallel-chunk=<elements>\tArray elements per task of pmap and preduce (default 4096)" << std::endl
+		<< "\t--fast-math\t\tLet floating-point arithmetic be reordered, to vectorize sums" << std::endl
+		<< "\t--soa-records\t\tStore arrays of records as one array per field" << std::endl
+		<< "\t--no-regions\t\tAllocate every array on the heap" << std::endl
+		<< "\t--no-cse\t\tDo not compute repeated subexpressions and loop invariants only once" << std::endl
+		<< "\t--no-dce\t\tKeep unused functions and lets" << std::endl
+		<< "\t--no-sink-lets\t\tCompute every let where it is written" << std::endl
+		<< "\t--no-switches\t\tKeep chains of conditionals comparing an integer with literals as they are" << std::endl
+		<< "\t--stats[=json]\t\tReport time, CPU time and memory spent in each phase, on stderr" << std::endl
+		<< "\t--trace=<file>\t\tWrite a Chrome trace_event file of every phase and function" << std::endl
+		<< "\t--trace-buffer=<events>\tOnly keep the most recent events in a ring buffer" << std::endl;
+	return EXIT_FAILURE;
+}
+
+
+struct trace_options
+{
+	std::string path = "";
+	size_t capacity = 0;
+};
+
+
+// Reads the number given to an option, which std::stoul would also take with a sign or trailing garbage
+size_t parse_count(std::string_view option, std::string_view value)
+{
+	size_t result = 0;
+	for(const char c : value)
 	{
-		std::cerr << "ERROR: Passed " << argc-1 << " argument" << (argc==2?"":"s") << ", expected 2." << std::endl;
-		return EXIT_FAILURE;
+		if (c < '0' || c > '9' || result > (SIZE_MAX - (c - '0')) / 10)
+			throw std::invalid_argument(std::string(option) + " expects a number, got \"" + std::string(value) + "\".");
+		result = result * 10 + (c - '0');
+	}
+	if (value.empty())
+		throw std::invalid_argument(std::string(option) + " expects a number.");
+	return result;
+}
+
+
+// Parses the leading options, and returns the index of the first argument after them
+int parse_options(int argc, const char** argv, driver::options& opts, trace_options& trace_opts)
+{
+	int i = 1;
+	for(; i < argc; ++i)
+	{
+		const std::string_view arg(argv[i]);
+
+		if (arg == "--line-directives")
+			opts.line_directives = true;
+		else if (arg == "--profile")
+			opts.profile = true;
+		else if (arg == "--no-constexpr")
+			opts.constant_evaluation = false;
+		else if (arg == "--no-closure-conversion")
+			opts.closure_conversion = false;
+		else if (arg == "--no-simd-reductions")
+			opts.simd_reductions = false;
+		else if (arg == "--fast-math")
+			opts.fast_math = true;
+		else if (arg == "--soa-records")
+			opts.columnar_records = true;
+		else if (arg == "--no-regions")
+			opts.regions = false;
+		else if (arg == "--no-cse")
+			opts.common_subexpressions = false;
+		else if (arg == "--no-dce")
+			opts.dead_code_elimination = false;
+		else if (arg == "--no-sink-lets")
+			opts.sink_lets = false;
+		else if (arg == "--no-switches")
+			opts.switches = false;
+		else if (arg.substr(0, 20) == "--specialize-budget=")
+			opts.specialization_budget = parse_count(arg.substr(0, 19), arg.substr(20));
+		else if (arg.substr(0, 16) == "--inline-budget=")
+			opts.inline_budget = parse_count(arg.substr(0, 15), arg.substr(16));
+		else if (arg.substr(0, 17) == "--parallel-chunk=")
+			opts.parallel_chunk = parse_count(arg.substr(0, 16), arg.substr(17));
+		else if (arg == "--stats" || arg == "-ftime-report")
+			opts.stats = stats::format::TEXT;
+		else if (arg == "--stats=json")
+			opts.stats = stats::format::JSON;
+		else if (arg.substr(0, 8) == "--trace=")
+			trace_opts.path = arg.substr(8);
+		else if (arg.substr(0, 15) == "--trace-buffer=")
+			trace_opts.capacity = parse_count(arg.substr(0, 14), arg.substr(15));
+		else
+			break;
 	}
-	const std::string_view output_type_arg(argv[2]);
+	return i;
+}
 
-	//Read source file
-	std::ifstream file(argv[1]);
-	std::stringstream buffer;
-	buffer << file.rdbuf();
-	std::string source = buffer.str();
-	file.close();
 
-	//Tokenize
-	std::queue<lexing::token> tokens = lexing::tokenize(source);
+void print_stats(const std::string& source, const stats::report& report, stats::format format)
+{
+	if (format == stats::format::JSON)
+		std::cerr << "{\"source\": \"" << escape(source) << "\", \"stats\": " << report.to_json() << "}" << std::endl;
+	else if (format == stats::format::TEXT)
+		std::cerr << source << ": " << report.to_text();
+}
 
-	if (output_type_arg == "tokens")
+
+int batch(int argc, const char** argv, const driver::options& opts)
+{
+	// --batch <output_type> [-j <threads>] [-o <output_dir>] <sources...|@manifest>
+	if (argc < 4)
+		return usage();
+
+	const driver::output_type type = driver::to_output_type(argv[2]);
+	size_t threads = 0;
+	std::string output_dir = "";
+	std::vector<std::string> sources = { };
+
+	for(int i = 3; i < argc; ++i)
 	{
-		std::cout << "[";
-		bool a = true;
-		while(!tokens.empty())
+		const std::string_view arg(argv[i]);
+
+		if ((arg == "-j" || arg == "-o") && i+1 == argc)
+			return usage();
+		else if (arg == "-j")
+			threads = parse_count(arg, argv[++i]);
+		else if (arg == "-o")
+			output_dir = argv[++i];
+		else if (arg.size() > 1 && arg[0] == '@')
 		{
-			std::cout << (a?"":", ") << tokens.front().serialize()->to_json();
-			tokens.pop();
-			a = false;
+			const auto manifest = driver::read_manifest(std::string(arg.substr(1)));
+			sources.insert(sources.end(), manifest.begin(), manifest.end());
 		}
-		std::cout << "]" << std::endl;
-		return EXIT_SUCCESS;
+		else
+			sources.emplace_back(arg);
 	}
 
-	//Build Abstract Syntax Tree
-	ast::parser parser(tokens);
-	const auto statements = parser.parse_statements();
-	
-	if (output_type_arg == "ast")
+	//Compile everything, then report per file
+	const auto results = driver::compile_batch(sources, type, output_dir, threads, opts);
+
+	size_t failures = 0;
+	for(const auto& r : results)
 	{
-		std::cout << serialized_array(statements).to_json() << std::endl;
-		return EXIT_SUCCESS;
+		if (r.success)
+		{
+			std::cerr << "OK    " << r.source << " -> " << r.output << " (" << r.seconds * 1000 << " ms)" << std::endl;
+		}
+		else
+		{
+			std::cerr << "FAIL  " << r.source << ": " << r.message << std::endl;
+			++failures;
+		}
+		print_stats(r.source, r.stats, opts.stats);
 	}
+	std::cerr << results.size() - failures << " succeeded, " << failures << " failed." << std::endl;
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
 
-	//Generate C++
-	codegen::generator g(statements);
-	const std::string cpp = g.get_cpp();
 
-	if (output_type_arg == "cpp")
+int single(int argc, const char** argv, driver::options opts)
+{
+	//Check argument count
+	if (argc != 3)
 	{
-		std::cout << cpp << std::endl;
-		return EXIT_SUCCESS;
+		std::cerr << "ERROR: Passed " << argc-1 << " argument" << (argc==2?"":"s") << ", expected 2." << std::endl;
+		return usage();
 	}
 
-	//Argument didn't match any of the above
-	std::cerr << "ERROR: Unrecognized argument \"" << output_type_arg << "\"" << std::endl;
-	return EXIT_FAILURE;
+	const driver::output_type type = driver::to_output_type(argv[2]);
+	opts.source_name = argv[1];
+	stats::report report;
+	try
+	{
+		std::cout << driver::compile(driver::read_file(argv[1]), type, opts, &report) << std::endl;
+	}
+	catch(const driver::compilation_error& e)
+	{
+		for(const auto& d : e.get_diagnostics())
+			std::cerr << argv[1] << ":" << d.position.line << ":" << d.position.column << ": error: " << d.message << std::endl;
+		print_stats(argv[1], report, opts.stats);
+		return EXIT_FAILURE;
+	}
+	print_stats(argv[1], report, opts.stats);
+	return EXIT_SUCCESS;
+}
+
+
+int main(int argc, const char** argv)
+{
+	try
+	{
+		//Skip past the options, so that argv[1] is the first positional argument
+		driver::options opts = { };
+		trace_options trace_opts = { };
+		const int shift = parse_options(argc, argv, opts, trace_opts) - 1;
+		argc -= shift;
+		argv += shift;
+
+		if (opts.stats != stats::format::NONE)
+			stats::count_allocations();
+
+		// A server runs until it is killed, so it would never write the file and its trace would grow forever
+		const bool server = argc > 1 && std::string_view(argv[1]) == "--server";
+		if (server && !trace_opts.path.empty())
+			throw std::invalid_argument("--trace cannot be used with --server, use --trace-buffer and \"trace\" requests instead.");
+
+		std::unique_ptr<trace::buffer> tracer = nullptr;
+		if (!trace_opts.path.empty() || trace_opts.capacity)
+		{
+			tracer = std::make_unique<trace::buffer>(trace_opts.capacity);
+			opts.tracer = tracer.get();
+		}
+
+		if (server)
+		{
+			if (argc != 3)
+				return usage();
+
+			// The trace is served through "trace" requests instead of written to a file
+			server::compile_server(argv[2], opts).run();
+			return EXIT_SUCCESS;
+		}
+
+		const int status = (argc > 1 && std::string_view(argv[1]) == "--batch") ? batch(argc, argv, opts) : single(argc, argv, opts);
+
+		// Failed compilations are often the most interesting ones to trace
+		if (!trace_opts.path.empty())
+			driver::write_file(trace_opts.path, tracer->to_json());
+
+		return status;
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
 }
@@ -0,0 +1,1550 @@
+#include "analysis.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+using namespace pebkac;
+using namespace pebkac::analysis;
+
+
+// Top-level names a piece of code depends on
+struct references
+{
+	std::unordered_set<std::string> calls;
+	std::unordered_set<std::string> globals;
+};
+
+
+scalar_type analysis::get_scalar_type(const std::shared_ptr<ast::type_node>& type)
+{
+	const auto identifier = std::dynamic_pointer_cast<ast::identifier_node>(type);
+	if (identifier && identifier->get_value() == "integer")
+		return scalar_type::INTEGER;
+	if (identifier && identifier->get_value() == "boolean")
+		return scalar_type::BOOLEAN;
+
+	return scalar_type::UNKNOWN;
+}
+
+
+bool analysis::is_fixed_width(const std::string& name)
+{
+	static const std::unordered_set<std::string> types = {"i8", "i16", "i32", "i64", "u8", "u16", "u32", "u64"};
+	return types.count(name);
+}
+
+
+bool analysis::is_floating_point(const std::string& name)
+{
+	return name == "float" || name == "double";
+}
+
+
+bool analysis::is_bigint(const std::string& name)
+{
+	return name == "bigint";
+}
+
+
+// Whether a type, statement or expression names float or double, or has a floating-point literal
+bool names_floating_point(const std::shared_ptr<ast::type_node>& ptr)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr))
+		return is_floating_point(cast->get_value());
+	else if (const auto cast = std::dynamic_pointer_cast<ast::array_type_node>(ptr))
+		return names_floating_point(cast->get_element_type());
+	else if (const auto cast = std::dynamic_pointer_cast<ast::map_type_node>(ptr))
+		return names_floating_point(cast->get_key_type()) || names_floating_point(cast->get_value_type());
+	else if (const auto cast = std::dynamic_pointer_cast<ast::vector_type_node>(ptr))
+		return names_floating_point(cast->get_element_type());
+	else if (const auto cast = std::dynamic_pointer_cast<ast::function_type_node>(ptr))
+	{
+		bool result = names_floating_point(cast->get_return_type());
+		for(const auto& parameter : cast->get_parameters())
+			result = result || names_floating_point(parameter);
+		return result;
+	}
+	return false;
+}
+
+
+bool names_floating_point(const std::shared_ptr<ast::statement_node>& ptr);
+
+
+bool names_floating_point(const std::vector<std::shared_ptr<ast::parameter_node>>& parameters)
+{
+	for(const auto& parameter : parameters)
+	{
+		if (names_floating_point(parameter->get_type()) || (parameter->get_default_value() && names_floating_point(parameter->get_default_value())))
+			return true;
+	}
+	return false;
+}
+
+
+bool names_floating_point(const std::vector<std::shared_ptr<ast::statement_node>>& statements)
+{
+	for(const auto& statement : statements)
+	{
+		if (names_floating_point(statement))
+			return true;
+	}
+	return false;
+}
+
+
+bool names_floating_point(const std::shared_ptr<ast::statement_node>& ptr)
+{
+	if (!ptr)
+		return false;
+
+	if (std::dynamic_pointer_cast<ast::floating_literal_node>(ptr))
+		return true;
+	else if (const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr))
+		return is_floating_point(cast->get_value());
+	else if (const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr))
+	{
+		bool result = names_floating_point(cast->get_function());
+		for(const auto& argument : cast->get_arguments())
+			result = result || names_floating_point(argument);
+		return result;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::lambda_node>(ptr))
+		return names_floating_point(cast->get_parameters()) || names_floating_point(cast->get_statements());
+	else if (const auto cast = std::dynamic_pointer_cast<ast::group_node>(ptr))
+		return names_floating_point(cast->get_expression());
+	else if (const auto cast = std::dynamic_pointer_cast<ast::field_access_node>(ptr))
+		return names_floating_point(cast->get_record());
+	else if (const auto cast = std::dynamic_pointer_cast<ast::array_literal_node>(ptr))
+	{
+		bool result = false;
+		for(const auto& element : cast->get_elements())
+			result = result || names_floating_point(element);
+		return result;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::unary_operator_node>(ptr))
+		return names_floating_point(cast->get_operand());
+	else if (const auto cast = std::dynamic_pointer_cast<ast::operator_node>(ptr))
+		return names_floating_point(cast->get_operand_a()) || names_floating_point(cast->get_operand_b());
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
+		return names_floating_point(cast->get_condition()) || names_floating_point(cast->get_value_true()) || names_floating_point(cast->get_value_false());
+	else if (const auto cast = std::dynamic_pointer_cast<ast::match_node>(ptr))
+	{
+		bool result = names_floating_point(cast->get_value()) || names_floating_point(cast->get_otherwise());
+		for(const auto& c : cast->get_cases())
+			result = result || names_floating_point(c->get_result());
+		return result;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::block_node>(ptr))
+		return names_floating_point(cast->get_statements());
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_node>(ptr))
+		return names_floating_point(cast->get_condition()) || names_floating_point(cast->get_branch_true()) || names_floating_point(cast->get_branch_false());
+	else if (const auto cast = std::dynamic_pointer_cast<ast::let_node>(ptr))
+		return names_floating_point(cast->get_type()) || names_floating_point(cast->get_value());
+	else if (const auto cast = std::dynamic_pointer_cast<ast::return_node>(ptr))
+		return names_floating_point(cast->get_value());
+	else if (const auto cast = std::dynamic_pointer_cast<ast::function_node>(ptr))
+		return names_floating_point(cast->get_parameters()) || names_floating_point(cast->get_return_type()) || names_floating_point(cast->get_body());
+	else if (const auto cast = std::dynamic_pointer_cast<ast::record_node>(ptr))
+		return names_floating_point(cast->get_fields());
+
+	return false;
+}
+
+
+bool analysis::uses_floating_point(const std::vector<std::shared_ptr<ast::statement_node>>& ast)
+{
+	return names_floating_point(ast);
+}
+
+
+bool analysis::is_array_builtin(const std::string& name)
+{
+	static const std::unordered_set<std::string> builtins = {"map", "filter", "fold", "zip", "length", "range", "pmap", "preduce"};
+	return builtins.count(name) || !name.compare(0, 14, "pebkac_array::");
+}
+
+
+bool analysis::is_persistent_builtin(const std::string& name)
+{
+	static const std::unordered_set<std::string> builtins = {"get", "put", "has", "remove", "push", "concat", "keys", "values", "to_map", "to_vector", "to_array"};
+	return builtins.count(name);
+}
+
+
+bool is_scalar(const std::shared_ptr<ast::type_node>& type)
+{
+	const auto identifier = std::dynamic_pointer_cast<ast::identifier_node>(type);
+	return get_scalar_type(type) != scalar_type::UNKNOWN || (identifier && (is_fixed_width(identifier->get_value()) || is_floating_point(identifier->get_value())));
+}
+
+
+// Checks that an expression only uses what compile-time evaluation allows, and collects what it refers to
+bool is_constant(const std::shared_ptr<ast::expression_node>& ptr, const std::unordered_set<std::string>& scope, references& refs)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr))
+	{
+		// Only direct calls to top-level functions
+		const auto callee = std::dynamic_pointer_cast<ast::identifier_node>(cast->get_function());
+		if (!callee || scope.count(callee->get_value()))
+			return false;
+
+		// Conversions like integer(x), which inlining inserts, are not calls
+		if (!is_scalar(callee))
+			refs.calls.insert(callee->get_value());
+
+		for(const auto& argument : cast->get_arguments())
+		{
+			if (!is_constant(argument, scope, refs))
+				return false;
+		}
+		return true;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr))
+	{
+		if (!scope.count(cast->get_value()))
+			refs.globals.insert(cast->get_value());
+		return true;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::numeric_literal_node>(ptr))
+	{
+		// Bigints may allocate, which constant expressions cannot do
+		return cast->get_suffix() != "n";
+	}
+	else if (std::dynamic_pointer_cast<ast::floating_literal_node>(ptr) || std::dynamic_pointer_cast<ast::boolean_literal_node>(ptr))
+	{
+		return true;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::group_node>(ptr))
+	{
+		return is_constant(cast->get_expression(), scope, refs);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::unary_operator_node>(ptr))
+	{
+		return is_constant(cast->get_operand(), scope, refs);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::operator_node>(ptr))
+	{
+		return is_constant(cast->get_operand_a(), scope, refs) && is_constant(cast->get_operand_b(), scope, refs);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
+	{
+		return is_constant(cast->get_condition(), scope, refs)
+			&& is_constant(cast->get_value_true(), scope, refs)
+			&& is_constant(cast->get_value_false(), scope, refs);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::match_node>(ptr))
+	{
+		bool result = is_constant(cast->get_value(), scope, refs) && is_constant(cast->get_otherwise(), scope, refs);
+		for(const auto& c : cast->get_cases())
+			result = result && is_constant(c->get_result(), scope, refs);
+		return result;
+	}
+
+	// Lambdas capture by reference, which constant expressions cannot do
+	return false;
+}
+
+
+// Same for statements, where lets add their names to the scope
+bool is_constant_statement(const std::shared_ptr<ast::statement_node>& ptr, std::unordered_set<std::string>& scope, references& refs)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::let_node>(ptr))
+	{
+		// Thunks remember their value, which constant expressions cannot do
+		if (cast->is_lazy() || (cast->get_type() && !is_scalar(cast->get_type())) || !is_constant(cast->get_value(), scope, refs))
+			return false;
+
+		scope.insert(cast->get_name());
+		return true;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_node>(ptr))
+	{
+		std::unordered_set<std::string> scope_true = scope;
+		std::unordered_set<std::string> scope_false = scope;
+		return is_constant(cast->get_condition(), scope, refs)
+			&& is_constant_statement(cast->get_branch_true(), scope_true, refs)
+			&& (!cast->get_branch_false() || is_constant_statement(cast->get_branch_false(), scope_false, refs));
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::return_node>(ptr))
+	{
+		return is_constant(cast->get_value(), scope, refs);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::block_node>(ptr))
+	{
+		std::unordered_set<std::string> inner = scope;
+		for(const auto& statement : cast->get_statements())
+		{
+			if (!is_constant_statement(statement, inner, refs))
+				return false;
+		}
+		return true;
+	}
+	else if (std::dynamic_pointer_cast<ast::empty_statement_node>(ptr))
+	{
+		return true;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::expression_node>(ptr))
+	{
+		return is_constant(cast, scope, refs);
+	}
+
+	return false;
+}
+
+
+// Whether a function may recurse, directly or through the functions it calls
+bool is_recursive(
+	const std::string& name,
+	const std::unordered_map<std::string, references>& functions,
+	std::unordered_map<std::string, int>& state)
+{
+	enum { VISITING = 1, BOUNDED, RECURSIVE };
+
+	auto& s = state[name];
+	if (s)
+		return s != BOUNDED;
+
+	s = VISITING;
+	bool recursive = false;
+	if (const auto f = functions.find(name); f != functions.end())
+	{
+		for(const auto& callee : f->second.calls)
+			recursive = is_recursive(callee, functions, state) || recursive;
+	}
+
+	state[name] = recursive ? RECURSIVE : BOUNDED;
+	return recursive;
+}
+
+
+constant_info analysis::find_constants(const std::vector<std::shared_ptr<ast::statement_node>>& ast)
+{
+	// Start from every declaration that looks constant on its own
+	std::unordered_map<std::string, references> functions = { };
+	std::unordered_map<std::string, references> constants = { };
+	for(const auto& ptr : ast)
+	{
+		if (const auto cast = std::dynamic_pointer_cast<ast::function_node>(ptr))
+		{
+			// main can never be constexpr, and io functions have side effects
+			if (cast->get_name() == "main" || cast->get_specifiers().count(ast::specifier::IO) || !is_scalar(cast->get_return_type()))
+				continue;
+
+			references refs = { };
+			std::unordered_set<std::string> scope = { };
+			bool constant = true;
+			for(const auto& parameter : cast->get_parameters())
+			{
+				constant = constant && is_scalar(parameter->get_type())
+					&& (!parameter->get_default_value() || is_constant(parameter->get_default_value(), std::unordered_set<std::string>(), refs));
+				scope.insert(parameter->get_name());
+			}
+
+			if (constant && is_constant_statement(cast->get_body(), scope, refs))
+				functions[cast->get_name()] = refs;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::let_node>(ptr))
+		{
+			references refs = { };
+			std::unordered_set<std::string> scope = { };
+			if (is_constant_statement(ptr, scope, refs))
+				constants[cast->get_name()] = refs;
+		}
+	}
+
+	std::unordered_map<std::string, int> state = { };
+	for(auto it = constants.begin(); it != constants.end();)
+	{
+		bool recursive = false;
+		for(const auto& callee : it->second.calls)
+			recursive = recursive || is_recursive(callee, functions, state);
+
+		it = recursive ? constants.erase(it) : std::next(it);
+	}
+
+	// Then drop anything depending on a declaration that was dropped, until nothing changes
+	const auto depends_on_runtime = [&](const references& refs) {
+		for(const auto& callee : refs.calls)
+		{
+			if (!functions.count(callee))
+				return true;
+		}
+		for(const auto& global : refs.globals)
+		{
+			if (!constants.count(global))
+				return true;
+		}
+		return false;
+	};
+
+	for(bool changed = true; changed;)
+	{
+		changed = false;
+		for(auto* declarations : {&functions, &constants})
+		{
+			for(auto it = declarations->begin(); it != declarations->end();)
+			{
+				if (depends_on_runtime(it->second))
+				{
+					it = declarations->erase(it);
+					changed = true;
+				}
+				else
+					++it;
+			}
+		}
+	}
+
+	constant_info result = { };
+	for(const auto& [name, refs] : functions)
+		result.functions.insert(name);
+	for(const auto& [name, refs] : constants)
+		result.constants.insert(name);
+	return result;
+}
+
+
+// What a function does besides computing its result
+struct effects
+{
+	references refs;
+
+	// Calls to parameters, lambdas or anything else that is not a top-level function
+	bool indirect = false;
+
+	// Divisions, and conversions to fixed-width types, which fail when the value does not fit
+	bool fails = false;
+};
+
+
+// Parameters and lets in scope. Unlike a set, it is cheap to restore after leaving a nested scope.
+typedef std::vector<std::string> local_names;
+
+
+bool is_local(const std::string& name, const local_names& scope)
+{
+	return std::find(scope.rbegin(), scope.rend(), name) != scope.rend();
+}
+
+
+void collect(const std::shared_ptr<ast::statement_node>& ptr, local_names& scope, effects& e);
+
+
+void collect(const std::shared_ptr<ast::expression_node>& ptr, local_names& scope, effects& e)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr))
+	{
+		const auto callee = std::dynamic_pointer_cast<ast::identifier_node>(cast->get_function());
+		if (!callee || is_local(callee->get_value(), scope))
+		{
+			e.indirect = true;
+			collect(cast->get_function(), scope, e);
+		}
+		else if (!is_scalar(callee) && !is_bigint(callee->get_value()))
+			e.refs.calls.insert(callee->get_value());
+		else
+			e.fails = e.fails || is_fixed_width(callee->get_value());
+
+		for(const auto& argument : cast->get_arguments())
+			collect(argument, scope, e);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::lambda_node>(ptr))
+	{
+		const size_t outer = scope.size();
+		for(const auto& parameter : cast->get_parameters())
+			scope.push_back(parameter->get_name());
+		for(const auto& statement : cast->get_statements())
+			collect(statement, scope, e);
+		scope.resize(outer);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr))
+	{
+		if (!is_local(cast->get_value(), scope))
+			e.refs.globals.insert(cast->get_value());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::group_node>(ptr))
+	{
+		collect(cast->get_expression(), scope, e);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::field_access_node>(ptr))
+	{
+		collect(cast->get_record(), scope, e);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::array_literal_node>(ptr))
+	{
+		for(const auto& element : cast->get_elements())
+			collect(element, scope, e);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::unary_operator_node>(ptr))
+	{
+		collect(cast->get_operand(), scope, e);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::operator_node>(ptr))
+	{
+		e.fails = e.fails || cast->get_operation() == ast::operation::DIVIDE || cast->get_operation() == ast::operation::MODULUS;
+		collect(cast->get_operand_a(), scope, e);
+		collect(cast->get_operand_b(), scope, e);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
+	{
+		collect(cast->get_condition(), scope, e);
+		collect(cast->get_value_true(), scope, e);
+		collect(cast->get_value_false(), scope, e);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::match_node>(ptr))
+	{
+		collect(cast->get_value(), scope, e);
+		for(const auto& c : cast->get_cases())
+			collect(c->get_result(), scope, e);
+		collect(cast->get_otherwise(), scope, e);
+	}
+}
+
+
+void collect(const std::shared_ptr<ast::statement_node>& ptr, local_names& scope, effects& e)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::let_node>(ptr))
+	{
+		collect(cast->get_value(), scope, e);
+		scope.push_back(cast->get_name());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_node>(ptr))
+	{
+		const size_t outer = scope.size();
+		collect(cast->get_condition(), scope, e);
+		collect(cast->get_branch_true(), scope, e);
+		scope.resize(outer);
+		if (cast->get_branch_false())
+			collect(cast->get_branch_false(), scope, e);
+		scope.resize(outer);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::return_node>(ptr))
+	{
+		collect(cast->get_value(), scope, e);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::block_node>(ptr))
+	{
+		const size_t outer = scope.size();
+		for(const auto& statement : cast->get_statements())
+			collect(statement, scope, e);
+		scope.resize(outer);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::expression_node>(ptr))
+	{
+		collect(cast, scope, e);
+	}
+	else if (std::dynamic_pointer_cast<ast::function_node>(ptr))
+	{
+		e.indirect = true;
+	}
+}
+
+
+purity_info analysis::find_pure_functions(const std::vector<std::shared_ptr<ast::statement_node>>& ast)
+{
+	std::unordered_map<std::string, effects> functions = { };
+	std::unordered_set<std::string> overloaded = { };
+	for(const auto& ptr : ast)
+	{
+		if (const auto record = std::dynamic_pointer_cast<ast::record_node>(ptr))
+		{
+			// Constructing a record only computes the default values of the fields it is not given
+			if (functions.count(record->get_name()))
+				overloaded.insert(record->get_name());
+
+			effects& e = functions[record->get_name()];
+			local_names scope = { };
+			for(const auto& field : record->get_fields())
+			{
+				if (field->get_default_value())
+					collect(field->get_default_value(), scope, e);
+			}
+			continue;
+		}
+
+		const auto cast = std::dynamic_pointer_cast<ast::function_node>(ptr);
+		if (!cast)
+			continue;
+
+		if (functions.count(cast->get_name()))
+			overloaded.insert(cast->get_name());
+
+		effects& e = functions[cast->get_name()];
+		local_names scope = { };
+		for(const auto& parameter : cast->get_parameters())
+			scope.push_back(parameter->get_name());
+		collect(cast->get_body(), scope, e);
+
+		e.indirect = e.indirect || cast->get_name() == "main" || cast->get_specifiers().count(ast::specifier::IO);
+	}
+
+	// Functions calling anything impure are impure themselves, until nothing changes
+	const auto prune = [](std::unordered_map<std::string, const effects*>& candidates) {
+		for(bool changed = true; changed;)
+		{
+			changed = false;
+			for(auto it = candidates.begin(); it != candidates.end();)
+			{
+				bool impure = false;
+				for(const auto& callee : it->second->refs.calls)
+					impure = impure || !candidates.count(callee);
+
+				if (impure)
+				{
+					it = candidates.erase(it);
+					changed = true;
+				}
+				else
+					++it;
+			}
+		}
+	};
+
+	std::unordered_map<std::string, const effects*> pure = { };
+	for(const auto& [name, e] : functions)
+	{
+		if (!e.indirect && !overloaded.count(name))
+			pure[name] = &e;
+	}
+	prune(pure);
+
+	std::unordered_map<std::string, references> calls = { };
+	for(const auto& [name, e] : functions)
+		calls[name] = e.refs;
+
+	std::unordered_map<std::string, int> state = { };
+	std::unordered_map<std::string, const effects*> total = { };
+	for(const auto& [name, e] : pure)
+	{
+		if (!e->fails && !is_recursive(name, calls, state))
+			total[name] = e;
+	}
+	prune(total);
+
+	purity_info result = { };
+	for(const auto& [name, e] : pure)
+		result.pure.insert(name);
+	for(const auto& [name, e] : total)
+		result.total.insert(name);
+	return result;
+}
+
+
+std::unordered_set<std::string> analysis::find_reachable(const std::vector<std::shared_ptr<ast::statement_node>>& ast, const purity_info& purity)
+{
+	// What each top-level name refers to, merged over overloads
+	std::unordered_map<std::string, references> uses = { };
+	std::vector<std::string> pending = { };
+	bool has_main = false;
+	for(const auto& ptr : ast)
+	{
+		effects e = { };
+		local_names scope = { };
+		std::string name = "";
+		bool entry = false;
+
+		if (const auto cast = std::dynamic_pointer_cast<ast::function_node>(ptr))
+		{
+			// Default values are evaluated by the callers, but still belong to the function
+			for(const auto& parameter : cast->get_parameters())
+			{
+				if (parameter->get_default_value())
+					collect(parameter->get_default_value(), scope, e);
+				scope.push_back(parameter->get_name());
+			}
+			collect(cast->get_body(), scope, e);
+
+			name = cast->get_name();
+			has_main = has_main || name == "main";
+			entry = name == "main" || cast->get_specifiers().count(ast::specifier::IO);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::let_node>(ptr))
+		{
+			collect(cast->get_value(), scope, e);
+			name = cast->get_name();
+
+			// Top-level lets are computed before main, so one that could print, fail or loop forever must stay. Lazy lets
+			// are only computed when used.
+			entry = !cast->is_lazy() && (e.indirect || e.fails);
+			for(const auto& callee : e.refs.calls)
+				entry = entry || (!cast->is_lazy() && !purity.total.count(callee));
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::record_node>(ptr))
+		{
+			// Records are always declared, so whatever their default values use must stay
+			for(const auto& field : cast->get_fields())
+			{
+				if (field->get_default_value())
+					collect(field->get_default_value(), scope, e);
+			}
+			name = cast->get_name();
+			entry = true;
+		}
+		else
+		{
+			collect(ptr, scope, e);
+			entry = true;
+		}
+
+		auto& refs = uses[name];
+		refs.calls.insert(e.refs.calls.begin(), e.refs.calls.end());
+		refs.globals.insert(e.refs.globals.begin(), e.refs.globals.end());
+		if (entry)
+			pending.push_back(name);
+	}
+
+	std::unordered_set<std::string> result = { };
+	if (!has_main)
+	{
+		// Without main, the C++ is included by other code which may use anything
+		for(const auto& [name, refs] : uses)
+			result.insert(name);
+		return result;
+	}
+
+	while(!pending.empty())
+	{
+		const std::string name = std::move(pending.back());
+		pending.pop_back();
+		if (!result.insert(name).second)
+			continue;
+
+		const auto it = uses.find(name);
+		if (it == uses.end())
+			continue;
+		pending.insert(pending.end(), it->second.calls.begin(), it->second.calls.end());
+		pending.insert(pending.end(), it->second.globals.begin(), it->second.globals.end());
+	}
+	return result;
+}
+
+
+// Where the function values of a function flow, to find the parameters and lambdas whose value may outlive a call
+class escape_graph
+{
+public:
+	escape_graph(
+		const std::unordered_map<std::string, const ast::function_node*>& functions) noexcept:
+		functions(functions),
+		scope({ }),
+		lambdas({ }),
+		thunks({ }),
+		edges({ }),
+		escaping({ })
+	{ }
+
+	/**
+	 * @brief Adds a function's body to the graph
+	 */
+	void add(const ast::function_node& function)
+	{
+		for(const auto& parameter : function.get_parameters())
+			scope.emplace_back(parameter->get_name(), parameter.get());
+		add(function.get_body());
+		scope.clear();
+	}
+
+	/**
+	 * @brief Returns every parameter, let and lambda whose value may outlive the call that created it
+	 */
+	std::unordered_set<const ast::node*> get_escaping() const
+	{
+		std::unordered_set<const ast::node*> result = { };
+		std::vector<const ast::node*> pending(escaping.begin(), escaping.end());
+		while(!pending.empty())
+		{
+			const ast::node* n = pending.back();
+			pending.pop_back();
+			if (!result.insert(n).second)
+				continue;
+
+			const auto [begin, end] = edges.equal_range(n);
+			for(auto it = begin; it != end; ++it)
+				pending.push_back(it->second);
+		}
+		return result;
+	}
+
+private:
+	void add(const std::shared_ptr<ast::statement_node>& ptr)
+	{
+		if (const auto cast = std::dynamic_pointer_cast<ast::let_node>(ptr))
+		{
+			if (cast->is_lazy())
+			{
+				// Lazy lets keep the names their value uses, like lambdas. Their value is held apart from the thunk,
+				// which only escapes with the lambdas using it.
+				lambdas.emplace_back(cast.get(), scope.size());
+				value(cast->get_value(), cast->get_value().get());
+				lambdas.pop_back();
+				thunks.emplace(cast->get_value().get(), cast.get());
+				scope.emplace_back(cast->get_name(), cast->get_value().get());
+				return;
+			}
+
+			// The let holds whatever its value holds
+			value(cast->get_value(), cast.get());
+			scope.emplace_back(cast->get_name(), cast.get());
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_node>(ptr))
+		{
+			const size_t outer = scope.size();
+			value(cast->get_condition(), nullptr);
+			add(cast->get_branch_true());
+			scope.resize(outer);
+			if (cast->get_branch_false())
+				add(cast->get_branch_false());
+			scope.resize(outer);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::return_node>(ptr))
+		{
+			value(cast->get_value(), nullptr);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::block_node>(ptr))
+		{
+			const size_t outer = scope.size();
+			for(const auto& statement : cast->get_statements())
+				add(statement);
+			scope.resize(outer);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::expression_node>(ptr))
+		{
+			value(cast, nullptr);
+		}
+	}
+
+	/**
+	 * Adds an expression whose value is held by a let, or escapes when there is none. Only the values of names and
+	 * lambdas matter, anything computed by a call is a new value that does not borrow anything.
+	 */
+	void value(const std::shared_ptr<ast::expression_node>& ptr, const ast::node* holder)
+	{
+		if (const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr))
+		{
+			if (const ast::node* binding = lookup(cast->get_value()))
+				flow(binding, holder);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::lambda_node>(ptr))
+		{
+			flow(cast.get(), holder);
+
+			// Names the lambda uses from outside are copied if the lambda escapes, and must then stay valid
+			const size_t outer = scope.size();
+			lambdas.emplace_back(cast.get(), outer);
+			for(const auto& parameter : cast->get_parameters())
+				scope.emplace_back(parameter->get_name(), parameter.get());
+			for(const auto& statement : cast->get_statements())
+				add(statement);
+			scope.resize(outer);
+			lambdas.pop_back();
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::group_node>(ptr))
+		{
+			value(cast->get_expression(), holder);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::array_literal_node>(ptr))
+		{
+			// Arrays copy their elements, which then go wherever the array goes
+			for(const auto& element : cast->get_elements())
+				value(element, nullptr);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
+		{
+			value(cast->get_condition(), nullptr);
+			value(cast->get_value_true(), holder);
+			value(cast->get_value_false(), holder);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::match_node>(ptr))
+		{
+			value(cast->get_value(), nullptr);
+			for(const auto& c : cast->get_cases())
+				value(c->get_result(), holder);
+			value(cast->get_otherwise(), holder);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::unary_operator_node>(ptr))
+		{
+			value(cast->get_operand(), nullptr);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::field_access_node>(ptr))
+		{
+			// Fields are copied out of the record
+			value(cast->get_record(), nullptr);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::operator_node>(ptr))
+		{
+			value(cast->get_operand_a(), nullptr);
+			value(cast->get_operand_b(), nullptr);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr))
+		{
+			call(*cast);
+		}
+	}
+
+	void call(const ast::function_call_node& call)
+	{
+		// Calling a function value does not keep it, only what it is given may be kept
+		const auto callee = std::dynamic_pointer_cast<ast::identifier_node>(call.get_function());
+		const ast::function_node* function = nullptr;
+		bool builtin = false;
+		if (callee && !lookup(callee->get_value()))
+		{
+			const auto it = functions.find(callee->get_value());
+			function = it != functions.end() ? it->second : nullptr;
+			builtin = it == functions.end() && is_array_builtin(callee->get_value());
+		}
+		else if (const auto lambda = std::dynamic_pointer_cast<ast::lambda_node>(call.get_function()))
+		{
+			// Lambdas applied right away are only used for the call
+			value(lambda, lambda.get());
+		}
+		else if (!callee)
+			value(call.get_function(), nullptr);
+
+		const auto& arguments = call.get_arguments();
+		for(size_t i = 0; i < arguments.size(); ++i)
+		{
+			// Arguments of top-level functions are held by their parameter, and outlive the call only if it escapes.
+			// Builtins hold them for the call only.
+			const bool known = function && i < function->get_parameters().size();
+			value(arguments[i], known ? function->get_parameters()[i].get() : builtin ? static_cast<const ast::node*>(&call) : nullptr);
+		}
+	}
+
+	// Makes a value escape along with its holder, or right away without one
+	void flow(const ast::node* value, const ast::node* holder)
+	{
+		if (holder)
+			edges.emplace(holder, value);
+		else
+			escaping.push_back(value);
+	}
+
+	// Finds the parameter or let a name refers to. Lambdas between here and there keep it, so it escapes with them.
+	const ast::node* lookup(const std::string& name)
+	{
+		for(size_t i = scope.size(); i-- > 0;)
+		{
+			if (scope[i].first != name)
+				continue;
+
+			const auto thunk = thunks.find(scope[i].second);
+			for(auto it = lambdas.rbegin(); it != lambdas.rend() && it->second > i; ++it)
+			{
+				edges.emplace(it->first, scope[i].second);
+				if (thunk != thunks.end())
+					edges.emplace(it->first, thunk->second);
+			}
+			return scope[i].second;
+		}
+		return nullptr;
+	}
+
+	const std::unordered_map<std::string, const ast::function_node*>& functions;
+
+	// Parameters and lets in scope, innermost last
+	std::vector<std::pair<std::string, const ast::node*>> scope;
+
+	// Lambdas and lazy lets being added, with the size of the scope outside of each
+	std::vector<std::pair<const ast::node*, size_t>> lambdas;
+
+	// Lazy lets by the value they hold, which is what their name refers to
+	std::unordered_map<const ast::node*, const ast::let_node*> thunks;
+
+	// When the first node escapes, so does the second
+	std::unordered_multimap<const ast::node*, const ast::node*> edges;
+	std::vector<const ast::node*> escaping;
+};
+
+
+closure_info analysis::find_closures(const std::vector<std::shared_ptr<ast::statement_node>>& ast)
+{
+	std::unordered_map<std::string, const ast::function_node*> functions = { };
+	closure_info result = { };
+	for(const auto& ptr : ast)
+	{
+		// Records keep whatever they are given
+		if (const auto record = std::dynamic_pointer_cast<ast::record_node>(ptr))
+			functions[record->get_name()] = nullptr;
+
+		const auto cast = std::dynamic_pointer_cast<ast::function_node>(ptr);
+		if (!cast)
+			continue;
+
+		// Calls to overloaded functions cannot tell which parameters they pass their arguments to
+		const auto [it, inserted] = functions.emplace(cast->get_name(), cast.get());
+		if (!inserted)
+			it->second = nullptr;
+
+		for(const auto& parameter : cast->get_parameters())
+		{
+			if (std::dynamic_pointer_cast<ast::function_type_node>(parameter->get_type()))
+				result.borrowed.insert(parameter.get());
+		}
+	}
+
+	escape_graph graph(functions);
+	for(const auto& ptr : ast)
+	{
+		if (const auto cast = std::dynamic_pointer_cast<ast::function_node>(ptr))
+			graph.add(*cast);
+	}
+
+	// Function-typed parameters are borrowed unless they escape
+	const auto escaping = graph.get_escaping();
+	for(auto it = result.borrowed.begin(); it != result.borrowed.end();)
+		it = escaping.count(*it) ? result.borrowed.erase(it) : std::next(it);
+	for(const ast::node* n : escaping)
+	{
+		if (const auto lambda = dynamic_cast<const ast::lambda_node*>(n))
+			result.escaping.insert(lambda);
+		else if (const auto let = dynamic_cast<const ast::let_node*>(n); let && let->is_lazy())
+			result.shared.insert(let);
+	}
+
+	return result;
+}
+
+
+// What a function allocates, and how often, to find the calls whose arrays can all come from a region
+struct allocations
+{
+	// Top-level functions called directly, and top-level lets used
+	references refs;
+
+	// Top-level functions that may run any number of times per call: called from a lambda, or given as a value
+	std::unordered_set<std::string> repeated_calls;
+
+	// Whether the function makes arrays, once per call or in lambdas, which may run any number of times
+	bool allocates = false;
+	bool allocates_repeatedly = false;
+
+	// Whether it makes function values, lambdas or top-level functions given as values
+	bool makes_functions = false;
+};
+
+
+// Whether a builtin returns a new array
+bool makes_array(const std::string& name)
+{
+	static const std::unordered_set<std::string> builtins = {"map", "filter", "zip", "range", "pmap", "keys", "values", "to_array"};
+	return builtins.count(name);
+}
+
+
+void collect_allocations(const std::shared_ptr<ast::statement_node>& ptr, const std::unordered_set<std::string>& functions, local_names& scope, bool repeated, allocations& a);
+
+
+void collect_allocations(const std::shared_ptr<ast::expression_node>& ptr, const std::unordered_set<std::string>& functions, local_names& scope, bool repeated, allocations& a)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr))
+	{
+		const auto callee = std::dynamic_pointer_cast<ast::identifier_node>(cast->get_function());
+		if (!callee || is_local(callee->get_value(), scope))
+			collect_allocations(cast->get_function(), functions, scope, repeated, a);
+		else if (functions.count(callee->get_value()))
+			(repeated ? a.repeated_calls : a.refs.calls).insert(callee->get_value());
+		else if (makes_array(callee->get_value()))
+			(repeated ? a.allocates_repeatedly : a.allocates) = true;
+		else
+			a.refs.globals.insert(callee->get_value());
+
+		for(const auto& argument : cast->get_arguments())
+			collect_allocations(argument, functions, scope, repeated, a);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::lambda_node>(ptr))
+	{
+		a.makes_functions = true;
+		const size_t outer = scope.size();
+		for(const auto& parameter : cast->get_parameters())
+			scope.push_back(parameter->get_name());
+		for(const auto& statement : cast->get_statements())
+			collect_allocations(statement, functions, scope, true, a);
+		scope.resize(outer);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr))
+	{
+		if (is_local(cast->get_value(), scope))
+			return;
+		if (functions.count(cast->get_value()))
+		{
+			a.makes_functions = true;
+			a.repeated_calls.insert(cast->get_value());
+		}
+		else
+			a.refs.globals.insert(cast->get_value());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::group_node>(ptr))
+	{
+		collect_allocations(cast->get_expression(), functions, scope, repeated, a);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::field_access_node>(ptr))
+	{
+		collect_allocations(cast->get_record(), functions, scope, repeated, a);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::array_literal_node>(ptr))
+	{
+		// The empty literal has no elements to allocate
+		if (!cast->get_elements().empty())
+			(repeated ? a.allocates_repeatedly : a.allocates) = true;
+		for(const auto& element : cast->get_elements())
+			collect_allocations(element, functions, scope, repeated, a);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::unary_operator_node>(ptr))
+	{
+		collect_allocations(cast->get_operand(), functions, scope, repeated, a);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::operator_node>(ptr))
+	{
+		collect_allocations(cast->get_operand_a(), functions, scope, repeated, a);
+		collect_allocations(cast->get_operand_b(), functions, scope, repeated, a);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
+	{
+		collect_allocations(cast->get_condition(), functions, scope, repeated, a);
+		collect_allocations(cast->get_value_true(), functions, scope, repeated, a);
+		collect_allocations(cast->get_value_false(), functions, scope, repeated, a);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::match_node>(ptr))
+	{
+		collect_allocations(cast->get_value(), functions, scope, repeated, a);
+		for(const auto& c : cast->get_cases())
+			collect_allocations(c->get_result(), functions, scope, repeated, a);
+		collect_allocations(cast->get_otherwise(), functions, scope, repeated, a);
+	}
+}
+
+
+void collect_allocations(const std::shared_ptr<ast::statement_node>& ptr, const std::unordered_set<std::string>& functions, local_names& scope, bool repeated, allocations& a)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::let_node>(ptr))
+	{
+		collect_allocations(cast->get_value(), functions, scope, repeated, a);
+		scope.push_back(cast->get_name());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_node>(ptr))
+	{
+		const size_t outer = scope.size();
+		collect_allocations(cast->get_condition(), functions, scope, repeated, a);
+		collect_allocations(cast->get_branch_true(), functions, scope, repeated, a);
+		scope.resize(outer);
+		if (cast->get_branch_false())
+			collect_allocations(cast->get_branch_false(), functions, scope, repeated, a);
+		scope.resize(outer);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::return_node>(ptr))
+	{
+		collect_allocations(cast->get_value(), functions, scope, repeated, a);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::block_node>(ptr))
+	{
+		const size_t outer = scope.size();
+		for(const auto& statement : cast->get_statements())
+			collect_allocations(statement, functions, scope, repeated, a);
+		scope.resize(outer);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::expression_node>(ptr))
+	{
+		collect_allocations(cast, functions, scope, repeated, a);
+	}
+	else if (std::dynamic_pointer_cast<ast::function_node>(ptr))
+	{
+		a.allocates_repeatedly = true;
+	}
+}
+
+
+// What deciding whether calls allocate a bounded number of arrays needs, and what it found so far
+struct bounds
+{
+	const std::unordered_map<std::string, allocations>& functions;
+	const std::unordered_map<std::string, references>& graph;
+	const std::unordered_set<std::string>& allocating;
+	std::unordered_map<std::string, int> recursion;
+	std::unordered_map<std::string, bool> bounded;
+};
+
+
+// Whether a call allocates a bounded number of arrays: none in lambdas, and neither do the functions it calls, which
+// must not recurse. Loops would otherwise keep every array they make until the region ends.
+bool is_bounded(const std::string& name, bounds& b)
+{
+	if (!b.allocating.count(name))
+		return true;
+	if (const auto it = b.bounded.find(name); it != b.bounded.end())
+		return it->second;
+
+	const allocations& a = b.functions.at(name);
+	bool result = !a.allocates_repeatedly && !is_recursive(name, b.graph, b.recursion);
+	for(const auto& callee : a.repeated_calls)
+		result = result && !b.allocating.count(callee);
+	for(const auto& callee : a.refs.calls)
+		result = result && is_bounded(callee, b);
+	return b.bounded[name] = result;
+}
+
+
+void collect_allocations(const std::vector<std::shared_ptr<ast::parameter_node>>& parameters, const std::unordered_set<std::string>& functions, local_names& scope, allocations& a)
+{
+	for(const auto& parameter : parameters)
+	{
+		if (parameter->get_default_value())
+			collect_allocations(parameter->get_default_value(), functions, scope, false, a);
+		scope.push_back(parameter->get_name());
+	}
+}
+
+
+std::unordered_set<std::string> analysis::find_regions(const std::vector<std::shared_ptr<ast::statement_node>>& ast)
+{
+	std::unordered_set<std::string> names = { };
+	for(const auto& ptr : ast)
+	{
+		if (const auto cast = std::dynamic_pointer_cast<ast::function_node>(ptr))
+			names.insert(cast->get_name());
+		else if (const auto cast = std::dynamic_pointer_cast<ast::record_node>(ptr))
+			names.insert(cast->get_name());
+	}
+
+	// Overloads share an entry, and must all qualify. Lazy lets keep the value they compute, and lets holding
+	// functions may allocate whenever they are called, which nothing here can follow.
+	std::unordered_map<std::string, allocations> functions = { };
+	std::unordered_map<std::string, bool> candidates = { };
+	std::unordered_set<std::string> opaque = { };
+	for(const auto& ptr : ast)
+	{
+		local_names scope = { };
+		if (const auto cast = std::dynamic_pointer_cast<ast::function_node>(ptr))
+		{
+			allocations& a = functions[cast->get_name()];
+			collect_allocations(cast->get_parameters(), names, scope, a);
+			collect_allocations(cast->get_body(), names, scope, false, a);
+
+			// Nothing a call allocates can leave it through a scalar result, and its arguments cannot allocate in it
+			const auto return_type = std::dynamic_pointer_cast<ast::identifier_node>(cast->get_return_type());
+			bool candidate = cast->get_name() != "main" && !cast->get_specifiers().count(ast::specifier::IO)
+				&& return_type && (is_scalar(return_type) || is_bigint(return_type->get_value()));
+			for(const auto& parameter : cast->get_parameters())
+				candidate = candidate && !std::dynamic_pointer_cast<ast::function_type_node>(parameter->get_type());
+
+			const auto [it, inserted] = candidates.emplace(cast->get_name(), candidate);
+			it->second = it->second && candidate;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::record_node>(ptr))
+			collect_allocations(cast->get_fields(), names, scope, functions[cast->get_name()]);
+		else if (const auto cast = std::dynamic_pointer_cast<ast::let_node>(ptr))
+		{
+			allocations value = { };
+			collect_allocations(cast->get_value(), names, scope, false, value);
+			if (value.makes_functions || (cast->is_lazy() && !(cast->get_type() && is_scalar(cast->get_type()))))
+				opaque.insert(cast->get_name());
+		}
+	}
+
+	// Functions allocating, or using opaque lets, directly or through whatever they call, until nothing changes
+	std::unordered_map<std::string, references> graph = { };
+	std::unordered_set<std::string> allocating = { };
+	std::unordered_set<std::string> unsafe = { };
+	for(const auto& [name, a] : functions)
+	{
+		graph[name].calls = a.refs.calls;
+		graph[name].calls.insert(a.repeated_calls.begin(), a.repeated_calls.end());
+		if (a.allocates || a.allocates_repeatedly)
+			allocating.insert(name);
+		for(const auto& global : a.refs.globals)
+		{
+			if (opaque.count(global))
+				unsafe.insert(name);
+		}
+	}
+	for(bool changed = true; changed;)
+	{
+		changed = false;
+		for(const auto& [name, refs] : graph)
+		{
+			for(const auto& callee : refs.calls)
+			{
+				if (allocating.count(callee) && allocating.insert(name).second)
+					changed = true;
+				if (unsafe.count(callee) && unsafe.insert(name).second)
+					changed = true;
+			}
+		}
+	}
+
+	bounds b = {functions, graph, allocating, { }, { }};
+	std::unordered_set<std::string> result = { };
+	for(const auto& [name, candidate] : candidates)
+	{
+		if (candidate && allocating.count(name) && !unsafe.count(name) && is_bounded(name, b))
+			result.insert(name);
+	}
+	return result;
+}
+
+
+// Top-level declarations, whose types tell what the names they declare hold
+struct declarations
+{
+	// Return types of top-level functions, null for overloaded names
+	std::unordered_map<std::string, std::shared_ptr<ast::type_node>> functions;
+
+	// Types of the values of top-level lets, as described by describe_type
+	std::unordered_map<std::string, std::string> lets;
+
+	std::unordered_map<std::string, std::shared_ptr<ast::record_node>> records;
+};
+
+
+// Parameters and lets in scope, with the types of their values as described by describe_type
+typedef std::vector<std::pair<std::string, std::string>> typed_names;
+
+
+// Names a type that is known not to be an integer or a boolean, or returns an empty string
+std::string describe_type(const std::shared_ptr<ast::type_node>& ptr, const declarations& d)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr))
+	{
+		const std::string& name = cast->get_value();
+		return (is_floating_point(name) || is_bigint(name) || d.records.count(name)) ? name : "";
+	}
+	else if (std::dynamic_pointer_cast<ast::array_type_node>(ptr))
+		return "array";
+	else if (std::dynamic_pointer_cast<ast::map_type_node>(ptr))
+		return "map";
+	else if (std::dynamic_pointer_cast<ast::vector_type_node>(ptr))
+		return "vector";
+	else if (std::dynamic_pointer_cast<ast::function_type_node>(ptr))
+		return "function";
+	return "";
+}
+
+
+// Names the type of an expression when declared types and literals show it is not an integer or a boolean, or
+// returns an empty string
+std::string describe_value(const std::shared_ptr<ast::expression_node>& ptr, const typed_names& scope, const declarations& d)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::floating_literal_node>(ptr))
+		return cast->get_suffix() == "f" ? "float" : "double";
+	else if (const auto cast = std::dynamic_pointer_cast<ast::numeric_literal_node>(ptr))
+		return cast->get_suffix() == "n" ? "bigint" : "";
+	else if (const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr))
+	{
+		for(auto it = scope.rbegin(); it != scope.rend(); ++it)
+		{
+			if (it->first == cast->get_value())
+				return it->second;
+		}
+		if (const auto let = d.lets.find(cast->get_value()); let != d.lets.end())
+			return let->second;
+		return d.functions.count(cast->get_value()) || d.records.count(cast->get_value()) ? "function" : "";
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr))
+	{
+		const auto callee = std::dynamic_pointer_cast<ast::identifier_node>(cast->get_function());
+		if (!callee || std::any_of(scope.begin(), scope.end(), [&](const auto& local) { return local.first == callee->get_value(); }))
+			return "";
+
+		const std::string& name = callee->get_value();
+		if (is_floating_point(name) || is_bigint(name) || d.records.count(name))
+			return name;
+		const auto function = d.functions.find(name);
+		return function != d.functions.end() ? describe_type(function->second, d) : "";
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::field_access_node>(ptr))
+	{
+		const auto record = d.records.find(describe_value(cast->get_record(), scope, d));
+		if (record == d.records.end())
+			return "";
+		for(const auto& field : record->second->get_fields())
+		{
+			if (field->get_name() == cast->get_field())
+				return describe_type(field->get_type(), d);
+		}
+		return "";
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::group_node>(ptr))
+		return describe_value(cast->get_expression(), scope, d);
+	else if (const auto cast = std::dynamic_pointer_cast<ast::unary_operator_node>(ptr))
+		return cast->get_operation() == ast::unary_operation::NOT ? "" : describe_value(cast->get_operand(), scope, d);
+	else if (const auto cast = std::dynamic_pointer_cast<ast::operator_node>(ptr))
+	{
+		const auto operation = cast->get_operation();
+		if (operation != ast::operation::ADD && operation != ast::operation::SUBTRACT && operation != ast::operation::MULTIPLY
+			&& operation != ast::operation::DIVIDE && operation != ast::operation::MODULUS)
+			return "";
+
+		// Arithmetic gives the wider of the two types, like in C++
+		const std::string a = describe_value(cast->get_operand_a(), scope, d);
+		const std::string b = describe_value(cast->get_operand_b(), scope, d);
+		for(const char* type : {"double", "float", "bigint"})
+		{
+			if (a == type || b == type)
+				return type;
+		}
+		return "";
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
+	{
+		const std::string type = describe_value(cast->get_value_true(), scope, d);
+		return type.empty() ? describe_value(cast->get_value_false(), scope, d) : type;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::match_node>(ptr))
+	{
+		for(const auto& c : cast->get_cases())
+		{
+			if (const std::string type = describe_value(c->get_result(), scope, d); !type.empty())
+				return type;
+		}
+		return describe_value(cast->get_otherwise(), scope, d);
+	}
+	else if (std::dynamic_pointer_cast<ast::array_literal_node>(ptr))
+		return "array";
+	else if (std::dynamic_pointer_cast<ast::lambda_node>(ptr))
+		return "function";
+	return "";
+}
+
+
+void collect_non_integer_matches(const std::shared_ptr<ast::statement_node>& ptr, typed_names& scope, const declarations& d, std::vector<match_error>& errors);
+
+
+void collect_non_integer_matches(const std::vector<std::shared_ptr<ast::parameter_node>>& parameters, typed_names& scope, const declarations& d, std::vector<match_error>& errors)
+{
+	for(const auto& parameter : parameters)
+	{
+		if (parameter->get_default_value())
+			collect_non_integer_matches(parameter->get_default_value(), scope, d, errors);
+		scope.emplace_back(parameter->get_name(), describe_type(parameter->get_type(), d));
+	}
+}
+
+
+void collect_non_integer_matches(const std::shared_ptr<ast::expression_node>& ptr, typed_names& scope, const declarations& d, std::vector<match_error>& errors)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::match_node>(ptr))
+	{
+		if (const std::string type = describe_value(cast->get_value(), scope, d); !type.empty())
+			errors.push_back({cast, type});
+
+		collect_non_integer_matches(cast->get_value(), scope, d, errors);
+		for(const auto& c : cast->get_cases())
+			collect_non_integer_matches(c->get_result(), scope, d, errors);
+		collect_non_integer_matches(cast->get_otherwise(), scope, d, errors);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr))
+	{
+		collect_non_integer_matches(cast->get_function(), scope, d, errors);
+		for(const auto& argument : cast->get_arguments())
+			collect_non_integer_matches(argument, scope, d, errors);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::lambda_node>(ptr))
+	{
+		const size_t outer = scope.size();
+		collect_non_integer_matches(cast->get_parameters(), scope, d, errors);
+		for(const auto& statement : cast->get_statements())
+			collect_non_integer_matches(statement, scope, d, errors);
+		scope.resize(outer);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::group_node>(ptr))
+	{
+		collect_non_integer_matches(cast->get_expression(), scope, d, errors);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::field_access_node>(ptr))
+	{
+		collect_non_integer_matches(cast->get_record(), scope, d, errors);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::array_literal_node>(ptr))
+	{
+		for(const auto& element : cast->get_elements())
+			collect_non_integer_matches(element, scope, d, errors);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::unary_operator_node>(ptr))
+	{
+		collect_non_integer_matches(cast->get_operand(), scope, d, errors);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::operator_node>(ptr))
+	{
+		collect_non_integer_matches(cast->get_operand_a(), scope, d, errors);
+		collect_non_integer_matches(cast->get_operand_b(), scope, d, errors);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
+	{
+		collect_non_integer_matches(cast->get_condition(), scope, d, errors);
+		collect_non_integer_matches(cast->get_value_true(), scope, d, errors);
+		collect_non_integer_matches(cast->get_value_false(), scope, d, errors);
+	}
+}
+
+
+void collect_non_integer_matches(const std::shared_ptr<ast::statement_node>& ptr, typed_names& scope, const declarations& d, std::vector<match_error>& errors)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::let_node>(ptr))
+	{
+		collect_non_integer_matches(cast->get_value(), scope, d, errors);
+		scope.emplace_back(cast->get_name(), cast->get_type() ? describe_type(cast->get_type(), d) : describe_value(cast->get_value(), scope, d));
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_node>(ptr))
+	{
+		const size_t outer = scope.size();
+		collect_non_integer_matches(cast->get_condition(), scope, d, errors);
+		collect_non_integer_matches(cast->get_branch_true(), scope, d, errors);
+		scope.resize(outer);
+		if (cast->get_branch_false())
+			collect_non_integer_matches(cast->get_branch_false(), scope, d, errors);
+		scope.resize(outer);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::return_node>(ptr))
+	{
+		collect_non_integer_matches(cast->get_value(), scope, d, errors);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::block_node>(ptr))
+	{
+		const size_t outer = scope.size();
+		for(const auto& statement : cast->get_statements())
+			collect_non_integer_matches(statement, scope, d, errors);
+		scope.resize(outer);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::expression_node>(ptr))
+	{
+		collect_non_integer_matches(cast, scope, d, errors);
+	}
+}
+
+
+std::vector<match_error> analysis::find_non_integer_matches(const std::vector<std::shared_ptr<ast::statement_node>>& ast)
+{
+	declarations d = { };
+	for(const auto& ptr : ast)
+	{
+		if (const auto cast = std::dynamic_pointer_cast<ast::function_node>(ptr))
+		{
+			const bool overloaded = d.functions.count(cast->get_name());
+			d.functions[cast->get_name()] = overloaded ? nullptr : cast->get_return_type();
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::record_node>(ptr))
+			d.records[cast->get_name()] = cast;
+	}
+	for(const auto& ptr : ast)
+	{
+		if (const auto cast = std::dynamic_pointer_cast<ast::let_node>(ptr))
+			d.lets[cast->get_name()] = cast->get_type() ? describe_type(cast->get_type(), d) : describe_value(cast->get_value(), { }, d);
+	}
+
+	std::vector<match_error> errors = { };
+	for(const auto& ptr : ast)
+	{
+		typed_names scope = { };
+		if (const auto cast = std::dynamic_pointer_cast<ast::function_node>(ptr))
+		{
+			collect_non_integer_matches(cast->get_parameters(), scope, d, errors);
+			collect_non_integer_matches(cast->get_body(), scope, d, errors);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::record_node>(ptr))
+			collect_non_integer_matches(cast->get_fields(), scope, d, errors);
+		else
+			collect_non_integer_matches(ptr, scope, d, errors);
+	}
+	return errors;
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "nodes.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+namespace pebkac::analysis
+{
+	/**
+	 * @brief Exact C++ types of values that are known to be integers or booleans. Anything else, including the plain
+	 * int of numeric literals, is UNKNOWN.
+	 */
+	enum class scalar_type
+	{
+		UNKNOWN,
+		INTEGER,
+		BOOLEAN,
+	};
+
+	/**
+	 * @brief Returns the scalar type a declared type names, or UNKNOWN for function types and missing types
+	 */
+	scalar_type get_scalar_type(const std::shared_ptr<ast::type_node>& type);
+
+	/**
+	 * @brief Whether a name is one of the fixed-width integer types, i8 to i64 and u8 to u64
+	 *
+	 * Calling one like u8(x) is a conversion, which fails when the value does not fit.
+	 */
+	bool is_fixed_width(const std::string& name);
+
+	/**
+	 * @brief Whether a name is float or double. Calling one like double(x) is a conversion.
+	 */
+	bool is_floating_point(const std::string& name);
+
+	/**
+	 * @brief Whether a name is bigint, the integer type of any size. Calling it like bigint(x) is a conversion.
+	 */
+	bool is_bigint(const std::string& name);
+
+	/**
+	 * @brief Whether any type, conversion or literal in the AST is float or double
+	 */
+	bool uses_floating_point(const std::vector<std::shared_ptr<ast::statement_node>>& ast);
+
+	/**
+	 * @brief Whether a name is one of the array functions every program can call, unless it declares the name itself
+	 *
+	 * They only call the functions they are given, and never keep them.
+	 */
+	bool is_array_builtin(const std::string& name);
+
+	/**
+	 * @brief Whether a name is one of the functions on persistent maps and vectors, unless the program declares it
+	 *
+	 * Unlike the array functions, they keep the values they are given, functions included.
+	 */
+	bool is_persistent_builtin(const std::string& name);
+
+
+	/**
+	 * @brief Top-level declarations that C++ can evaluate at compile time
+	 */
+	struct constant_info
+	{
+		// Pure, non-io functions over integers and booleans, which can be declared constexpr
+		std::unordered_set<std::string> functions;
+
+		// Top-level lets whose value can be computed at compile time
+		std::unordered_set<std::string> constants;
+	};
+
+	/**
+	 * @brief Finds the top-level functions and lets that only depend on constants and on each other
+	 *
+	 * Lets calling recursive functions are left out, as evaluating them at compile time could exceed the
+	 * C++ compiler's constexpr evaluation limits. The functions themselves stay constexpr.
+	 */
+	constant_info find_constants(const std::vector<std::shared_ptr<ast::statement_node>>& ast);
+
+
+	/**
+	 * @brief Top-level functions whose calls can be moved or merged
+	 */
+	struct purity_info
+	{
+		// Non-io functions that only call each other, so calls with the same arguments give the same result
+		std::unordered_set<std::string> pure;
+
+		// Pure functions that neither recurse nor divide, so calling them cannot fail or loop forever
+		std::unordered_set<std::string> total;
+	};
+
+	/**
+	 * @brief Finds the top-level functions without side effects
+	 *
+	 * Calls to anything but a top-level function, like a parameter or a lambda, are assumed to have side effects.
+	 */
+	purity_info find_pure_functions(const std::vector<std::shared_ptr<ast::statement_node>>& ast);
+
+
+	/**
+	 * @brief Finds the top-level functions and lets the program can use
+	 * @param purity The pure functions of the same AST
+	 *
+	 * Uses are followed from main, io functions and the top-level lets that could have side effects or fail. A source
+	 * without main may be included by other C++ code, so all of its declarations are reachable.
+	 */
+	std::unordered_set<std::string> find_reachable(const std::vector<std::shared_ptr<ast::statement_node>>& ast, const purity_info& purity);
+
+
+	/**
+	 * @brief How the function values of a program are kept, to choose how each closure is represented
+	 */
+	struct closure_info
+	{
+		// Function-typed parameters whose argument never outlives the call, so they can borrow it instead of copying it
+		std::unordered_set<const ast::parameter_node*> borrowed;
+
+		// Lambdas that may outlive the names they use, so they must copy them
+		std::unordered_set<const ast::lambda_node*> escaping;
+
+		// Lazy lets that may outlive the names their value uses, whose thunk must copy them and be shared by its copies
+		std::unordered_set<const ast::let_node*> shared;
+	};
+
+	/**
+	 * @brief Finds which function values may outlive the function they were created or passed to
+	 *
+	 * Values escape when they are returned, put in an array, passed to anything but a parameter of a top-level
+	 * function or an array builtin, or used by an escaping lambda. Lets and parameters escape with the values they
+	 * are given, and names used by the value of a lazy let escape with it.
+	 */
+	closure_info find_closures(const std::vector<std::shared_ptr<ast::statement_node>>& ast);
+
+	/**
+	 * @brief Finds the functions whose calls can take the arrays they make from a region, freed when they return.
+	 * They return scalars, through which nothing they make can escape, take no functions, and make a bounded number
+	 * of arrays: none in lambdas or through recursion, directly or in what they call. Neither can they use lazy or
+	 * function-valued top-level lets, which could keep what they make.
+	 */
+	std::unordered_set<std::string> find_regions(const std::vector<std::shared_ptr<ast::statement_node>>& ast);
+
+
+	/**
+	 * @brief A match whose value is known not to be an integer, which its switch cannot tell apart
+	 */
+	struct match_error
+	{
+		std::shared_ptr<ast::match_node> match;
+
+		// Type of the value, like double, bigint, array or the name of a record
+		std::string type;
+	};
+
+	/**
+	 * @brief Finds the matches on floating-point numbers, bigints, records, arrays, maps, vectors or functions
+	 *
+	 * Only declared types and literals are looked at, so values whose type is not known, like those of calls to
+	 * parameters, are taken to be integers and left to the C++ compiler.
+	 */
+	std::vector<match_error> find_non_integer_matches(const std::vector<std::shared_ptr<ast::statement_node>>& ast);
+}
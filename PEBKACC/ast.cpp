@@ -1,7 +1,8 @@
 #include "ast.hpp"
 
+#include <cmath>
+#include <cstdlib>
 #include <stdexcept>
-#include <stack>
 
 using namespace pebkac;
 using namespace pebkac::ast;
@@ -37,130 +38,210 @@ operation string_to_operation(const std::string& v)
 }
 
 
-parser::parser(
-	const std::queue<lexing::token>& tokens) noexcept:
-	tokens(tokens)
-{ }
-
-
-void shunting_yard(std::stack<std::shared_ptr<expression_node>>& expressions, std::stack<std::string>& operations)
+// Magnitude of a decimal number as 32-bit limbs, least significant first, without the limbs that are 0
+std::vector<std::uint32_t> to_limbs(const std::string& digits)
 {
-	while(operations.size())
+	std::vector<std::uint32_t> limbs = { };
+	for(const char c : digits)
 	{
-		const auto& op = operations.top();
-
-		if (expressions.size() == 1)
+		std::uint64_t carry = c - '0';
+		for(auto& limb : limbs)
 		{
-			const auto exp = expressions.top();
-			expressions.pop();
-
-			expressions.push(std::make_shared<unary_operator_node>(string_to_unary_operation(op), exp));
+			carry += static_cast<std::uint64_t>(limb) * 10;
+			limb = static_cast<std::uint32_t>(carry);
+			carry >>= 32;
 		}
-		else
-		{
-			const auto exp_b = expressions.top();
-			expressions.pop();
-			const auto exp_a = expressions.top();
-			expressions.pop();
+		if (carry)
+			limbs.push_back(static_cast<std::uint32_t>(carry));
+	}
+	return limbs;
+}
 
-			expressions.push(std::make_shared<operator_node>(string_to_operation(op), exp_a, exp_b));
-		}
 
-		operations.pop();
-	}
+unsigned long long get_low_bits(const std::vector<std::uint32_t>& limbs) noexcept
+{
+	return limbs.empty() ? 0 : limbs.size() == 1 ? limbs[0] : (static_cast<unsigned long long>(limbs[1]) << 32) | limbs[0];
+}
+
+
+// Largest value of an integer literal with the given suffix, which is empty for integers
+unsigned long long get_largest(const std::string& type)
+{
+	const int bits = type.empty() ? 64 : std::stoi(type.substr(1));
+	return type[0] == 'u' ? ~0ull >> (64 - bits) : ~0ull >> (65 - bits);
 }
 
 
+parser::parser(
+	const std::queue<lexing::token>& tokens) noexcept:
+	tokens(tokens),
+	lines(nullptr),
+	reported_end(false),
+	last_span({0, 0}),
+	origin(0),
+	closed_block(false),
+	ended_block(false),
+	node_count(0),
+	tracer(nullptr)
+{ }
+
+
+parser::parser(
+	const std::queue<lexing::token>& tokens,
+	const lexing::line_table& lines) noexcept:
+	tokens(tokens),
+	lines(&lines),
+	reported_end(false),
+	last_span({0, 0}),
+	origin(0),
+	closed_block(false),
+	ended_block(false),
+	node_count(0),
+	tracer(nullptr)
+{ }
+
+
+// Binding strength of binary operators, matching C++ since the generated code prints them without parentheses
 size_t precedence(const std::string& s)
 {
-	if (s == "!")  return 0;
-	if (s == "&&") return 1;
 	if (s == "||") return 1;
-	if (s == "+")  return 2;
-	if (s == "-")  return 2;
-	if (s == "*")  return 3;
-	if (s == "/")  return 3;
-	if (s == "%")  return 3;
-	if (s == "==") return 4;
-	if (s == "!=") return 4;
+	if (s == "&&") return 2;
+	if (s == "==") return 3;
+	if (s == "!=") return 3;
 	if (s == "<")  return 4;
 	if (s == ">")  return 4;
 	if (s == "<=") return 4;
 	if (s == ">=") return 4;
+	if (s == "+")  return 5;
+	if (s == "-")  return 5;
+	if (s == "*")  return 6;
+	if (s == "/")  return 6;
+	if (s == "%")  return 6;
+
+	return 0;
+}
+
 
-	throw std::runtime_error("Unknown operator: " + s);
+bool is_unary(const std::string& s)
+{
+	return s == "+" || s == "-" || s == "!";
 }
 
 
 std::shared_ptr<expression_node> parser::parse_expression()
 {
-	std::stack<std::shared_ptr<expression_node>> expressions = { };
-	std::stack<std::string> operations = { };
+	return parse_binary_expression(1);
+}
 
-	bool prev_op = false;
-	while(true)
-	{
-		const lexing::token t = peek_token();
 
-		if (t == lexing::token(lexing::token_type::BRACKET, "{"))
-			expressions.push(parse_lambda());
+// Precedence climbing, all binary operators are left associative
+std::shared_ptr<expression_node> parser::parse_binary_expression(size_t min_precedence)
+{
+	auto result = parse_prefix_expression();
 
-		else if (t == lexing::token(lexing::token_type::BRACKET, "("))
-			if (prev_op || expressions.size() == 0) expressions.push(parse_group());
-			else
-			{
-				const auto previous_exp = expressions.top();
-				expressions.pop();
+	while(!is_end() && peek_token().get_type() == lexing::token_type::OPERATOR)
+	{
+		const size_t p = precedence(peek_token().get_value());
+		if (p == 0)
+			throw parsing_error("Malformed expression");
+		if (p < min_precedence)
+			break;
 
-				consume_token();
-				expressions.push(std::make_shared<function_call_node>(previous_exp, parse_expressions()));
-				consume_token(lexing::token_type::BRACKET, ")");
-			}
+		const lexing::token op = consume_token();
+		if (!is_end() && !starts_expression(peek_token()))
+			throw parsing_error("Postfix operator detected.");
 
-		else if (t == lexing::token(lexing::token_type::KEYWORD, "if"))
-			expressions.push(parse_conditional_expression());
+		const auto operand = parse_binary_expression(p + 1);
+		result = spanned(std::make_shared<operator_node>(string_to_operation(op.get_value()), result, operand), result->get_span() | operand->get_span());
+	}
 
-		else if (t.get_type() == lexing::token_type::IDENTIFIER)
-			expressions.push(parse_identifier());
+	return result;
+}
 
-		else if (t.get_type() == lexing::token_type::BOOLEAN_LITERAL)
-			expressions.push(parse_boolean_literal());
 
-		else if (t.get_type() == lexing::token_type::NUMERIC_LITERAL)
-			expressions.push(parse_numeric_literal());
+std::shared_ptr<expression_node> parser::parse_prefix_expression()
+{
+	const lexing::token t = peek_token();
+	if (t.get_type() != lexing::token_type::OPERATOR)
+		return parse_postfix_expression();
 
-		else if (t.get_type() == lexing::token_type::OPERATOR)
-			{
-				//Shunting-Yard algorithm
-				consume_token();
-				const auto& op_b = t.get_value();
-				if (operations.size() > 0)
-				{
-					const auto op_a = operations.top();
-					
-					if (precedence(op_b) < precedence(op_a))
-						shunting_yard(expressions, operations);
-				}
-
-				operations.push(op_b);
-			}
+	if (!is_unary(t.get_value()))
+		throw parsing_error("Malformed expression");
 
-		else
-			break;
+	consume_token();
+	if (!is_end() && !starts_expression(peek_token()))
+		throw parsing_error("Postfix operator detected.");
 
-		prev_op = t.get_type() == lexing::token_type::OPERATOR;
+	if (t.get_value() == "-")
+	{
+		if (const auto smallest = parse_smallest_literal(get_span(t)))
+			return smallest;
 	}
 
-	if (prev_op)
-		throw parsing_error("Postfix operator detected.");
+	const auto operand = parse_prefix_expression();
+	return spanned(std::make_shared<unary_operator_node>(string_to_unary_operation(t.get_value()), operand), get_span(t) | operand->get_span());
+}
 
-	//Shunting-Yard algorithm
-	shunting_yard(expressions, operations);
 
-	if (expressions.size() == 1 && operations.size() == 0)
-		return expressions.top();
+// A primary expression, followed by any number of calls and field accesses
+std::shared_ptr<expression_node> parser::parse_postfix_expression()
+{
+	const lexing::token t = peek_token();
+	std::shared_ptr<expression_node> result = nullptr;
+
+	if (t == lexing::token(lexing::token_type::BRACKET, "{"))
+		result = parse_lambda();
+	else if (t == lexing::token(lexing::token_type::BRACKET, "("))
+		result = parse_group();
+	else if (t == lexing::token(lexing::token_type::BRACKET, "["))
+		result = parse_array_literal();
+	else if (t == lexing::token(lexing::token_type::KEYWORD, "if"))
+		result = parse_conditional_expression();
+	else if (t == lexing::token(lexing::token_type::KEYWORD, "match"))
+		result = parse_match();
+	else if (t.get_type() == lexing::token_type::IDENTIFIER)
+		result = parse_identifier();
+	else if (t.get_type() == lexing::token_type::BOOLEAN_LITERAL)
+		result = parse_boolean_literal();
+	else if (t.get_type() == lexing::token_type::NUMERIC_LITERAL)
+		result = parse_numeric_literal();
 	else
 		throw parsing_error("Malformed expression");
+
+	while(!is_end())
+	{
+		if (peek_token() == lexing::token(lexing::token_type::BRACKET, "("))
+		{
+			consume_token();
+			const auto arguments = parse_expressions();
+			consume_token(lexing::token_type::BRACKET, ")");
+			result = spanned(std::make_shared<function_call_node>(result, arguments), result->get_span() | last_span);
+		}
+		else if (peek_token() == lexing::token(lexing::token_type::SYNTATIC_ELEMENT, "."))
+		{
+			consume_token();
+			const std::string field = consume_token(lexing::token_type::IDENTIFIER).get_value();
+			result = spanned(std::make_shared<field_access_node>(result, field), result->get_span() | last_span);
+		}
+		else
+			break;
+	}
+
+	return result;
+}
+
+
+bool parser::starts_expression(const lexing::token& t) const
+{
+	return t == lexing::token(lexing::token_type::BRACKET, "{")
+		|| t == lexing::token(lexing::token_type::BRACKET, "(")
+		|| t == lexing::token(lexing::token_type::BRACKET, "[")
+		|| t == lexing::token(lexing::token_type::KEYWORD, "if")
+		|| t == lexing::token(lexing::token_type::KEYWORD, "match")
+		|| t.get_type() == lexing::token_type::IDENTIFIER
+		|| t.get_type() == lexing::token_type::BOOLEAN_LITERAL
+		|| t.get_type() == lexing::token_type::NUMERIC_LITERAL
+		|| (t.get_type() == lexing::token_type::OPERATOR && is_unary(t.get_value()));
 }
 
 
@@ -174,12 +255,14 @@ std::shared_ptr<statement_node> parser::parse_statement()
 			return parse_conditional();
 		else if (t == lexing::token(lexing::token_type::KEYWORD, "return"))
 			return parse_return();
-		else if (t == lexing::token(lexing::token_type::KEYWORD, "let"))
+		else if (t == lexing::token(lexing::token_type::KEYWORD, "let") || t == lexing::token(lexing::token_type::KEYWORD, "lazy"))
 			return parse_let();
 		else if (t == lexing::token(lexing::token_type::BRACKET, "{"))
 			return parse_block();
 		else if (t == lexing::token(lexing::token_type::KEYWORD, "fun") || t == lexing::token(lexing::token_type::KEYWORD, "io"))
 			return parse_function();
+		else if (t == lexing::token(lexing::token_type::KEYWORD, "record"))
+			return parse_record();
 		else if (t == lexing::token(lexing::token_type::SYNTATIC_ELEMENT, ";"))
 			return parse_empty_statement();
 		else
@@ -200,6 +283,14 @@ std::shared_ptr<type_node> parser::parse_type()
 	{
 		return parse_function_type();
 	}
+	else if (peek_token() == lexing::token(lexing::token_type::BRACKET, "["))
+	{
+		return parse_array_type();
+	}
+	else if (peek_token() == lexing::token(lexing::token_type::OPERATOR, "<"))
+	{
+		return parse_vector_type();
+	}
 	else
 	{
 		return parse_identifier();
@@ -208,16 +299,135 @@ std::shared_ptr<type_node> parser::parse_type()
 
 
 std::vector<std::shared_ptr<statement_node>> parser::parse_statements()
+{
+	std::vector<std::shared_ptr<statement_node>> statements = parse_statement_list();
+
+	// A stray "}" ends the statements early, which is only worth reporting when recovering, and was already reported
+	// when a broken statement consumed it
+	while(lines && (ended_block || !is_end()))
+	{
+		if (ended_block)
+		{
+			ended_block = false;
+		}
+		else
+		{
+			report(parsing_error("Unexpected \"}\"."));
+			consume_token();
+		}
+
+		const auto more = parse_statement_list();
+		statements.insert(statements.end(), more.begin(), more.end());
+	}
+
+	return statements;
+}
+
+
+std::vector<std::shared_ptr<statement_node>> parser::parse_statement_list()
 {
 	std::vector<std::shared_ptr<statement_node>> statements = { };
-	while(!is_end() && peek_token() != lexing::token(lexing::token_type::BRACKET, "}"))
+	while(!ended_block && !is_end() && peek_token() != lexing::token(lexing::token_type::BRACKET, "}"))
 	{
-		statements.push_back(parse_statement());
+		if (const auto statement = parse_recovering_statement())
+			statements.push_back(statement);
 	}
 	return statements;
 }
 
 
+std::shared_ptr<statement_node> parser::parse_recovering_statement()
+{
+	if (!lines)
+		return parse_statement();
+
+	try
+	{
+		return parse_statement();
+	}
+	catch(const std::exception& e)
+	{
+		// A mismatched "}" ends the statement list it closes, skipping on would swallow the statements after it
+		report(e);
+		const bool consumed = dynamic_cast<const unexpected_token_type_error*>(&e) || dynamic_cast<const unexpected_token_value_error*>(&e);
+		if (consumed && closed_block)
+			ended_block = true;
+		else
+			synchronize();
+		return nullptr;
+	}
+}
+
+
+void parser::end_statement_list()
+{
+	if (ended_block)
+		ended_block = false;
+	else
+		consume_token(lexing::token_type::BRACKET, "}");
+}
+
+
+void parser::report(const std::exception& e)
+{
+	// Running out of tokens unwinds through every enclosing statement, only report it once
+	const bool end = dynamic_cast<const end_error*>(&e) != nullptr || (is_end() && !dynamic_cast<const located_error*>(&e));
+	if (end && reported_end)
+		return;
+	reported_end = reported_end || end;
+
+	// Mismatched tokens were already consumed, some errors say where they are, anything else is about the upcoming token
+	const bool consumed = dynamic_cast<const unexpected_token_type_error*>(&e) || dynamic_cast<const unexpected_token_value_error*>(&e);
+	const auto located = dynamic_cast<const located_error*>(&e);
+	const size_t offset = located ? located->get_span().offset : (consumed || is_end()) ? last_span.offset : get_span(tokens.front()).offset;
+
+	diagnostics.push_back({e.what(), offset, lines->get_position(offset)});
+}
+
+
+void parser::skip_block()
+{
+	for(size_t depth = 1; depth > 0 && !is_end();)
+	{
+		const lexing::token t = consume_token();
+		if (t == lexing::token(lexing::token_type::BRACKET, "{"))
+			++depth;
+		else if (t == lexing::token(lexing::token_type::BRACKET, "}"))
+			--depth;
+	}
+}
+
+
+void parser::synchronize()
+{
+	// Skip to the end of the broken statement: past the next ";", or past a whole "{...}" block,
+	// but stop before a "}" closing the enclosing block
+	size_t depth = 0;
+	while(!is_end())
+	{
+		const lexing::token t = peek_token();
+
+		if (t == lexing::token(lexing::token_type::BRACKET, "}"))
+		{
+			if (depth == 0)
+				return;
+
+			consume_token();
+			if (--depth == 0)
+				return;
+			continue;
+		}
+
+		consume_token();
+
+		if (t == lexing::token(lexing::token_type::BRACKET, "{"))
+			++depth;
+		else if (depth == 0 && t == lexing::token(lexing::token_type::SYNTATIC_ELEMENT, ";"))
+			return;
+	}
+}
+
+
 std::vector<std::shared_ptr<expression_node>> parser::parse_expressions()
 {
 	std::vector<std::shared_ptr<expression_node>> expressions = { };
@@ -255,24 +465,96 @@ std::vector<std::shared_ptr<parameter_node>> parser::parse_parameters()
 std::shared_ptr<boolean_literal_node> parser::parse_boolean_literal()
 {
 	const lexing::token t = consume_token(lexing::token_type::BOOLEAN_LITERAL);
-	return std::make_shared<boolean_literal_node>(t.get_value() == "true");
+	return spanned(std::make_shared<boolean_literal_node>(t.get_value() == "true"), get_span(t));
 }
 
 
-std::shared_ptr<numeric_literal_node> parser::parse_numeric_literal()
+std::shared_ptr<expression_node> parser::parse_numeric_literal()
 {
 	const lexing::token t = consume_token(lexing::token_type::NUMERIC_LITERAL);
-	return std::make_shared<numeric_literal_node>(std::stoll(t.get_value()));
+	const bool floating = t.get_value().find_first_of(".eEf") != std::string::npos;
+	const size_t suffix = t.get_value().find_first_of("iun");
+	if (floating && suffix != std::string::npos)
+		throw parsing_error("Numeric literal " + t.get_value() + " is not an integer");
+
+	// Floats are parsed as floats, so that printing them back gives the same float. Literals too small for one round
+	// to 0, and only the ones too large for one are errors.
+	if (floating)
+	{
+		const bool single = t.get_value().back() == 'f';
+		const double value = single ? std::strtof(t.get_value().c_str(), nullptr) : std::strtod(t.get_value().c_str(), nullptr);
+		if (std::isinf(value))
+			throw parsing_error("Numeric literal " + t.get_value() + " is out of range");
+		return spanned(std::make_shared<floating_literal_node>(value, single ? "f" : ""), get_span(t));
+	}
+
+	// Literals have no sign, so they only need to be below the largest value of their type. Bigints have no largest
+	// value, and keep the limbs of the ones that do not fit in 64 bits.
+	const std::string type = suffix == std::string::npos ? "" : t.get_value().substr(suffix);
+	std::vector<std::uint32_t> limbs = to_limbs(t.get_value().substr(0, suffix));
+	const unsigned long long value = get_low_bits(limbs);
+	if (type == "n")
+	{
+		if (limbs.size() <= 2)
+			limbs.clear();
+		return spanned(std::make_shared<numeric_literal_node>(static_cast<long long>(value), type, limbs), get_span(t));
+	}
+
+	if (limbs.size() > 2 || value > get_largest(type))
+		throw located_error("Numeric literal " + t.get_value() + " is out of range", get_span(t));
+	return spanned(std::make_shared<numeric_literal_node>(static_cast<long long>(value), type), get_span(t));
+}
+
+
+std::shared_ptr<numeric_literal_node> parser::parse_smallest_literal(const lexing::source_span& minus)
+{
+	const lexing::token& t = peek_token();
+	if (t.get_type() != lexing::token_type::NUMERIC_LITERAL || t.get_value().find_first_of(".eEfun") != std::string::npos)
+		return nullptr;
+
+	const size_t suffix = t.get_value().find('i');
+	const std::string type = suffix == std::string::npos ? "" : t.get_value().substr(suffix);
+	const std::vector<std::uint32_t> limbs = to_limbs(t.get_value().substr(0, suffix));
+	const unsigned long long largest = get_largest(type);
+	if (limbs.size() > 2 || get_low_bits(limbs) != largest + 1)
+		return nullptr;
+
+	consume_token();
+	return spanned(std::make_shared<numeric_literal_node>(-static_cast<long long>(largest) - 1, type), minus | last_span);
 }
 
 
 std::shared_ptr<group_node> parser::parse_group()
 {
+	const lexing::source_span begin = get_span(peek_token());
 	consume_token(lexing::token_type::BRACKET, "(");
 	const auto exp = parse_expression();
 	consume_token(lexing::token_type::BRACKET, ")");
 
-	return std::make_shared<group_node>(exp);
+	return spanned(std::make_shared<group_node>(exp), begin | last_span);
+}
+
+
+std::shared_ptr<array_literal_node> parser::parse_array_literal()
+{
+	// [ [elements] ]
+
+	const lexing::source_span begin = get_span(peek_token());
+	consume_token(lexing::token_type::BRACKET, "[");
+
+	std::vector<std::shared_ptr<expression_node>> elements = { };
+	if (peek_token() != lexing::token(lexing::token_type::BRACKET, "]"))
+	{
+		elements.push_back(parse_expression());
+		while(peek_token() == lexing::token(lexing::token_type::SYNTATIC_ELEMENT, ","))
+		{
+			consume_token();
+			elements.push_back(parse_expression());
+		}
+	}
+	consume_token(lexing::token_type::BRACKET, "]");
+
+	return spanned(std::make_shared<array_literal_node>(elements), begin | last_span);
 }
 
 
@@ -280,10 +562,11 @@ std::shared_ptr<unary_operator_node> parser::parse_unary_operator()
 {
 	// <op> <expression>
 
+	const lexing::source_span begin = get_span(peek_token());
 	const unary_operation op = string_to_unary_operation(consume_token(lexing::token_type::OPERATOR).get_value());
 	const auto expression = parse_expression();
 
-	return std::make_shared<unary_operator_node>(op, expression);
+	return spanned(std::make_shared<unary_operator_node>(op, expression), begin | last_span);
 }
 
 
@@ -291,11 +574,12 @@ std::shared_ptr<operator_node> parser::parse_operator()
 {
 	// <a> <op> <b>
 
+	const lexing::source_span begin = get_span(peek_token());
 	const auto a = parse_expression();
 	const operation op = string_to_operation(consume_token(lexing::token_type::OPERATOR).get_value());
 	const auto b = parse_expression();
 
-	return std::make_shared<operator_node>(op, a, b);
+	return spanned(std::make_shared<operator_node>(op, a, b), begin | last_span);
 }
 
 
@@ -304,6 +588,7 @@ std::shared_ptr<function_call_node> parser::parse_function_call()
 	// <function> ( [args] )
 
 	// Function
+	const lexing::source_span begin = get_span(peek_token());
 	const auto function = parse_expression();
 	consume_token(lexing::token_type::BRACKET, "(");
 	
@@ -311,7 +596,7 @@ std::shared_ptr<function_call_node> parser::parse_function_call()
 	const auto arguments = parse_expressions();
 	consume_token(lexing::token_type::BRACKET, ")");
 
-	return std::make_shared<function_call_node>(function, arguments);
+	return spanned(std::make_shared<function_call_node>(function, arguments), begin | last_span);
 }
 
 
@@ -319,20 +604,22 @@ std::shared_ptr<lambda_node> parser::parse_lambda()
 {
 	// { [params] -> <statement> }
 
+	const lexing::source_span begin = get_span(peek_token());
 	consume_token(lexing::token_type::BRACKET, "{");
 	const auto params = parse_parameters();
 	consume_token(lexing::token_type::SYNTATIC_ELEMENT, "->");
-	const auto statements = parse_statements();
-	consume_token(lexing::token_type::BRACKET, "}");
+	const auto statements = parse_statement_list();
+	end_statement_list();
 
-	return std::make_shared<lambda_node>(params, statements);
+	return spanned(std::make_shared<lambda_node>(params, statements), begin | last_span);
 }
 
 
 std::shared_ptr<identifier_node> parser::parse_identifier()
 {
 	// <name>
-	return std::make_shared<identifier_node>(consume_token(lexing::token_type::IDENTIFIER).get_value());
+	const lexing::token t = consume_token(lexing::token_type::IDENTIFIER);
+	return spanned(std::make_shared<identifier_node>(t.get_value()), get_span(t));
 }
 
 
@@ -341,6 +628,7 @@ std::shared_ptr<function_type_node> parser::parse_function_type()
 	//TODO: specifiers
 	// ( [param_types] ) -> <return_type>
 
+	const lexing::source_span begin = get_span(peek_token());
 	consume_token(lexing::token_type::BRACKET, "(");
 
 	std::vector<std::shared_ptr<type_node>> parameter_types = { };
@@ -359,7 +647,40 @@ std::shared_ptr<function_type_node> parser::parse_function_type()
 	const auto return_type = parse_type(); 
 
 	std::unordered_set<specifier> aaa = {};
-	return std::make_shared<function_type_node>(aaa, parameter_types, return_type);
+	return spanned(std::make_shared<function_type_node>(aaa, parameter_types, return_type), begin | last_span);
+}
+
+
+std::shared_ptr<type_node> parser::parse_array_type()
+{
+	// [ <element_type> ] | [ <key_type> : <value_type> ]
+
+	const lexing::source_span begin = get_span(peek_token());
+	consume_token(lexing::token_type::BRACKET, "[");
+	const auto element_type = parse_type();
+	if (peek_token() == lexing::token(lexing::token_type::SYNTATIC_ELEMENT, ":"))
+	{
+		consume_token();
+		const auto value_type = parse_type();
+		consume_token(lexing::token_type::BRACKET, "]");
+		return spanned(std::make_shared<map_type_node>(element_type, value_type), begin | last_span);
+	}
+	consume_token(lexing::token_type::BRACKET, "]");
+
+	return spanned(std::make_shared<array_type_node>(element_type), begin | last_span);
+}
+
+
+std::shared_ptr<vector_type_node> parser::parse_vector_type()
+{
+	// < <element_type> >
+
+	const lexing::source_span begin = get_span(peek_token());
+	consume_token(lexing::token_type::OPERATOR, "<");
+	const auto element_type = parse_type();
+	consume_token(lexing::token_type::OPERATOR, ">");
+
+	return spanned(std::make_shared<vector_type_node>(element_type), begin | last_span);
 }
 
 
@@ -367,6 +688,7 @@ std::shared_ptr<conditional_node> parser::parse_conditional()
 {
 	// if ( <condition> ) <branch_true> [else <branch_false>]
 
+	const lexing::source_span begin = get_span(peek_token());
 	consume_token(lexing::token_type::KEYWORD, "if");
 	consume_token(lexing::token_type::BRACKET, "(");
 	const auto expression = parse_expression();
@@ -380,7 +702,7 @@ std::shared_ptr<conditional_node> parser::parse_conditional()
 		branch_false = parse_statement();
 	}
 
-	return std::make_shared<conditional_node>(expression, branch_true, branch_false);
+	return spanned(std::make_shared<conditional_node>(expression, branch_true, branch_false), begin | last_span);
 }
 
 
@@ -388,6 +710,7 @@ std::shared_ptr<conditional_expression_node> parser::parse_conditional_expressio
 {
 	// if ( <condition> ) <branch_true> else <branch_false>
 
+	const lexing::source_span begin = get_span(peek_token());
 	consume_token(lexing::token_type::KEYWORD, "if");
 	consume_token(lexing::token_type::BRACKET, "(");
 	const auto expression = parse_expression();
@@ -396,13 +719,117 @@ std::shared_ptr<conditional_expression_node> parser::parse_conditional_expressio
 	consume_token(lexing::token_type::KEYWORD, "else");
 	const auto branch_false = parse_expression();
 
-	return std::make_shared<conditional_expression_node>(expression, branch_true, branch_false);
+	return spanned(std::make_shared<conditional_expression_node>(expression, branch_true, branch_false), begin | last_span);
+}
+
+
+std::shared_ptr<match_node> parser::parse_match()
+{
+	// match ( <value> ) { [<ranges> -> <result>;]... else -> <otherwise>; }
+
+	const lexing::source_span begin = get_span(peek_token());
+	consume_token(lexing::token_type::KEYWORD, "match");
+	consume_token(lexing::token_type::BRACKET, "(");
+	const auto value = parse_expression();
+	consume_token(lexing::token_type::BRACKET, ")");
+	consume_token(lexing::token_type::BRACKET, "{");
+
+	std::vector<std::shared_ptr<match_case_node>> cases = { };
+	std::shared_ptr<expression_node> otherwise = nullptr;
+	try
+	{
+		while(peek_token() != lexing::token(lexing::token_type::KEYWORD, "else"))
+		{
+			if (peek_token() == lexing::token(lexing::token_type::BRACKET, "}"))
+				throw parsing_error("Match without an else case");
+
+			const lexing::source_span first = get_span(peek_token());
+			std::vector<std::pair<long long, long long>> ranges = {parse_match_range()};
+			while(peek_token() == lexing::token(lexing::token_type::SYNTATIC_ELEMENT, ","))
+			{
+				consume_token();
+				ranges.push_back(parse_match_range());
+			}
+			consume_token(lexing::token_type::SYNTATIC_ELEMENT, "->");
+			const auto result = parse_expression();
+			consume_token(lexing::token_type::SYNTATIC_ELEMENT, ";");
+			cases.push_back(spanned(std::make_shared<match_case_node>(ranges, result), first | last_span));
+		}
+
+		consume_token(lexing::token_type::KEYWORD, "else");
+		consume_token(lexing::token_type::SYNTATIC_ELEMENT, "->");
+		otherwise = parse_expression();
+		consume_token(lexing::token_type::SYNTATIC_ELEMENT, ";");
+		consume_token(lexing::token_type::BRACKET, "}");
+	}
+	catch(const std::exception& e)
+	{
+		if (!lines)
+			throw;
+
+		// The rest of the match is skipped, so that the statement around it parses as if it were whole, unless a
+		// mismatched "}" already closed it. The value stands in for a missing else case, as the diagnostic already
+		// fails the compilation.
+		report(e);
+		const bool consumed = dynamic_cast<const unexpected_token_type_error*>(&e) || dynamic_cast<const unexpected_token_value_error*>(&e);
+		if (!consumed || !closed_block)
+			skip_block();
+		if (!otherwise)
+			otherwise = value;
+	}
+
+	return spanned(std::make_shared<match_node>(value, cases, otherwise), begin | last_span);
+}
+
+
+// A value like 5, or an inclusive range of values like 3..9
+std::pair<long long, long long> parser::parse_match_range()
+{
+	const lexing::source_span begin = get_span(peek_token());
+	const long long first = parse_match_bound();
+	if (peek_token() != lexing::token(lexing::token_type::SYNTATIC_ELEMENT, ".."))
+		return {first, first};
+
+	consume_token();
+	const long long last = parse_match_bound();
+	if (last < first)
+		throw located_error("Range " + std::to_string(first) + ".." + std::to_string(last) + " matches nothing", begin | last_span);
+	return {first, last};
+}
+
+
+// An integer literal, maybe negative
+long long parser::parse_match_bound()
+{
+	const lexing::source_span begin = get_span(peek_token());
+	const bool negative = peek_token() == lexing::token(lexing::token_type::OPERATOR, "-");
+	if (negative)
+	{
+		consume_token();
+		if (const auto smallest = parse_smallest_literal(begin))
+			return smallest->get_value();
+	}
+
+	const lexing::token t = peek_token();
+	const auto literal = std::dynamic_pointer_cast<numeric_literal_node>(parse_numeric_literal());
+	if (!literal || literal->get_suffix() == "n" || (negative && literal->get_suffix()[0] == 'u'))
+		throw located_error("Cannot match " + std::string(negative ? "-" : "") + t.get_value() + ", patterns are integer literals", begin | last_span);
+	return negative ? -literal->get_value() : literal->get_value();
 }
 
 
 std::shared_ptr<let_node> parser::parse_let()
 {
-	// let <name> [: <type>] = <value>;
+	// [lazy] let <name> [: <type>] = <value>;
+
+	// Laziness
+	const lexing::source_span begin = get_span(peek_token());
+	bool lazy = false;
+	if (peek_token() == lexing::token(lexing::token_type::KEYWORD, "lazy"))
+	{
+		consume_token();
+		lazy = true;
+	}
 
 	// Name
 	consume_token(lexing::token_type::KEYWORD, "let");
@@ -421,13 +848,14 @@ std::shared_ptr<let_node> parser::parse_let()
 	const std::shared_ptr<expression_node> value = parse_expression();
 	consume_token(lexing::token_type::SYNTATIC_ELEMENT, ";");
 
-	return std::make_unique<let_node>(name, type, value);
+	return spanned(std::make_shared<let_node>(name, type, value, lazy), begin | last_span);
 }
 
 
 std::shared_ptr<parameter_node> parser::parse_parameter()
 {
 	// <name> : <type> [= <expression>]
+	const lexing::source_span begin = get_span(peek_token());
 	const std::string name = consume_token(lexing::token_type::IDENTIFIER).get_value();
 	consume_token(lexing::token_type::SYNTATIC_ELEMENT, ":");
 	const std::shared_ptr<type_node> type = parse_type();
@@ -439,15 +867,17 @@ std::shared_ptr<parameter_node> parser::parse_parameter()
 		value = parse_expression();
 	}
 
-	return std::make_shared<parameter_node>(name, type, value);
+	return spanned(std::make_shared<parameter_node>(name, type, value), begin | last_span);
 }
 
 
 std::shared_ptr<function_node> parser::parse_function()
 {
 	// [specifiers] fun <name>([params]) : <return_type> [= <expression>;] | { <statements> }
+	trace::scope event(tracer, "parse", "fun");
 
 	// Specifiers
+	const lexing::source_span begin = get_span(peek_token());
 	const std::array<lexing::token, 1> specifier_array = {
 		lexing::token(lexing::token_type::KEYWORD, "io"),
 	};
@@ -461,6 +891,7 @@ std::shared_ptr<function_node> parser::parse_function()
 	// Some syntatic stuff and name
 	consume_token(lexing::token_type::KEYWORD, "fun");
 	const std::string name = consume_token(lexing::token_type::IDENTIFIER).get_value();
+	event.set_name(name);
 	consume_token(lexing::token_type::BRACKET, "(");
 	
 	// Parameters
@@ -479,8 +910,8 @@ std::shared_ptr<function_node> parser::parse_function()
 		const auto value = parse_expression();
 		consume_token(lexing::token_type::SYNTATIC_ELEMENT, ";");
 
-		const std::vector<std::shared_ptr<statement_node>> b = {std::make_shared<return_node>(value)};
-		body = std::make_shared<block_node>(b);
+		const std::vector<std::shared_ptr<statement_node>> b = {spanned(std::make_shared<return_node>(value), value->get_span())};
+		body = spanned(std::make_shared<block_node>(b), value->get_span());
 	}
 	else
 	{
@@ -488,18 +919,34 @@ std::shared_ptr<function_node> parser::parse_function()
 	}
 
 	// Create node and return
-	return std::make_shared<function_node>(specifiers, name, parameters, type, body);
+	return spanned(std::make_shared<function_node>(specifiers, name, parameters, type, body), begin | last_span);
+}
+
+
+std::shared_ptr<record_node> parser::parse_record()
+{
+	// record <name>([fields]);
+	const lexing::source_span begin = get_span(peek_token());
+	consume_token(lexing::token_type::KEYWORD, "record");
+	const std::string name = consume_token(lexing::token_type::IDENTIFIER).get_value();
+	consume_token(lexing::token_type::BRACKET, "(");
+	const auto fields = parse_parameters();
+	consume_token(lexing::token_type::BRACKET, ")");
+	consume_token(lexing::token_type::SYNTATIC_ELEMENT, ";");
+
+	return spanned(std::make_shared<record_node>(name, fields), begin | last_span);
 }
 
 
 std::shared_ptr<return_node> parser::parse_return()
 {
 	// return <expression>;
+	const lexing::source_span begin = get_span(peek_token());
 	consume_token(lexing::token_type::KEYWORD, "return");
 	const std::shared_ptr<expression_node> value = parse_expression();;
 	consume_token(lexing::token_type::SYNTATIC_ELEMENT, ";");
 
-	return std::make_shared<return_node>(value);
+	return spanned(std::make_shared<return_node>(value), begin | last_span);
 }
 
 
@@ -507,17 +954,12 @@ std::shared_ptr<block_node> parser::parse_block()
 {
 	// { [statements] }
 
+	const lexing::source_span begin = get_span(peek_token());
 	consume_token(lexing::token_type::BRACKET, "{");
+	const auto statements = parse_statement_list();
+	end_statement_list();
 
-	std::vector<std::shared_ptr<statement_node>> statements = { };
-	while(peek_token() != lexing::token(lexing::token_type::BRACKET, "}"))
-	{
-		statements.push_back(parse_statement());
-	}
-
-	consume_token();
-
-	return std::make_shared<block_node>(statements);
+	return spanned(std::make_shared<block_node>(statements), begin | last_span);
 }
 
 
@@ -525,8 +967,9 @@ std::shared_ptr<empty_statement_node> parser::parse_empty_statement()
 {
 	// ;
 
+	const lexing::source_span begin = get_span(peek_token());
 	consume_token(lexing::token_type::SYNTATIC_ELEMENT, ";");
-	return std::make_shared<empty_statement_node>();
+	return spanned(std::make_shared<empty_statement_node>(), begin | last_span);
 }
 
 
@@ -542,6 +985,43 @@ bool parser::is_end()
 }
 
 
+size_t parser::get_token_count() const noexcept
+{
+	return tokens.size();
+}
+
+
+size_t parser::get_node_count() const noexcept
+{
+	return node_count;
+}
+
+
+void parser::set_tracer(trace::buffer* tracer) noexcept
+{
+	this->tracer = tracer;
+}
+
+
+const std::vector<diagnostic>& parser::get_diagnostics() const noexcept
+{
+	return diagnostics;
+}
+
+
+void parser::set_origin(size_t offset) noexcept
+{
+	origin = offset;
+}
+
+
+lexing::source_span parser::get_span(const lexing::token& t) const noexcept
+{
+	const lexing::source_span& span = t.get_span();
+	return {static_cast<std::uint32_t>(span.offset - origin), span.length};
+}
+
+
 const lexing::token& parser::peek_token()
 {
 	if (is_end())
@@ -555,6 +1035,8 @@ lexing::token parser::consume_token()
 {
 	const lexing::token token = peek_token();
 	tokens.pop();
+	last_span = get_span(token);
+	closed_block = token.get_type() == lexing::token_type::BRACKET && token.get_value() == "}";
 	return token;
 }
 
@@ -641,6 +1123,20 @@ const std::string& unexpected_token_value_error::get_got() const noexcept
 }
 
 
+located_error::located_error(
+	const std::string& msg,
+	const lexing::source_span& span) noexcept:
+	parsing_error(msg),
+	span(span)
+{ }
+
+
+const lexing::source_span& located_error::get_span() const noexcept
+{
+	return span;
+}
+
+
 end_error::end_error() noexcept:
 	parsing_error("End of token queue reached.")
 { }
\ No newline at end of file
@@ -2,9 +2,11 @@
 
 #include "nodes.hpp"
 #include "lexing.hpp"
+#include "trace.hpp"
 
 #include <array>
 #include <memory>
+#include <stdexcept>
 #include <vector>
 #include <unordered_set>
 
@@ -12,28 +14,51 @@ namespace pebkac
 {
 	namespace ast
 	{
+		struct diagnostic
+		{
+			std::string message;
+			size_t offset;
+			lexing::position position;
+		};
+
+
 		class parser
 		{
 		public:
 			parser(const std::queue<lexing::token>& tokens) noexcept;
 
+			/**
+			 * @brief Creates a parser that recovers from syntax errors instead of throwing them
+			 * @param tokens Tokens to parse
+			 * @param lines Line table of the tokenized source, used to give diagnostics their line and column
+			 *
+			 * A statement that fails to parse is reported, then skipped up to the next ";" or "}", and
+			 * left out of the AST. Parsing then carries on, so a single pass reports every error.
+			 */
+			parser(const std::queue<lexing::token>& tokens, const lexing::line_table& lines) noexcept;
+
 			std::shared_ptr<expression_node> parse_expression();
 			std::shared_ptr<statement_node> parse_statement();
 			std::shared_ptr<conditional_node> parse_conditional();
 			std::shared_ptr<conditional_expression_node> parse_conditional_expression();
+			std::shared_ptr<match_node> parse_match();
 			std::shared_ptr<type_node> parse_type();
 			std::shared_ptr<identifier_node> parse_identifier();
 			std::shared_ptr<function_type_node> parse_function_type();
+			std::shared_ptr<type_node> parse_array_type();
+			std::shared_ptr<vector_type_node> parse_vector_type();
 			std::shared_ptr<let_node> parse_let();
 			std::shared_ptr<parameter_node> parse_parameter();
 			std::shared_ptr<function_node> parse_function();
+			std::shared_ptr<record_node> parse_record();
 			std::shared_ptr<function_call_node> parse_function_call();
 			std::shared_ptr<return_node> parse_return();
 			std::shared_ptr<block_node> parse_block();
 			std::shared_ptr<lambda_node> parse_lambda();
 			std::shared_ptr<boolean_literal_node> parse_boolean_literal();
-			std::shared_ptr<numeric_literal_node> parse_numeric_literal();
+			std::shared_ptr<expression_node> parse_numeric_literal();
 			std::shared_ptr<group_node> parse_group();
+			std::shared_ptr<array_literal_node> parse_array_literal();
 			std::shared_ptr<operator_node> parse_operator();
 			std::shared_ptr<unary_operator_node> parse_unary_operator();
 			std::shared_ptr<empty_statement_node> parse_empty_statement();
@@ -44,10 +69,82 @@ namespace pebkac
 			std::vector<std::shared_ptr<parameter_node>> parse_parameters();
 
 			bool is_end();
+			size_t get_token_count() const noexcept;
+
+			/**
+			 * @brief Returns how many AST nodes were created so far
+			 */
+			size_t get_node_count() const noexcept;
+
+			/**
+			 * @brief Records a trace event for every function parsed from now on
+			 */
+			void set_tracer(trace::buffer* tracer) noexcept;
+
+			/**
+			 * @brief Makes the spans of the nodes parsed from now on relative to a source offset, which no token comes before
+			 */
+			void set_origin(size_t offset) noexcept;
+			const std::vector<diagnostic>& get_diagnostics() const noexcept;
 
 		private:
 			std::queue<lexing::token> tokens;
+
+			// Only set when recovering from errors
+			const lexing::line_table* lines;
+			std::vector<diagnostic> diagnostics;
+			bool reported_end;
+
+			// Span of the last consumed token, where every node parsed so far ends
+			lexing::source_span last_span;
+
+			// Source offset that spans are relative to
+			size_t origin;
+
+			// Whether the last consumed token was a "}", which tokens mismatching what was expected are consumed as
+			bool closed_block;
+
+			// Whether a broken statement consumed the "}" ending the statement list it was in
+			bool ended_block;
+
+			size_t node_count;
+			trace::buffer* tracer;
+
+			/**
+			 * @brief Gives a freshly created node its span, and counts it
+			 */
+			template<typename T>
+			std::shared_ptr<T> spanned(const std::shared_ptr<T>& node, const lexing::source_span& span) noexcept
+			{
+				node->set_span(span);
+				++node_count;
+				return node;
+			}
+
+			std::shared_ptr<expression_node> parse_binary_expression(size_t min_precedence);
+			std::shared_ptr<expression_node> parse_prefix_expression();
+			std::shared_ptr<expression_node> parse_postfix_expression();
+			bool starts_expression(const lexing::token& t) const;
+			/**
+			 * @brief Parses the literal after a "-" as a single negative literal, when it is one past the largest value of a
+			 * signed type, which only fits the type once negated. Parses nothing otherwise.
+			 */
+			std::shared_ptr<numeric_literal_node> parse_smallest_literal(const lexing::source_span& minus);
+			std::pair<long long, long long> parse_match_range();
+			long long parse_match_bound();
+
+			std::vector<std::shared_ptr<statement_node>> parse_statement_list();
+			std::shared_ptr<statement_node> parse_recovering_statement();
+			void report(const std::exception& e);
+			void synchronize();
+
+			// Consumes the "}" ending a statement list, unless a broken statement in it already did
+			void end_statement_list();
+
+			// Skips past the "}" closing the block the parser is in
+			void skip_block();
 		
+			lexing::source_span get_span(const lexing::token& t) const noexcept;
 			const lexing::token& peek_token();
 			lexing::token consume_token();
 			lexing::token consume_token(lexing::token_type type);
@@ -99,6 +196,24 @@ namespace pebkac
 		};
 
 
+		/**
+		 * @brief A parsing error about tokens that were already consumed, reported where they are
+		 */
+		class located_error: public parsing_error
+		{
+		public:
+			located_error(
+				const std::string& msg,
+				const lexing::source_span& span
+			) noexcept;
+
+			const lexing::source_span& get_span() const noexcept;
+
+		private:
+			const lexing::source_span span;
+		};
+
+
 		class end_error: public parsing_error
 		{
 		public:
@@ -0,0 +1,170 @@
+#include <queue>
+#include <chrono>
+#include <limits>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <iomanip>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <functional>
+
+#include "lexing.hpp"
+#include "ast.hpp"
+#include "codegen.hpp"
+#include "driver.hpp"
+
+using namespace pebkac;
+
+
+// Synthetic programs, each stressing a different part of the pipeline. Their size grows linearly with the scale.
+
+std::string deep_expressions(size_t scale)
+{
+	// Deeply nested groups and operators, in many small functions
+	std::string result = "";
+	for(size_t i = 0; i < scale; ++i)
+	{
+		std::string expression = "a";
+		for(size_t depth = 0; depth < 64; ++depth)
+			expression = "(" + expression + (depth%3==0 ? " + " : depth%3==1 ? " * " : " - ") + std::to_string(depth) + ")";
+
+		result += "fun deep" + std::to_string(i) + "(a: integer): integer = " + expression + ";\n";
+	}
+	return result;
+}
+
+
+std::string many_functions(size_t scale)
+{
+	// Lots of small top-level functions, calling each other
+	std::string result = "";
+	for(size_t i = 0; i < scale * 16; ++i)
+	{
+		const std::string name = "f" + std::to_string(i);
+		const std::string next = i ? "f" + std::to_string(i - 1) : name;
+
+		result += "fun " + name + "(a: integer, b: integer): integer {\n"
+			"\tlet x = a * " + std::to_string(i) + " + b;\n"
+			"\tif (x > 100) return " + next + "(x - 1, b);\n"
+			"\treturn if (x == b) a else b;\n"
+			"}\n\n";
+	}
+	return result;
+}
+
+
+std::string long_comments(size_t scale)
+{
+	// Mostly comments, with the odd statement in between
+	std::string result = "";
+	for(size_t i = 0; i < scale; ++i)
+	{
+		result += "/*\n";
+		for(size_t line = 0; line < 32; ++line)
+			result += " * Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt.\n";
+		result += " */\n";
+
+		for(size_t line = 0; line < 16; ++line)
+			result += "// Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris nisi ut aliquip.\n";
+
+		result += "let c" + std::to_string(i) + " = " + std::to_string(i) + ";\n\n";
+	}
+	return result;
+}
+
+
+std::string nested_lambdas(size_t scale)
+{
+	// Lambdas returning lambdas, many levels deep
+	std::string result = "";
+	for(size_t i = 0; i < scale; ++i)
+	{
+		std::string lambda = "x0";
+		for(size_t depth = 16; depth > 0; --depth)
+			lambda = "{ x" + std::to_string(depth - 1) + ": integer -> return " + lambda + (depth > 1 ? "" : " + 1") + "; }";
+
+		result += "let l" + std::to_string(i) + " = " + lambda + ";\n";
+	}
+	return result;
+}
+
+
+// Runs a function several times, and returns its fastest time in seconds
+double measure(size_t repetitions, const std::function<void()>& f)
+{
+	double best = std::numeric_limits<double>::infinity();
+	for(size_t i = 0; i < repetitions; ++i)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		f();
+		best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+
+void report(const std::string& phase, double seconds, size_t bytes, size_t nodes)
+{
+	std::cout << "  " << std::left << std::setw(12) << phase << std::right << std::fixed
+		<< std::setw(10) << std::setprecision(3) << seconds * 1000 << " ms"
+		<< std::setw(10) << std::setprecision(2) << bytes / seconds / 1e6 << " MB/s"
+		<< std::setw(14) << std::setprecision(0) << nodes / seconds << " nodes/s" << std::endl;
+}
+
+
+void run(const std::string& name, const std::string& source, size_t repetitions)
+{
+	std::queue<lexing::token> tokens;
+	std::vector<std::shared_ptr<ast::statement_node>> statements;
+	std::vector<std::shared_ptr<ast::statement_node>> optimized;
+	size_t nodes = 0;
+	std::string cpp = "";
+	std::string json = "";
+
+	const double t_tokenize = measure(repetitions, [&]{ tokens = lexing::tokenize(source); });
+	const double t_parse = measure(repetitions, [&]{
+		ast::parser parser(tokens);
+		statements = parser.parse_statements();
+		nodes = parser.get_node_count();
+	});
+	const double t_optimize = measure(repetitions, [&]{ optimized = driver::optimize(statements, { }); });
+	const double t_codegen = measure(repetitions, [&]{ cpp = codegen::generator(optimized).get_cpp(); });
+	const double t_json = measure(repetitions, [&]{ json = driver::serialize_ast(statements); });
+
+	std::cout << name << ": " << source.size() << " bytes, " << tokens.size() << " tokens, " << nodes << " nodes" << std::endl;
+	report("tokenize", t_tokenize, source.size(), nodes);
+	report("parse", t_parse, source.size(), nodes);
+	report("optimize", t_optimize, source.size(), nodes);
+	report("codegen", t_codegen, source.size(), nodes);
+	report("json", t_json, source.size(), nodes);
+	std::cout << std::endl;
+}
+
+
+int main(int argc, const char** argv)
+{
+	try
+	{
+		// pebkacc_bench [scale] [repetitions]
+		const size_t scale = argc > 1 ? std::stoul(argv[1]) : 64;
+		const size_t repetitions = argc > 2 ? std::stoul(argv[2]) : 5;
+		if (scale == 0 || repetitions == 0)
+			throw std::invalid_argument("Scale and repetitions must be positive.");
+
+		std::cout << "Scale " << scale << ", best of " << repetitions << " runs" << std::endl << std::endl;
+
+		run("deep_expressions", deep_expressions(scale), repetitions);
+		run("many_functions", many_functions(scale), repetitions);
+		run("long_comments", long_comments(scale), repetitions);
+		run("nested_lambdas", nested_lambdas(scale), repetitions);
+
+		return EXIT_SUCCESS;
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
@@ -1,7 +1,12 @@
 #include "codegen.hpp"
 #include "nodes.hpp"
+#include "runtime.hpp"
 
+#include <cstdio>
 #include <memory>
+#include <climits>
+#include <cstdlib>
+#include <algorithm>
 #include <stdexcept>
 
 using namespace pebkac;
@@ -9,11 +14,178 @@ using namespace pebkac::codegen;
 
 
 generator::generator(
-	const std::vector<std::shared_ptr<ast::statement_node>>& ast) noexcept:
-	ast(ast)
+	const std::vector<std::shared_ptr<ast::statement_node>>& ast,
+	const options& opts) noexcept:
+	ast(ast),
+	opts(opts),
+	functions({ }),
+	arrays(false),
+	persistent(false),
+	parallel(false),
+	fixed_width(false),
+	bigints(false),
+	floating_point(analysis::uses_floating_point(ast)),
+	lazy(false),
+	local(false),
+	scope({ })
 { }
 
 
+// One of the disjoint ranges a match tells apart, with the index of the case it picks
+struct match_range
+{
+	long long first;
+	long long last;
+	size_t result;
+};
+
+
+// Ranges of the values each case of a match picks, the first matching case winning, sorted and with neighbours
+// picking the same case merged
+std::vector<match_range> get_match_ranges(const std::shared_ptr<ast::match_node>& ptr)
+{
+	std::vector<match_range> covered = { };
+	const auto& cases = ptr->get_cases();
+	for(size_t i = 0; i < cases.size(); ++i)
+	{
+		for(const auto& range : cases[i]->get_ranges())
+		{
+			// Whatever earlier cases already match is cut out of the range
+			std::vector<std::pair<long long, long long>> pieces = { range };
+			for(const auto& earlier : covered)
+			{
+				std::vector<std::pair<long long, long long>> remaining = { };
+				for(const auto& piece : pieces)
+				{
+					if (earlier.last < piece.first || piece.second < earlier.first)
+					{
+						remaining.push_back(piece);
+						continue;
+					}
+					if (piece.first < earlier.first)
+						remaining.emplace_back(piece.first, earlier.first - 1);
+					if (earlier.last < piece.second)
+						remaining.emplace_back(earlier.last + 1, piece.second);
+				}
+				pieces = remaining;
+			}
+
+			for(const auto& piece : pieces)
+				covered.push_back({ piece.first, piece.second, i });
+		}
+	}
+
+	std::sort(covered.begin(), covered.end(), [](const match_range& a, const match_range& b) { return a.first < b.first; });
+
+	std::vector<match_range> result = { };
+	for(const auto& range : covered)
+	{
+		if (!result.empty() && result.back().result == range.result && result.back().last + 1 == range.first)
+			result.back().last = range.last;
+		else
+			result.push_back(range);
+	}
+	return result;
+}
+
+
+// Integer literal in C++, as the smallest long long has none of its own
+std::string get_integer_literal(long long value)
+{
+	if (value == LLONG_MIN)
+		return "(-9223372036854775807ll - 1)";
+	return std::to_string(value);
+}
+
+
+// Statement returning the result of a case of a match, or of its else case past the last one
+std::string get_match_return(size_t result, size_t cases)
+{
+	const std::string name = result < cases ? "pebkac_result_" + std::to_string(result) : "pebkac_otherwise";
+	return "return static_cast<pebkac_match_type>(" + name + "());";
+}
+
+
+// Decision tree telling apart the ranges from begin to end, when the key is known to be in none of the others.
+// Ranges spanning more values than a few case labels are tested by comparisons, the one nearest the middle first,
+// and the rest become a switch.
+std::string get_decision_tree(const std::vector<match_range>& ranges, size_t begin, size_t end, size_t cases, const std::string& indent)
+{
+	const unsigned long long largest_label_range = 16;
+	const size_t middle = begin + (end - begin) / 2;
+	const auto distance = [middle](size_t i) { return i < middle ? middle - i : i - middle; };
+
+	size_t split = end;
+	for(size_t i = begin; i < end; ++i)
+	{
+		const unsigned long long span = static_cast<unsigned long long>(ranges[i].last) - static_cast<unsigned long long>(ranges[i].first);
+		if (span >= largest_label_range && (split == end || distance(i) < distance(split)))
+			split = i;
+	}
+
+	if (split != end)
+	{
+		const match_range& range = ranges[split];
+		return indent + "if (pebkac_key < " + get_integer_literal(range.first) + ")" + indent + "{"
+			+ get_decision_tree(ranges, begin, split, cases, indent + "\t") + indent + "}"
+			+ indent + "if (pebkac_key <= " + get_integer_literal(range.last) + ")"
+			+ indent + "\t" + get_match_return(range.result, cases)
+			+ get_decision_tree(ranges, split + 1, end, cases, indent);
+	}
+
+	if (begin == end)
+		return indent + get_match_return(cases, cases);
+
+	// Every case gets the labels of all its values, so each result is returned from one place
+	std::string result = indent + "switch (pebkac_key)" + indent + "{";
+	for(size_t i = 0; i <= cases; ++i)
+	{
+		std::string labels = "";
+		for(size_t j = begin; j < end; ++j)
+		{
+			if (ranges[j].result != i)
+				continue;
+			for(long long value = ranges[j].first; ; ++value)
+			{
+				labels += indent + "case " + get_integer_literal(value) + ":";
+				if (value == ranges[j].last)
+					break;
+			}
+		}
+		if (!labels.empty())
+			result += labels + indent + "\t" + get_match_return(i, cases);
+	}
+	return result + indent + "default:" + indent + "\t" + get_match_return(cases, cases) + indent + "}";
+}
+
+
+// Shortest text that reads back as the same double, or float, and still looks like one to C++
+std::string to_floating_literal(double value, bool single)
+{
+	char buffer[32];
+	for(int precision = 1; precision <= 17; ++precision)
+	{
+		std::snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+		if (single ? std::strtof(buffer, nullptr) == static_cast<float>(value) : std::strtod(buffer, nullptr) == value)
+			break;
+	}
+
+	std::string result = buffer;
+	if (result.find_first_of(".e") == std::string::npos)
+		result += ".0";
+	return single ? result + "f" : result;
+}
+
+
+// Appends an operand after an operator, separated when they would read as ++ or --, like in a - -b or - -a
+void append_operand(std::string& code, const std::string& operand)
+{
+	if (!code.empty() && !operand.empty() && (code.back() == '+' || code.back() == '-') && operand.front() == code.back())
+		code += " ";
+	code += operand;
+}
+
+
 template<class T>
 std::string generator::get_cpp(const std::vector<T>& ptrs, const std::string& indent, const std::string& separator)
 {
@@ -24,8 +196,45 @@ std::string generator::get_cpp(const std::vector<T>& ptrs, const std::string& in
 }
 
 
+std::string generator::get_cpp(const std::vector<std::shared_ptr<ast::statement_node>>& ptrs, const std::string& indent, const std::string& separator)
+{
+	std::string result = "";
+	for(const auto& ptr : ptrs)
+	{
+		// Directives must start a line, so they go after the indentation's line break
+		const std::string directive = get_line_directive(ptr);
+		result += indent + (result.length()?separator:"") + (directive.length() ? directive + indent.substr(indent.find_last_of('\n') + 1) : "") + get_cpp(ptr);
+	}
+	return result;
+}
+
+
+std::string generator::get_line_directive(const std::shared_ptr<ast::statement_node>& ptr) const
+{
+	if (!opts.lines || ptr->get_span().is_empty())
+		return "";
+
+	std::string name = "";
+	for(char c : opts.source_name)
+	{
+		if (c == '"' || c == '\\')
+			name += '\\';
+		name += c;
+	}
+
+	return "#line " + std::to_string(opts.lines->get_position(ptr->get_span().offset).line) + " \"" + name + "\"\n";
+}
+
+
 std::string generator::get_cpp(const std::shared_ptr<ast::parameter_node>& ptr)
 {
+	if (closures.borrowed.count(ptr.get()))
+	{
+		const auto type = std::static_pointer_cast<ast::function_type_node>(ptr->get_type());
+		const std::string borrowed = "const pebkac_closure::function_ref<" + get_cpp(type->get_return_type()) + "(" + get_cpp(type->get_parameters(), "", ", ") + ")>";
+		return borrowed + "& " + ptr->get_name() + (ptr->get_default_value()?(" = " + get_cpp(ptr->get_default_value())):"");
+	}
+
 	return get_cpp(ptr->get_type()) + "& " + ptr->get_name() + (ptr->get_default_value()?(" = " + get_cpp(ptr->get_default_value())):"");
 }
 
@@ -38,6 +247,8 @@ std::string generator::get_cpp(const std::shared_ptr<ast::type_node>& ptr)
 	if (std::dynamic_pointer_cast<ast::identifier_node>(ptr))
 	{
 		const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr);
+		fixed_width = fixed_width || analysis::is_fixed_width(cast->get_value());
+		bigints = bigints || analysis::is_bigint(cast->get_value());
 		return (cast->get_value()=="int"?"":"const ") + cast->get_value();
 	}
 	else if (std::dynamic_pointer_cast<ast::function_type_node>(ptr))
@@ -45,6 +256,29 @@ std::string generator::get_cpp(const std::shared_ptr<ast::type_node>& ptr)
 		const auto cast = std::dynamic_pointer_cast<ast::function_type_node>(ptr);
 		return "const std::function<" + get_cpp(cast->get_return_type()) + "(" + get_cpp(cast->get_parameters(), "", ", ") + ")>";
 	}
+	else if (std::dynamic_pointer_cast<ast::array_type_node>(ptr))
+	{
+		// Arrays are immutable as a whole, their elements are stored without const
+		const auto cast = std::dynamic_pointer_cast<ast::array_type_node>(ptr);
+		const std::string element = get_cpp(cast->get_element_type());
+		arrays = true;
+		return "const pebkac_array::array<" + (element.compare(0, 6, "const ") ? element : element.substr(6)) + ">";
+	}
+	else if (std::dynamic_pointer_cast<ast::map_type_node>(ptr))
+	{
+		const auto cast = std::dynamic_pointer_cast<ast::map_type_node>(ptr);
+		const std::string key = get_cpp(cast->get_key_type());
+		const std::string value = get_cpp(cast->get_value_type());
+		arrays = persistent = true;
+		return "const pebkac_persistent::map<" + (key.compare(0, 6, "const ") ? key : key.substr(6)) + ", " + (value.compare(0, 6, "const ") ? value : value.substr(6)) + ">";
+	}
+	else if (std::dynamic_pointer_cast<ast::vector_type_node>(ptr))
+	{
+		const auto cast = std::dynamic_pointer_cast<ast::vector_type_node>(ptr);
+		const std::string element = get_cpp(cast->get_element_type());
+		arrays = persistent = true;
+		return "const pebkac_persistent::vector<" + (element.compare(0, 6, "const ") ? element : element.substr(6)) + ">";
+	}
 
 	throw std::runtime_error("WTF (type)");
 }
@@ -55,22 +289,83 @@ std::string generator::get_cpp(const std::shared_ptr<ast::expression_node>& ptr)
 	if (std::dynamic_pointer_cast<ast::function_call_node>(ptr))
 	{
 		const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr);
+		const auto callee = std::dynamic_pointer_cast<ast::identifier_node>(cast->get_function());
+		if (callee && !functions.count(callee->get_value()) && analysis::is_array_builtin(callee->get_value()))
+		{
+			arrays = true;
+			parallel = parallel || callee->get_value() == "pmap" || callee->get_value() == "preduce";
+		}
+		else if (callee && !functions.count(callee->get_value()) && analysis::is_persistent_builtin(callee->get_value()))
+			arrays = persistent = true;
+		else if (callee && !functions.count(callee->get_value()) && analysis::is_bigint(callee->get_value()))
+			bigints = true;
+		else if (callee && !functions.count(callee->get_value()) && analysis::is_fixed_width(callee->get_value()))
+		{
+			// Unlike a C++ cast, converting to a fixed-width type checks that the value fits
+			fixed_width = true;
+			return "pebkac_int::convert<" + callee->get_value() + ">(" + get_cpp(cast->get_arguments(), "", ", ") + ")";
+		}
 		return get_cpp(cast->get_function()) + "(" + get_cpp(cast->get_arguments(), "", ", ") + ")";
 	}
+	else if (std::dynamic_pointer_cast<ast::array_literal_node>(ptr))
+	{
+		const auto cast = std::dynamic_pointer_cast<ast::array_literal_node>(ptr);
+		arrays = true;
+		return "pebkac_array::of(" + get_cpp(cast->get_elements(), "", ", ") + ")";
+	}
 	else if (std::dynamic_pointer_cast<ast::lambda_node>(ptr))
 	{
 		const auto cast = std::dynamic_pointer_cast<ast::lambda_node>(ptr);
-		return "[&](" + get_cpp(cast->get_parameters(), "", ", ") + "){" + get_cpp(cast->get_statements(), "\n\t", "") + "\n}";
+		const std::string parameters = get_cpp(cast->get_parameters(), "", ", ");
+
+		const size_t outer = scope.size();
+		for(const auto& parameter : cast->get_parameters())
+			scope.emplace_back(parameter->get_name(), false);
+		const std::string statements = get_cpp(cast->get_statements(), "\n\t", "");
+		scope.resize(outer);
+
+		return (closures.escaping.count(cast.get())?"[=](":"[&](") + parameters + "){" + statements + "\n}";
 	}
 	else if (std::dynamic_pointer_cast<ast::identifier_node>(ptr))
 	{
 		const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr);
+
+		// Lazy lets are thunks, which give their value when called
+		for(auto it = scope.rbegin(); lazy && it != scope.rend(); ++it)
+		{
+			if (it->first == cast->get_value())
+				return it->second ? cast->get_value() + "()" : cast->get_value();
+		}
 		return cast->get_value();
 	}
 	else if (std::dynamic_pointer_cast<ast::numeric_literal_node>(ptr))
 	{
 		const auto cast = std::dynamic_pointer_cast<ast::numeric_literal_node>(ptr);
-		return std::to_string(cast->get_value());
+		if (cast->get_suffix().empty())
+			return get_integer_literal(cast->get_value());
+
+		// The parser checked that the value fits
+		if (cast->get_suffix() == "n")
+		{
+			bigints = true;
+			if (cast->get_limbs().size())
+			{
+				std::string limbs = "";
+				for(const std::uint32_t limb : cast->get_limbs())
+					limbs += (limbs.empty() ? "" : ", ") + std::to_string(limb) + "u";
+				return "bigint::of_limbs({" + limbs + "})";
+			}
+			return "bigint(" + std::to_string(static_cast<unsigned long long>(cast->get_value())) + "ull)";
+		}
+		fixed_width = true;
+		if (cast->get_suffix() == "u64")
+			return "u64(" + std::to_string(static_cast<unsigned long long>(cast->get_value())) + "ull)";
+		return cast->get_suffix() + "(" + get_integer_literal(cast->get_value()) + ")";
+	}
+	else if (std::dynamic_pointer_cast<ast::floating_literal_node>(ptr))
+	{
+		const auto cast = std::dynamic_pointer_cast<ast::floating_literal_node>(ptr);
+		return to_floating_literal(cast->get_value(), cast->get_suffix() == "f");
 	}
 	else if (std::dynamic_pointer_cast<ast::boolean_literal_node>(ptr))
 	{
@@ -102,12 +397,17 @@ std::string generator::get_cpp(const std::shared_ptr<ast::expression_node>& ptr)
 			break;
 		}
 
-		result += get_cpp(cast->get_operand());
+		append_operand(result, get_cpp(cast->get_operand()));
 		return result;
 	}
 	else if (std::dynamic_pointer_cast<ast::operator_node>(ptr))
 	{
 		const auto cast = std::dynamic_pointer_cast<ast::operator_node>(ptr);
+
+		// C++ has no % for floating-point numbers, so programs using them take every remainder through fmod
+		if (floating_point && cast->get_operation() == ast::operation::MODULUS)
+			return "pebkac_float::fmod(" + get_cpp(cast->get_operand_a()) + ", " + get_cpp(cast->get_operand_b()) + ")";
+
 		std::string result = get_cpp(cast->get_operand_a());
 
 		switch (cast->get_operation())
@@ -165,14 +465,21 @@ std::string generator::get_cpp(const std::shared_ptr<ast::expression_node>& ptr)
 			break;
 		}
 
-		result += get_cpp(cast->get_operand_b());
+		append_operand(result, get_cpp(cast->get_operand_b()));
 		return result;
 	}
+	else if (std::dynamic_pointer_cast<ast::field_access_node>(ptr))
+	{
+		const auto cast = std::dynamic_pointer_cast<ast::field_access_node>(ptr);
+		return get_cpp(cast->get_record()) + "." + cast->get_field();
+	}
 	else if (std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
 	{
 		const auto cast = std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr);
 		return "(" + get_cpp(cast->get_condition()) + "?(" + get_cpp(cast->get_value_true()) + "):(" + get_cpp(cast->get_value_false()) + "))";
 	}
+	else if (std::dynamic_pointer_cast<ast::match_node>(ptr))
+		return get_match_cpp(std::dynamic_pointer_cast<ast::match_node>(ptr));
 	
 	throw std::runtime_error("WTF BRO (expression)");
 }
@@ -183,23 +490,66 @@ std::string generator::get_cpp(const std::shared_ptr<ast::statement_node>& ptr)
 	if (std::dynamic_pointer_cast<ast::function_node>(ptr))
 	{
 		const auto cast = std::dynamic_pointer_cast<ast::function_node>(ptr);
-		return get_cpp(cast->get_return_type()) +  " " + cast->get_name() + "(" + get_cpp(cast->get_parameters(), "", ", ") + ")" + get_cpp(cast->get_body());
+		const std::string signature = get_cpp(cast->get_return_type()) +  " " + cast->get_name() + "(" + get_cpp(cast->get_parameters(), "", ", ") + ")";
+
+		const size_t outer = scope.size();
+		for(const auto& parameter : cast->get_parameters())
+			scope.emplace_back(parameter->get_name(), false);
+		const bool was_local = local;
+		local = true;
+
+		// The profiling and region scopes live for the whole body, and end however the function returns. The region
+		// comes second, so that the timer also counts freeing it.
+		std::string prologue = "";
+		if (const auto id = profile_ids.find(cast.get()); id != profile_ids.end())
+			prologue += "\n\tpebkac_profile::scope pebkac_profile_scope(" + std::to_string(id->second) + ");";
+		if (regions.count(cast->get_name()) && !constants.functions.count(cast->get_name()))
+			prologue += "\n\tpebkac_region::scope pebkac_region_scope;";
+
+		std::string result = "";
+		if (!prologue.empty())
+			result = signature + "\n{" + prologue + get_cpp(cast->get_body()->get_statements(), "\n\t", "") + "\n}";
+		else
+			result = signature + get_cpp(cast->get_body());
+
+		local = was_local;
+		scope.resize(outer);
+		return result;
 	}
 	else if (std::dynamic_pointer_cast<ast::let_node>(ptr))
 	{
 		const auto cast = std::dynamic_pointer_cast<ast::let_node>(ptr);
-		return get_cpp(cast->get_type()) + " " + cast->get_name() + " = " + get_cpp(cast->get_value()) + ";";
+		if (cast->is_lazy())
+			return get_lazy_cpp(cast, closures.shared.count(cast.get()) ? "[=]" : "[&]");
+
+		const std::string result = get_cpp(cast->get_type()) + " " + cast->get_name() + " = " + get_cpp(cast->get_value()) + ";";
+		scope.emplace_back(cast->get_name(), false);
+		return result;
 	}
 	else if (std::dynamic_pointer_cast<ast::conditional_node>(ptr))
 	{
 		const auto cast = std::dynamic_pointer_cast<ast::conditional_node>(ptr);
-		return "if (" + get_cpp(cast->get_condition()) + ") " + get_cpp(cast->get_branch_true()) + (cast->get_branch_false() ? (" else " + get_cpp(cast->get_branch_false())) : "");
+		const std::string condition = get_cpp(cast->get_condition());
+
+		// A let can be a branch of its own
+		const size_t outer = scope.size();
+		const std::string branch_true = get_cpp(cast->get_branch_true());
+		scope.resize(outer);
+		const std::string branch_false = cast->get_branch_false() ? (" else " + get_cpp(cast->get_branch_false())) : "";
+		scope.resize(outer);
+
+		return "if (" + condition + ") " + branch_true + branch_false;
 	}
 	else if (std::dynamic_pointer_cast<ast::return_node>(ptr))
 	{
 		const auto cast = std::dynamic_pointer_cast<ast::return_node>(ptr);
 		return "return " + get_cpp(cast->get_value()) + ";";
 	}
+	else if (std::dynamic_pointer_cast<ast::record_node>(ptr))
+	{
+		const auto cast = std::dynamic_pointer_cast<ast::record_node>(ptr);
+		return get_record_cpp(cast);
+	}
 	else if (std::dynamic_pointer_cast<ast::empty_statement_node>(ptr))
 	{
 		const auto cast = std::dynamic_pointer_cast<ast::empty_statement_node>(ptr);
@@ -213,19 +563,170 @@ std::string generator::get_cpp(const std::shared_ptr<ast::statement_node>& ptr)
 	else if (std::dynamic_pointer_cast<ast::block_node>(ptr))
 	{
 		const auto cast = std::dynamic_pointer_cast<ast::block_node>(ptr);
-		return "\n{" + get_cpp(cast->get_statements(), "\n\t", "") + "\n}";
+		const size_t outer = scope.size();
+		const std::string statements = get_cpp(cast->get_statements(), "\n\t", "");
+		scope.resize(outer);
+		return "\n{" + statements + "\n}";
 	}
 
 	throw std::runtime_error("WTF BRO (statement)");
 }
 
 
+std::string generator::get_record_cpp(const std::shared_ptr<ast::record_node>& ptr)
+{
+	// Fields are stored without const, so that arrays can store records
+	std::string fields = "";
+	std::string initializers = "";
+	std::string members = "";
+	for(const auto& field : ptr->get_fields())
+	{
+		const std::string type = get_cpp(field->get_type());
+		fields += "\n\t" + (type.compare(0, 6, "const ") ? type : type.substr(6)) + " " + field->get_name() + ";";
+		initializers += (initializers.empty() ? ":\n\t\t" : ",\n\t\t") + field->get_name() + "(" + field->get_name() + ")";
+		members += (members.empty() ? "&" : ", &") + ptr->get_name() + "::" + field->get_name();
+	}
+
+	// Records with defaults for every field are default constructed by their own constructor
+	std::string constructors = "";
+	if (ptr->get_fields().empty() || !ptr->get_fields().front()->get_default_value())
+		constructors += "\n\t" + ptr->get_name() + "() = default;";
+	if (!ptr->get_fields().empty())
+		constructors += "\n\t" + ptr->get_name() + "(" + get_cpp(ptr->get_fields(), "", ", ") + ")" + initializers + "\n\t{ }";
+
+	// The array runtime stores records listing their fields as one array per field
+	std::string columns = "";
+	if (opts.columnar_records && !ptr->get_fields().empty())
+		columns = "\n\n\ttemplate<typename V>\n\tstatic auto pebkac_fields(const V& visit)\n\t{\n\t\treturn visit(" + members + ");\n\t}";
+
+	return "struct " + ptr->get_name() + "\n{" + fields + "\n" + constructors + columns + "\n};";
+}
+
+
+std::string generator::get_lazy_cpp(const std::shared_ptr<ast::let_node>& ptr, const std::string& capture)
+{
+	// The thunk's lambda returns the declared type, so the value is converted to it once
+	std::string type = "";
+	if (ptr->get_type())
+	{
+		const std::string declared = get_cpp(ptr->get_type());
+		type = " -> " + (declared.compare(0, 6, "const ") ? declared : declared.substr(6));
+	}
+
+	const std::string value = get_cpp(ptr->get_value());
+	const std::string thunk = closures.shared.count(ptr.get()) ? "pebkac_lazy::share(" : "pebkac_lazy::make(";
+	scope.emplace_back(ptr->get_name(), true);
+	lazy = true;
+
+	return "const auto " + ptr->get_name() + " = " + thunk + capture + "()" + type + " { return " + value + "; });";
+}
+
+
+std::string generator::get_match_cpp(const std::shared_ptr<ast::match_node>& ptr)
+{
+	// Each result is a lambda of its own, called only by the case picking it, and the match has the type the
+	// conditionals it stands for would have
+	const auto& cases = ptr->get_cases();
+	std::string results = "";
+	std::string type = "";
+	for(size_t i = 0; i < cases.size(); ++i)
+	{
+		const std::string name = "pebkac_result_" + std::to_string(i);
+		results += "\n\tconst auto " + name + " = [&](){ return " + get_cpp(cases[i]->get_result()) + "; };";
+		type += "true ? " + name + "() : ";
+	}
+	results += "\n\tconst auto pebkac_otherwise = [&](){ return " + get_cpp(ptr->get_otherwise()) + "; };";
+	type += "pebkac_otherwise()";
+
+	const std::vector<match_range> ranges = get_match_ranges(ptr);
+	return std::string(local ? "[&]" : "[]") + "(){\n\tconst auto pebkac_key = " + get_cpp(ptr->get_value()) + ";" + results
+		+ "\n\ttypedef decltype(" + type + ") pebkac_match_type;"
+		+ get_decision_tree(ranges, 0, ranges.size(), cases.size(), "\n\t") + "\n}()";
+}
+
+
 std::string generator::get_cpp()
 {
-	std::string result = "#include <iostream>\n#include <functional>\n\ntypedef long long integer;\ntypedef bool boolean;\nvoid print(long long n)\n{\n\tstd::cout << n << std::endl;\n}\n\n";
+	std::string result = runtime::get_prelude();
 
+	if (opts.constant_evaluation && !opts.profile)
+		constants = analysis::find_constants(ast);
+
+	if (opts.closure_conversion)
+		closures = analysis::find_closures(ast);
+	if (!closures.borrowed.empty())
+		result += runtime::get_closures();
+
+	if (opts.regions)
+		regions = analysis::find_regions(ast);
+
+	if (opts.profile)
+	{
+		std::vector<std::string> names = { };
+		for(const auto& ptr : ast)
+		{
+			if (const auto function = std::dynamic_pointer_cast<ast::function_node>(ptr))
+			{
+				profile_ids[function.get()] = names.size();
+				names.push_back(function->get_name());
+			}
+		}
+		result += runtime::get_profiler(names);
+	}
+
+	for(const auto& ptr : ast)
+	{
+		if (const auto function = std::dynamic_pointer_cast<ast::function_node>(ptr))
+			functions.insert(function->get_name());
+		else if (const auto record = std::dynamic_pointer_cast<ast::record_node>(ptr))
+			functions.insert(record->get_name());
+	}
+
+	// The array runtime is only known to be needed once everything is generated
+	std::string body = "";
 	for(const auto& ptr : ast)
-		result += get_cpp(ptr) + "\n\n";
+	{
+		const auto function = std::dynamic_pointer_cast<ast::function_node>(ptr);
+		trace::scope event(function ? opts.tracer : nullptr, "codegen", function ? function->get_name() : "");
 
-	return result;
+		body += get_line_directive(ptr) + get_top_level_cpp(ptr) + "\n\n";
+	}
+
+	if (lazy)
+		result += runtime::get_lazy();
+	if (fixed_width)
+		result += runtime::get_fixed_width();
+	if (bigints)
+		result += runtime::get_bigint();
+	if (floating_point)
+		result += runtime::get_floating_point();
+	if (arrays)
+		result += runtime::get_regions() + runtime::get_arrays();
+	if (persistent)
+		result += runtime::get_persistent();
+	if (parallel)
+		result += runtime::get_parallel(opts.parallel_chunk);
+	if (opts.fast_math)
+		result += runtime::get_fast_math();
+	return result + body;
+}
+
+
+std::string generator::get_top_level_cpp(const std::shared_ptr<ast::statement_node>& ptr)
+{
+	const auto function = std::dynamic_pointer_cast<ast::function_node>(ptr);
+	const auto let = std::dynamic_pointer_cast<ast::let_node>(ptr);
+
+	// Thunks outside of functions cannot capture anything, nor do they need to
+	if (let && let->is_lazy())
+		return get_lazy_cpp(let, "[]");
+
+	const std::string cpp = get_cpp(ptr);
+	if ((function && constants.functions.count(function->get_name())) || (let && constants.constants.count(let->get_name())))
+	{
+		// Constant declarations are all scalars, whose types start with "const"
+		if (cpp.compare(0, 6, "const ") == 0)
+			return "constexpr " + cpp.substr(6);
+	}
+	return cpp;
 }
@@ -1,14 +1,62 @@
 #pragma once
 
 #include "nodes.hpp"
+#include "lexing.hpp"
+#include "trace.hpp"
+#include "analysis.hpp"
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace pebkac::codegen
 {
+	struct options
+	{
+		// Name of the source file, as written in #line directives
+		std::string source_name = "";
+
+		// Line table of the source file. When set, every statement is preceded by a #line directive,
+		// so that C++ compiler errors and debuggers point back at the original source.
+		const lexing::line_table* lines = nullptr;
+
+		// When set, receives a trace event for every top-level function generated
+		trace::buffer* tracer = nullptr;
+
+		// Count the calls and time spent in every top-level function, and print a summary when the program exits
+		bool profile = false;
+
+		// Declare pure functions and constant lets constexpr, so that the C++ compiler can evaluate them ahead of time.
+		// Profiled functions cannot be constexpr, so profiling turns this off.
+		bool constant_evaluation = true;
+
+		// Have function-typed parameters borrow their argument when it cannot outlive the call, and escaping lambdas copy
+		// what they use
+		bool closure_conversion = true;
+
+		// Number of array elements each task of pmap and preduce works on
+		size_t parallel_chunk = 4096;
+
+		// Let the C++ compiler reorder and contract floating-point arithmetic in the generated functions
+		bool fast_math = false;
+
+		// Store arrays of records as one array per field, so that going over some fields does not load the others
+		bool columnar_records = false;
+
+		// Have calls that return a scalar take the arrays they make from a region, freed all at once when they return
+		bool regions = true;
+	};
+
+
 	class generator
 	{
 	public:
 		generator(
-			const std::vector<std::shared_ptr<ast::statement_node>>& ast
+			const std::vector<std::shared_ptr<ast::statement_node>>& ast,
+			const options& opts = { }
 		) noexcept;
 
 		std::string get_cpp();
@@ -19,8 +67,72 @@ namespace pebkac::codegen
 
 		template<class T>
 		std::string get_cpp(const std::vector<T>& ptrs, const std::string& indent, const std::string& separator);
+		std::string get_cpp(const std::vector<std::shared_ptr<ast::statement_node>>& ptrs, const std::string& indent, const std::string& separator);
 
 	private:
 		const std::vector<std::shared_ptr<ast::statement_node>>& ast;
+		const options opts;
+
+		// Index of each profiled function in the profiler's tables
+		std::unordered_map<const ast::function_node*, size_t> profile_ids;
+
+		analysis::constant_info constants;
+		analysis::closure_info closures;
+
+		// Top-level functions whose calls allocate from a region
+		std::unordered_set<std::string> regions;
+
+		// Top-level functions and records, which hide the array builtins of the same name
+		std::unordered_set<std::string> functions;
+
+		// Whether the generated code uses arrays, and needs their runtime
+		bool arrays;
+
+		// Whether the generated code uses persistent maps or vectors, and needs their runtime
+		bool persistent;
+
+		// Whether the generated code calls pmap or preduce, and needs the thread pool
+		bool parallel;
+
+		// Whether the generated code uses fixed-width integer types, and needs their typedefs and conversions
+		bool fixed_width;
+
+		// Whether the generated code uses bigints, and needs their class
+		bool bigints;
+
+		// Whether the program uses floats or doubles, whose % must call fmod. Known before generating anything.
+		bool floating_point;
+
+		// Whether the generated code has lazy lets, and needs their thunks
+		bool lazy;
+
+		// Whether a function's body is being generated. Lambdas outside of one cannot capture anything, nor need to.
+		bool local;
+
+		// Parameters and lets in scope, innermost last, with whether each is a lazy let called to get its value
+		std::vector<std::pair<std::string_view, bool>> scope;
+
+		std::string get_top_level_cpp(const std::shared_ptr<ast::statement_node>& ptr);
+
+		/**
+		 * @brief Declares a lazy let as a thunk computing its value, and brings it into scope
+		 * @param capture Capture of the thunk's lambda
+		 */
+		std::string get_lazy_cpp(const std::shared_ptr<ast::let_node>& ptr, const std::string& capture);
+
+		/**
+		 * @brief Declares a record as a struct with a constructor taking every field
+		 */
+		std::string get_record_cpp(const std::shared_ptr<ast::record_node>& ptr);
+
+		/**
+		 * @brief Generates a match as a lambda called in place, whose body tells the cases apart with a decision tree
+		 *
+		 * Small ranges become the labels of a switch, which C++ compilers turn into jump tables. Larger ones are
+		 * tested with comparisons, splitting the remaining ranges in two around them.
+		 */
+		std::string get_match_cpp(const std::shared_ptr<ast::match_node>& ptr);
+
+		std::string get_line_directive(const std::shared_ptr<ast::statement_node>& ptr) const;
 	};
 }
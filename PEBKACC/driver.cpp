@@ -0,0 +1,307 @@
+#include "driver.hpp"
+#include "codegen.hpp"
+#include "optimization.hpp"
+#include "thread_pool.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <filesystem>
+#include <unordered_map>
+
+using namespace pebkac;
+using namespace pebkac::driver;
+
+
+output_type driver::to_output_type(std::string_view s)
+{
+	if (s == "tokens") return output_type::TOKENS;
+	if (s == "ast") return output_type::AST;
+	if (s == "cpp") return output_type::CPP;
+
+	throw std::invalid_argument("Unrecognized argument \"" + std::string(s) + "\"");
+}
+
+
+std::string driver::get_extension(output_type t)
+{
+	if (t == output_type::TOKENS) return ".tokens.json";
+	if (t == output_type::AST) return ".ast.json";
+	if (t == output_type::CPP) return ".cpp";
+
+	throw std::runtime_error("Unknown output type.");
+}
+
+
+std::string driver::read_file(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file)
+		throw std::runtime_error("Cannot open \"" + path + "\"");
+
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	return buffer.str();
+}
+
+
+void driver::write_file(const std::string& path, const std::string& contents)
+{
+	std::ofstream file(path);
+	if (!file)
+		throw std::runtime_error("Cannot write \"" + path + "\"");
+
+	file << contents;
+}
+
+
+std::string format_diagnostics(const std::vector<ast::diagnostic>& diagnostics)
+{
+	std::string result = "";
+	for(const auto& d : diagnostics)
+		result += (result.length()?"\n":"") + std::to_string(d.position.line) + ":" + std::to_string(d.position.column) + ": " + d.message;
+	return result;
+}
+
+
+compilation_error::compilation_error(
+	const std::vector<ast::diagnostic>& diagnostics) noexcept:
+	std::runtime_error(format_diagnostics(diagnostics)),
+	diagnostics(diagnostics)
+{ }
+
+
+const std::vector<ast::diagnostic>& compilation_error::get_diagnostics() const noexcept
+{
+	return diagnostics;
+}
+
+
+std::vector<std::shared_ptr<ast::statement_node>> driver::parse(
+	const std::string& source,
+	const std::queue<lexing::token>& tokens,
+	size_t* node_count,
+	trace::buffer* tracer)
+{
+	const lexing::line_table lines(source);
+	ast::parser parser(tokens, lines);
+	parser.set_tracer(tracer);
+	const auto statements = parser.parse_statements();
+
+	if (node_count)
+		*node_count = parser.get_node_count();
+
+	if (!parser.get_diagnostics().empty())
+		throw compilation_error(parser.get_diagnostics());
+
+	// Matches become switches, which C++ only allows on integers
+	std::vector<ast::diagnostic> diagnostics = { };
+	for(const auto& error : analysis::find_non_integer_matches(statements))
+	{
+		const size_t offset = error.match->get_value()->get_span().offset;
+		diagnostics.push_back({"Cannot match values of type " + error.type + ", only integers", offset, lines.get_position(offset)});
+	}
+	if (!diagnostics.empty())
+		throw compilation_error(diagnostics);
+
+	return statements;
+}
+
+
+std::vector<std::shared_ptr<ast::statement_node>> driver::optimize(
+	const std::vector<std::shared_ptr<ast::statement_node>>& statements,
+	const options& opts)
+{
+	// Profiles report the functions as they were written
+	if (opts.profile)
+		return statements;
+
+	// Inlining comes after specialization, to call the lambdas in the clones right away
+	auto result = statements;
+	if (opts.specialization_budget)
+		result = optimization::specialize_functions(result, opts.specialization_budget);
+	if (opts.inline_budget)
+		result = optimization::inline_functions(result, opts.inline_budget);
+	if (opts.simd_reductions)
+		result = optimization::lower_reductions(result, opts.fast_math);
+	if (opts.common_subexpressions)
+		result = optimization::eliminate_common_subexpressions(result);
+	if (opts.dead_code_elimination)
+		result = optimization::eliminate_dead_code(result);
+	if (opts.sink_lets)
+		result = optimization::sink_lets(result);
+	if (opts.switches)
+		result = optimization::lower_switches(result);
+	return result;
+}
+
+
+std::string driver::serialize_tokens(std::queue<lexing::token> tokens)
+{
+	std::string result = "[";
+	bool a = true;
+	while(!tokens.empty())
+	{
+		result += (a?"":", ") + tokens.front().serialize()->to_json();
+		tokens.pop();
+		a = false;
+	}
+	return result + "]";
+}
+
+
+std::string driver::serialize_ast(const std::vector<std::shared_ptr<ast::statement_node>>& statements)
+{
+	return serialized_array(statements).to_json();
+}
+
+
+codegen::options driver::get_codegen_options(const options& opts, const lexing::line_table& lines)
+{
+	return {opts.source_name, opts.line_directives ? &lines : nullptr, opts.tracer, opts.profile, opts.constant_evaluation, opts.closure_conversion, opts.parallel_chunk, opts.fast_math, opts.columnar_records, opts.regions};
+}
+
+
+std::string driver::compile(const std::string& source, output_type type, const options& opts, stats::report* report)
+{
+	// Measuring is cheap enough to always do it
+	stats::report unused;
+	stats::report& r = report ? *report : unused;
+	r.source_bytes = source.size();
+
+	// Every phase feeds both the statistics and the trace
+	trace::scope compilation(opts.tracer, "compile", opts.source_name);
+	const auto phase = [&](const char* name, const auto& f) {
+		trace::scope event(opts.tracer, "phase", name, opts.source_name);
+		return r.measure(name, f);
+	};
+
+	//Tokenize
+	const std::queue<lexing::token> tokens = phase("tokenize", [&]{ return lexing::tokenize(source); });
+	r.tokens = tokens.size();
+
+	if (type == output_type::TOKENS)
+		return phase("serialize", [&]{ return serialize_tokens(tokens); });
+
+	//Build Abstract Syntax Tree
+	const auto statements = phase("parse", [&]{ return parse(source, tokens, &r.nodes, opts.tracer); });
+
+	if (type == output_type::AST)
+		return phase("serialize", [&]{ return serialize_ast(statements); });
+
+	const auto optimized = phase("optimize", [&]{ return optimize(statements, opts); });
+
+	//Generate C++
+	return phase("codegen", [&]{
+		const lexing::line_table lines(source);
+		codegen::generator g(optimized, get_codegen_options(opts, lines));
+		return g.get_cpp();
+	});
+}
+
+
+std::vector<std::string> driver::read_manifest(const std::string& path)
+{
+	std::istringstream manifest(read_file(path));
+	std::vector<std::string> sources = { };
+
+	for(std::string line; std::getline(manifest, line);)
+	{
+		// Tolerate CRLF manifests and surrounding whitespace
+		const size_t begin = line.find_first_not_of(" \t\r");
+		if (begin == std::string::npos || line[begin] == '#')
+			continue;
+		const size_t end = line.find_last_not_of(" \t\r");
+
+		sources.push_back(line.substr(begin, end - begin + 1));
+	}
+
+	return sources;
+}
+
+
+std::vector<batch_result> driver::compile_batch(
+	const std::vector<std::string>& sources,
+	output_type type,
+	const std::string& output_dir,
+	size_t threads,
+	const options& opts)
+{
+	// Every job owns exactly one slot, so results need no locking
+	std::vector<batch_result> results(sources.size());
+
+	// A source listed more than once is compiled once, the later entries share the result of the first
+	std::unordered_map<std::string, size_t> first_entries;
+	std::vector<size_t> first_entry(sources.size());
+
+	// Sources with the same name in different directories would write the same output, so none of them is compiled
+	std::unordered_map<std::string, std::vector<size_t>> writers;
+	for(size_t i = 0; i < sources.size(); ++i)
+	{
+		batch_result& r = results[i];
+		r.source = sources[i];
+		r.success = false;
+		r.seconds = 0;
+
+		std::filesystem::path out = std::filesystem::path(sources[i]).replace_extension("");
+		if (!output_dir.empty())
+			out = std::filesystem::path(output_dir) / out.filename();
+		r.output = out.string() + get_extension(type);
+
+		first_entry[i] = first_entries.try_emplace(std::filesystem::absolute(sources[i]).lexically_normal().string(), i).first->second;
+		if (first_entry[i] == i)
+			writers[std::filesystem::absolute(r.output).lexically_normal().string()].push_back(i);
+	}
+	for(const auto& [output, indices] : writers)
+	{
+		if (indices.size() < 2)
+			continue;
+		for(const size_t i : indices)
+		{
+			results[i].message = "Output " + results[i].output + " would also be written by";
+			for(const size_t j : indices)
+			{
+				if (j != i)
+					results[i].message += " " + sources[j];
+			}
+		}
+	}
+
+	thread_pool pool(std::min(threads ? threads : std::thread::hardware_concurrency(), std::max<size_t>(sources.size(), 1)));
+	for(size_t i = 0; i < sources.size(); ++i)
+	{
+		if (!results[i].message.empty() || first_entry[i] != i)
+			continue;
+
+		pool.submit([&, i]{
+			batch_result& r = results[i];
+
+			options file_opts = opts;
+			file_opts.source_name = sources[i];
+
+			const auto start = std::chrono::steady_clock::now();
+			try
+			{
+				write_file(r.output, compile(read_file(sources[i]), type, file_opts, opts.stats != stats::format::NONE ? &r.stats : nullptr) + "\n");
+				r.success = true;
+			}
+			catch(const std::exception& e)
+			{
+				r.message = e.what();
+			}
+			r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		});
+	}
+	pool.wait();
+
+	for(size_t i = 0; i < sources.size(); ++i)
+	{
+		if (first_entry[i] != i)
+		{
+			results[i] = results[first_entry[i]];
+			results[i].source = sources[i];
+		}
+	}
+	return results;
+}
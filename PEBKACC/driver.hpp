@@ -0,0 +1,190 @@
+#pragma once
+
+#include "lexing.hpp"
+#include "nodes.hpp"
+#include "ast.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+#include "codegen.hpp"
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <string_view>
+
+namespace pebkac::driver
+{
+	enum class output_type
+	{
+		TOKENS,
+		AST,
+		CPP,
+	};
+
+	struct options
+	{
+		// Name of the source file, used in #line directives
+		std::string source_name = "";
+
+		// Precede every generated statement with a #line directive pointing back at the source
+		bool line_directives = false;
+
+		// Instrument the generated program to report the calls and time spent in each function
+		bool profile = false;
+
+		// Let the C++ compiler evaluate pure functions and constants ahead of time
+		bool constant_evaluation = true;
+
+		// Pass closures to the parameters that only borrow them without copying them
+		bool closure_conversion = true;
+
+		// Most AST nodes that clones of higher-order functions may add. 0 disables specialization.
+		size_t specialization_budget = 1024;
+
+		// Largest function body, in AST nodes, that calls are replaced with. 0 disables inlining.
+		size_t inline_budget = 16;
+
+		// Compute folds adding integers, or finding the smallest or largest one, with SIMD instructions
+		bool simd_reductions = true;
+
+		// Number of array elements each parallel task of pmap and preduce works on
+		size_t parallel_chunk = 4096;
+
+		// Let floating-point arithmetic be reordered and contracted, which rounds differently but vectorizes
+		bool fast_math = false;
+
+		// Store arrays of records as one array per field
+		bool columnar_records = false;
+
+		// Take the arrays of calls returning a scalar from a region freed when they return
+		bool regions = true;
+
+		// Compute repeated pure subexpressions, and the invariants of tail-recursive functions, only once
+		bool common_subexpressions = true;
+
+		// Remove the functions and lets a program with a main cannot use
+		bool dead_code_elimination = true;
+
+		// Move lets that cannot fail into the only branch using them, so the other branches do not compute them
+		bool sink_lets = true;
+
+		// Generate chains of conditionals comparing an integer with literals as switches
+		bool switches = true;
+
+		// Report where each compilation spends its time and memory
+		stats::format stats = stats::format::NONE;
+
+		// When set, receives trace events for every phase and function. Shared by every batch job.
+		trace::buffer* tracer = nullptr;
+	};
+
+
+	output_type to_output_type(std::string_view s);
+	std::string get_extension(output_type t);
+
+	/**
+	 * @brief Reads a whole file into memory
+	 * @param path Path of the file to read
+	 * @return The contents of the file
+	 */
+	std::string read_file(const std::string& path);
+
+	/**
+	 * @brief Overwrites a file with the given contents
+	 */
+	void write_file(const std::string& path, const std::string& contents);
+
+	class compilation_error: public std::runtime_error
+	{
+	public:
+		compilation_error(
+			const std::vector<ast::diagnostic>& diagnostics
+		) noexcept;
+
+		const std::vector<ast::diagnostic>& get_diagnostics() const noexcept;
+
+	private:
+		const std::vector<ast::diagnostic> diagnostics;
+	};
+
+
+	/**
+	 * @brief Parses tokens into an AST, collecting every syntax error in a single pass
+	 * @param source Source code the tokens come from, used to locate errors
+	 * @param tokens Tokens to parse
+	 * @param node_count If not null, receives the number of AST nodes created
+	 * @param tracer If not null, receives a trace event for every function parsed
+	 * @return The AST, if there were no syntax errors
+	 * @throws compilation_error Listing every syntax error
+	 */
+	std::vector<std::shared_ptr<ast::statement_node>> parse(
+		const std::string& source,
+		const std::queue<lexing::token>& tokens,
+		size_t* node_count = nullptr,
+		trace::buffer* tracer = nullptr
+	);
+
+	/**
+	 * @brief Runs the optimization passes enabled by the options on an AST
+	 * @return The optimized AST, which shares the nodes that did not change with the original one
+	 */
+	std::vector<std::shared_ptr<ast::statement_node>> optimize(
+		const std::vector<std::shared_ptr<ast::statement_node>>& statements,
+		const options& opts
+	);
+
+	/**
+	 * @brief Returns the code generator options matching the compilation options, for every mode to generate the same code
+	 * @param lines Line table of the source, which #line directives are generated from when the options ask for them
+	 */
+	codegen::options get_codegen_options(const options& opts, const lexing::line_table& lines);
+
+	std::string serialize_tokens(std::queue<lexing::token> tokens);
+	std::string serialize_ast(const std::vector<std::shared_ptr<ast::statement_node>>& statements);
+
+	/**
+	 * @brief Runs the compiler pipeline on a source string, up to the requested output
+	 * @param source Source code to compile
+	 * @param type Which stage of the pipeline to output
+	 * @param opts Compilation options
+	 * @param report If not null, receives the timings and allocations of every phase, even when compilation fails
+	 * @return Serialized tokens or AST, or generated C++ code
+	 */
+	std::string compile(const std::string& source, output_type type, const options& opts = { }, stats::report* report = nullptr);
+
+
+	struct batch_result
+	{
+		std::string source;
+		std::string output;
+		bool success;
+		std::string message;
+		double seconds;
+
+		// Only filled when statistics were requested
+		stats::report stats;
+	};
+
+	/**
+	 * @brief Reads a manifest file, one source path per line. Blank lines and lines starting with # are ignored
+	 */
+	std::vector<std::string> read_manifest(const std::string& path);
+
+	/**
+	 * @brief Compiles many source files concurrently on a pool of worker threads
+	 * @param sources Paths of the source files to compile
+	 * @param type Which stage of the pipeline to output
+	 * @param output_dir Directory for the output files, or empty to write them next to their sources. Sources whose
+	 * outputs would have the same path fail without being compiled. A source listed more than once is compiled once.
+	 * @param threads Number of worker threads, 0 picks the hardware concurrency
+	 * @param opts Compilation options, shared by every source file except for its name
+	 * @return One result per source file, in the same order as the sources
+	 */
+	std::vector<batch_result> compile_batch(
+		const std::vector<std::string>& sources,
+		output_type type,
+		const std::string& output_dir,
+		size_t threads,
+		const options& opts = { }
+	);
+}
@@ -0,0 +1,247 @@
+#include "incremental.hpp"
+#include "ast.hpp"
+
+#include <exception>
+#include <stdexcept>
+
+using namespace pebkac;
+using namespace pebkac::incremental;
+
+
+// Largest number of segments an edit's region grows by at once, looking for the end of an unclosed bracket
+static const size_t max_growth_step = 8;
+
+
+document::document(
+	const std::string& source):
+	source(source)
+{
+	try
+	{
+		segments = parse_region(0, source.size(), true);
+	}
+	catch(const std::exception&)
+	{
+		// Files are often opened while broken, so only edits report errors
+		segments.push_back({0, { }, nullptr, true});
+		mark_broken(0, 0, 0, source.size());
+	}
+}
+
+
+const std::string& document::get_source() const noexcept
+{
+	return source;
+}
+
+
+std::queue<lexing::token> document::get_tokens() const
+{
+	// Segments store offsets relative to their own start, so that edits do not invalidate the ones after them
+	std::queue<lexing::token> tokens = { };
+	size_t begin = 0;
+	for(const auto& s : segments)
+	{
+		for(const auto& t : s.tokens)
+			tokens.push(lexing::token(t.get_type(), t.get_value(), begin + t.get_offset()));
+		begin += s.length;
+	}
+	return tokens;
+}
+
+
+bool document::is_valid() const noexcept
+{
+	for(const auto& s : segments)
+	{
+		if (!s.valid)
+			return false;
+	}
+	return true;
+}
+
+
+std::vector<std::shared_ptr<ast::statement_node>> document::get_statements() const
+{
+	std::vector<std::shared_ptr<ast::statement_node>> statements = { };
+	for(const auto& s : segments)
+	{
+		if (s.statement)
+			statements.push_back(s.statement);
+	}
+	return statements;
+}
+
+
+std::vector<size_t> document::get_statement_offsets() const
+{
+	std::vector<size_t> offsets = { };
+	size_t begin = 0;
+	for(const auto& s : segments)
+	{
+		if (s.statement)
+			offsets.push_back(begin);
+		begin += s.length;
+	}
+	return offsets;
+}
+
+
+std::vector<document::segment> document::parse_region(size_t begin, size_t end, bool at_end) const
+{
+	std::queue<lexing::token> queue = lexing::tokenize(source, begin, end);
+	const std::vector<lexing::token> tokens = [queue]() mutable {
+		std::vector<lexing::token> v = { };
+		for(; !queue.empty(); queue.pop())
+			v.push_back(queue.front());
+		return v;
+	}();
+
+	// An unterminated block comment lexes as "/" "*", and the comment's end may lie past this region
+	if (!at_end)
+	{
+		for(size_t i = 1; i < tokens.size(); ++i)
+		{
+			if (tokens[i-1].get_value() == "/" && tokens[i].get_value() == "*" && tokens[i].get_offset() == tokens[i-1].get_offset() + 1)
+				throw ast::end_error();
+		}
+	}
+
+	// Parse one statement at a time, and cut a segment after the last token each one consumed
+	std::vector<segment> result = { };
+	ast::parser parser(queue);
+	size_t first = 0;
+	size_t segment_begin = begin;
+	while(!parser.is_end())
+	{
+		// Spans are relative to the segment, so that they do not depend on the segments before it
+		parser.set_origin(segment_begin);
+		const auto statement = parser.parse_statement();
+		const size_t consumed = tokens.size() - parser.get_token_count();
+		const lexing::token& last = tokens[consumed - 1];
+		const size_t segment_end = last.get_offset() + last.get_value().size();
+
+		segment s = { segment_end - segment_begin, { }, statement, true };
+		for(size_t i = first; i < consumed; ++i)
+			s.tokens.push_back(lexing::token(tokens[i].get_type(), tokens[i].get_value(), tokens[i].get_offset() - segment_begin));
+		result.push_back(std::move(s));
+
+		first = consumed;
+		segment_begin = segment_end;
+	}
+
+	// Trailing whitespace and comments join the last segment
+	if (result.empty())
+		result.push_back({0, { }, nullptr, true});
+	for(size_t i = first; i < tokens.size(); ++i)
+		result.back().tokens.push_back(lexing::token(tokens[i].get_type(), tokens[i].get_value(), tokens[i].get_offset() - (segment_begin - result.back().length)));
+	result.back().length += end - segment_begin;
+
+	return result;
+}
+
+
+void document::edit(size_t offset, size_t length, const std::string& text)
+{
+	if (offset + length > source.size())
+		throw std::out_of_range("Edit range is outside of the document.");
+
+	// Find every segment touching the edit, including the ones that merely border it
+	size_t first = 0;
+	size_t begin = 0;
+	while(first + 1 < segments.size() && begin + segments[first].length < offset)
+		begin += segments[first++].length;
+
+	size_t last = first;
+	size_t end = begin + segments[first].length;
+	while(last + 1 < segments.size() && end <= offset + length)
+		end += segments[++last].length;
+
+	source.replace(offset, length, text);
+	end = end - length + text.size();
+	const size_t edited_first = first;
+	const size_t edited_last = last;
+	const size_t edited_begin = begin;
+	const size_t edited_end = end;
+
+	// Grow the region until it parses on its own
+	std::vector<segment> replacement;
+	std::exception_ptr error = nullptr;
+	bool grown_back = false;
+	size_t step = 1;
+	while(true)
+	{
+		try
+		{
+			replacement = parse_region(begin, end, last + 1 == segments.size());
+			error = nullptr;
+			break;
+		}
+		catch(const ast::end_error&)
+		{
+			// Ran out of tokens, an unclosed bracket or comment needs the text that follows. Grow geometrically,
+			// but only a few times, as a brace that is never closed would swallow the rest of the document.
+			error = std::current_exception();
+			if (last + 1 < segments.size() && step <= max_growth_step)
+			{
+				for(size_t i = 0; i < step && last + 1 < segments.size(); ++i)
+					end += segments[++last].length;
+				step *= 2;
+				continue;
+			}
+			if (grow_back(first, begin, grown_back))
+				continue;
+		}
+		catch(const std::exception&)
+		{
+			// The previous statement may own the start of this region, such as an "else" typed after an "if".
+			// Otherwise, the parser never looks past the offending token, so growing forward would not help.
+			error = std::current_exception();
+			if (grow_back(first, begin, grown_back))
+				continue;
+		}
+		break;
+	}
+
+	if (error)
+	{
+		// The edit may close a region broken by an earlier one, which one reparse of the whole document finds out.
+		// Otherwise only the edited segments are left broken, and the statements around them stay available.
+		try
+		{
+			segments = parse_region(0, source.size(), true);
+			return;
+		}
+		catch(const std::exception&)
+		{
+			mark_broken(edited_first, edited_last, edited_begin, edited_end);
+			std::rethrow_exception(error);
+		}
+	}
+
+	segments.erase(segments.begin() + first, segments.begin() + last + 1);
+	segments.insert(segments.begin() + first, std::make_move_iterator(replacement.begin()), std::make_move_iterator(replacement.end()));
+}
+
+
+bool document::grow_back(size_t& first, size_t& begin, bool& grown_back) const noexcept
+{
+	if (grown_back || first == 0)
+		return false;
+
+	begin -= segments[--first].length;
+	grown_back = true;
+	return true;
+}
+
+
+void document::mark_broken(size_t first, size_t last, size_t begin, size_t end)
+{
+	// Keep the region's tokens around, unparsed, until a later edit touches it again
+	segment broken = {end - begin, { }, nullptr, false};
+	for(auto tokens = lexing::tokenize(source, begin, end); !tokens.empty(); tokens.pop())
+		broken.tokens.push_back(lexing::token(tokens.front().get_type(), tokens.front().get_value(), tokens.front().get_offset() - begin));
+
+	segments.erase(segments.begin() + first, segments.begin() + last + 1);
+	segments.insert(segments.begin() + first, std::move(broken));
+}
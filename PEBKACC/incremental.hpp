@@ -0,0 +1,76 @@
+#pragma once
+
+#include "lexing.hpp"
+#include "nodes.hpp"
+
+#include <queue>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pebkac::incremental
+{
+	/**
+	 * @brief A source file kept tokenized and parsed across edits
+	 *
+	 * The source is split into segments, one per top-level statement. An edit only re-lexes and re-parses
+	 * the segments it touches, every other segment keeps its tokens and AST subtree untouched.
+	 */
+	class document
+	{
+	public:
+		/**
+		 * @brief Tokenizes and parses a whole source file. A source that does not parse is kept as a single broken region.
+		 */
+		document(
+			const std::string& source
+		);
+
+		/**
+		 * @brief Replaces a range of the source, then updates the tokens and AST to match
+		 * @param offset Offset of the first character to replace
+		 * @param length Number of characters to replace
+		 * @param text Text to insert in their place
+		 *
+		 * If the edited source does not parse, the edit is still applied and the parsing error is rethrown.
+		 * The edited statements are kept unparsed, and left out of the statements, until a later edit fixes them.
+		 * The statements around them keep their ASTs.
+		 */
+		void edit(size_t offset, size_t length, const std::string& text);
+
+		/**
+		 * @brief Checks whether every part of the document parsed successfully
+		 */
+		bool is_valid() const noexcept;
+
+		const std::string& get_source() const noexcept;
+		std::queue<lexing::token> get_tokens() const;
+		std::vector<std::shared_ptr<ast::statement_node>> get_statements() const;
+
+		/**
+		 * @brief Returns where each statement's segment begins in the source, in the same order as get_statements()
+		 *
+		 * Spans of the statements' nodes are relative to their segment, so that edits do not invalidate them.
+		 */
+		std::vector<size_t> get_statement_offsets() const;
+
+	private:
+		struct segment
+		{
+			// Number of source characters covered, including leading whitespace and comments
+			size_t length;
+			std::vector<lexing::token> tokens;
+
+			// Null when the segment holds no statement, or could not be parsed
+			std::shared_ptr<ast::statement_node> statement;
+			bool valid;
+		};
+
+		std::string source;
+		std::vector<segment> segments;
+
+		std::vector<segment> parse_region(size_t begin, size_t end, bool at_end) const;
+		bool grow_back(size_t& first, size_t& begin, bool& grown_back) const noexcept;
+		void mark_broken(size_t first, size_t last, size_t begin, size_t end);
+	};
+}
@@ -1,6 +1,7 @@
 #include "lexing.hpp"
 
 #include <regex>
+#include <cctype>
 #include <limits>
 #include <algorithm>
 #include <stdexcept>
@@ -13,10 +14,34 @@ using namespace pebkac::lexing;
 using namespace std::string_literals;
 
 
+std::uint32_t source_span::get_end() const noexcept
+{
+	return offset + length;
+}
+
+
+bool source_span::is_empty() const noexcept
+{
+	return length == 0;
+}
+
+
+source_span source_span::operator | (const source_span& other) const noexcept
+{
+	if (is_empty()) return other;
+	if (other.is_empty()) return *this;
+
+	const std::uint32_t begin = std::min(offset, other.offset);
+	return {begin, std::max(get_end(), other.get_end()) - begin};
+}
+
+
 token::token(
 	token_type type,
-	const std::string& value) noexcept:
+	const std::string& value,
+	size_t offset) noexcept:
 	type(type),
+	span({static_cast<std::uint32_t>(offset), static_cast<std::uint32_t>(value.size())}),
 	value(value)
 { }
 
@@ -45,6 +70,18 @@ const std::string& token::get_value() const noexcept
 }
 
 
+const source_span& token::get_span() const noexcept
+{
+	return span;
+}
+
+
+size_t token::get_offset() const noexcept
+{
+	return span.offset;
+}
+
+
 std::shared_ptr<serialized> token::serialize() const
 {
 	auto obj = std::make_shared<serialized_object>();
@@ -54,6 +91,25 @@ std::shared_ptr<serialized> token::serialize() const
 }
 
 
+line_table::line_table(
+	const std::string& source) noexcept:
+	source(source)
+{ }
+
+
+position line_table::get_position(size_t offset) const
+{
+	std::call_once(built, [this]{
+		line_starts.push_back(0);
+		for(size_t i = source.find('\n'); i != std::string::npos; i = source.find('\n', i + 1))
+			line_starts.push_back(static_cast<std::uint32_t>(i + 1));
+	});
+
+	const size_t line = std::distance(line_starts.begin(), std::upper_bound(line_starts.begin(), line_starts.end(), offset)) - 1;
+	return {line + 1, offset - line_starts[line] + 1};
+}
+
+
 std::string lexing::to_string(token_type t)
 {
 	if (t == token_type::COMMENT) return "COMMENT";
@@ -71,32 +127,50 @@ std::string lexing::to_string(token_type t)
 
 std::queue<token> lexing::tokenize(const std::string& source)
 {
+	return tokenize(source, 0, source.size());
+}
+
+
+std::queue<token> lexing::tokenize(const std::string& source, size_t begin, size_t end)
+{
+	// Spans use 32-bit offsets
+	if (end > std::numeric_limits<std::uint32_t>::max())
+		throw std::runtime_error("Source code larger than 4 GiB is not supported.");
+
 	// Regex query corresponding to each type of token/lexeme. Yes, regex is fugly.
 	// Order of elements matters! Later elements in the list have higher priority.
 	const static std::array<const std::pair<const token_type, const std::regex>, 8> regex_queries = {
 		std::make_pair(token_type::COMMENT, std::regex("(\\/{2,}.*)|(\\/\\*[\\s\\S]*?\\*\\/)")),
 		std::make_pair(token_type::IDENTIFIER, std::regex("\\w+")),
 		std::make_pair(token_type::OPERATOR, std::regex("[+\\-*/%!]|!=|==|<|>|<=|>=|&&|\\|\\|")),
-		std::make_pair(token_type::KEYWORD, std::regex("(fun|io|return|let|if|else)\\b")),
+		std::make_pair(token_type::KEYWORD, std::regex("(fun|io|return|lazy|let|record|if|else|match)\\b")),
 		std::make_pair(token_type::BRACKET, std::regex("[(){}[\\]]")),
-		std::make_pair(token_type::SYNTATIC_ELEMENT, std::regex(":|;|->|=|,")),
-		std::make_pair(token_type::NUMERIC_LITERAL, std::regex("\\d*\\.?\\d+")),
+		std::make_pair(token_type::SYNTATIC_ELEMENT, std::regex(":|;|->|=|,|\\.\\.|\\.")),
+		std::make_pair(token_type::NUMERIC_LITERAL, std::regex("\\d*\\.?\\d+([eE][+\\-]?\\d+)?(f|n|[iu](8|16|32|64))?")),
 		std::make_pair(token_type::BOOLEAN_LITERAL, std::regex("(true|false)\\b")),
 	};
 
 	// Loop through the source code and parse it into tokens
 	std::queue<token> result = {};
-	for(std::string::const_iterator current = source.begin(); current != source.end();)
+	const std::string::const_iterator last = source.begin() + end;
+	for(std::string::const_iterator current = source.begin() + begin; current != last;)
 	{
-		// Try every single regex
+		// No token starts with whitespace, so skip it before matching
+		while(current != last && std::isspace(static_cast<unsigned char>(*current)))
+			++current;
+		if (current == last)
+			break;
+
+		// Try every single regex, anchored at the current character. This keeps tokenizing linear,
+		// since an unanchored search may scan all the way to the end for each token.
 		size_t i = 0;
 		size_t fails = 0;
 		std::array<std::pair<size_t, std::string>, regex_queries.size()> query_results;
 		for(const auto& [t, r] : regex_queries)
 		{
-			if (auto it = std::sregex_iterator(current, source.end(), r); it != std::sregex_iterator())
+			if (std::smatch m; std::regex_search(current, last, m, r, std::regex_constants::match_continuous))
 			{
-				query_results[i] = std::make_pair(it->position(), it->str());
+				query_results[i] = std::make_pair(0, m.str());
 			}
 			else
 			{
@@ -106,6 +180,26 @@ std::queue<token> lexing::tokenize(const std::string& source)
 			++i;
 		}
 
+		// Nothing starts here, so fall back to searching for the nearest token
+		if (fails == regex_queries.size())
+		{
+			i = 0;
+			fails = 0;
+			for(const auto& [t, r] : regex_queries)
+			{
+				if (auto it = std::sregex_iterator(current, last, r); it != std::sregex_iterator())
+				{
+					query_results[i] = std::make_pair(it->position(), it->str());
+				}
+				else
+				{
+					query_results[i] = std::make_pair(std::numeric_limits<size_t>::max(), "");
+					++fails;
+				}
+				++i;
+			}
+		}
+
 		//If no more tokens exist, end the loop
 		if (fails == regex_queries.size())
 			break;
@@ -119,8 +213,9 @@ std::queue<token> lexing::tokenize(const std::string& source)
 			}));
 
 		//Update result
-		result.push(token(regex_queries[index].first, query_results[index].second));
-		current += query_results[index].first + query_results[index].second.length();
+		current += query_results[index].first;
+		result.push(token(regex_queries[index].first, query_results[index].second, current - source.begin()));
+		current += query_results[index].second.length();
 	}
 
 	// C++11 has move-semantics, so it does not have to copy the local vector when returning.
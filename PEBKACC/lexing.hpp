@@ -2,10 +2,12 @@
 
 #include "serialization.hpp"
 
+#include <mutex>
 #include <vector>
 #include <queue>
 #include <array>
 #include <string>
+#include <cstdint>
 
 namespace pebkac::lexing
 {
@@ -23,28 +25,92 @@ namespace pebkac::lexing
 
 	std::string to_string(token_type t);
 
+
+	/**
+	 * @brief A range of source code, packed into 8 bytes so that every token and AST node can afford one
+	 */
+	struct source_span
+	{
+		std::uint32_t offset;
+		std::uint32_t length;
+
+		std::uint32_t get_end() const noexcept;
+		bool is_empty() const noexcept;
+
+		/**
+		 * @brief Returns the smallest span covering both spans
+		 */
+		source_span operator | (const source_span& other) const noexcept;
+	};
+
+
 	class token: public serializable
 	{
 	public:
-		token(token_type type, const std::string& value) noexcept;
+		token(token_type type, const std::string& value, size_t offset = 0) noexcept;
 
 		bool operator == (const token& other) const noexcept;
 		bool operator != (const token& other) const noexcept;
 
 		const token_type& get_type() const noexcept;
 		const std::string& get_value() const noexcept;
+		const source_span& get_span() const noexcept;
+		size_t get_offset() const noexcept;
 
 		std::shared_ptr<serialized> serialize() const;
 
 	private:
 		const token_type type;
+		const source_span span;
 		const std::string value;
 	};
 
+	struct position
+	{
+		size_t line;
+		size_t column;
+	};
+
+
+	/**
+	 * @brief Maps source offsets back to lines and columns
+	 *
+	 * The table is only built the first time it is used, so that compiling a valid file without
+	 * line directives never pays for it. The source must outlive the table.
+	 */
+	class line_table
+	{
+	public:
+		line_table(const std::string& source) noexcept;
+
+		/**
+		 * @brief Finds where an offset lies in the source
+		 * @return The 1-based line and column of the offset
+		 */
+		position get_position(size_t offset) const;
+
+	private:
+		const std::string& source;
+
+		// Offset of the first character of each line
+		mutable std::once_flag built;
+		mutable std::vector<std::uint32_t> line_starts;
+	};
+
+
 	/**
 	 * @brief Splits a source code string into tokens
 	 * @param source Source code to parse into tokens
 	 * @return A FIFO queue of tokens, used for parsing
 	 */
 	std::queue<token> tokenize(const std::string& source);
+
+	/**
+	 * @brief Splits part of a source code string into tokens
+	 * @param source Source code to parse into tokens
+	 * @param begin Offset of the first character to tokenize, which must not be in the middle of a token
+	 * @param end Offset one past the last character to tokenize
+	 * @return A FIFO queue of tokens, whose offsets are relative to the start of the whole source
+	 */
+	std::queue<token> tokenize(const std::string& source, size_t begin, size_t end);
 }
@@ -10,6 +10,18 @@ using namespace pebkac::ast;
 using namespace std::string_literals;
 
 
+const lexing::source_span& node::get_span() const noexcept
+{
+	return span;
+}
+
+
+void node::set_span(const lexing::source_span& span) noexcept
+{
+	this->span = span;
+}
+
+
 std::string to_string(specifier s)
 {
 	if (s == specifier::IO) return "IO";
@@ -98,6 +110,78 @@ std::shared_ptr<serialized> function_type_node::serialize() const
 }
 
 
+array_type_node::array_type_node(
+	const std::shared_ptr<type_node>& element_type) noexcept:
+	element_type(element_type)
+{ }
+
+
+const std::shared_ptr<type_node>& array_type_node::get_element_type() const noexcept
+{
+	return element_type;
+}
+
+
+std::shared_ptr<serialized> array_type_node::serialize() const
+{
+	auto obj = std::make_shared<serialized_object>();
+	*obj += std::make_pair("node"s, "array_type"s);
+	*obj += std::make_pair("element_type"s, element_type);
+	return obj;
+}
+
+
+map_type_node::map_type_node(
+	const std::shared_ptr<type_node>& key_type,
+	const std::shared_ptr<type_node>& value_type) noexcept:
+	key_type(key_type),
+	value_type(value_type)
+{ }
+
+
+const std::shared_ptr<type_node>& map_type_node::get_key_type() const noexcept
+{
+	return key_type;
+}
+
+
+const std::shared_ptr<type_node>& map_type_node::get_value_type() const noexcept
+{
+	return value_type;
+}
+
+
+std::shared_ptr<serialized> map_type_node::serialize() const
+{
+	auto obj = std::make_shared<serialized_object>();
+	*obj += std::make_pair("node"s, "map_type"s);
+	*obj += std::make_pair("key_type"s, key_type);
+	*obj += std::make_pair("value_type"s, value_type);
+	return obj;
+}
+
+
+vector_type_node::vector_type_node(
+	const std::shared_ptr<type_node>& element_type) noexcept:
+	element_type(element_type)
+{ }
+
+
+const std::shared_ptr<type_node>& vector_type_node::get_element_type() const noexcept
+{
+	return element_type;
+}
+
+
+std::shared_ptr<serialized> vector_type_node::serialize() const
+{
+	auto obj = std::make_shared<serialized_object>();
+	*obj += std::make_pair("node"s, "vector_type"s);
+	*obj += std::make_pair("element_type"s, element_type);
+	return obj;
+}
+
+
 identifier_node::identifier_node(
 	const std::string& value) noexcept:
 	value(value)
@@ -110,6 +194,19 @@ const std::string& identifier_node::get_value() const noexcept
 }
 
 
+const lexing::source_span& identifier_node::get_span() const noexcept
+{
+	return expression_node::get_span();
+}
+
+
+void identifier_node::set_span(const lexing::source_span& span) noexcept
+{
+	expression_node::set_span(span);
+	type_node::set_span(span);
+}
+
+
 std::shared_ptr<serialized> identifier_node::serialize() const
 {
 	auto obj = std::make_shared<serialized_object>();
@@ -120,8 +217,12 @@ std::shared_ptr<serialized> identifier_node::serialize() const
 
 
 numeric_literal_node::numeric_literal_node(
-	long long value) noexcept:
-	value(value)
+	long long value,
+	const std::string& suffix,
+	const std::vector<std::uint32_t>& limbs) noexcept:
+	value(value),
+	suffix(suffix),
+	limbs(limbs)
 { }
 
 
@@ -131,11 +232,58 @@ long long numeric_literal_node::get_value() const noexcept
 }
 
 
+const std::string& numeric_literal_node::get_suffix() const noexcept
+{
+	return suffix;
+}
+
+
+const std::vector<std::uint32_t>& numeric_literal_node::get_limbs() const noexcept
+{
+	return limbs;
+}
+
+
 std::shared_ptr<serialized> numeric_literal_node::serialize() const
 {
 	auto obj = std::make_shared<serialized_object>();
 	*obj += std::make_pair("node"s, "numeric_literal"s);
 	*obj += std::make_pair("value"s, value);
+	if (suffix.length())
+		*obj += std::make_pair("suffix"s, suffix);
+	if (limbs.size())
+		*obj += std::make_pair("limbs"s, std::vector<long long>(limbs.begin(), limbs.end()));
+	return obj;
+}
+
+
+floating_literal_node::floating_literal_node(
+	double value,
+	const std::string& suffix) noexcept:
+	value(value),
+	suffix(suffix)
+{ }
+
+
+double floating_literal_node::get_value() const noexcept
+{
+	return value;
+}
+
+
+const std::string& floating_literal_node::get_suffix() const noexcept
+{
+	return suffix;
+}
+
+
+std::shared_ptr<serialized> floating_literal_node::serialize() const
+{
+	auto obj = std::make_shared<serialized_object>();
+	*obj += std::make_pair("node"s, "floating_literal"s);
+	*obj += std::make_pair("value"s, value);
+	if (suffix.length())
+		*obj += std::make_pair("suffix"s, suffix);
 	return obj;
 }
 
@@ -182,6 +330,27 @@ std::shared_ptr<serialized> group_node::serialize() const
 }
 
 
+array_literal_node::array_literal_node(
+	const std::vector<std::shared_ptr<expression_node>>& elements) noexcept:
+	elements(elements)
+{ }
+
+
+const std::vector<std::shared_ptr<expression_node>>& array_literal_node::get_elements() const noexcept
+{
+	return elements;
+}
+
+
+std::shared_ptr<serialized> array_literal_node::serialize() const
+{
+	auto obj = std::make_shared<serialized_object>();
+	*obj += std::make_pair("node"s, "array_literal"s);
+	*obj += std::make_pair("elements"s, elements);
+	return obj;
+}
+
+
 unary_operator_node::unary_operator_node(
 	unary_operation operation,
 	const std::shared_ptr<expression_node>& operand) noexcept:
@@ -348,13 +517,92 @@ std::shared_ptr<serialized> conditional_expression_node::serialize() const
 }
 
 
+match_case_node::match_case_node(
+	const std::vector<std::pair<long long, long long>>& ranges,
+	const std::shared_ptr<expression_node>& result) noexcept:
+	ranges(ranges),
+	result(result)
+{ }
+
+
+const std::vector<std::pair<long long, long long>>& match_case_node::get_ranges() const noexcept
+{
+	return ranges;
+}
+
+
+const std::shared_ptr<expression_node>& match_case_node::get_result() const noexcept
+{
+	return result;
+}
+
+
+std::shared_ptr<serialized> match_case_node::serialize() const
+{
+	// Ranges are flattened into their bounds, first to last
+	std::vector<long long> bounds = { };
+	for(const auto& [first, last] : ranges)
+	{
+		bounds.push_back(first);
+		bounds.push_back(last);
+	}
+
+	auto obj = std::make_shared<serialized_object>();
+	*obj += std::make_pair("node"s, "match_case"s);
+	*obj += std::make_pair("ranges"s, bounds);
+	*obj += std::make_pair("result"s, result);
+	return obj;
+}
+
+
+match_node::match_node(
+	const std::shared_ptr<expression_node>& value,
+	const std::vector<std::shared_ptr<match_case_node>>& cases,
+	const std::shared_ptr<expression_node>& otherwise) noexcept:
+	value(value),
+	cases(cases),
+	otherwise(otherwise)
+{ }
+
+
+const std::shared_ptr<expression_node>& match_node::get_value() const noexcept
+{
+	return value;
+}
+
+
+const std::vector<std::shared_ptr<match_case_node>>& match_node::get_cases() const noexcept
+{
+	return cases;
+}
+
+
+const std::shared_ptr<expression_node>& match_node::get_otherwise() const noexcept
+{
+	return otherwise;
+}
+
+
+std::shared_ptr<serialized> match_node::serialize() const
+{
+	auto obj = std::make_shared<serialized_object>();
+	*obj += std::make_pair("node"s, "match"s);
+	*obj += std::make_pair("value"s, value);
+	*obj += std::make_pair("cases"s, cases);
+	*obj += std::make_pair("otherwise"s, otherwise);
+	return obj;
+}
+
+
 let_node::let_node(
 	const std::string& name,
 	const std::shared_ptr<type_node> type,
-	const std::shared_ptr<expression_node> value) noexcept:
+	const std::shared_ptr<expression_node> value,
+	bool lazy) noexcept:
 	name(name),
 	type(type),
-	value(value)
+	value(value),
+	lazy(lazy)
 { }
 
 
@@ -376,6 +624,12 @@ const std::shared_ptr<expression_node>& let_node::get_value() const noexcept
 }
 
 
+bool let_node::is_lazy() const noexcept
+{
+	return lazy;
+}
+
+
 std::shared_ptr<serialized> let_node::serialize() const
 {
 	auto obj = std::make_shared<serialized_object>();
@@ -383,6 +637,7 @@ std::shared_ptr<serialized> let_node::serialize() const
 	*obj += std::make_pair("name"s, name);
 	*obj += std::make_pair("type"s, type);
 	*obj += std::make_pair("value"s, value);
+	*obj += std::make_pair("lazy"s, lazy);
 	return obj;
 }
 
@@ -543,6 +798,66 @@ std::shared_ptr<serialized> function_call_node::serialize() const
 }
 
 
+record_node::record_node(
+	const std::string& name,
+	const std::vector<std::shared_ptr<parameter_node>>& fields) noexcept:
+	name(name),
+	fields(fields)
+{ }
+
+
+const std::string& record_node::get_name() const noexcept
+{
+	return name;
+}
+
+
+const std::vector<std::shared_ptr<parameter_node>>& record_node::get_fields() const noexcept
+{
+	return fields;
+}
+
+
+std::shared_ptr<serialized> record_node::serialize() const
+{
+	auto obj = std::make_shared<serialized_object>();
+	*obj += std::make_pair("node"s, "record"s);
+	*obj += std::make_pair("name"s, name);
+	*obj += std::make_pair("fields"s, fields);
+	return obj;
+}
+
+
+field_access_node::field_access_node(
+	const std::shared_ptr<expression_node>& record,
+	const std::string& field) noexcept:
+	record(record),
+	field(field)
+{ }
+
+
+const std::shared_ptr<expression_node>& field_access_node::get_record() const noexcept
+{
+	return record;
+}
+
+
+const std::string& field_access_node::get_field() const noexcept
+{
+	return field;
+}
+
+
+std::shared_ptr<serialized> field_access_node::serialize() const
+{
+	auto obj = std::make_shared<serialized_object>();
+	*obj += std::make_pair("node"s, "field_access"s);
+	*obj += std::make_pair("record"s, record);
+	*obj += std::make_pair("field"s, field);
+	return obj;
+}
+
+
 return_node::return_node(
 	const std::shared_ptr<expression_node>& value) noexcept:
 	value(value)
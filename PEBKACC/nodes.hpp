@@ -1,9 +1,11 @@
 #pragma once
 
 #include "serialization.hpp"
+#include "lexing.hpp"
 
 #include <memory>
 #include <vector>
+#include <cstdint>
 #include <unordered_set>
 
 namespace pebkac::ast
@@ -40,7 +42,18 @@ namespace pebkac::ast
 	};
 
 
-	class node: public serializable { };
+	class node: public serializable
+	{
+	public:
+		/**
+		 * @brief Returns the source code this node was parsed from, or an empty span for generated nodes
+		 */
+		const lexing::source_span& get_span() const noexcept;
+		void set_span(const lexing::source_span& span) noexcept;
+
+	private:
+		lexing::source_span span = {0, 0};
+	};
 	class statement_node: public node { };
 	class expression_node: public statement_node { };
 	class type_node: public node { };
@@ -69,6 +82,60 @@ namespace pebkac::ast
 	};
 
 
+	class array_type_node: public type_node
+	{
+	public:
+		array_type_node(
+			const std::shared_ptr<type_node>& element_type
+		) noexcept;
+
+		std::shared_ptr<serialized> serialize() const;
+
+		// Getters
+		const std::shared_ptr<type_node>& get_element_type() const noexcept;
+
+	private:
+		const std::shared_ptr<type_node> element_type;
+	};
+
+
+	class map_type_node: public type_node
+	{
+	public:
+		map_type_node(
+			const std::shared_ptr<type_node>& key_type,
+			const std::shared_ptr<type_node>& value_type
+		) noexcept;
+
+		std::shared_ptr<serialized> serialize() const;
+
+		// Getters
+		const std::shared_ptr<type_node>& get_key_type() const noexcept;
+		const std::shared_ptr<type_node>& get_value_type() const noexcept;
+
+	private:
+		const std::shared_ptr<type_node> key_type;
+		const std::shared_ptr<type_node> value_type;
+	};
+
+
+	class vector_type_node: public type_node
+	{
+	public:
+		vector_type_node(
+			const std::shared_ptr<type_node>& element_type
+		) noexcept;
+
+		std::shared_ptr<serialized> serialize() const;
+
+		// Getters
+		const std::shared_ptr<type_node>& get_element_type() const noexcept;
+
+	private:
+		const std::shared_ptr<type_node> element_type;
+	};
+
+
 	class identifier_node: public expression_node, public type_node
 	{
 	public:
@@ -81,6 +148,10 @@ namespace pebkac::ast
 		// Getters
 		const std::string& get_value() const noexcept;
 
+		// Identifiers are both expressions and types, so they inherit node twice
+		const lexing::source_span& get_span() const noexcept;
+		void set_span(const lexing::source_span& span) noexcept;
+
 	private:
 		const std::string value;
 	};
@@ -89,8 +160,13 @@ namespace pebkac::ast
 	class numeric_literal_node: public expression_node
 	{
 	public:
+		/**
+		 * @param limbs Magnitude of bigint literals larger than any integer, as 32-bit limbs, least significant first
+		 */
 		numeric_literal_node(
-			long long value
+			long long value,
+			const std::string& suffix,
+			const std::vector<std::uint32_t>& limbs = { }
 		) noexcept;
 
 		std::shared_ptr<serialized> serialize() const;
@@ -98,8 +174,48 @@ namespace pebkac::ast
 		// Getters
 		long long get_value() const noexcept;
 
+		/**
+		 * @brief Returns the fixed-width type the literal is written with, like u8 in 200u8, n for bigints like 200n, or an
+		 * empty string for integers
+		 *
+		 * u64 and bigint literals larger than any integer are stored with the same bits as the value.
+		 */
+		const std::string& get_suffix() const noexcept;
+
+		/**
+		 * @brief Returns the magnitude of a bigint literal as 32-bit limbs, least significant first, when it does not
+		 * fit in 64 bits. The value then only holds its lowest 64 bits. Empty for every other literal.
+		 */
+		const std::vector<std::uint32_t>& get_limbs() const noexcept;
+
 	private:
 		const long long value;
+		const std::string suffix;
+		const std::vector<std::uint32_t> limbs;
+	};
+
+
+	class floating_literal_node: public expression_node
+	{
+	public:
+		floating_literal_node(
+			double value,
+			const std::string& suffix
+		) noexcept;
+
+		std::shared_ptr<serialized> serialize() const;
+
+		// Getters
+		double get_value() const noexcept;
+
+		/**
+		 * @brief Returns f for float literals like 1.5f, or an empty string for doubles
+		 */
+		const std::string& get_suffix() const noexcept;
+
+	private:
+		const double value;
+		const std::string suffix;
 	};
 
 
@@ -137,6 +253,23 @@ namespace pebkac::ast
 	};
 
 
+	class array_literal_node: public expression_node
+	{
+	public:
+		array_literal_node(
+			const std::vector<std::shared_ptr<expression_node>>& elements
+		) noexcept;
+
+		std::shared_ptr<serialized> serialize() const;
+
+		// Getters
+		const std::vector<std::shared_ptr<expression_node>>& get_elements() const noexcept;
+
+	private:
+		const std::vector<std::shared_ptr<expression_node>> elements;
+	};
+
+
 	class unary_operator_node: public expression_node
 	{
 	public:
@@ -243,13 +376,72 @@ namespace pebkac::ast
 	};
 
 
+	class match_case_node: public node
+	{
+	public:
+		match_case_node(
+			const std::vector<std::pair<long long, long long>>& ranges,
+			const std::shared_ptr<expression_node>& result
+		) noexcept;
+
+		std::shared_ptr<serialized> serialize() const;
+
+		// Getters
+
+		/**
+		 * @brief Returns the values the case matches, as inclusive ranges like 3..9, or 5..5 for 5
+		 *
+		 * Fixed-width literals larger than any integer are stored with the same bits as the value, like numeric
+		 * literals are.
+		 */
+		const std::vector<std::pair<long long, long long>>& get_ranges() const noexcept;
+		const std::shared_ptr<expression_node>& get_result() const noexcept;
+
+	private:
+		const std::vector<std::pair<long long, long long>> ranges;
+		const std::shared_ptr<expression_node> result;
+	};
+
+
+	class match_node: public expression_node
+	{
+	public:
+		match_node(
+			const std::shared_ptr<expression_node>& value,
+			const std::vector<std::shared_ptr<match_case_node>>& cases,
+			const std::shared_ptr<expression_node>& otherwise
+		) noexcept;
+
+		std::shared_ptr<serialized> serialize() const;
+
+		// Getters
+		const std::shared_ptr<expression_node>& get_value() const noexcept;
+
+		/**
+		 * @brief Returns the cases, of which the first matching the value gives the result
+		 */
+		const std::vector<std::shared_ptr<match_case_node>>& get_cases() const noexcept;
+
+		/**
+		 * @brief Returns the result of the else case, for values no case matches
+		 */
+		const std::shared_ptr<expression_node>& get_otherwise() const noexcept;
+
+	private:
+		const std::shared_ptr<expression_node> value;
+		const std::vector<std::shared_ptr<match_case_node>> cases;
+		const std::shared_ptr<expression_node> otherwise;
+	};
+
+
 	class let_node: public statement_node
 	{
 	public:
 		let_node(
 			const std::string& name,
 			const std::shared_ptr<type_node> type,
-			const std::shared_ptr<expression_node> value
+			const std::shared_ptr<expression_node> value,
+			bool lazy = false
 		) noexcept;
 
 		std::shared_ptr<serialized> serialize() const;
@@ -259,10 +451,16 @@ namespace pebkac::ast
 		const std::shared_ptr<type_node>& get_type() const noexcept;
 		const std::shared_ptr<expression_node>& get_value() const noexcept;
 
+		/**
+		 * @brief Whether the value is only computed the first time the name is used, rather than where it is declared
+		 */
+		bool is_lazy() const noexcept;
+
 	private:
 		const std::string name;
 		const std::shared_ptr<type_node> type;
 		const std::shared_ptr<expression_node> value;
+		const bool lazy;
 	};
 
 
@@ -358,6 +556,46 @@ namespace pebkac::ast
 	};
 
 
+	class record_node: public statement_node
+	{
+	public:
+		record_node(
+			const std::string& name,
+			const std::vector<std::shared_ptr<parameter_node>>& fields
+		) noexcept;
+
+		std::shared_ptr<serialized> serialize() const;
+
+		// Getters
+		const std::string& get_name() const noexcept;
+		const std::vector<std::shared_ptr<parameter_node>>& get_fields() const noexcept;
+
+	private:
+		const std::string name;
+		const std::vector<std::shared_ptr<parameter_node>> fields;
+	};
+
+
+	class field_access_node: public expression_node
+	{
+	public:
+		field_access_node(
+			const std::shared_ptr<expression_node>& record,
+			const std::string& field
+		) noexcept;
+
+		std::shared_ptr<serialized> serialize() const;
+
+		// Getters
+		const std::shared_ptr<expression_node>& get_record() const noexcept;
+		const std::string& get_field() const noexcept;
+
+	private:
+		const std::shared_ptr<expression_node> record;
+		const std::string field;
+	};
+
+
 	class return_node: public statement_node
 	{
 	public:
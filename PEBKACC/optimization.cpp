@@ -0,0 +1,2578 @@
+#include "optimization.hpp"
+
+#include <cstdint>
+#include <algorithm>
+
+using namespace pebkac;
+using namespace pebkac::optimization;
+using analysis::scalar_type;
+
+
+// Gives a rebuilt node the span of the node it replaces
+template<typename T>
+std::shared_ptr<T> with_span(const std::shared_ptr<T>& node, const lexing::source_span& span) noexcept
+{
+	node->set_span(span);
+	return node;
+}
+
+
+// Looks through parentheses
+std::shared_ptr<ast::expression_node> strip_groups(std::shared_ptr<ast::expression_node> ptr)
+{
+	while(const auto group = std::dynamic_pointer_cast<ast::group_node>(ptr))
+		ptr = group->get_expression();
+	return ptr;
+}
+
+
+rewriter::rewriter(
+	const std::vector<std::shared_ptr<ast::statement_node>>& ast):
+	declarations({ }),
+	lazy({ }),
+	ast(ast),
+	functions({ }),
+	globals({ }),
+	locals({ })
+{
+	for(const auto& ptr : ast)
+	{
+		if (const auto cast = std::dynamic_pointer_cast<ast::function_node>(ptr))
+		{
+			const auto [it, inserted] = functions.emplace(cast->get_name(), cast);
+			if (!inserted)
+				it->second = nullptr;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::record_node>(ptr))
+		{
+			// Records are called like functions, but have no body to inline or specialize
+			functions[cast->get_name()] = nullptr;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::let_node>(ptr))
+		{
+			// Untyped lets are declared auto, and take the type of their value
+			globals[cast->get_name()] = cast->get_type() ? analysis::get_scalar_type(cast->get_type()) : get_type(cast->get_value());
+			if (cast->is_lazy())
+				lazy.insert(cast->get_name());
+		}
+	}
+}
+
+
+std::vector<std::shared_ptr<ast::statement_node>> rewriter::rewrite()
+{
+	std::vector<std::shared_ptr<ast::statement_node>> result = { };
+	result.reserve(ast.size());
+	for(const auto& ptr : ast)
+	{
+		const auto statement = rewrite_statement(ptr);
+		result.insert(result.end(), declarations.begin(), declarations.end());
+		declarations.clear();
+		result.push_back(statement);
+	}
+	return result;
+}
+
+
+size_t rewriter::declare(const std::vector<std::shared_ptr<ast::parameter_node>>& parameters)
+{
+	const size_t scope = locals.size();
+	for(const auto& parameter : parameters)
+		locals.push_back({parameter->get_name(), analysis::get_scalar_type(parameter->get_type()), parameter->get_type()});
+	return scope;
+}
+
+
+void rewriter::restore(size_t scope) noexcept
+{
+	locals.resize(scope);
+}
+
+
+size_t rewriter::get_scope() const noexcept
+{
+	return locals.size();
+}
+
+
+bool rewriter::is_local(const std::string& name) const
+{
+	for(const auto& local : locals)
+	{
+		if (local.name == name)
+			return true;
+	}
+	return false;
+}
+
+
+bool rewriter::is_builtin(const std::string& name) const
+{
+	return !is_local(name) && !functions.count(name) && !globals.count(name);
+}
+
+
+std::shared_ptr<ast::type_node> rewriter::get_local_type(const std::string& name) const
+{
+	for(auto it = locals.rbegin(); it != locals.rend(); ++it)
+	{
+		if (it->name != name)
+			continue;
+		if (it->declared || it->type == scalar_type::UNKNOWN)
+			return it->declared;
+		return std::make_shared<ast::identifier_node>(it->type == scalar_type::INTEGER ? "integer" : "boolean");
+	}
+	return nullptr;
+}
+
+
+std::shared_ptr<ast::function_node> rewriter::get_function(const std::string& name) const
+{
+	const auto it = functions.find(name);
+	return it != functions.end() ? it->second : nullptr;
+}
+
+
+scalar_type rewriter::get_type(const std::shared_ptr<ast::expression_node>& ptr) const
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr))
+	{
+		for(auto it = locals.rbegin(); it != locals.rend(); ++it)
+		{
+			if (it->name == cast->get_value())
+				return it->type;
+		}
+
+		const auto global = globals.find(cast->get_value());
+		return global != globals.end() ? global->second : scalar_type::UNKNOWN;
+	}
+	else if (std::dynamic_pointer_cast<ast::boolean_literal_node>(ptr))
+	{
+		return scalar_type::BOOLEAN;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::group_node>(ptr))
+	{
+		return get_type(cast->get_expression());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::unary_operator_node>(ptr))
+	{
+		if (cast->get_operation() == ast::unary_operation::NOT)
+			return scalar_type::BOOLEAN;
+		return get_type(cast->get_operand()) == scalar_type::INTEGER ? scalar_type::INTEGER : scalar_type::UNKNOWN;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::operator_node>(ptr))
+	{
+		switch (cast->get_operation())
+		{
+		case ast::operation::ADD:
+		case ast::operation::SUBTRACT:
+		case ast::operation::MULTIPLY:
+		case ast::operation::DIVIDE:
+		case ast::operation::MODULUS:
+		{
+			// Booleans and plain literals are converted to the integer operand, anything else unknown could be wider
+			const auto is_integral = [](const std::shared_ptr<ast::expression_node>& operand, scalar_type type) {
+				const auto literal = std::dynamic_pointer_cast<ast::numeric_literal_node>(strip_groups(operand));
+				return type != scalar_type::UNKNOWN || (literal && literal->get_suffix().empty());
+			};
+			const scalar_type a = get_type(cast->get_operand_a());
+			const scalar_type b = get_type(cast->get_operand_b());
+			const bool integer = (a == scalar_type::INTEGER || b == scalar_type::INTEGER)
+				&& is_integral(cast->get_operand_a(), a) && is_integral(cast->get_operand_b(), b);
+			return integer ? scalar_type::INTEGER : scalar_type::UNKNOWN;
+		}
+
+		default:
+			return scalar_type::BOOLEAN;
+		}
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
+	{
+		const scalar_type a = get_type(cast->get_value_true());
+		const scalar_type b = get_type(cast->get_value_false());
+		if (a == b)
+			return a;
+		return (a != scalar_type::UNKNOWN && b != scalar_type::UNKNOWN) ? scalar_type::INTEGER : scalar_type::UNKNOWN;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::match_node>(ptr))
+	{
+		// Like the conditionals it stands for
+		scalar_type result = get_type(cast->get_otherwise());
+		for(const auto& c : cast->get_cases())
+		{
+			const scalar_type type = get_type(c->get_result());
+			if (type != result)
+				result = (result != scalar_type::UNKNOWN && type != scalar_type::UNKNOWN) ? scalar_type::INTEGER : scalar_type::UNKNOWN;
+		}
+		return result;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr))
+	{
+		const auto callee = std::dynamic_pointer_cast<ast::identifier_node>(cast->get_function());
+		if (!callee || is_local(callee->get_value()))
+			return scalar_type::UNKNOWN;
+
+		// Either a conversion like integer(x), or a call to a top-level function
+		if (const scalar_type conversion = analysis::get_scalar_type(callee); conversion != scalar_type::UNKNOWN)
+			return conversion;
+		const auto function = get_function(callee->get_value());
+		return function ? analysis::get_scalar_type(function->get_return_type()) : scalar_type::UNKNOWN;
+	}
+
+	return scalar_type::UNKNOWN;
+}
+
+
+std::vector<std::shared_ptr<ast::statement_node>> rewriter::rewrite_statements(const std::vector<std::shared_ptr<ast::statement_node>>& statements)
+{
+	std::vector<std::shared_ptr<ast::statement_node>> result = { };
+	result.reserve(statements.size());
+	for(const auto& ptr : statements)
+	{
+		result.push_back(rewrite_statement(ptr));
+
+		if (const auto let = std::dynamic_pointer_cast<ast::let_node>(result.back()))
+			locals.push_back({let->get_name(), let->get_type() ? analysis::get_scalar_type(let->get_type()) : get_type(let->get_value()), let->get_type()});
+	}
+	return result;
+}
+
+
+std::shared_ptr<ast::statement_node> rewriter::rewrite_statement(const std::shared_ptr<ast::statement_node>& ptr)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::function_node>(ptr))
+	{
+		const size_t scope = declare(cast->get_parameters());
+		const auto body = std::static_pointer_cast<ast::block_node>(rewrite_statement(cast->get_body()));
+		restore(scope);
+
+		if (body == cast->get_body())
+			return ptr;
+		return with_span(std::make_shared<ast::function_node>(cast->get_specifiers(), cast->get_name(), cast->get_parameters(), cast->get_return_type(), body), ptr->get_span());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::let_node>(ptr))
+	{
+		if (cast->is_lazy())
+			lazy.insert(cast->get_name());
+
+		const auto value = rewrite_expression(cast->get_value());
+		if (value == cast->get_value())
+			return ptr;
+		return with_span(std::make_shared<ast::let_node>(cast->get_name(), cast->get_type(), value, cast->is_lazy()), ptr->get_span());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_node>(ptr))
+	{
+		const size_t scope = locals.size();
+		const auto condition = rewrite_expression(cast->get_condition());
+		const auto branch_true = rewrite_statement(cast->get_branch_true());
+		locals.resize(scope);
+		const auto branch_false = cast->get_branch_false() ? rewrite_statement(cast->get_branch_false()) : nullptr;
+		locals.resize(scope);
+
+		if (condition == cast->get_condition() && branch_true == cast->get_branch_true() && branch_false == cast->get_branch_false())
+			return ptr;
+		return with_span(std::make_shared<ast::conditional_node>(condition, branch_true, branch_false), ptr->get_span());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::return_node>(ptr))
+	{
+		const auto value = rewrite_expression(cast->get_value());
+		if (value == cast->get_value())
+			return ptr;
+		return with_span(std::make_shared<ast::return_node>(value), ptr->get_span());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::block_node>(ptr))
+	{
+		const size_t scope = locals.size();
+		const auto statements = rewrite_statements(cast->get_statements());
+		locals.resize(scope);
+
+		if (statements == cast->get_statements())
+			return ptr;
+		return with_span(std::make_shared<ast::block_node>(statements), ptr->get_span());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::expression_node>(ptr))
+	{
+		return rewrite_expression(cast);
+	}
+
+	return ptr;
+}
+
+
+std::shared_ptr<ast::expression_node> rewriter::rewrite_expression(const std::shared_ptr<ast::expression_node>& ptr)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr))
+	{
+		const auto function = rewrite_expression(cast->get_function());
+		bool changed = function != cast->get_function();
+
+		std::vector<std::shared_ptr<ast::expression_node>> arguments = { };
+		for(const auto& argument : cast->get_arguments())
+		{
+			arguments.push_back(rewrite_expression(argument));
+			changed = changed || arguments.back() != argument;
+		}
+
+		if (!changed)
+			return ptr;
+		return with_span(std::make_shared<ast::function_call_node>(function, arguments), ptr->get_span());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::lambda_node>(ptr))
+	{
+		const size_t scope = declare(cast->get_parameters());
+		const auto statements = rewrite_statements(cast->get_statements());
+		restore(scope);
+
+		if (statements == cast->get_statements())
+			return ptr;
+		return with_span(std::make_shared<ast::lambda_node>(cast->get_parameters(), statements), ptr->get_span());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::group_node>(ptr))
+	{
+		const auto expression = rewrite_expression(cast->get_expression());
+		if (expression == cast->get_expression())
+			return ptr;
+		return with_span(std::make_shared<ast::group_node>(expression), ptr->get_span());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::array_literal_node>(ptr))
+	{
+		bool changed = false;
+		std::vector<std::shared_ptr<ast::expression_node>> elements = { };
+		for(const auto& element : cast->get_elements())
+		{
+			elements.push_back(rewrite_expression(element));
+			changed = changed || elements.back() != element;
+		}
+
+		if (!changed)
+			return ptr;
+		return with_span(std::make_shared<ast::array_literal_node>(elements), ptr->get_span());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::unary_operator_node>(ptr))
+	{
+		const auto operand = rewrite_expression(cast->get_operand());
+		if (operand == cast->get_operand())
+			return ptr;
+		return with_span(std::make_shared<ast::unary_operator_node>(cast->get_operation(), operand), ptr->get_span());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::operator_node>(ptr))
+	{
+		const auto operand_a = rewrite_expression(cast->get_operand_a());
+		const auto operand_b = rewrite_expression(cast->get_operand_b());
+		if (operand_a == cast->get_operand_a() && operand_b == cast->get_operand_b())
+			return ptr;
+		return with_span(std::make_shared<ast::operator_node>(cast->get_operation(), operand_a, operand_b), ptr->get_span());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
+	{
+		const auto condition = rewrite_expression(cast->get_condition());
+		const auto value_true = rewrite_expression(cast->get_value_true());
+		const auto value_false = rewrite_expression(cast->get_value_false());
+		if (condition == cast->get_condition() && value_true == cast->get_value_true() && value_false == cast->get_value_false())
+			return ptr;
+		return with_span(std::make_shared<ast::conditional_expression_node>(condition, value_true, value_false), ptr->get_span());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::match_node>(ptr))
+	{
+		const auto value = rewrite_expression(cast->get_value());
+		bool changed = value != cast->get_value();
+		std::vector<std::shared_ptr<ast::match_case_node>> cases = { };
+		for(const auto& c : cast->get_cases())
+		{
+			const auto result = rewrite_expression(c->get_result());
+			cases.push_back(result == c->get_result() ? c : with_span(std::make_shared<ast::match_case_node>(c->get_ranges(), result), c->get_span()));
+			changed = changed || result != c->get_result();
+		}
+		const auto otherwise = rewrite_expression(cast->get_otherwise());
+
+		if (!changed && otherwise == cast->get_otherwise())
+			return ptr;
+		return with_span(std::make_shared<ast::match_node>(value, cases, otherwise), ptr->get_span());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::field_access_node>(ptr))
+	{
+		const auto record = rewrite_expression(cast->get_record());
+		if (record == cast->get_record())
+			return ptr;
+		return with_span(std::make_shared<ast::field_access_node>(record, cast->get_field()), ptr->get_span());
+	}
+
+	// Names and literals have no children
+	return ptr;
+}
+
+
+// Whether an expression prints as a single C++ operand, which operators around it cannot split
+bool is_atomic(const std::shared_ptr<ast::expression_node>& ptr)
+{
+	return std::dynamic_pointer_cast<ast::identifier_node>(ptr)
+		|| std::dynamic_pointer_cast<ast::numeric_literal_node>(ptr)
+		|| std::dynamic_pointer_cast<ast::floating_literal_node>(ptr)
+		|| std::dynamic_pointer_cast<ast::boolean_literal_node>(ptr)
+		|| std::dynamic_pointer_cast<ast::group_node>(ptr)
+		|| std::dynamic_pointer_cast<ast::function_call_node>(ptr)
+		|| std::dynamic_pointer_cast<ast::field_access_node>(ptr);
+}
+
+
+// Whether duplicating or dropping an expression costs nothing and cannot change what the program does
+bool is_trivial(const std::shared_ptr<ast::expression_node>& ptr)
+{
+	const auto stripped = strip_groups(ptr);
+	return std::dynamic_pointer_cast<ast::identifier_node>(stripped)
+		|| std::dynamic_pointer_cast<ast::numeric_literal_node>(stripped)
+		|| std::dynamic_pointer_cast<ast::floating_literal_node>(stripped)
+		|| std::dynamic_pointer_cast<ast::boolean_literal_node>(stripped);
+}
+
+
+// Everything known about an expression that is about to be inlined
+struct body_info
+{
+	size_t size = 0;
+	bool lambdas = false;
+
+	// Every name the expression refers to
+	std::unordered_set<std::string> names;
+
+	// How often each name is used, and whether some use is only evaluated under a condition
+	std::unordered_map<std::string, size_t> uses;
+	std::unordered_set<std::string> conditional;
+};
+
+
+void inspect(const std::shared_ptr<ast::expression_node>& ptr, bool conditional, body_info& info)
+{
+	++info.size;
+
+	if (const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr))
+	{
+		info.names.insert(cast->get_value());
+		++info.uses[cast->get_value()];
+		if (conditional)
+			info.conditional.insert(cast->get_value());
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr))
+	{
+		inspect(cast->get_function(), conditional, info);
+		for(const auto& argument : cast->get_arguments())
+			inspect(argument, conditional, info);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::group_node>(ptr))
+	{
+		inspect(cast->get_expression(), conditional, info);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::field_access_node>(ptr))
+	{
+		inspect(cast->get_record(), conditional, info);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::array_literal_node>(ptr))
+	{
+		for(const auto& element : cast->get_elements())
+			inspect(element, conditional, info);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::unary_operator_node>(ptr))
+	{
+		inspect(cast->get_operand(), conditional, info);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::operator_node>(ptr))
+	{
+		const bool short_circuit = cast->get_operation() == ast::operation::AND || cast->get_operation() == ast::operation::OR;
+		inspect(cast->get_operand_a(), conditional, info);
+		inspect(cast->get_operand_b(), conditional || short_circuit, info);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
+	{
+		inspect(cast->get_condition(), conditional, info);
+		inspect(cast->get_value_true(), true, info);
+		inspect(cast->get_value_false(), true, info);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::match_node>(ptr))
+	{
+		inspect(cast->get_value(), conditional, info);
+		for(const auto& c : cast->get_cases())
+			inspect(c->get_result(), true, info);
+		inspect(cast->get_otherwise(), true, info);
+	}
+	else if (std::dynamic_pointer_cast<ast::lambda_node>(ptr))
+	{
+		info.lambdas = true;
+	}
+}
+
+
+// Replaces names by expressions. Only used on expressions without lambdas, which could shadow the names.
+std::shared_ptr<ast::expression_node> substitute(
+	const std::shared_ptr<ast::expression_node>& ptr,
+	const std::unordered_map<std::string, std::shared_ptr<ast::expression_node>>& replacements,
+	const lexing::source_span& span)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr))
+	{
+		const auto it = replacements.find(cast->get_value());
+		return it != replacements.end() ? it->second : ptr;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr))
+	{
+		std::vector<std::shared_ptr<ast::expression_node>> arguments = { };
+		for(const auto& argument : cast->get_arguments())
+			arguments.push_back(substitute(argument, replacements, span));
+		return with_span(std::make_shared<ast::function_call_node>(substitute(cast->get_function(), replacements, span), arguments), span);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::group_node>(ptr))
+	{
+		return with_span(std::make_shared<ast::group_node>(substitute(cast->get_expression(), replacements, span)), span);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::field_access_node>(ptr))
+	{
+		return with_span(std::make_shared<ast::field_access_node>(substitute(cast->get_record(), replacements, span), cast->get_field()), span);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::array_literal_node>(ptr))
+	{
+		std::vector<std::shared_ptr<ast::expression_node>> elements = { };
+		for(const auto& element : cast->get_elements())
+			elements.push_back(substitute(element, replacements, span));
+		return with_span(std::make_shared<ast::array_literal_node>(elements), span);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::unary_operator_node>(ptr))
+	{
+		return with_span(std::make_shared<ast::unary_operator_node>(cast->get_operation(), substitute(cast->get_operand(), replacements, span)), span);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::operator_node>(ptr))
+	{
+		return with_span(std::make_shared<ast::operator_node>(cast->get_operation(), substitute(cast->get_operand_a(), replacements, span), substitute(cast->get_operand_b(), replacements, span)), span);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
+	{
+		return with_span(std::make_shared<ast::conditional_expression_node>(
+			substitute(cast->get_condition(), replacements, span),
+			substitute(cast->get_value_true(), replacements, span),
+			substitute(cast->get_value_false(), replacements, span)), span);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::match_node>(ptr))
+	{
+		std::vector<std::shared_ptr<ast::match_case_node>> cases = { };
+		for(const auto& c : cast->get_cases())
+			cases.push_back(with_span(std::make_shared<ast::match_case_node>(c->get_ranges(), substitute(c->get_result(), replacements, span)), span));
+		return with_span(std::make_shared<ast::match_node>(
+			substitute(cast->get_value(), replacements, span),
+			cases,
+			substitute(cast->get_otherwise(), replacements, span)), span);
+	}
+
+	return ptr;
+}
+
+
+class inliner: public rewriter
+{
+public:
+	inliner(
+		const std::vector<std::shared_ptr<ast::statement_node>>& ast,
+		size_t budget):
+		rewriter(ast),
+		budget(budget),
+		expanding({ })
+	{ }
+
+protected:
+	std::shared_ptr<ast::expression_node> rewrite_expression(const std::shared_ptr<ast::expression_node>& ptr)
+	{
+		const auto result = rewriter::rewrite_expression(ptr);
+		const auto call = std::dynamic_pointer_cast<ast::function_call_node>(result);
+		if (!call)
+			return result;
+
+		if (const auto lambda = std::dynamic_pointer_cast<ast::lambda_node>(strip_groups(call->get_function())))
+		{
+			// The lambda is defined right where it is called, so its body already refers to the right names
+			const auto body = get_body(lambda->get_statements(), lambda->get_parameters(), call->get_arguments());
+			if (!body)
+				return result;
+			return bind(*body, lambda->get_parameters(), call, scalar_type::UNKNOWN);
+		}
+
+		const auto callee = std::dynamic_pointer_cast<ast::identifier_node>(call->get_function());
+		if (!callee || is_local(callee->get_value()) || expanding.count(callee->get_value()))
+			return result;
+
+		const auto function = get_function(callee->get_value());
+		if (!function || function->get_name() == "main" || function->get_specifiers().count(ast::specifier::IO))
+			return result;
+
+		const scalar_type return_type = analysis::get_scalar_type(function->get_return_type());
+		const auto body = get_body(function->get_body()->get_statements(), function->get_parameters(), call->get_arguments());
+		if (!body || return_type == scalar_type::UNKNOWN || body->names.count(function->get_name()))
+			return result;
+
+		// The body refers to top-level declarations, which must not be shadowed where it lands
+		for(const auto& name : body->names)
+		{
+			if (is_local(name) && !body->parameters.count(name))
+				return result;
+		}
+
+		// Inlined calls may contain more calls to inline, but not to the same function
+		expanding.insert(function->get_name());
+		const auto inlined = rewrite_expression(bind(*body, function->get_parameters(), call, return_type));
+		expanding.erase(function->get_name());
+		return inlined;
+	}
+
+private:
+	struct inlinable: body_info
+	{
+		std::shared_ptr<ast::expression_node> value;
+		std::unordered_set<std::string> parameters;
+	};
+
+	// Checks that a body is a single return whose parameters can all be replaced by their arguments
+	std::unique_ptr<inlinable> get_body(
+		const std::vector<std::shared_ptr<ast::statement_node>>& statements,
+		const std::vector<std::shared_ptr<ast::parameter_node>>& parameters,
+		const std::vector<std::shared_ptr<ast::expression_node>>& arguments)
+	{
+		const auto ret = statements.size() == 1 ? std::dynamic_pointer_cast<ast::return_node>(statements.front()) : nullptr;
+		if (!ret || parameters.size() != arguments.size())
+			return nullptr;
+
+		auto body = std::make_unique<inlinable>();
+		body->value = ret->get_value();
+		inspect(body->value, false, *body);
+		if (body->lambdas || body->size > budget)
+			return nullptr;
+
+		// Conversions are spelled with the type names
+		if (is_local("integer") || is_local("boolean"))
+			return nullptr;
+
+		for(size_t i = 0; i < parameters.size(); ++i)
+		{
+			const auto& name = parameters[i]->get_name();
+			if (!body->parameters.insert(name).second)
+				return nullptr;
+
+			// Function arguments are only replaced by top-level functions, so calls keep their exact types
+			if (analysis::get_scalar_type(parameters[i]->get_type()) == scalar_type::UNKNOWN)
+			{
+				const auto function = std::dynamic_pointer_cast<ast::identifier_node>(arguments[i]);
+				if (!function || is_local(function->get_value()) || !get_function(function->get_value()))
+					return nullptr;
+			}
+
+			// Arguments are evaluated exactly once, only names and literals can be copied or dropped. Lazy lets compute
+			// their value when the call is made, and must still do so if the body does not use them.
+			const auto uses = body->uses.find(name);
+			const bool once = uses != body->uses.end() && uses->second == 1 && !body->conditional.count(name);
+			const auto identifier = std::dynamic_pointer_cast<ast::identifier_node>(strip_groups(arguments[i]));
+			if (!once && (!is_trivial(arguments[i]) || (identifier && lazy.count(identifier->get_value()))))
+				return nullptr;
+		}
+
+		return body;
+	}
+
+	// Substitutes the arguments of a call into a body, converting them, and the result, the way the call would
+	std::shared_ptr<ast::expression_node> bind(
+		const inlinable& body,
+		const std::vector<std::shared_ptr<ast::parameter_node>>& parameters,
+		const std::shared_ptr<ast::function_call_node>& call,
+		scalar_type return_type)
+	{
+		const auto& span = call->get_span();
+
+		std::unordered_map<std::string, std::shared_ptr<ast::expression_node>> replacements = { };
+		for(size_t i = 0; i < parameters.size(); ++i)
+			replacements[parameters[i]->get_name()] = convert(call->get_arguments()[i], analysis::get_scalar_type(parameters[i]->get_type()), span);
+
+		return convert(substitute(body.value, replacements, span), return_type, span);
+	}
+
+	std::shared_ptr<ast::expression_node> convert(const std::shared_ptr<ast::expression_node>& ptr, scalar_type type, const lexing::source_span& span)
+	{
+		if (type != scalar_type::UNKNOWN && get_type(ptr) != type)
+		{
+			const auto name = with_span(std::make_shared<ast::identifier_node>(type == scalar_type::INTEGER ? "integer" : "boolean"), span);
+			return with_span(std::make_shared<ast::function_call_node>(name, std::vector<std::shared_ptr<ast::expression_node>>{ptr}), span);
+		}
+
+		// Operators are printed without parentheses, so they must not mix with the operators around them
+		return is_atomic(ptr) ? ptr : with_span(std::make_shared<ast::group_node>(ptr), span);
+	}
+
+	const size_t budget;
+
+	// Functions being inlined, which cannot be inlined into themselves
+	std::unordered_set<std::string> expanding;
+};
+
+
+std::vector<std::shared_ptr<ast::statement_node>> optimization::inline_functions(const std::vector<std::shared_ptr<ast::statement_node>>& ast, size_t budget)
+{
+	return inliner(ast, budget).rewrite();
+}
+
+
+class reduction_lowerer: public rewriter
+{
+public:
+	reduction_lowerer(
+		const std::vector<std::shared_ptr<ast::statement_node>>& ast,
+		bool reassociate):
+		rewriter(ast),
+		reassociate(reassociate)
+	{ }
+
+protected:
+	std::shared_ptr<ast::expression_node> rewrite_expression(const std::shared_ptr<ast::expression_node>& ptr)
+	{
+		const auto result = rewriter::rewrite_expression(ptr);
+		const auto call = std::dynamic_pointer_cast<ast::function_call_node>(result);
+		const auto callee = call ? std::dynamic_pointer_cast<ast::identifier_node>(call->get_function()) : nullptr;
+		if (!callee || callee->get_value() != "fold" || !is_builtin("fold") || call->get_arguments().size() != 3)
+			return result;
+
+		const auto lambda = std::dynamic_pointer_cast<ast::lambda_node>(strip_groups(call->get_arguments()[2]));
+		const std::string reduction = lambda ? get_reduction(*lambda) : "";
+		if (reduction.empty())
+			return result;
+
+		// Names with :: cannot be written in the source, so nothing can hide the runtime's
+		const auto name = with_span(std::make_shared<ast::identifier_node>("pebkac_array::" + reduction), callee->get_span());
+		std::vector<std::shared_ptr<ast::expression_node>> arguments = {call->get_arguments()[0], call->get_arguments()[1]};
+
+		// Floating-point sums add in the type of the lambda's parameters, whatever the initial value is
+		const auto type = std::dynamic_pointer_cast<ast::identifier_node>(lambda->get_parameters()[0]->get_type());
+		if (analysis::is_floating_point(type->get_value()))
+		{
+			const auto conversion = with_span(std::make_shared<ast::identifier_node>(type->get_value()), arguments[1]->get_span());
+			arguments[1] = with_span(std::make_shared<ast::function_call_node>(conversion, std::vector<std::shared_ptr<ast::expression_node>>{arguments[1]}), arguments[1]->get_span());
+		}
+		return with_span(std::make_shared<ast::function_call_node>(name, arguments), call->get_span());
+	}
+
+private:
+	// Whether floating-point sums may be added in another order
+	const bool reassociate;
+
+	// Names the runtime's reduction that a lambda taking two integers computes, or two floating-point numbers adds,
+	// if there is one
+	std::string get_reduction(const ast::lambda_node& lambda) const
+	{
+		const auto& parameters = lambda.get_parameters();
+		const auto& statements = lambda.get_statements();
+		const auto ret = statements.size() == 1 ? std::dynamic_pointer_cast<ast::return_node>(statements.front()) : nullptr;
+		if (!ret || parameters.size() != 2 || parameters[0]->get_name() == parameters[1]->get_name())
+			return "";
+
+		const auto type = std::dynamic_pointer_cast<ast::identifier_node>(parameters[0]->get_type());
+		const auto other = std::dynamic_pointer_cast<ast::identifier_node>(parameters[1]->get_type());
+		if (!type || !other || type->get_value() != other->get_value())
+			return "";
+		const bool floating = reassociate && analysis::is_floating_point(type->get_value());
+		if (!floating && analysis::get_scalar_type(type) != scalar_type::INTEGER)
+			return "";
+
+		const auto name = [](const std::shared_ptr<ast::expression_node>& ptr) {
+			const auto identifier = std::dynamic_pointer_cast<ast::identifier_node>(strip_groups(ptr));
+			return identifier ? identifier->get_value() : "";
+		};
+		const auto both = [&](const std::shared_ptr<ast::expression_node>& x, const std::shared_ptr<ast::expression_node>& y) {
+			const std::string& a = parameters[0]->get_name();
+			const std::string& b = parameters[1]->get_name();
+			return (name(x) == a && name(y) == b) || (name(x) == b && name(y) == a);
+		};
+
+		const auto value = strip_groups(ret->get_value());
+		if (const auto cast = std::dynamic_pointer_cast<ast::operator_node>(value))
+		{
+			if (cast->get_operation() != ast::operation::ADD || !both(cast->get_operand_a(), cast->get_operand_b()))
+				return "";
+			return floating ? "reassociated_sum" : "sum";
+		}
+		if (floating)
+			return "";
+
+		const auto conditional = std::dynamic_pointer_cast<ast::conditional_expression_node>(value);
+		const auto comparison = conditional ? std::dynamic_pointer_cast<ast::operator_node>(strip_groups(conditional->get_condition())) : nullptr;
+		if (!comparison || !both(comparison->get_operand_a(), comparison->get_operand_b()) || !both(conditional->get_value_true(), conditional->get_value_false()))
+			return "";
+
+		// Picking the smaller one when it is smaller gives the minimum, picking the other one the maximum
+		std::string smaller = "";
+		if (comparison->get_operation() == ast::operation::LESS_THAN || comparison->get_operation() == ast::operation::LESS_OR_EQUAL)
+			smaller = name(comparison->get_operand_a());
+		else if (comparison->get_operation() == ast::operation::GREATER_THAN || comparison->get_operation() == ast::operation::GREATER_OR_EQUAL)
+			smaller = name(comparison->get_operand_b());
+		else
+			return "";
+		return name(conditional->get_value_true()) == smaller ? "minimum" : "maximum";
+	}
+};
+
+
+std::vector<std::shared_ptr<ast::statement_node>> optimization::lower_reductions(const std::vector<std::shared_ptr<ast::statement_node>>& ast, bool reassociate)
+{
+	return reduction_lowerer(ast, reassociate).rewrite();
+}
+
+
+// Replaces some nodes, found by address, with other nodes
+class replacer: public rewriter
+{
+public:
+	replacer(
+		const std::unordered_map<const ast::expression_node*, std::shared_ptr<ast::expression_node>>& replacements):
+		rewriter(none),
+		replacements(replacements)
+	{ }
+
+	using rewriter::rewrite_statement;
+
+protected:
+	std::shared_ptr<ast::expression_node> rewrite_expression(const std::shared_ptr<ast::expression_node>& ptr)
+	{
+		const auto it = replacements.find(ptr.get());
+		return it != replacements.end() ? it->second : rewriter::rewrite_expression(ptr);
+	}
+
+private:
+	inline static const std::vector<std::shared_ptr<ast::statement_node>> none = { };
+	const std::unordered_map<const ast::expression_node*, std::shared_ptr<ast::expression_node>>& replacements;
+};
+
+
+size_t combine(size_t seed, size_t value) noexcept
+{
+	return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+
+// What each name of a block is bound to, sorted by identifier node
+typedef std::vector<std::pair<const ast::identifier_node*, size_t>> binding_table;
+
+
+// Structural equality, through parentheses. Names must also be bound to the same declarations, when bindings are given.
+bool same(
+	const std::shared_ptr<ast::expression_node>& ptr_a,
+	const std::shared_ptr<ast::expression_node>& ptr_b,
+	const binding_table* bindings)
+{
+	const auto a = strip_groups(ptr_a);
+	const auto b = strip_groups(ptr_b);
+
+	if (const auto x = std::dynamic_pointer_cast<ast::identifier_node>(a))
+	{
+		const auto y = std::dynamic_pointer_cast<ast::identifier_node>(b);
+		if (!y || x->get_value() != y->get_value())
+			return false;
+		if (!bindings)
+			return true;
+
+		const auto find = [bindings](const ast::identifier_node* identifier) {
+			return std::lower_bound(bindings->begin(), bindings->end(), std::make_pair(identifier, size_t(0)))->second;
+		};
+		return find(x.get()) == find(y.get());
+	}
+	else if (const auto x = std::dynamic_pointer_cast<ast::numeric_literal_node>(a))
+	{
+		const auto y = std::dynamic_pointer_cast<ast::numeric_literal_node>(b);
+		return y && x->get_value() == y->get_value() && x->get_suffix() == y->get_suffix() && x->get_limbs() == y->get_limbs();
+	}
+	else if (const auto x = std::dynamic_pointer_cast<ast::floating_literal_node>(a))
+	{
+		const auto y = std::dynamic_pointer_cast<ast::floating_literal_node>(b);
+		return y && x->get_value() == y->get_value() && x->get_suffix() == y->get_suffix();
+	}
+	else if (const auto x = std::dynamic_pointer_cast<ast::boolean_literal_node>(a))
+	{
+		const auto y = std::dynamic_pointer_cast<ast::boolean_literal_node>(b);
+		return y && x->get_value() == y->get_value();
+	}
+	else if (const auto x = std::dynamic_pointer_cast<ast::unary_operator_node>(a))
+	{
+		const auto y = std::dynamic_pointer_cast<ast::unary_operator_node>(b);
+		return y && x->get_operation() == y->get_operation() && same(x->get_operand(), y->get_operand(), bindings);
+	}
+	else if (const auto x = std::dynamic_pointer_cast<ast::operator_node>(a))
+	{
+		const auto y = std::dynamic_pointer_cast<ast::operator_node>(b);
+		return y && x->get_operation() == y->get_operation()
+			&& same(x->get_operand_a(), y->get_operand_a(), bindings) && same(x->get_operand_b(), y->get_operand_b(), bindings);
+	}
+	else if (const auto x = std::dynamic_pointer_cast<ast::conditional_expression_node>(a))
+	{
+		const auto y = std::dynamic_pointer_cast<ast::conditional_expression_node>(b);
+		return y && same(x->get_condition(), y->get_condition(), bindings)
+			&& same(x->get_value_true(), y->get_value_true(), bindings) && same(x->get_value_false(), y->get_value_false(), bindings);
+	}
+	else if (const auto x = std::dynamic_pointer_cast<ast::match_node>(a))
+	{
+		const auto y = std::dynamic_pointer_cast<ast::match_node>(b);
+		if (!y || x->get_cases().size() != y->get_cases().size()
+			|| !same(x->get_value(), y->get_value(), bindings) || !same(x->get_otherwise(), y->get_otherwise(), bindings))
+			return false;
+		for(size_t i = 0; i < x->get_cases().size(); ++i)
+		{
+			const auto& c = x->get_cases()[i];
+			const auto& d = y->get_cases()[i];
+			if (c->get_ranges() != d->get_ranges() || !same(c->get_result(), d->get_result(), bindings))
+				return false;
+		}
+		return true;
+	}
+	else if (const auto x = std::dynamic_pointer_cast<ast::field_access_node>(a))
+	{
+		const auto y = std::dynamic_pointer_cast<ast::field_access_node>(b);
+		return y && x->get_field() == y->get_field() && same(x->get_record(), y->get_record(), bindings);
+	}
+	else if (const auto x = std::dynamic_pointer_cast<ast::function_call_node>(a))
+	{
+		const auto y = std::dynamic_pointer_cast<ast::function_call_node>(b);
+		if (!y || x->get_arguments().size() != y->get_arguments().size() || !same(x->get_function(), y->get_function(), bindings))
+			return false;
+		for(size_t i = 0; i < x->get_arguments().size(); ++i)
+		{
+			if (!same(x->get_arguments()[i], y->get_arguments()[i], bindings))
+				return false;
+		}
+		return true;
+	}
+	else if (const auto x = std::dynamic_pointer_cast<ast::array_literal_node>(a))
+	{
+		const auto y = std::dynamic_pointer_cast<ast::array_literal_node>(b);
+		if (!y || x->get_elements().size() != y->get_elements().size())
+			return false;
+		for(size_t i = 0; i < x->get_elements().size(); ++i)
+		{
+			if (!same(x->get_elements()[i], y->get_elements()[i], bindings))
+				return false;
+		}
+		return true;
+	}
+
+	// Lambdas are never equal
+	return false;
+}
+
+
+// Finds the pure subexpressions that a block computes more than once
+class duplicate_finder
+{
+public:
+	struct occurrence
+	{
+		std::shared_ptr<ast::expression_node> expression;
+		size_t statement;
+
+		// Whether the expression may not be evaluated when its statement runs
+		bool conditional;
+	};
+
+	duplicate_finder(
+		const analysis::purity_info& purity,
+		const std::unordered_set<std::string>& lazy) noexcept:
+		purity(purity),
+		lazy(lazy),
+		scope({ }),
+		next_binding(1),
+		bindings({ }),
+		candidates({ }),
+		grouped({ }),
+		group({ })
+	{ }
+
+	/**
+	 * @brief Picks the largest subexpression of a block worth computing once, before the first statement that always computes it
+	 * @param statement Receives the index of that statement
+	 * @return The occurrences to replace, or an empty vector if there are none
+	 */
+	std::vector<occurrence> find(const std::vector<std::shared_ptr<ast::statement_node>>& statements, size_t& statement)
+	{
+		// Buffers are reused from block to block
+		scope.clear();
+		bindings.clear();
+		candidates.clear();
+
+		for(size_t i = 0; i < statements.size(); ++i)
+			scan(statements[i], i, false);
+
+		std::sort(bindings.begin(), bindings.end());
+		std::sort(candidates.begin(), candidates.end(), [](const candidate& a, const candidate& b){ return a.hash < b.hash; });
+
+		std::vector<occurrence> best = { };
+		size_t best_size = 0;
+		grouped.assign(candidates.size(), false);
+		for(size_t i = 0; i < candidates.size(); ++i)
+		{
+			if (grouped[i])
+				continue;
+
+			// Candidates with the same hash are almost always equal, but only almost
+			group.clear();
+			group.push_back(i);
+			for(size_t j = i + 1; j < candidates.size() && candidates[j].hash == candidates[i].hash; ++j)
+			{
+				if (!grouped[j] && same(candidates[i].o.expression, candidates[j].o.expression, &bindings))
+				{
+					group.push_back(j);
+					grouped[j] = true;
+				}
+			}
+			if (group.size() < 2)
+				continue;
+
+			size_t first = SIZE_MAX;
+			for(const size_t j : group)
+			{
+				if (!candidates[j].o.conditional)
+					first = std::min(first, candidates[j].o.statement);
+			}
+			group.erase(std::remove_if(group.begin(), group.end(), [this, first](size_t j){ return candidates[j].o.statement < first; }), group.end());
+
+			const size_t size = candidates[i].size;
+			if (group.size() >= 2 && (size > best_size || (size == best_size && group.size() > best.size())))
+			{
+				best.clear();
+				for(const size_t j : group)
+					best.push_back(candidates[j].o);
+				best_size = size;
+				statement = first;
+			}
+		}
+		return best;
+	}
+
+private:
+	struct summary
+	{
+		size_t hash = 0;
+		size_t size = 0;
+		bool pure = true;
+	};
+
+	struct candidate
+	{
+		size_t hash;
+		size_t size;
+		occurrence o;
+	};
+
+	size_t lookup(const std::string& name) const
+	{
+		for(auto it = scope.rbegin(); it != scope.rend(); ++it)
+		{
+			if (it->first == name)
+				return it->second;
+		}
+
+		// Declared outside of the block, so the same everywhere in it
+		return 0;
+	}
+
+	void scan(const std::shared_ptr<ast::statement_node>& ptr, size_t statement, bool conditional)
+	{
+		if (const auto cast = std::dynamic_pointer_cast<ast::let_node>(ptr))
+		{
+			// Lazy lets may never compute their value
+			scan(cast->get_value(), statement, conditional || cast->is_lazy());
+			scope.emplace_back(cast->get_name(), next_binding++);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_node>(ptr))
+		{
+			const size_t outer = scope.size();
+			scan(cast->get_condition(), statement, conditional);
+			scan(cast->get_branch_true(), statement, true);
+			scope.resize(outer);
+			if (cast->get_branch_false())
+				scan(cast->get_branch_false(), statement, true);
+			scope.resize(outer);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::return_node>(ptr))
+		{
+			scan(cast->get_value(), statement, conditional);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::block_node>(ptr))
+		{
+			// Statements of nested blocks may come after a return
+			const size_t outer = scope.size();
+			for(const auto& s : cast->get_statements())
+				scan(s, statement, true);
+			scope.resize(outer);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::expression_node>(ptr))
+		{
+			scan(cast, statement, conditional);
+		}
+	}
+
+	summary scan(const std::shared_ptr<ast::expression_node>& ptr, size_t statement, bool conditional)
+	{
+		summary s = { };
+
+		// Smallest size worth computing only once, small operations are cheaper to repeat than to keep in a variable.
+		// Conversions count their name, so converting a name or a literal is not worth it either.
+		size_t minimum = SIZE_MAX;
+
+		if (const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr))
+		{
+			// Using a lazy let may compute it, which must happen where it is written
+			const size_t binding = lookup(cast->get_value());
+			bindings.emplace_back(cast.get(), binding);
+			s.hash = combine(combine(1, std::hash<std::string>()(cast->get_value())), binding);
+			s.pure = !lazy.count(cast->get_value());
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::numeric_literal_node>(ptr))
+		{
+			s.hash = combine(2, std::hash<long long>()(cast->get_value()));
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::floating_literal_node>(ptr))
+		{
+			s.hash = combine(10, std::hash<double>()(cast->get_value()));
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::boolean_literal_node>(ptr))
+		{
+			s.hash = combine(3, cast->get_value());
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::group_node>(ptr))
+		{
+			// Parentheses are only there for printing
+			return scan(cast->get_expression(), statement, conditional);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::unary_operator_node>(ptr))
+		{
+			const summary operand = scan(cast->get_operand(), statement, conditional);
+			s = {combine(combine(4, static_cast<size_t>(cast->get_operation())), operand.hash), operand.size, operand.pure};
+			minimum = 3;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::operator_node>(ptr))
+		{
+			const bool short_circuit = cast->get_operation() == ast::operation::AND || cast->get_operation() == ast::operation::OR;
+			const summary a = scan(cast->get_operand_a(), statement, conditional);
+			const summary b = scan(cast->get_operand_b(), statement, conditional || short_circuit);
+			s = {combine(combine(combine(5, static_cast<size_t>(cast->get_operation())), a.hash), b.hash), a.size + b.size, a.pure && b.pure};
+			minimum = 3;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
+		{
+			const summary condition = scan(cast->get_condition(), statement, conditional);
+			const summary a = scan(cast->get_value_true(), statement, true);
+			const summary b = scan(cast->get_value_false(), statement, true);
+			s = {combine(combine(combine(6, condition.hash), a.hash), b.hash), condition.size + a.size + b.size, condition.pure && a.pure && b.pure};
+			minimum = 3;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::match_node>(ptr))
+		{
+			// Only the value is always computed
+			s = scan(cast->get_value(), statement, conditional);
+			s.hash = combine(12, s.hash);
+			for(const auto& c : cast->get_cases())
+			{
+				const summary result = scan(c->get_result(), statement, true);
+				for(const auto& [first, last] : c->get_ranges())
+					s.hash = combine(combine(s.hash, std::hash<long long>()(first)), std::hash<long long>()(last));
+				s = {combine(s.hash, result.hash), s.size + result.size, s.pure && result.pure};
+			}
+			const summary otherwise = scan(cast->get_otherwise(), statement, true);
+			s = {combine(s.hash, otherwise.hash), s.size + otherwise.size, s.pure && otherwise.pure};
+			minimum = 3;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::field_access_node>(ptr))
+		{
+			// Reading a field of a name is as cheap as the name
+			const summary record = scan(cast->get_record(), statement, conditional);
+			s = {combine(combine(11, std::hash<std::string>()(cast->get_field())), record.hash), record.size, record.pure};
+			minimum = 3;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr))
+		{
+			const summary function = scan(cast->get_function(), statement, conditional);
+			s = {combine(7, function.hash), function.size, false};
+
+			// Calls are only pure when made directly to pure top-level functions
+			const auto callee = std::dynamic_pointer_cast<ast::identifier_node>(cast->get_function());
+			if (callee && !lookup(callee->get_value()))
+			{
+				// Fixed-width and bigint conversions can fail, but always do for the same value
+				const bool conversion = analysis::get_scalar_type(callee) != analysis::scalar_type::UNKNOWN || analysis::is_fixed_width(callee->get_value())
+					|| analysis::is_floating_point(callee->get_value()) || analysis::is_bigint(callee->get_value());
+				s.pure = conversion || purity.pure.count(callee->get_value());
+				minimum = conversion ? 4 : 1;
+			}
+
+			for(const auto& argument : cast->get_arguments())
+			{
+				const summary a = scan(argument, statement, conditional);
+				s.hash = combine(s.hash, a.hash);
+				s.size += a.size;
+				s.pure = s.pure && a.pure;
+			}
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::array_literal_node>(ptr))
+		{
+			s.hash = 9;
+			for(const auto& element : cast->get_elements())
+			{
+				const summary e = scan(element, statement, conditional);
+				s.hash = combine(s.hash, e.hash);
+				s.size += e.size;
+				s.pure = s.pure && e.pure;
+			}
+			minimum = 2;
+		}
+		else
+		{
+			// Lambdas are optimized on their own
+			s.hash = combine(8, reinterpret_cast<size_t>(ptr.get()));
+			s.pure = false;
+		}
+
+		++s.size;
+		if (s.pure && s.size >= minimum)
+			candidates.push_back({s.hash, s.size, {ptr, statement, conditional}});
+		return s;
+	}
+
+	const analysis::purity_info& purity;
+	const std::unordered_set<std::string>& lazy;
+
+	// Lets of the block in scope, each with a number telling apart lets of the same name
+	std::vector<std::pair<std::string, size_t>> scope;
+	size_t next_binding;
+	binding_table bindings;
+
+	std::vector<candidate> candidates;
+	std::vector<bool> grouped;
+	std::vector<size_t> group;
+};
+
+
+// Collects the names declared or used that start with a prefix, shadowed or not
+void find_names(const std::shared_ptr<ast::expression_node>& ptr, const std::string& prefix, std::unordered_set<std::string>& names);
+
+
+void find_names(const std::string& name, const std::string& prefix, std::unordered_set<std::string>& names)
+{
+	if (!name.compare(0, prefix.length(), prefix))
+		names.insert(name);
+}
+
+
+void find_names(const std::vector<std::shared_ptr<ast::parameter_node>>& parameters, const std::string& prefix, std::unordered_set<std::string>& names)
+{
+	for(const auto& parameter : parameters)
+	{
+		find_names(parameter->get_name(), prefix, names);
+		if (parameter->get_default_value())
+			find_names(parameter->get_default_value(), prefix, names);
+	}
+}
+
+
+void find_names(const std::shared_ptr<ast::statement_node>& ptr, const std::string& prefix, std::unordered_set<std::string>& names)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::function_node>(ptr))
+	{
+		find_names(cast->get_name(), prefix, names);
+		find_names(cast->get_parameters(), prefix, names);
+		find_names(cast->get_body(), prefix, names);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::let_node>(ptr))
+	{
+		find_names(cast->get_name(), prefix, names);
+		find_names(cast->get_value(), prefix, names);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::record_node>(ptr))
+	{
+		find_names(cast->get_name(), prefix, names);
+		find_names(cast->get_fields(), prefix, names);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_node>(ptr))
+	{
+		find_names(cast->get_condition(), prefix, names);
+		find_names(cast->get_branch_true(), prefix, names);
+		if (cast->get_branch_false())
+			find_names(cast->get_branch_false(), prefix, names);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::return_node>(ptr))
+	{
+		find_names(cast->get_value(), prefix, names);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::block_node>(ptr))
+	{
+		for(const auto& statement : cast->get_statements())
+			find_names(statement, prefix, names);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::expression_node>(ptr))
+	{
+		find_names(cast, prefix, names);
+	}
+}
+
+
+void find_names(const std::shared_ptr<ast::expression_node>& ptr, const std::string& prefix, std::unordered_set<std::string>& names)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr))
+	{
+		find_names(cast->get_value(), prefix, names);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr))
+	{
+		find_names(cast->get_function(), prefix, names);
+		for(const auto& argument : cast->get_arguments())
+			find_names(argument, prefix, names);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::lambda_node>(ptr))
+	{
+		find_names(cast->get_parameters(), prefix, names);
+		for(const auto& statement : cast->get_statements())
+			find_names(statement, prefix, names);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::group_node>(ptr))
+	{
+		find_names(cast->get_expression(), prefix, names);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::field_access_node>(ptr))
+	{
+		find_names(cast->get_record(), prefix, names);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::array_literal_node>(ptr))
+	{
+		for(const auto& element : cast->get_elements())
+			find_names(element, prefix, names);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::unary_operator_node>(ptr))
+	{
+		find_names(cast->get_operand(), prefix, names);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::operator_node>(ptr))
+	{
+		find_names(cast->get_operand_a(), prefix, names);
+		find_names(cast->get_operand_b(), prefix, names);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
+	{
+		find_names(cast->get_condition(), prefix, names);
+		find_names(cast->get_value_true(), prefix, names);
+		find_names(cast->get_value_false(), prefix, names);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::match_node>(ptr))
+	{
+		find_names(cast->get_value(), prefix, names);
+		for(const auto& c : cast->get_cases())
+			find_names(c->get_result(), prefix, names);
+		find_names(cast->get_otherwise(), prefix, names);
+	}
+}
+
+
+// Finds the calls a function makes to itself, which must all be tail calls, and the names its body declares
+bool find_tail_calls(
+	const std::shared_ptr<ast::expression_node>& ptr,
+	const std::string& name,
+	bool tail,
+	std::vector<const ast::function_call_node*>& calls,
+	std::unordered_set<std::string>& declared);
+
+
+bool find_tail_calls(
+	const std::shared_ptr<ast::statement_node>& ptr,
+	const std::string& name,
+	bool tail,
+	std::vector<const ast::function_call_node*>& calls,
+	std::unordered_set<std::string>& declared)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::let_node>(ptr))
+	{
+		declared.insert(cast->get_name());
+		return find_tail_calls(cast->get_value(), name, false, calls, declared);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_node>(ptr))
+	{
+		return find_tail_calls(cast->get_condition(), name, false, calls, declared)
+			&& find_tail_calls(cast->get_branch_true(), name, tail, calls, declared)
+			&& (!cast->get_branch_false() || find_tail_calls(cast->get_branch_false(), name, tail, calls, declared));
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::return_node>(ptr))
+	{
+		return find_tail_calls(cast->get_value(), name, tail, calls, declared);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::block_node>(ptr))
+	{
+		for(const auto& statement : cast->get_statements())
+		{
+			if (!find_tail_calls(statement, name, tail, calls, declared))
+				return false;
+		}
+		return true;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::expression_node>(ptr))
+	{
+		return find_tail_calls(cast, name, false, calls, declared);
+	}
+
+	return !std::dynamic_pointer_cast<ast::function_node>(ptr);
+}
+
+
+bool find_tail_calls(
+	const std::shared_ptr<ast::expression_node>& ptr,
+	const std::string& name,
+	bool tail,
+	std::vector<const ast::function_call_node*>& calls,
+	std::unordered_set<std::string>& declared)
+{
+	if (const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr))
+	{
+		// The function is only allowed as the callee of tail calls
+		return cast->get_value() != name;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr))
+	{
+		const auto callee = std::dynamic_pointer_cast<ast::identifier_node>(cast->get_function());
+		if (callee && callee->get_value() == name)
+		{
+			if (!tail)
+				return false;
+			calls.push_back(cast.get());
+		}
+		else if (!find_tail_calls(cast->get_function(), name, false, calls, declared))
+			return false;
+
+		for(const auto& argument : cast->get_arguments())
+		{
+			if (!find_tail_calls(argument, name, false, calls, declared))
+				return false;
+		}
+		return true;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::lambda_node>(ptr))
+	{
+		// Returns inside lambdas return from the lambda
+		for(const auto& parameter : cast->get_parameters())
+			declared.insert(parameter->get_name());
+		for(const auto& statement : cast->get_statements())
+		{
+			if (!find_tail_calls(statement, name, false, calls, declared))
+				return false;
+		}
+		return true;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::group_node>(ptr))
+	{
+		return find_tail_calls(cast->get_expression(), name, tail, calls, declared);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::field_access_node>(ptr))
+	{
+		return find_tail_calls(cast->get_record(), name, false, calls, declared);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::array_literal_node>(ptr))
+	{
+		for(const auto& element : cast->get_elements())
+		{
+			if (!find_tail_calls(element, name, false, calls, declared))
+				return false;
+		}
+		return true;
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::unary_operator_node>(ptr))
+	{
+		return find_tail_calls(cast->get_operand(), name, false, calls, declared);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::operator_node>(ptr))
+	{
+		return find_tail_calls(cast->get_operand_a(), name, false, calls, declared)
+			&& find_tail_calls(cast->get_operand_b(), name, false, calls, declared);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
+	{
+		return find_tail_calls(cast->get_condition(), name, false, calls, declared)
+			&& find_tail_calls(cast->get_value_true(), name, tail, calls, declared)
+			&& find_tail_calls(cast->get_value_false(), name, tail, calls, declared);
+	}
+	else if (const auto cast = std::dynamic_pointer_cast<ast::match_node>(ptr))
+	{
+		if (!find_tail_calls(cast->get_value(), name, false, calls, declared))
+			return false;
+		for(const auto& c : cast->get_cases())
+		{
+			if (!find_tail_calls(c->get_result(), name, tail, calls, declared))
+				return false;
+		}
+		return find_tail_calls(cast->get_otherwise(), name, tail, calls, declared);
+	}
+
+	return true;
+}
+
+
+// Turns the tail calls of a function into calls to its loop, passing the hoisted invariants along
+class tail_call_replacer: public replacer
+{
+public:
+	tail_call_replacer(
+		const std::unordered_map<const ast::expression_node*, std::shared_ptr<ast::expression_node>>& replacements,
+		const std::string& name,
+		const std::shared_ptr<ast::identifier_node>& loop,
+		const std::vector<std::shared_ptr<ast::expression_node>>& invariants):
+		replacer(replacements),
+		name(name),
+		loop(loop),
+		invariants(invariants)
+	{ }
+
+protected:
+	std::shared_ptr<ast::expression_node> rewrite_expression(const std::shared_ptr<ast::expression_node>& ptr)
+	{
+		const auto result = replacer::rewrite_expression(ptr);
+		const auto call = std::dynamic_pointer_cast<ast::function_call_node>(result);
+		const auto callee = call ? std::dynamic_pointer_cast<ast::identifier_node>(call->get_function()) : nullptr;
+		if (!callee || callee->get_value() != name)
+			return result;
+
+		auto arguments = call->get_arguments();
+		arguments.insert(arguments.end(), invariants.begin(), invariants.end());
+		return with_span(std::make_shared<ast::function_call_node>(loop, arguments), call->get_span());
+	}
+
+private:
+	const std::string& name;
+	const std::shared_ptr<ast::identifier_node> loop;
+	const std::vector<std::shared_ptr<ast::expression_node>>& invariants;
+};
+
+
+class eliminator: public rewriter
+{
+public:
+	eliminator(
+		const std::vector<std::shared_ptr<ast::statement_node>>& ast):
+		rewriter(ast),
+		purity(analysis::find_pure_functions(ast)),
+		finder(purity, lazy),
+		names({ })
+	{
+		for(const auto& statement : ast)
+			find_names(statement, "pebkac_", names);
+	}
+
+protected:
+	std::vector<std::shared_ptr<ast::statement_node>> rewrite_statements(const std::vector<std::shared_ptr<ast::statement_node>>& statements)
+	{
+		auto result = rewriter::rewrite_statements(statements);
+
+		// Hoist the largest duplicates first, their parts may be duplicated in what remains
+		size_t statement = 0;
+		for(auto duplicates = finder.find(result, statement); duplicates.size(); duplicates = finder.find(result, statement))
+		{
+			const auto value = strip_groups(duplicates.front().expression);
+			const auto& span = duplicates.front().expression->get_span();
+			const auto variable = with_span(std::make_shared<ast::identifier_node>(get_fresh_name("pebkac_common_")), span);
+
+			std::unordered_map<const ast::expression_node*, std::shared_ptr<ast::expression_node>> replacements = { };
+			for(const auto& o : duplicates)
+				replacements[o.expression.get()] = variable;
+
+			replacer r(replacements);
+			for(size_t i = statement; i < result.size(); ++i)
+				result[i] = r.rewrite_statement(result[i]);
+			result.insert(result.begin() + statement, with_span(std::make_shared<ast::let_node>(variable->get_value(), nullptr, value), span));
+		}
+
+		return result;
+	}
+
+	std::shared_ptr<ast::statement_node> rewrite_statement(const std::shared_ptr<ast::statement_node>& ptr)
+	{
+		const bool top_level = get_scope() == 0;
+		const auto result = rewriter::rewrite_statement(ptr);
+
+		const auto function = std::dynamic_pointer_cast<ast::function_node>(result);
+		if (!top_level || !function || function->get_name() == "main")
+			return result;
+
+		const size_t scope = declare(function->get_parameters());
+		const auto hoisted = hoist_invariants(function);
+		restore(scope);
+		return hoisted;
+	}
+
+private:
+	struct invariant_summary
+	{
+		bool invariant = true;
+		bool total = true;
+		size_t size = 0;
+	};
+
+	/**
+	 * Splits a tail-recursive function into a loop taking its invariants as extra parameters, and the function itself
+	 * computing them once before entering the loop
+	 */
+	std::shared_ptr<ast::statement_node> hoist_invariants(const std::shared_ptr<ast::function_node>& function)
+	{
+		const auto& parameters = function->get_parameters();
+
+		std::vector<const ast::function_call_node*> calls = { };
+		std::unordered_set<std::string> variant = { };
+		if (!find_tail_calls(function->get_body(), function->get_name(), true, calls, variant) || calls.empty())
+			return function;
+
+		// Names declared in the body must not hide the parameters, which the loop passes along
+		for(const auto& parameter : parameters)
+		{
+			if (variant.count(parameter->get_name()) || variant.count(function->get_name()))
+				return function;
+		}
+
+		// Parameters every tail call passes on unchanged are invariant
+		for(const auto* call : calls)
+		{
+			if (call->get_arguments().size() != parameters.size())
+				return function;
+		}
+		for(size_t i = 0; i < parameters.size(); ++i)
+		{
+			for(const auto* call : calls)
+			{
+				const auto argument = std::dynamic_pointer_cast<ast::identifier_node>(strip_groups(call->get_arguments()[i]));
+				if (!argument || argument->get_value() != parameters[i]->get_name())
+				{
+					variant.insert(parameters[i]->get_name());
+					break;
+				}
+			}
+		}
+
+		std::vector<std::shared_ptr<ast::expression_node>> found = { };
+		for(const auto& statement : function->get_body()->get_statements())
+			find_invariants(statement, variant, found);
+		if (found.empty())
+			return function;
+
+		// Structurally equal invariants become the same parameter
+		const auto& span = function->get_span();
+		std::vector<std::shared_ptr<ast::expression_node>> values = { };
+		std::vector<std::shared_ptr<ast::expression_node>> invariants = { };
+		std::vector<std::shared_ptr<ast::parameter_node>> loop_parameters = { };
+		std::unordered_map<const ast::expression_node*, std::shared_ptr<ast::expression_node>> replacements = { };
+
+		for(const auto& parameter : parameters)
+			loop_parameters.push_back(with_span(std::make_shared<ast::parameter_node>(parameter->get_name(), parameter->get_type(), nullptr), parameter->get_span()));
+
+		for(const auto& expression : found)
+		{
+			size_t i = 0;
+			while(i < values.size() && !same(values[i], expression, nullptr))
+				++i;
+
+			if (i == values.size())
+			{
+				const auto type = get_type(expression) == analysis::scalar_type::INTEGER ? "integer" : "boolean";
+				const auto invariant = with_span(std::make_shared<ast::identifier_node>(get_fresh_name("pebkac_invariant_")), expression->get_span());
+				values.push_back(strip_groups(expression));
+				invariants.push_back(invariant);
+				loop_parameters.push_back(with_span(std::make_shared<ast::parameter_node>(invariant->get_value(), with_span(std::make_shared<ast::identifier_node>(type), span), nullptr), span));
+			}
+			replacements[expression.get()] = invariants[i];
+		}
+
+		const auto loop = with_span(std::make_shared<ast::identifier_node>(get_fresh_name("pebkac_" + function->get_name() + "_loop_")), span);
+		const auto body = std::static_pointer_cast<ast::block_node>(tail_call_replacer(replacements, function->get_name(), loop, invariants).rewrite_statement(function->get_body()));
+		declarations.push_back(with_span(std::make_shared<ast::function_node>(function->get_specifiers(), loop->get_value(), loop_parameters, function->get_return_type(), body), span));
+
+		// The function itself computes the invariants, and enters the loop
+		std::vector<std::shared_ptr<ast::expression_node>> arguments = { };
+		for(const auto& parameter : parameters)
+			arguments.push_back(with_span(std::make_shared<ast::identifier_node>(parameter->get_name()), span));
+		arguments.insert(arguments.end(), values.begin(), values.end());
+
+		const auto call = with_span(std::make_shared<ast::function_call_node>(loop, arguments), span);
+		const auto entry = with_span(std::make_shared<ast::block_node>(std::vector<std::shared_ptr<ast::statement_node>>{with_span(std::make_shared<ast::return_node>(call), span)}), function->get_body()->get_span());
+		return with_span(std::make_shared<ast::function_node>(function->get_specifiers(), function->get_name(), parameters, function->get_return_type(), entry), span);
+	}
+
+	void find_invariants(const std::shared_ptr<ast::statement_node>& ptr, const std::unordered_set<std::string>& variant, std::vector<std::shared_ptr<ast::expression_node>>& found)
+	{
+		if (const auto cast = std::dynamic_pointer_cast<ast::let_node>(ptr))
+		{
+			// Lazy lets would no longer be lazy about their invariants
+			if (!cast->is_lazy())
+				find_invariants(cast->get_value(), variant, found);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_node>(ptr))
+		{
+			find_invariants(cast->get_condition(), variant, found);
+			find_invariants(cast->get_branch_true(), variant, found);
+			if (cast->get_branch_false())
+				find_invariants(cast->get_branch_false(), variant, found);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::return_node>(ptr))
+			find_invariants(cast->get_value(), variant, found);
+		else if (const auto cast = std::dynamic_pointer_cast<ast::block_node>(ptr))
+		{
+			for(const auto& statement : cast->get_statements())
+				find_invariants(statement, variant, found);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::expression_node>(ptr))
+			find_invariants(cast, variant, found);
+	}
+
+	// Collects the largest invariant subexpressions, which can be computed ahead of time as they cannot fail
+	invariant_summary find_invariants(const std::shared_ptr<ast::expression_node>& ptr, const std::unordered_set<std::string>& variant, std::vector<std::shared_ptr<ast::expression_node>>& found)
+	{
+		const size_t before = found.size();
+		invariant_summary s = { };
+		size_t minimum = SIZE_MAX;
+
+		if (const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr))
+		{
+			s.invariant = !variant.count(cast->get_value());
+			s.total = !lazy.count(cast->get_value());
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::group_node>(ptr))
+		{
+			return find_invariants(cast->get_expression(), variant, found);
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::unary_operator_node>(ptr))
+		{
+			s = find_invariants(cast->get_operand(), variant, found);
+			minimum = 3;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::field_access_node>(ptr))
+		{
+			s = find_invariants(cast->get_record(), variant, found);
+			minimum = 3;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::operator_node>(ptr))
+		{
+			const invariant_summary a = find_invariants(cast->get_operand_a(), variant, found);
+			const invariant_summary b = find_invariants(cast->get_operand_b(), variant, found);
+			const bool divides = cast->get_operation() == ast::operation::DIVIDE || cast->get_operation() == ast::operation::MODULUS;
+			s = {a.invariant && b.invariant, a.total && b.total && !divides, a.size + b.size};
+			minimum = 3;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
+		{
+			const invariant_summary condition = find_invariants(cast->get_condition(), variant, found);
+			const invariant_summary a = find_invariants(cast->get_value_true(), variant, found);
+			const invariant_summary b = find_invariants(cast->get_value_false(), variant, found);
+			s = {condition.invariant && a.invariant && b.invariant, condition.total && a.total && b.total, condition.size + a.size + b.size};
+			minimum = 3;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::match_node>(ptr))
+		{
+			s = find_invariants(cast->get_value(), variant, found);
+			for(const auto& c : cast->get_cases())
+			{
+				const invariant_summary result = find_invariants(c->get_result(), variant, found);
+				s = {s.invariant && result.invariant, s.total && result.total, s.size + result.size};
+			}
+			const invariant_summary otherwise = find_invariants(cast->get_otherwise(), variant, found);
+			s = {s.invariant && otherwise.invariant, s.total && otherwise.total, s.size + otherwise.size};
+			minimum = 3;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr))
+		{
+			const auto callee = std::dynamic_pointer_cast<ast::identifier_node>(cast->get_function());
+			const bool conversion = callee && (analysis::get_scalar_type(callee) != analysis::scalar_type::UNKNOWN || analysis::is_floating_point(callee->get_value()));
+			s.total = callee && !variant.count(callee->get_value()) && !is_local(callee->get_value()) && (conversion || purity.total.count(callee->get_value()));
+			minimum = conversion ? 4 : 1;
+
+			if (!callee)
+				find_invariants(cast->get_function(), variant, found);
+			for(const auto& argument : cast->get_arguments())
+			{
+				const invariant_summary a = find_invariants(argument, variant, found);
+				s = {s.invariant && a.invariant, s.total && a.total, s.size + a.size};
+			}
+		}
+		else if (std::dynamic_pointer_cast<ast::lambda_node>(ptr))
+		{
+			s.invariant = false;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::array_literal_node>(ptr))
+		{
+			// Only scalars are passed to the loop, but the elements may have some
+			for(const auto& element : cast->get_elements())
+				find_invariants(element, variant, found);
+			s.invariant = false;
+		}
+
+		++s.size;
+		if (s.invariant && s.total && s.size >= minimum && get_type(ptr) != analysis::scalar_type::UNKNOWN)
+		{
+			found.resize(before);
+			found.push_back(ptr);
+		}
+		return s;
+	}
+
+	std::string get_fresh_name(const std::string& prefix)
+	{
+		for(size_t i = 0;; ++i)
+		{
+			const std::string name = prefix + std::to_string(i);
+			if (names.insert(name).second)
+				return name;
+		}
+	}
+
+	const analysis::purity_info purity;
+	duplicate_finder finder;
+
+	// Names starting with pebkac_, generated or not
+	std::unordered_set<std::string> names;
+};
+
+
+std::vector<std::shared_ptr<ast::statement_node>> optimization::eliminate_common_subexpressions(const std::vector<std::shared_ptr<ast::statement_node>>& ast)
+{
+	return eliminator(ast).rewrite();
+}
+
+
+// Rewriter telling which lets can be computed elsewhere, or not at all, without the program behaving differently
+class totality_rewriter: public rewriter
+{
+public:
+	totality_rewriter(
+		const std::vector<std::shared_ptr<ast::statement_node>>& ast,
+		const analysis::purity_info& purity):
+		rewriter(ast),
+		purity(purity)
+	{ }
+
+protected:
+	// Whether computing an expression can be skipped, as it has no side effects and cannot fail or loop forever
+	bool is_total(const std::shared_ptr<ast::expression_node>& ptr) const
+	{
+		if (const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr))
+		{
+			// Using a lazy let computes it
+			return !lazy.count(cast->get_value());
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::group_node>(ptr))
+		{
+			return is_total(cast->get_expression());
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::unary_operator_node>(ptr))
+		{
+			return is_total(cast->get_operand());
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::field_access_node>(ptr))
+		{
+			return is_total(cast->get_record());
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::operator_node>(ptr))
+		{
+			const bool divides = cast->get_operation() == ast::operation::DIVIDE || cast->get_operation() == ast::operation::MODULUS;
+			return !divides && is_total(cast->get_operand_a()) && is_total(cast->get_operand_b());
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
+		{
+			return is_total(cast->get_condition()) && is_total(cast->get_value_true()) && is_total(cast->get_value_false());
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::match_node>(ptr))
+		{
+			bool result = is_total(cast->get_value()) && is_total(cast->get_otherwise());
+			for(const auto& c : cast->get_cases())
+				result = result && is_total(c->get_result());
+			return result;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::array_literal_node>(ptr))
+		{
+			for(const auto& element : cast->get_elements())
+			{
+				if (!is_total(element))
+					return false;
+			}
+			return true;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr))
+		{
+			const auto callee = std::dynamic_pointer_cast<ast::identifier_node>(cast->get_function());
+			if (!callee || is_local(callee->get_value()))
+				return false;
+			const bool conversion = analysis::get_scalar_type(callee) != analysis::scalar_type::UNKNOWN || analysis::is_floating_point(callee->get_value());
+			if (!conversion && !purity.total.count(callee->get_value()))
+				return false;
+
+			for(const auto& argument : cast->get_arguments())
+			{
+				if (!is_total(argument))
+					return false;
+			}
+			return true;
+		}
+
+		// Literals and lambdas are only values
+		return true;
+	}
+
+private:
+	const analysis::purity_info& purity;
+};
+
+
+class dead_code_eliminator: public totality_rewriter
+{
+public:
+	using totality_rewriter::totality_rewriter;
+
+protected:
+	std::vector<std::shared_ptr<ast::statement_node>> rewrite_statements(const std::vector<std::shared_ptr<ast::statement_node>>& statements)
+	{
+		auto result = rewriter::rewrite_statements(statements);
+
+		// Going backwards, a let is unused if no statement after it mentions its name
+		std::unordered_set<std::string> used = { };
+		for(size_t i = result.size(); i-- > 0;)
+		{
+			const auto let = std::dynamic_pointer_cast<ast::let_node>(result[i]);
+			if (let && !used.count(let->get_name()) && (let->is_lazy() || is_total(let->get_value())))
+				result.erase(result.begin() + i);
+			else
+				find_names(result[i], "", used);
+		}
+		return result;
+	}
+};
+
+
+std::vector<std::shared_ptr<ast::statement_node>> optimization::eliminate_dead_code(const std::vector<std::shared_ptr<ast::statement_node>>& ast)
+{
+	// Removing unreachable functions leaves the others as pure as they were
+	const auto purity = analysis::find_pure_functions(ast);
+	const auto reachable = analysis::find_reachable(ast, purity);
+
+	std::vector<std::shared_ptr<ast::statement_node>> live = { };
+	live.reserve(ast.size());
+	for(const auto& ptr : ast)
+	{
+		const auto function = std::dynamic_pointer_cast<ast::function_node>(ptr);
+		const auto let = std::dynamic_pointer_cast<ast::let_node>(ptr);
+		if ((function && !reachable.count(function->get_name())) || (let && !reachable.count(let->get_name())))
+			continue;
+		live.push_back(ptr);
+	}
+
+	return dead_code_eliminator(live, purity).rewrite();
+}
+
+
+class let_sinker: public totality_rewriter
+{
+public:
+	using totality_rewriter::totality_rewriter;
+
+protected:
+	std::vector<std::shared_ptr<ast::statement_node>> rewrite_statements(const std::vector<std::shared_ptr<ast::statement_node>>& statements)
+	{
+		auto result = rewriter::rewrite_statements(statements);
+
+		// Only conditionals can keep a let from being computed
+		bool conditional = false;
+		for(const auto& statement : result)
+			conditional = conditional || std::dynamic_pointer_cast<ast::conditional_node>(statement);
+		if (!conditional)
+			return result;
+
+		// Going backwards, moving a let leaves the lets before it used further down
+		std::vector<std::unordered_set<std::string>> names(result.size());
+		for(size_t i = 0; i < result.size(); ++i)
+			find_names(result[i], "", names[i]);
+		for(size_t i = result.size(); i-- > 0;)
+			sink(result, names, i);
+		return result;
+	}
+
+private:
+	// Moves the let at index i, if it is one, down to its first use, and updates the names each statement mentions
+	void sink(std::vector<std::shared_ptr<ast::statement_node>>& statements, std::vector<std::unordered_set<std::string>>& names, size_t i)
+	{
+		const auto let = std::dynamic_pointer_cast<ast::let_node>(statements[i]);
+		if (!let || let->is_lazy() || !is_total(let->get_value()))
+			return;
+
+		std::unordered_set<std::string> value = { };
+		find_names(let->get_value(), "", value);
+
+		// The value must mean the same after the lets it is moved past, and skipping conditionals is the only gain
+		size_t first = i + 1;
+		size_t last_conditional = i;
+		for(; first < statements.size() && !names[first].count(let->get_name()); ++first)
+		{
+			const auto other = std::dynamic_pointer_cast<ast::let_node>(statements[first]);
+			if (other && value.count(other->get_name()))
+				return;
+			if (std::dynamic_pointer_cast<ast::conditional_node>(statements[first]))
+				last_conditional = first;
+		}
+		if (first == statements.size())
+			return;
+
+		size_t uses = 0;
+		for(size_t j = first; j < statements.size(); ++j)
+			uses += names[j].count(let->get_name());
+
+		const auto conditional = std::dynamic_pointer_cast<ast::conditional_node>(statements[first]);
+		if (uses == 1 && conditional)
+		{
+			std::unordered_set<std::string> condition = { };
+			find_names(conditional->get_condition(), "", condition);
+			const bool in_true = mentions(conditional->get_branch_true(), let->get_name());
+			const bool in_false = conditional->get_branch_false() && mentions(conditional->get_branch_false(), let->get_name());
+			if (!condition.count(let->get_name()) && in_true != in_false)
+			{
+				const auto& branch = in_true ? conditional->get_branch_true() : conditional->get_branch_false();
+				const auto sunk = into(let, branch);
+				statements[first] = with_span(std::make_shared<ast::conditional_node>(
+					conditional->get_condition(),
+					in_true ? sunk : conditional->get_branch_true(),
+					in_true ? conditional->get_branch_false() : sunk), conditional->get_span());
+
+				names[first].insert(value.begin(), value.end());
+				statements.erase(statements.begin() + i);
+				names.erase(names.begin() + i);
+				return;
+			}
+		}
+
+		std::rotate(statements.begin() + i, statements.begin() + i + 1, statements.begin() + last_conditional + 1);
+		std::rotate(names.begin() + i, names.begin() + i + 1, names.begin() + last_conditional + 1);
+	}
+
+	// Puts a let first in a branch, and keeps moving it down inside the branch
+	std::shared_ptr<ast::statement_node> into(const std::shared_ptr<ast::let_node>& let, const std::shared_ptr<ast::statement_node>& branch)
+	{
+		const auto block = std::dynamic_pointer_cast<ast::block_node>(branch);
+		std::vector<std::shared_ptr<ast::statement_node>> statements = block ? block->get_statements() : std::vector<std::shared_ptr<ast::statement_node>>{branch};
+		statements.insert(statements.begin(), let);
+
+		std::vector<std::unordered_set<std::string>> names(statements.size());
+		for(size_t i = 1; i < statements.size(); ++i)
+			find_names(statements[i], "", names[i]);
+		sink(statements, names, 0);
+
+		return with_span(std::make_shared<ast::block_node>(statements), branch->get_span());
+	}
+
+	static bool mentions(const std::shared_ptr<ast::statement_node>& ptr, const std::string& name)
+	{
+		std::unordered_set<std::string> names = { };
+		find_names(ptr, "", names);
+		return names.count(name);
+	}
+};
+
+
+std::vector<std::shared_ptr<ast::statement_node>> optimization::sink_lets(const std::vector<std::shared_ptr<ast::statement_node>>& ast)
+{
+	const auto purity = analysis::find_pure_functions(ast);
+	return let_sinker(ast, purity).rewrite();
+}
+
+
+// Replaces chains of conditionals comparing the same integer with literals by matches
+class switch_lowerer: public rewriter
+{
+public:
+	switch_lowerer(
+		const std::vector<std::shared_ptr<ast::statement_node>>& ast):
+		rewriter(ast)
+	{ }
+
+protected:
+	std::shared_ptr<ast::expression_node> rewrite_expression(const std::shared_ptr<ast::expression_node>& ptr)
+	{
+		if (!std::dynamic_pointer_cast<ast::conditional_expression_node>(ptr))
+			return rewriter::rewrite_expression(ptr);
+
+		// The chain goes on through the else branches for as long as they compare the same name. Chains are
+		// recognized from their first conditional, before the rest of them is rewritten.
+		std::shared_ptr<ast::identifier_node> value = nullptr;
+		std::vector<std::pair<std::vector<std::pair<long long, long long>>, std::shared_ptr<ast::expression_node>>> links = { };
+		std::shared_ptr<ast::expression_node> otherwise = ptr;
+		size_t comparisons = 0;
+		while (const auto link = std::dynamic_pointer_cast<ast::conditional_expression_node>(strip_groups(otherwise)))
+		{
+			std::vector<std::pair<long long, long long>> ranges = { };
+			if (!get_values(link->get_condition(), value, ranges))
+				break;
+			comparisons += ranges.size();
+			links.emplace_back(ranges, link->get_value_true());
+			otherwise = link->get_value_false();
+		}
+
+		// Shorter chains are as fast as conditionals
+		if (comparisons < 3)
+			return rewriter::rewrite_expression(ptr);
+
+		std::vector<std::shared_ptr<ast::match_case_node>> cases = { };
+		for(const auto& link : links)
+			cases.push_back(with_span(std::make_shared<ast::match_case_node>(link.first, rewrite_expression(link.second)), link.second->get_span()));
+		return with_span(std::make_shared<ast::match_node>(value, cases, rewrite_expression(otherwise)), ptr->get_span());
+	}
+
+private:
+	// Adds the values a condition compares a name with to ranges, when it is name == literal or literal == name,
+	// or an || of those, and the name is the one compared so far, if any
+	bool get_values(const std::shared_ptr<ast::expression_node>& ptr, std::shared_ptr<ast::identifier_node>& value, std::vector<std::pair<long long, long long>>& ranges) const
+	{
+		const auto comparison = std::dynamic_pointer_cast<ast::operator_node>(strip_groups(ptr));
+		if (!comparison)
+			return false;
+		if (comparison->get_operation() == ast::operation::OR)
+			return get_values(comparison->get_operand_a(), value, ranges) && get_values(comparison->get_operand_b(), value, ranges);
+		if (comparison->get_operation() != ast::operation::EQUAL)
+			return false;
+
+		long long literal = 0;
+		auto name = std::dynamic_pointer_cast<ast::identifier_node>(strip_groups(comparison->get_operand_a()));
+		if (!name || !get_literal(comparison->get_operand_b(), literal))
+		{
+			name = std::dynamic_pointer_cast<ast::identifier_node>(strip_groups(comparison->get_operand_b()));
+			if (!name || !get_literal(comparison->get_operand_a(), literal))
+				return false;
+		}
+
+		if (value && value->get_value() != name->get_value())
+			return false;
+		if (!value && !is_switchable(name->get_value()))
+			return false;
+		value = name;
+		ranges.emplace_back(literal, literal);
+		return true;
+	}
+
+	// Whether a name is an integer, or a signed fixed-width one, that can be read again without computing anything
+	bool is_switchable(const std::string& name) const
+	{
+		if (lazy.count(name))
+			return false;
+		if (get_type(std::make_shared<ast::identifier_node>(name)) == scalar_type::INTEGER)
+			return true;
+
+		// Negative literals would not convert to the labels of a switch on an unsigned type
+		const auto type = std::dynamic_pointer_cast<ast::identifier_node>(get_local_type(name));
+		return type && analysis::is_fixed_width(type->get_value()) && type->get_value()[0] == 'i';
+	}
+
+	// Reads an integer literal without a suffix, maybe negated
+	static bool get_literal(const std::shared_ptr<ast::expression_node>& ptr, long long& value)
+	{
+		const auto stripped = strip_groups(ptr);
+		if (const auto negation = std::dynamic_pointer_cast<ast::unary_operator_node>(stripped))
+		{
+			if (negation->get_operation() != ast::unary_operation::MINUS || !get_literal(negation->get_operand(), value))
+				return false;
+			value = -value;
+			return true;
+		}
+
+		const auto literal = std::dynamic_pointer_cast<ast::numeric_literal_node>(stripped);
+		if (!literal || !literal->get_suffix().empty())
+			return false;
+		value = literal->get_value();
+		return true;
+	}
+};
+
+
+std::vector<std::shared_ptr<ast::statement_node>> optimization::lower_switches(const std::vector<std::shared_ptr<ast::statement_node>>& ast)
+{
+	return switch_lowerer(ast).rewrite();
+}
+
+
+// Replaces the names that code uses without declaring them, and finds out which names those are
+class free_name_replacer: public rewriter
+{
+public:
+	struct replacement
+	{
+		std::shared_ptr<ast::expression_node> value;
+
+		// Conversion of the result of calls to the name, if any
+		std::string conversion;
+
+		// Top-level names the value refers to, which must not be hidden where it goes
+		std::vector<std::string> uses;
+	};
+
+	free_name_replacer(
+		const std::unordered_map<std::string, replacement>& replacements):
+		rewriter(none),
+		replacements(replacements),
+		seen({ }),
+		free({ }),
+		size(0),
+		hidden(false)
+	{ }
+
+	using rewriter::rewrite_statement;
+
+	std::shared_ptr<ast::expression_node> replace(const std::shared_ptr<ast::expression_node>& ptr)
+	{
+		return rewrite_expression(ptr);
+	}
+
+	/**
+	 * @brief Returns the names used without being declared, in the order they are first used
+	 */
+	const std::vector<std::string>& get_free() const noexcept
+	{
+		return free;
+	}
+
+	/**
+	 * @brief Returns the number of expression nodes rewritten so far
+	 */
+	size_t get_size() const noexcept
+	{
+		return size;
+	}
+
+	/**
+	 * @brief Whether a replacement went where a name it refers to is declared, and so would refer to something else
+	 */
+	bool is_hidden() const noexcept
+	{
+		return hidden;
+	}
+
+protected:
+	std::shared_ptr<ast::expression_node> rewrite_expression(const std::shared_ptr<ast::expression_node>& ptr)
+	{
+		++size;
+		if (const auto cast = std::dynamic_pointer_cast<ast::identifier_node>(ptr))
+		{
+			const std::string& name = cast->get_value();
+			if (is_local(name))
+				return ptr;
+			if (seen.insert(name).second)
+				free.push_back(name);
+
+			const auto it = replacements.find(name);
+			if (it == replacements.end())
+				return ptr;
+			for(const auto& use : it->second.uses)
+				hidden = hidden || is_local(use);
+			return it->second.value;
+		}
+		else if (const auto cast = std::dynamic_pointer_cast<ast::function_call_node>(ptr))
+		{
+			const auto callee = std::dynamic_pointer_cast<ast::identifier_node>(cast->get_function());
+			const auto it = callee && !is_local(callee->get_value()) ? replacements.find(callee->get_value()) : replacements.end();
+			if (it != replacements.end() && it->second.conversion.length())
+			{
+				// Calls through a function type converted the result to its return type
+				const auto conversion = with_span(std::make_shared<ast::identifier_node>(it->second.conversion), ptr->get_span());
+				const std::vector<std::shared_ptr<ast::expression_node>> arguments = {rewriter::rewrite_expression(ptr)};
+				return with_span(std::make_shared<ast::function_call_node>(conversion, arguments), ptr->get_span());
+			}
+		}
+
+		return rewriter::rewrite_expression(ptr);
+	}
+
+private:
+	inline static const std::vector<std::shared_ptr<ast::statement_node>> none = { };
+	const std::unordered_map<std::string, replacement>& replacements;
+
+	std::unordered_set<std::string> seen;
+	std::vector<std::string> free;
+	size_t size;
+	bool hidden;
+};
+
+
+class specializer: public rewriter
+{
+public:
+	specializer(
+		const std::vector<std::shared_ptr<ast::statement_node>>& ast,
+		size_t budget):
+		rewriter(ast),
+		budget(budget),
+		nested(false),
+		caller(""),
+		top_level({ }),
+		defined({ }),
+		cache({ }),
+		pending({ }),
+		expanding({ }),
+		names({ })
+	{
+		for(const auto& statement : ast)
+		{
+			if (const auto function = std::dynamic_pointer_cast<ast::function_node>(statement))
+				top_level.insert(function->get_name());
+			else if (const auto let = std::dynamic_pointer_cast<ast::let_node>(statement))
+				top_level.insert(let->get_name());
+			find_names(statement, "pebkac_", names);
+		}
+	}
+
+protected:
+	std::shared_ptr<ast::statement_node> rewrite_statement(const std::shared_ptr<ast::statement_node>& ptr)
+	{
+		if (nested)
+			return rewriter::rewrite_statement(ptr);
+
+		const auto function = std::dynamic_pointer_cast<ast::function_node>(ptr);
+		const auto let = std::dynamic_pointer_cast<ast::let_node>(ptr);
+		caller = function ? function->get_name() : "";
+
+		nested = true;
+		const auto result = rewriter::rewrite_statement(ptr);
+		emit_pending();
+		nested = false;
+
+		if (function)
+			defined.insert(function->get_name());
+		else if (let)
+			defined.insert(let->get_name());
+		return result;
+	}
+
+	std::shared_ptr<ast::expression_node> rewrite_expression(const std::shared_ptr<ast::expression_node>& ptr)
+	{
+		const auto call = std::dynamic_pointer_cast<ast::function_call_node>(ptr);
+		const auto callee = call ? std::dynamic_pointer_cast<ast::identifier_node>(call->get_function()) : nullptr;
+		const auto function = callee && !is_local(callee->get_value()) ? get_function(callee->get_value()) : nullptr;
+
+		// Specializing looks at the arguments as written, which is what clones are cached by
+		const auto specialized = function ? specialize(*call, function) : nullptr;
+		return rewriter::rewrite_expression(specialized ? specialized : ptr);
+	}
+
+private:
+	struct specialization
+	{
+		// Name of the clone, empty if the function cannot be specialized for these arguments
+		std::string name;
+
+		// Indices of the parameters the clone no longer has
+		std::vector<size_t> removed;
+
+		// Names the lambdas use from where they are written, passed to the clone as extra arguments
+		std::vector<std::string> captures;
+	};
+
+	// Identifies the function arguments a call can be specialized for, by parameter index
+	std::string get_key(const ast::function_node& function, const std::vector<std::shared_ptr<ast::expression_node>>& arguments, std::vector<size_t>& indices) const
+	{
+		std::string key = function.get_name();
+		const auto& parameters = function.get_parameters();
+		for(size_t i = 0; i < parameters.size(); ++i)
+		{
+			if (!std::dynamic_pointer_cast<ast::function_type_node>(parameters[i]->get_type()))
+				continue;
+
+			// Lambdas are told apart by node, as the same lambda is always written in the same place
+			const auto argument = strip_groups(arguments[i]);
+			const auto identifier = std::dynamic_pointer_cast<ast::identifier_node>(argument);
+			if (const auto lambda = std::dynamic_pointer_cast<ast::lambda_node>(argument))
+				key += " " + std::to_string(i) + ":" + std::to_string(reinterpret_cast<std::uintptr_t>(lambda.get()));
+			else if (identifier && !is_local(identifier->get_value()) && get_function(identifier->get_value()) && defined.count(identifier->get_value()))
+				key += " " + std::to_string(i) + "=" + identifier->get_value();
+			else
+				continue;
+			indices.push_back(i);
+		}
+		return key;
+	}
+
+	// Calls the clone of a function for the lambdas and functions a call passes, if there is or can be one
+	std::shared_ptr<ast::expression_node> specialize(const ast::function_call_node& call, const std::shared_ptr<ast::function_node>& function)
+	{
+		const auto& arguments = call.get_arguments();
+		if (arguments.size() != function->get_parameters().size() || function->get_name() == caller || !defined.count(function->get_name()))
+			return nullptr;
+
+		std::vector<size_t> indices = { };
+		const std::string key = get_key(*function, arguments, indices);
+		if (indices.empty())
+			return nullptr;
+
+		auto it = cache.find(key);
+		if (it == cache.end())
+		{
+			// Clones of a function being cloned could go on forever, and are only made again by later calls
+			if (expanding.count(function->get_name()))
+				return nullptr;
+			create(function, arguments, key, indices);
+			it = cache.find(key);
+		}
+
+		const specialization& s = it->second;
+		if (s.name.empty())
+			return nullptr;
+
+		std::vector<std::shared_ptr<ast::expression_node>> kept = { };
+		for(size_t i = 0, j = 0; i < arguments.size(); ++i)
+		{
+			if (j < s.removed.size() && s.removed[j] == i)
+				++j;
+			else
+				kept.push_back(arguments[i]);
+		}
+		for(const auto& capture : s.captures)
+			kept.push_back(with_span(std::make_shared<ast::identifier_node>(capture), call.get_span()));
+
+		const auto name = with_span(std::make_shared<ast::identifier_node>(s.name), call.get_function()->get_span());
+		return with_span(std::make_shared<ast::function_call_node>(name, kept), call.get_span());
+	}
+
+	/**
+	 * Clones a function with the given lambdas and functions in place of its parameters. Names the lambdas use from
+	 * where they are written become parameters of the clone.
+	 */
+	void create(
+		const std::shared_ptr<ast::function_node>& function,
+		const std::vector<std::shared_ptr<ast::expression_node>>& arguments,
+		const std::string& key,
+		const std::vector<size_t>& indices)
+	{
+		const auto& parameters = function->get_parameters();
+		specialization& s = cache[key];
+		s.removed = indices;
+
+		std::unordered_map<std::string, free_name_replacer::replacement> replacements = { };
+		std::vector<std::shared_ptr<ast::parameter_node>> captures = { };
+		std::vector<std::shared_ptr<ast::expression_node>> values(arguments.size());
+		for(const size_t i : indices)
+		{
+			const auto type = std::static_pointer_cast<ast::function_type_node>(parameters[i]->get_type());
+			const scalar_type result = analysis::get_scalar_type(type->get_return_type());
+			const std::string conversion = result == scalar_type::INTEGER ? "integer" : result == scalar_type::BOOLEAN ? "boolean" : "";
+
+			const auto argument = strip_groups(arguments[i]);
+			const auto lambda = std::dynamic_pointer_cast<ast::lambda_node>(argument);
+			if (!lambda)
+			{
+				const auto& name = std::static_pointer_cast<ast::identifier_node>(argument)->get_value();
+				replacements[parameters[i]->get_name()] = {argument, conversion, {name}};
+				values[i] = argument;
+				continue;
+			}
+
+			// The replacer keeps a reference to its replacements, which must outlive it
+			const std::unordered_map<std::string, free_name_replacer::replacement> no_replacements = { };
+			free_name_replacer finder(no_replacements);
+			finder.replace(lambda);
+
+			std::unordered_map<std::string, free_name_replacer::replacement> renames = { };
+			std::vector<std::string> uses = { };
+			for(const auto& name : finder.get_free())
+			{
+				if (!is_local(name))
+				{
+					// Clones go right before the caller, so anything declared later cannot be used yet
+					if (top_level.count(name) && !defined.count(name))
+						return;
+					uses.push_back(name);
+					continue;
+				}
+
+				// Passing a lazy let to the clone would compute its value even if the lambda is never called
+				const auto capture_type = get_local_type(name);
+				if (!capture_type || lazy.count(name))
+					return;
+
+				const std::string capture = get_fresh_name("pebkac_capture_");
+				renames[name] = {with_span(std::make_shared<ast::identifier_node>(capture), lambda->get_span()), "", { }};
+				captures.push_back(with_span(std::make_shared<ast::parameter_node>(capture, capture_type, nullptr), lambda->get_span()));
+				s.captures.push_back(name);
+			}
+
+			const auto renamed = renames.empty() ? argument : free_name_replacer(renames).replace(lambda);
+			replacements[parameters[i]->get_name()] = {renamed, conversion, uses};
+			values[i] = renamed;
+		}
+
+		free_name_replacer substitution(replacements);
+		const auto body = std::static_pointer_cast<ast::block_node>(substitution.rewrite_statement(function->get_body()));
+		if (substitution.is_hidden() || substitution.get_size() > budget)
+		{
+			s = { };
+			return;
+		}
+		budget -= substitution.get_size();
+
+		std::vector<std::shared_ptr<ast::parameter_node>> kept = { };
+		for(size_t i = 0; i < parameters.size(); ++i)
+		{
+			if (!values[i])
+				kept.push_back(parameters[i]);
+		}
+		kept.insert(kept.end(), captures.begin(), captures.end());
+
+		s.name = get_fresh_name("pebkac_" + function->get_name() + "_");
+		pending.emplace_back(with_span(std::make_shared<ast::function_node>(function->get_specifiers(), s.name, kept, function->get_return_type(), body), function->get_span()), function->get_name());
+
+		// The clone passes the same lambdas on when it calls the function again, which then calls the clone itself
+		std::vector<size_t> indices_inside = { };
+		const std::string key_inside = get_key(*function, values, indices_inside);
+		if (key_inside != key)
+		{
+			specialization inside = {s.name, s.removed, { }};
+			for(const auto& capture : captures)
+				inside.captures.push_back(capture->get_name());
+			cache[key_inside] = inside;
+		}
+	}
+
+	// Rewrites the clones made for the last top-level statement, which go right before it, after the clones they call
+	void emit_pending()
+	{
+		auto clones = std::move(pending);
+		pending.clear();
+		for(const auto& [clone, original] : clones)
+		{
+			expanding.insert(original);
+			const auto result = rewriter::rewrite_statement(clone);
+			emit_pending();
+			expanding.erase(original);
+			declarations.push_back(result);
+		}
+	}
+
+	std::string get_fresh_name(const std::string& prefix)
+	{
+		for(size_t i = 0;; ++i)
+		{
+			const std::string name = prefix + std::to_string(i);
+			if (names.insert(name).second)
+				return name;
+		}
+	}
+
+	// Nodes the clones may still add
+	size_t budget;
+
+	// Whether a top-level statement is being rewritten, and the name of the function it is
+	bool nested;
+	std::string caller;
+
+	// Top-level names, and those declared before the statement being rewritten
+	std::unordered_set<std::string> top_level;
+	std::unordered_set<std::string> defined;
+
+	std::unordered_map<std::string, specialization> cache;
+
+	// Clones still to rewrite, and the functions they are clones of
+	std::vector<std::pair<std::shared_ptr<ast::function_node>, std::string>> pending;
+	std::unordered_set<std::string> expanding;
+
+	// Names starting with pebkac_, generated or not
+	std::unordered_set<std::string> names;
+};
+
+
+std::vector<std::shared_ptr<ast::statement_node>> optimization::specialize_functions(const std::vector<std::shared_ptr<ast::statement_node>>& ast, size_t budget)
+{
+	return specializer(ast, budget).rewrite();
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "nodes.hpp"
+#include "analysis.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * @brief Transformations of the AST that keep the behaviour of the generated program, but make it faster
+ */
+namespace pebkac::optimization
+{
+	/**
+	 * @brief Rebuilds an AST bottom-up while keeping track of the names in scope
+	 *
+	 * Passes override rewrite_expression or rewrite_statement, and call the base version to rewrite the children.
+	 * Nodes whose children did not change are shared with the original AST rather than copied.
+	 */
+	class rewriter
+	{
+	public:
+		rewriter(
+			const std::vector<std::shared_ptr<ast::statement_node>>& ast
+		);
+		virtual ~rewriter() = default;
+
+		/**
+		 * @brief Rewrites every top-level statement
+		 */
+		std::vector<std::shared_ptr<ast::statement_node>> rewrite();
+
+	protected:
+		virtual std::shared_ptr<ast::statement_node> rewrite_statement(const std::shared_ptr<ast::statement_node>& ptr);
+		virtual std::shared_ptr<ast::expression_node> rewrite_expression(const std::shared_ptr<ast::expression_node>& ptr);
+
+		// Rewrites the statements of a block, making every let visible to the statements after it
+		virtual std::vector<std::shared_ptr<ast::statement_node>> rewrite_statements(const std::vector<std::shared_ptr<ast::statement_node>>& statements);
+
+		/**
+		 * @brief Brings parameters into scope
+		 * @return The scope to restore once they go out of scope
+		 */
+		size_t declare(const std::vector<std::shared_ptr<ast::parameter_node>>& parameters);
+		void restore(size_t scope) noexcept;
+
+		/**
+		 * @brief Returns the number of names in scope, which is 0 for top-level statements
+		 */
+		size_t get_scope() const noexcept;
+
+		/**
+		 * @brief Whether a name refers to a parameter or let of the code being rewritten, rather than to a top-level declaration
+		 */
+		bool is_local(const std::string& name) const;
+
+		/**
+		 * @brief Whether a name is neither local nor declared at the top level, so it can only refer to a builtin
+		 */
+		bool is_builtin(const std::string& name) const;
+
+		/**
+		 * @brief Infers the C++ type of an expression in the current scope
+		 */
+		analysis::scalar_type get_type(const std::shared_ptr<ast::expression_node>& ptr) const;
+
+		/**
+		 * @brief Returns the type of a parameter or let in scope, as declared or, for untyped lets, as inferred
+		 * @return The type, or null if the name is not local or its type is not known
+		 */
+		std::shared_ptr<ast::type_node> get_local_type(const std::string& name) const;
+
+		/**
+		 * @brief Returns the top-level function with the given name, unless it is missing or overloaded
+		 */
+		std::shared_ptr<ast::function_node> get_function(const std::string& name) const;
+
+		// Top-level declarations to insert before the top-level statement being rewritten
+		std::vector<std::shared_ptr<ast::statement_node>> declarations;
+
+		// Names of the top-level lazy lets and of every lazy let rewritten so far, whatever hides them. Using one of
+		// these names may compute a value, which can have side effects or fail.
+		std::unordered_set<std::string> lazy;
+
+	private:
+		const std::vector<std::shared_ptr<ast::statement_node>>& ast;
+
+		// Top-level functions by name, null for overloaded names
+		std::unordered_map<std::string, std::shared_ptr<ast::function_node>> functions;
+
+		// Types of top-level lets
+		std::unordered_map<std::string, analysis::scalar_type> globals;
+
+		struct local
+		{
+			std::string name;
+			analysis::scalar_type type;
+
+			// Type written in the source, if any
+			std::shared_ptr<ast::type_node> declared;
+		};
+
+		// Parameters and lets in scope, innermost last
+		std::vector<local> locals;
+	};
+
+
+	/**
+	 * @brief Replaces calls to higher-order functions given lambdas or top-level functions by calls to clones of them
+	 * @param ast Top-level statements to optimize
+	 * @param budget Largest number of nodes the clones may add in total
+	 *
+	 * Each clone has the lambda or function in place of the parameter, so it calls it directly rather than through
+	 * std::function. Names a lambda uses from the caller are passed to the clone as extra parameters. Clones are
+	 * shared by all calls passing the same lambdas or functions, including the recursive calls of the clones.
+	 */
+	std::vector<std::shared_ptr<ast::statement_node>> specialize_functions(const std::vector<std::shared_ptr<ast::statement_node>>& ast, size_t budget);
+
+
+	/**
+	 * @brief Replaces calls to small functions by their bodies, and immediately applied lambdas by their bodies
+	 * @param ast Top-level statements to optimize
+	 * @param budget Largest number of nodes a body may have to be inlined
+	 *
+	 * Only functions and lambdas consisting of a single return statement are inlined. Arguments are substituted
+	 * for the parameters, so an argument used more than once, or maybe not at all, must be a name or a literal.
+	 * Conversions are inserted wherever the call would have converted an argument or the result.
+	 */
+	std::vector<std::shared_ptr<ast::statement_node>> inline_functions(const std::vector<std::shared_ptr<ast::statement_node>>& ast, size_t budget);
+
+
+	/**
+	 * @brief Replaces folds whose function adds integers, or picks the smaller or larger one, by the array runtime's
+	 * SIMD reductions
+	 * @param reassociate Whether folds adding floats or doubles may also be replaced, by a sum that adds them in
+	 * another order, and so may round differently
+	 *
+	 * Only lambdas taking two integers and returning a + b, or if (a < b) a else b and its variants, are recognized.
+	 */
+	std::vector<std::shared_ptr<ast::statement_node>> lower_reductions(const std::vector<std::shared_ptr<ast::statement_node>>& ast, bool reassociate);
+
+
+	/**
+	 * @brief Computes repeated pure subexpressions only once, and the invariants of tail-recursive functions before they loop
+	 *
+	 * Subexpressions computed more than once in a block are hoisted into a let before the first statement that always
+	 * computes them. Tail-recursive functions become a loop function taking the subexpressions that do not depend on
+	 * changing parameters as extra parameters, which is only done for subexpressions that cannot fail, since the loop
+	 * may not have computed them at all.
+	 */
+	std::vector<std::shared_ptr<ast::statement_node>> eliminate_common_subexpressions(const std::vector<std::shared_ptr<ast::statement_node>>& ast);
+
+
+	/**
+	 * @brief Removes the top-level functions and lets the program cannot use, and the lets nothing after them uses
+	 *
+	 * Only lets whose value has no side effects and cannot fail are removed, so the program behaves the same.
+	 * Unused lazy lets are always removed, as their value is never computed.
+	 */
+	std::vector<std::shared_ptr<ast::statement_node>> eliminate_dead_code(const std::vector<std::shared_ptr<ast::statement_node>>& ast);
+
+
+	/**
+	 * @brief Moves lets down to the first statement using them, and into the only branch of a conditional using them
+	 *
+	 * Only lets whose value has no side effects and cannot fail are moved, so they are computed only when needed
+	 * without the program behaving any differently. Lets are moved past conditionals, which may return before using
+	 * them, and into a conditional only when no other statement uses them.
+	 */
+	std::vector<std::shared_ptr<ast::statement_node>> sink_lets(const std::vector<std::shared_ptr<ast::statement_node>>& ast);
+
+
+	/**
+	 * @brief Replaces chains of conditionals comparing the same integer with literals by matches, which are generated as
+	 * switches
+	 *
+	 * Conditions must be name == literal, literal == name, or an || of those, and the chain must compare at least three
+	 * values in total. Only local names and top-level lets of type integer, or of a signed fixed-width type, are
+	 * recognized, and never lazy ones, as reading them again must not compute anything.
+	 */
+	std::vector<std::shared_ptr<ast::statement_node>> lower_switches(const std::vector<std::shared_ptr<ast::statement_node>>& ast);
+}
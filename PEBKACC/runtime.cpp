@@ -0,0 +1,2585 @@
+#include "runtime.hpp"
+
+using namespace pebkac;
+
+
+std::string runtime::get_prelude()
+{
+	return "#include <iostream>\n#include <functional>\n\ntypedef long long integer;\ntypedef bool boolean;\nvoid print(long long n)\n{\n\tstd::cout << n << std::endl;\n}\n\n";
+}
+
+
+std::string runtime::get_profiler(const std::vector<std::string>& functions)
+{
+	std::string names = "";
+	for(const auto& f : functions)
+		names += (names.length()?", ":"") + ("\"" + f + "\"");
+
+	return "#include <mutex>\n#include <chrono>\n#include <cstdio>\n#include <cstdint>\n#include <algorithm>\n"
+		"#if defined(_MSC_VER)\n#include <intrin.h>\n#elif defined(__x86_64__) || defined(__i386__)\n#include <x86intrin.h>\n#endif\n\n"
+		"namespace pebkac_profile\n{\n"
+		"\tconstexpr std::size_t function_count = " + std::to_string(functions.size()) + ";\n"
+		"\tconst char* const function_names[function_count + 1] = {" + names + (names.length()?", ":"") + "nullptr};\n"
+		R"(
+	inline std::uint64_t ticks() noexcept
+	{
+	#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+	#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	#endif
+	}
+
+	// Process-wide totals, printed when the program exits
+	struct registry
+	{
+		std::mutex mutex;
+		std::uint64_t calls[function_count + 1] = { };
+		std::uint64_t ticks[function_count + 1] = { };
+		const std::uint64_t start_ticks = pebkac_profile::ticks();
+		const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+		~registry()
+		{
+			// Calibrate ticks against the wall clock over the whole run
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+			const double ticks_per_second = seconds > 0 ? (pebkac_profile::ticks() - start_ticks) / seconds : 1e9;
+
+			std::size_t order[function_count + 1];
+			for(std::size_t i = 0; i < function_count; ++i)
+				order[i] = i;
+			std::sort(order, order + function_count, [this](std::size_t a, std::size_t b){ return ticks[a] > ticks[b]; });
+
+			std::fprintf(stderr, "%-32s %14s %14s %14s\n", "function", "calls", "total ms", "ns/call");
+			for(std::size_t j = 0; j < function_count; ++j)
+			{
+				const std::size_t i = order[j];
+				if (!calls[i])
+					continue;
+				const double total = ticks[i] / ticks_per_second;
+				std::fprintf(stderr, "%-32s %14llu %14.3f %14.1f\n", function_names[i], static_cast<unsigned long long>(calls[i]), total * 1e3, total * 1e9 / calls[i]);
+			}
+		}
+	};
+	registry totals;
+
+	// Every thread counts on its own, and only takes the lock once, when it exits
+	struct counters
+	{
+		std::uint64_t calls[function_count + 1] = { };
+		std::uint64_t ticks[function_count + 1] = { };
+		std::uint64_t start[function_count + 1] = { };
+		std::uint32_t depth[function_count + 1] = { };
+
+		~counters()
+		{
+			std::lock_guard<std::mutex> lock(totals.mutex);
+			for(std::size_t i = 0; i < function_count; ++i)
+			{
+				totals.calls[i] += calls[i];
+				totals.ticks[i] += ticks[i];
+			}
+		}
+	};
+	thread_local counters local;
+
+	struct scope
+	{
+		counters& c;
+		const std::size_t id;
+
+		scope(std::size_t id) noexcept: c(local), id(id)
+		{
+			++c.calls[id];
+			if (c.depth[id]++ == 0)
+				c.start[id] = pebkac_profile::ticks();
+		}
+
+		~scope()
+		{
+			if (--c.depth[id] == 0)
+				c.ticks[id] += pebkac_profile::ticks() - c.start[id];
+		}
+	};
+}
+
+)";
+}
+
+
+std::string runtime::get_closures()
+{
+	return R"(#include <type_traits>
+
+namespace pebkac_closure
+{
+	template<typename F>
+	class function_ref;
+
+	template<typename R, typename... P>
+	class function_ref<R(P...)>
+	{
+		union target
+		{
+			const void* object;
+			void (*function)();
+		};
+
+		target t;
+		R (*call)(target, P...);
+
+	public:
+		template<typename F, std::enable_if_t<!std::is_function_v<F> && !std::is_same_v<F, function_ref>, int> = 0>
+		function_ref(const F& f) noexcept:
+			call([](target t, P... p) -> R { return (*static_cast<const F*>(t.object))(static_cast<P>(p)...); })
+		{
+			t.object = &f;
+		}
+
+		template<typename F, std::enable_if_t<std::is_function_v<F>, int> = 0>
+		function_ref(F& f) noexcept:
+			call([](target t, P... p) -> R { return reinterpret_cast<F*>(t.function)(static_cast<P>(p)...); })
+		{
+			t.function = reinterpret_cast<void (*)()>(&f);
+		}
+
+		R operator()(P... p) const
+		{
+			return call(t, static_cast<P>(p)...);
+		}
+	};
+}
+
+)";
+}
+
+
+std::string runtime::get_lazy()
+{
+	return R"(#include <atomic>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <optional>
+#include <type_traits>
+
+namespace pebkac_lazy
+{
+	template<typename F>
+	class thunk
+	{
+	public:
+		typedef std::decay_t<std::invoke_result_t<const F&>> value_type;
+
+		explicit thunk(F f):
+			f(std::move(f)),
+			state(pending)
+		{ }
+
+		// Copies could compute the value again, lambdas copying a thunk use a shared one
+		thunk(const thunk&) = delete;
+		thunk& operator=(const thunk&) = delete;
+
+		const value_type& operator()() const
+		{
+			if (state.load(std::memory_order_acquire) != done)
+				force();
+			return *value;
+		}
+
+	private:
+		enum: unsigned char { pending, computing, done };
+
+		// The first thread to get here computes the value, the others wait for it
+		void force() const
+		{
+			for(;;)
+			{
+				unsigned char expected = pending;
+				if (state.compare_exchange_weak(expected, computing, std::memory_order_acquire))
+				{
+					try
+					{
+						value.emplace(f());
+					}
+					catch(...)
+					{
+						state.store(pending, std::memory_order_release);
+						throw;
+					}
+					state.store(done, std::memory_order_release);
+					return;
+				}
+				if (expected == done)
+					return;
+				std::this_thread::yield();
+			}
+		}
+
+		const F f;
+		mutable std::optional<value_type> value;
+		mutable std::atomic<unsigned char> state;
+	};
+
+	template<typename F>
+	class shared_thunk
+	{
+	public:
+		typedef typename thunk<F>::value_type value_type;
+
+		explicit shared_thunk(F f):
+			t(std::make_shared<const thunk<F>>(std::move(f)))
+		{ }
+
+		const value_type& operator()() const
+		{
+			return (*t)();
+		}
+
+	private:
+		std::shared_ptr<const thunk<F>> t;
+	};
+
+	template<typename F>
+	thunk<F> make(F f)
+	{
+		return thunk<F>(std::move(f));
+	}
+
+	template<typename F>
+	shared_thunk<F> share(F f)
+	{
+		return shared_thunk<F>(std::move(f));
+	}
+}
+
+)";
+}
+
+
+std::string runtime::get_fixed_width()
+{
+	return R"(#include <limits>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+typedef std::int8_t i8;
+typedef std::int16_t i16;
+typedef std::int32_t i32;
+typedef std::int64_t i64;
+typedef std::uint8_t u8;
+typedef std::uint16_t u16;
+typedef std::uint32_t u32;
+typedef std::uint64_t u64;
+
+// Only u64 can be larger than any integer. Everything else prints as an integer.
+template<typename T, std::enable_if_t<std::is_same_v<T, u64>, int> = 0>
+void print(T n)
+{
+	std::cout << n << std::endl;
+}
+
+namespace pebkac_int
+{
+	// Compares the values themselves, not what they become when converted to the same type
+	template<typename T, typename V>
+	constexpr bool fits(V value) noexcept
+	{
+		if constexpr (std::is_signed_v<V> == std::is_signed_v<T>)
+			return value >= std::numeric_limits<T>::min() && value <= std::numeric_limits<T>::max();
+		else if constexpr (std::is_signed_v<V>)
+			return value >= 0 && static_cast<std::make_unsigned_t<V>>(value) <= std::numeric_limits<T>::max();
+		else
+			return value <= static_cast<std::make_unsigned_t<T>>(std::numeric_limits<T>::max());
+	}
+
+	template<typename T, typename V>
+	constexpr T convert(V value)
+	{
+		if (!fits<T>(value))
+			throw std::range_error("Integer conversion out of range");
+		return static_cast<T>(value);
+	}
+}
+
+)";
+}
+
+
+std::string runtime::get_bigint()
+{
+	return R"(#include <cmath>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <stdexcept>
+#include <type_traits>
+
+namespace pebkac_big
+{
+	// Magnitudes are little-endian 32-bit limbs without leading zeros, so zero has none
+	typedef std::vector<std::uint32_t> limbs;
+
+	// Products of operands shorter than this are faster to compute on paper than with Karatsuba's method
+	constexpr std::size_t karatsuba_threshold = 32;
+
+	inline bool add_overflow(long long a, long long b, long long& result) noexcept
+	{
+	#if defined(__GNUC__)
+		return __builtin_add_overflow(a, b, &result);
+	#else
+		if ((b > 0 && a > std::numeric_limits<long long>::max() - b) || (b < 0 && a < std::numeric_limits<long long>::min() - b))
+			return true;
+		result = a + b;
+		return false;
+	#endif
+	}
+
+	inline bool sub_overflow(long long a, long long b, long long& result) noexcept
+	{
+	#if defined(__GNUC__)
+		return __builtin_sub_overflow(a, b, &result);
+	#else
+		if ((b < 0 && a > std::numeric_limits<long long>::max() + b) || (b > 0 && a < std::numeric_limits<long long>::min() + b))
+			return true;
+		result = a - b;
+		return false;
+	#endif
+	}
+
+	inline bool mul_overflow(long long a, long long b, long long& result) noexcept
+	{
+	#if defined(__GNUC__)
+		return __builtin_mul_overflow(a, b, &result);
+	#else
+		result = static_cast<long long>(static_cast<unsigned long long>(a) * static_cast<unsigned long long>(b));
+		if (a == 0 || b == 0)
+			return false;
+		if ((a == -1 && b == std::numeric_limits<long long>::min()) || (b == -1 && a == std::numeric_limits<long long>::min()))
+			return true;
+		return result / b != a;
+	#endif
+	}
+
+	inline void trim(limbs& x) noexcept
+	{
+		while (!x.empty() && !x.back())
+			x.pop_back();
+	}
+
+	inline limbs from(unsigned long long x)
+	{
+		limbs result;
+		for(; x; x >>= 32)
+			result.push_back(static_cast<std::uint32_t>(x));
+		return result;
+	}
+
+	inline int compare(const limbs& a, const limbs& b) noexcept
+	{
+		if (a.size() != b.size())
+			return a.size() < b.size() ? -1 : 1;
+		for(std::size_t i = a.size(); i-- > 0;)
+		{
+			if (a[i] != b[i])
+				return a[i] < b[i] ? -1 : 1;
+		}
+		return 0;
+	}
+
+	// Adds n limbs of b, shifted left by some limbs, to a
+	inline void add_to(limbs& a, const std::uint32_t* b, std::size_t n, std::size_t shift)
+	{
+		if (a.size() < shift + n)
+			a.resize(shift + n, 0);
+
+		std::uint64_t carry = 0;
+		for(std::size_t i = 0; i < n; ++i)
+		{
+			carry += static_cast<std::uint64_t>(a[shift + i]) + b[i];
+			a[shift + i] = static_cast<std::uint32_t>(carry);
+			carry >>= 32;
+		}
+		for(std::size_t i = shift + n; carry; ++i)
+		{
+			if (i == a.size())
+				a.push_back(0);
+			carry += a[i];
+			a[i] = static_cast<std::uint32_t>(carry);
+			carry >>= 32;
+		}
+	}
+
+	// Subtracts n limbs of b from a, which must be at least as large
+	inline void subtract_from(limbs& a, const std::uint32_t* b, std::size_t n) noexcept
+	{
+		std::uint64_t borrow = 0;
+		for(std::size_t i = 0; i < n || borrow; ++i)
+		{
+			const std::uint64_t difference = static_cast<std::uint64_t>(a[i]) - (i < n ? b[i] : 0) - borrow;
+			a[i] = static_cast<std::uint32_t>(difference);
+			borrow = difference >> 63;
+		}
+		trim(a);
+	}
+
+	inline limbs multiply_on_paper(const std::uint32_t* a, std::size_t n, const std::uint32_t* b, std::size_t m)
+	{
+		limbs result(n + m, 0);
+		for(std::size_t i = 0; i < n; ++i)
+		{
+			// At most (2^32 - 1)^2 + 2 (2^32 - 1), which still fits
+			std::uint64_t carry = 0;
+			for(std::size_t j = 0; j < m; ++j)
+			{
+				carry += static_cast<std::uint64_t>(a[i]) * b[j] + result[i + j];
+				result[i + j] = static_cast<std::uint32_t>(carry);
+				carry >>= 32;
+			}
+			result[i + m] = static_cast<std::uint32_t>(carry);
+		}
+		trim(result);
+		return result;
+	}
+
+	// Karatsuba's method splits both operands in halves, and needs three products of halves instead of four
+	inline limbs multiply(const std::uint32_t* a, std::size_t n, const std::uint32_t* b, std::size_t m)
+	{
+		if (n < m)
+			return multiply(b, m, a, n);
+		if (m < karatsuba_threshold)
+			return multiply_on_paper(a, n, b, m);
+
+		// An operand shorter than half the other one is multiplied by each of its halves
+		const std::size_t half = n / 2;
+		if (m <= half)
+		{
+			limbs result = multiply(a, half, b, m);
+			const limbs high = multiply(a + half, n - half, b, m);
+			add_to(result, high.data(), high.size(), half);
+			trim(result);
+			return result;
+		}
+
+		// With a = a1 B + a0 and b = b1 B + b0, a b = z2 B^2 + z1 B + z0, where z1 = (a0 + a1)(b0 + b1) - z2 - z0
+		const limbs z0 = multiply(a, half, b, half);
+		const limbs z2 = multiply(a + half, n - half, b + half, m - half);
+		limbs sum_a(a, a + half);
+		limbs sum_b(b, b + half);
+		add_to(sum_a, a + half, n - half, 0);
+		add_to(sum_b, b + half, m - half, 0);
+		trim(sum_a);
+		trim(sum_b);
+		limbs z1 = multiply(sum_a.data(), sum_a.size(), sum_b.data(), sum_b.size());
+		subtract_from(z1, z0.data(), z0.size());
+		subtract_from(z1, z2.data(), z2.size());
+
+		limbs result = z0;
+		add_to(result, z1.data(), z1.size(), half);
+		add_to(result, z2.data(), z2.size(), 2 * half);
+		trim(result);
+		return result;
+	}
+
+	// One limb more than x, shifted left by less than a limb
+	inline limbs shift_left(const limbs& x, unsigned shift)
+	{
+		limbs result(x.size() + 1, 0);
+		for(std::size_t i = 0; i < x.size(); ++i)
+		{
+			result[i] |= x[i] << shift;
+			if (shift)
+				result[i + 1] = x[i] >> (32 - shift);
+		}
+		return result;
+	}
+
+	// Long division, guessing each limb of the quotient from the top limbs left, as in Knuth's algorithm D
+	inline void divide(const limbs& a, const limbs& b, limbs& quotient, limbs& remainder)
+	{
+		if (compare(a, b) < 0)
+		{
+			quotient.clear();
+			remainder = a;
+			return;
+		}
+
+		if (b.size() == 1)
+		{
+			quotient.assign(a.size(), 0);
+			std::uint64_t rest = 0;
+			for(std::size_t i = a.size(); i-- > 0;)
+			{
+				rest = (rest << 32) | a[i];
+				quotient[i] = static_cast<std::uint32_t>(rest / b[0]);
+				rest %= b[0];
+			}
+			trim(quotient);
+			remainder = from(rest);
+			return;
+		}
+
+		// With the top bit of the divisor set, each guess is at most 2 too large, and checking the next limb fixes
+		// all but one in 2^32 of those
+		unsigned shift = 0;
+		while (!((b.back() << shift) & 0x80000000u))
+			++shift;
+		const limbs v = shift_left(b, shift);
+		limbs u = shift_left(a, shift);
+		const std::size_t n = b.size();
+		const std::size_t m = a.size() - n;
+
+		quotient.assign(m + 1, 0);
+		for(std::size_t j = m + 1; j-- > 0;)
+		{
+			const std::uint64_t top = (static_cast<std::uint64_t>(u[j + n]) << 32) | u[j + n - 1];
+			std::uint64_t guess = top / v[n - 1];
+			std::uint64_t rest = top % v[n - 1];
+			while (guess > 0xffffffffu || guess * v[n - 2] > ((rest << 32) | u[j + n - 2]))
+			{
+				--guess;
+				rest += v[n - 1];
+				if (rest > 0xffffffffu)
+					break;
+			}
+
+			std::uint64_t carry = 0;
+			std::int64_t borrow = 0;
+			for(std::size_t i = 0; i < n; ++i)
+			{
+				const std::uint64_t product = guess * v[i] + carry;
+				carry = product >> 32;
+				const std::int64_t difference = static_cast<std::int64_t>(u[i + j]) - borrow - static_cast<std::int64_t>(product & 0xffffffffu);
+				u[i + j] = static_cast<std::uint32_t>(difference);
+				borrow = difference < 0;
+			}
+			const std::int64_t difference = static_cast<std::int64_t>(u[j + n]) - borrow - static_cast<std::int64_t>(carry);
+			u[j + n] = static_cast<std::uint32_t>(difference);
+
+			// The guess was still one too large, so the divisor is added back
+			if (difference < 0)
+			{
+				--guess;
+				carry = 0;
+				for(std::size_t i = 0; i < n; ++i)
+				{
+					carry += static_cast<std::uint64_t>(u[i + j]) + v[i];
+					u[i + j] = static_cast<std::uint32_t>(carry);
+					carry >>= 32;
+				}
+				u[j + n] += static_cast<std::uint32_t>(carry);
+			}
+			quotient[j] = static_cast<std::uint32_t>(guess);
+		}
+		trim(quotient);
+
+		remainder.assign(n, 0);
+		for(std::size_t i = 0; i < n; ++i)
+			remainder[i] = (u[i] >> shift) | (shift ? u[i + 1] << (32 - shift) : 0);
+		trim(remainder);
+	}
+
+	// Integer of any size. Values that fit in a long long stay in it, without allocating anything, and only the
+	// others spill to limbs on the heap, which copies share since no operation changes them.
+	class bigint
+	{
+		long long small;
+		bool negative;
+		std::shared_ptr<const limbs> magnitude;
+
+		// Keeps the value in a long long if it fits, so that a value with limbs never fits
+		bigint(bool negative, limbs&& digits): small(0), negative(false), magnitude(nullptr)
+		{
+			trim(digits);
+			if (digits.size() <= 2)
+			{
+				const unsigned long long value = digits.empty() ? 0 : digits.size() == 1 ? digits[0] : (static_cast<unsigned long long>(digits[1]) << 32) | digits[0];
+				if (value <= static_cast<unsigned long long>(std::numeric_limits<long long>::max()) + (negative ? 1 : 0))
+				{
+					small = static_cast<long long>(negative ? 0 - value : value);
+					return;
+				}
+			}
+			this->negative = negative;
+			magnitude = std::make_shared<const limbs>(std::move(digits));
+		}
+
+		bool is_negative() const noexcept
+		{
+			return magnitude ? negative : small < 0;
+		}
+
+		limbs digits() const
+		{
+			if (magnitude)
+				return *magnitude;
+			return from(small < 0 ? 0 - static_cast<unsigned long long>(small) : static_cast<unsigned long long>(small));
+		}
+
+		// Low 64 bits of the magnitude
+		unsigned long long low() const noexcept
+		{
+			if (!magnitude)
+				return small < 0 ? 0 - static_cast<unsigned long long>(small) : static_cast<unsigned long long>(small);
+			return (magnitude->size() > 1 ? static_cast<unsigned long long>((*magnitude)[1]) << 32 : 0) | (*magnitude)[0];
+		}
+
+		static bigint add(bool negative_a, const limbs& a, bool negative_b, const limbs& b)
+		{
+			limbs result;
+			if (negative_a == negative_b)
+			{
+				result = a;
+				add_to(result, b.data(), b.size(), 0);
+				return bigint(negative_a, std::move(result));
+			}
+			if (compare(a, b) >= 0)
+			{
+				result = a;
+				subtract_from(result, b.data(), b.size());
+				return bigint(negative_a, std::move(result));
+			}
+			result = b;
+			subtract_from(result, a.data(), a.size());
+			return bigint(negative_b, std::move(result));
+		}
+
+		static int order(const bigint& a, const bigint& b) noexcept
+		{
+			if (!a.magnitude && !b.magnitude)
+				return a.small < b.small ? -1 : a.small > b.small;
+			if (a.is_negative() != b.is_negative())
+				return a.is_negative() ? -1 : 1;
+
+			// Values with limbs are larger than any that fits
+			const int larger = !a.magnitude ? -1 : !b.magnitude ? 1 : compare(*a.magnitude, *b.magnitude);
+			return a.is_negative() ? -larger : larger;
+		}
+
+	public:
+		bigint() noexcept: small(0), negative(false), magnitude(nullptr)
+		{ }
+
+		// Magnitude given as 32-bit limbs, least significant first, for literals larger than any integer
+		static bigint of_limbs(limbs digits)
+		{
+			return bigint(false, std::move(digits));
+		}
+
+		template<typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
+		bigint(T value): small(0), negative(false), magnitude(nullptr)
+		{
+			if constexpr (std::is_unsigned_v<T> && sizeof(T) >= sizeof(long long))
+				*this = bigint(false, from(value));
+			else
+				small = static_cast<long long>(value);
+		}
+
+		// Drops the fractional part, like converting to an integer does
+		template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+		explicit bigint(T value): small(0), negative(false), magnitude(nullptr)
+		{
+			if (!std::isfinite(value))
+				throw std::domain_error("Conversion of a number that is not finite to bigint");
+
+			const double whole = std::trunc(static_cast<double>(value));
+			if (whole >= -9223372036854775808.0 && whole < 9223372036854775808.0)
+			{
+				small = static_cast<long long>(whole);
+				return;
+			}
+			limbs digits;
+			for(double rest = std::fabs(whole); rest >= 1; rest = std::floor(rest / 4294967296.0))
+				digits.push_back(static_cast<std::uint32_t>(std::fmod(rest, 4294967296.0)));
+			*this = bigint(whole < 0, std::move(digits));
+		}
+
+		// Converting to a C++ integer keeps the low bits, like converting to a smaller integer type does
+		template<typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+		explicit operator T() const noexcept
+		{
+			if constexpr (std::is_same_v<T, bool>)
+				return magnitude || small;
+			else if constexpr (std::is_floating_point_v<T>)
+			{
+				if (!magnitude)
+					return static_cast<T>(small);
+				double result = 0;
+				for(std::size_t i = magnitude->size(); i-- > 0;)
+					result = result * 4294967296.0 + (*magnitude)[i];
+				return static_cast<T>(negative ? -result : result);
+			}
+			else
+				return static_cast<T>(is_negative() ? 0 - low() : low());
+		}
+
+		// Whether the value fits in an integer type, which it is then converted to
+		template<typename T>
+		bool fits(T& result) const noexcept
+		{
+			if (!magnitude)
+			{
+				if (small < 0 ? !std::is_signed_v<T> || small < static_cast<long long>(std::numeric_limits<T>::min()) : static_cast<unsigned long long>(small) > static_cast<unsigned long long>(std::numeric_limits<T>::max()))
+					return false;
+				result = static_cast<T>(small);
+				return true;
+			}
+
+			// Only the largest unsigned types hold values that a long long does not
+			if (negative || magnitude->size() > 2 || !std::is_unsigned_v<T> || sizeof(T) < sizeof(long long))
+				return false;
+			result = static_cast<T>(low());
+			return true;
+		}
+
+		std::string to_string() const
+		{
+			if (!magnitude)
+				return std::to_string(small);
+
+			// Nine decimal digits at a time, least significant first
+			limbs rest = *magnitude;
+			std::string digits;
+			while (!rest.empty())
+			{
+				std::uint64_t chunk = 0;
+				for(std::size_t i = rest.size(); i-- > 0;)
+				{
+					chunk = (chunk << 32) | rest[i];
+					rest[i] = static_cast<std::uint32_t>(chunk / 1000000000u);
+					chunk %= 1000000000u;
+				}
+				trim(rest);
+				for(int i = 0; i < 9; ++i, chunk /= 10)
+					digits.push_back(static_cast<char>('0' + chunk % 10));
+			}
+			while (digits.back() == '0')
+				digits.pop_back();
+			if (negative)
+				digits.push_back('-');
+			return std::string(digits.rbegin(), digits.rend());
+		}
+
+		friend bigint operator+(const bigint& a, const bigint& b)
+		{
+			long long result;
+			if (!a.magnitude && !b.magnitude && !add_overflow(a.small, b.small, result))
+				return bigint(result);
+			return add(a.is_negative(), a.digits(), b.is_negative(), b.digits());
+		}
+
+		friend bigint operator-(const bigint& a, const bigint& b)
+		{
+			long long result;
+			if (!a.magnitude && !b.magnitude && !sub_overflow(a.small, b.small, result))
+				return bigint(result);
+			return add(a.is_negative(), a.digits(), !b.is_negative(), b.digits());
+		}
+
+		friend bigint operator*(const bigint& a, const bigint& b)
+		{
+			long long result;
+			if (!a.magnitude && !b.magnitude && !mul_overflow(a.small, b.small, result))
+				return bigint(result);
+			const limbs x = a.digits();
+			const limbs y = b.digits();
+			return bigint(a.is_negative() != b.is_negative(), multiply(x.data(), x.size(), y.data(), y.size()));
+		}
+
+		// Rounds towards zero, like dividing integers does
+		friend bigint operator/(const bigint& a, const bigint& b)
+		{
+			if (!b.magnitude && !b.small)
+				throw std::domain_error("Division by zero");
+			if (!a.magnitude && !b.magnitude && (a.small != std::numeric_limits<long long>::min() || b.small != -1))
+				return bigint(a.small / b.small);
+
+			limbs quotient, remainder;
+			divide(a.digits(), b.digits(), quotient, remainder);
+			return bigint(a.is_negative() != b.is_negative(), std::move(quotient));
+		}
+
+		// Has the sign of the dividend, like the remainder of integers does
+		friend bigint operator%(const bigint& a, const bigint& b)
+		{
+			if (!b.magnitude && !b.small)
+				throw std::domain_error("Division by zero");
+			if (!a.magnitude && !b.magnitude)
+				return bigint(b.small == -1 ? 0 : a.small % b.small);
+
+			limbs quotient, remainder;
+			divide(a.digits(), b.digits(), quotient, remainder);
+			return bigint(a.is_negative(), std::move(remainder));
+		}
+
+		friend bigint operator-(const bigint& a)
+		{
+			if (!a.magnitude && a.small != std::numeric_limits<long long>::min())
+				return bigint(-a.small);
+			return bigint(!a.is_negative(), a.digits());
+		}
+
+		friend bigint operator+(const bigint& a)
+		{
+			return a;
+		}
+
+		friend bool operator==(const bigint& a, const bigint& b) noexcept
+		{
+			return order(a, b) == 0;
+		}
+
+		friend bool operator!=(const bigint& a, const bigint& b) noexcept
+		{
+			return order(a, b) != 0;
+		}
+
+		friend bool operator<(const bigint& a, const bigint& b) noexcept
+		{
+			return order(a, b) < 0;
+		}
+
+		friend bool operator>(const bigint& a, const bigint& b) noexcept
+		{
+			return order(a, b) > 0;
+		}
+
+		friend bool operator<=(const bigint& a, const bigint& b) noexcept
+		{
+			return order(a, b) <= 0;
+		}
+
+		friend bool operator>=(const bigint& a, const bigint& b) noexcept
+		{
+			return order(a, b) >= 0;
+		}
+	};
+}
+
+typedef pebkac_big::bigint bigint;
+
+void print(const bigint& n)
+{
+	std::cout << n.to_string() << std::endl;
+}
+
+namespace pebkac_int
+{
+	// Unlike converting to integer, converting to a fixed-width type checks the whole value
+	template<typename T>
+	T convert(const pebkac_big::bigint& value)
+	{
+		T result;
+		if (!value.fits(result))
+			throw std::range_error("Integer conversion out of range");
+		return result;
+	}
+}
+
+)";
+}
+
+
+std::string runtime::get_floating_point()
+{
+	return R"(#include <cmath>
+#include <type_traits>
+
+template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+void print(T n)
+{
+	std::cout << n << std::endl;
+}
+
+namespace pebkac_float
+{
+	template<typename T>
+	constexpr T remainder(T a, T b)
+	{
+		// Constant evaluation cannot call std::fmod, so it divides like on paper instead. Each step subtracts the
+		// largest power of two times b that fits, which is exact, since it is at least half of what it is taken from.
+		if (__builtin_is_constant_evaluated() && a - a == 0 && b == b && b != 0)
+		{
+			const T divisor = b < 0 ? -b : b;
+			T result = a < 0 ? -a : a;
+			while (result >= divisor)
+			{
+				T multiple = divisor;
+				while (multiple <= result - multiple)
+					multiple += multiple;
+				result -= multiple;
+			}
+			return a < 0 ? -result : result;
+		}
+		return std::fmod(a, b);
+	}
+
+	// The % of C++ for integers and bigints, and the remainder of std::fmod for anything else
+	template<typename A, typename B>
+	constexpr auto fmod(A a, B b)
+	{
+		if constexpr (!std::is_floating_point_v<A> && !std::is_floating_point_v<B>)
+			return a % b;
+		else
+			return remainder<std::common_type_t<A, B>>(a, b);
+	}
+}
+
+)";
+}
+
+
+std::string runtime::get_fast_math()
+{
+	return R"(#if defined(__clang__)
+#pragma clang fp reassociate(on) contract(fast)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fast-math")
+#elif defined(_MSC_VER)
+#pragma float_control(precise, off)
+#pragma fp_contract(on)
+#endif
+
+)";
+}
+
+
+std::string runtime::get_regions()
+{
+	return R"(#include <new>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+
+namespace pebkac_region
+{
+	// Memory of a region comes in chunks, which go back to a per-thread pool when it ends, so that regions entered
+	// over and over only allocate from the system once
+	struct chunk
+	{
+		chunk* next;
+		std::size_t capacity;
+	};
+
+	constexpr std::size_t header = (sizeof(chunk) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+	constexpr std::size_t chunk_size = 64 * 1024;
+	constexpr std::size_t pooled_chunks = 16;
+
+	class pool
+	{
+		chunk* free;
+		std::size_t count;
+
+	public:
+		pool() noexcept: free(nullptr), count(0)
+		{ }
+
+		~pool()
+		{
+			while (free)
+			{
+				chunk* next = free->next;
+				::operator delete(free);
+				free = next;
+			}
+		}
+
+		chunk* take(std::size_t capacity)
+		{
+			if (capacity <= chunk_size && free)
+			{
+				chunk* result = free;
+				free = free->next;
+				--count;
+				return result;
+			}
+
+			chunk* result = static_cast<chunk*>(::operator new(header + std::max(capacity, chunk_size)));
+			result->capacity = std::max(capacity, chunk_size);
+			return result;
+		}
+
+		// Larger chunks, for a single large allocation, go straight back to the system
+		void give(chunk* c) noexcept
+		{
+			if (c->capacity == chunk_size && count < pooled_chunks)
+			{
+				c->next = free;
+				free = c;
+				++count;
+			}
+			else
+				::operator delete(c);
+		}
+	};
+
+	inline pool& chunks()
+	{
+		static thread_local pool instance;
+		return instance;
+	}
+
+	// Bump allocator, which frees everything at once when destroyed, without running any destructor
+	class arena
+	{
+		chunk* used;
+		char* top;
+		char* end;
+
+	public:
+		arena() noexcept: used(nullptr), top(nullptr), end(nullptr)
+		{ }
+
+		arena(const arena&) = delete;
+		arena& operator=(const arena&) = delete;
+
+		~arena()
+		{
+			while (used)
+			{
+				chunk* next = used->next;
+				chunks().give(used);
+				used = next;
+			}
+		}
+
+		void* allocate(std::size_t size, std::size_t alignment)
+		{
+			std::uintptr_t address = (reinterpret_cast<std::uintptr_t>(top) + alignment - 1) & ~(alignment - 1);
+			if (!used || address + size > reinterpret_cast<std::uintptr_t>(end))
+			{
+				chunk* c = chunks().take(size + alignment);
+				c->next = used;
+				used = c;
+				top = reinterpret_cast<char*>(c) + header;
+				end = top + c->capacity;
+				address = (reinterpret_cast<std::uintptr_t>(top) + alignment - 1) & ~(alignment - 1);
+			}
+			top = reinterpret_cast<char*>(address + size);
+			return reinterpret_cast<void*>(address);
+		}
+	};
+
+	// Region the thread allocates from, or null to use the heap
+	inline arena*& current() noexcept
+	{
+		static thread_local arena* region = nullptr;
+		return region;
+	}
+
+	// Region of a function call, entered for the rest of the call and freed when it returns
+	class scope
+	{
+		arena memory;
+		arena* outer;
+
+	public:
+		scope() noexcept: memory(), outer(current())
+		{
+			current() = &memory;
+		}
+
+		scope(const scope&) = delete;
+		scope& operator=(const scope&) = delete;
+
+		~scope()
+		{
+			current() = outer;
+		}
+	};
+
+	// Allocates from the heap until destroyed, for values that may outlive the current region
+	class suspend
+	{
+		arena* outer;
+
+	public:
+		suspend() noexcept: outer(current())
+		{
+			current() = nullptr;
+		}
+
+		suspend(const suspend&) = delete;
+		suspend& operator=(const suspend&) = delete;
+
+		~suspend()
+		{
+			current() = outer;
+		}
+	};
+
+	// Default-initialized elements from the current region, or null outside of any. Regions never destroy them, so
+	// they must not need it.
+	template<typename T>
+	T* allocate(std::size_t count)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "Elements allocated from a region are never destroyed");
+		arena* region = current();
+		if (!region)
+			return nullptr;
+		T* result = static_cast<T*>(region->allocate(sizeof(T) * count, alignof(T)));
+		std::uninitialized_default_construct_n(result, count);
+		return result;
+	}
+}
+
+)";
+}
+
+
+std::string runtime::get_arrays()
+{
+	return R"(#include <tuple>
+#include <memory>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace pebkac_array
+{
+	// Numeric literals are int, and are stored as integer like everywhere else
+	template<typename T>
+	struct element
+	{
+		typedef std::decay_t<T> type;
+	};
+
+	template<>
+	struct element<int>
+	{
+		typedef long long type;
+	};
+
+	template<typename T>
+	using element_t = typename element<std::decay_t<T>>::type;
+
+	// Given the fields a record lists, gives the type of an array of each
+	struct column_types
+	{
+		template<typename T, typename... F>
+		std::tuple<std::shared_ptr<F[]>...> operator()(F T::*...) const
+		{
+			return { };
+		}
+	};
+
+	// Records compiled with --soa-records list their fields, to be stored one array per field
+	template<typename T, typename = void>
+	struct is_columnar: std::false_type
+	{ };
+
+	template<typename T>
+	struct is_columnar<T, std::void_t<decltype(T::pebkac_fields(column_types()))>>: std::true_type
+	{ };
+
+	template<typename T>
+	constexpr bool is_columnar_v = is_columnar<T>::value;
+
+	// Elements that need no destructor come from the current region if there is one, shared without counting
+	// references, as the region outlives every copy
+	template<typename T>
+	std::shared_ptr<T> allocate(std::size_t count)
+	{
+		if constexpr (std::is_trivially_destructible_v<T>)
+		{
+			if (T* elements = pebkac_region::allocate<T>(count))
+				return std::shared_ptr<T>(std::shared_ptr<T>(), elements);
+		}
+		return std::shared_ptr<T>(new T[count], std::default_delete<T[]>());
+	}
+
+	// Contiguous immutable elements, shared by every copy
+	template<typename T, bool = is_columnar_v<T>>
+	class array
+	{
+		std::shared_ptr<T> storage;
+		std::size_t count;
+
+	public:
+		array() noexcept: storage(nullptr), count(0)
+		{ }
+
+		// Scalar elements are left uninitialized, for whoever creates the array to write them
+		explicit array(std::size_t count): storage(count ? pebkac_array::allocate<T>(count) : nullptr), count(count)
+		{ }
+
+		// Converts every element, like when an array of int is given where an array of integer is expected
+		template<typename U, std::enable_if_t<!std::is_same_v<U, T> && std::is_convertible_v<const U&, T>, int> = 0>
+		array(const array<U>& other): array(other.size())
+		{
+			std::copy(other.data(), other.data() + other.size(), data());
+		}
+
+		T* data() const noexcept
+		{
+			return storage.get();
+		}
+
+		std::size_t size() const noexcept
+		{
+			return count;
+		}
+
+		const T& operator[](std::size_t i) const noexcept
+		{
+			return storage.get()[i];
+		}
+
+		// Writes an element, for whoever creates the array
+		void set(std::size_t i, const T& value) const
+		{
+			storage.get()[i] = value;
+		}
+
+		// Forgets the elements past the first ones, without moving anything
+		void truncate(std::size_t count) noexcept
+		{
+			this->count = count;
+		}
+	};
+
+	// Records stored one array per field, shared by every copy. Elements are gathered from every field when read, and
+	// the compiler drops the loads of the fields nothing uses, so loops over some fields only go through those.
+	template<typename T>
+	class array<T, true>
+	{
+		typedef decltype(T::pebkac_fields(column_types())) columns;
+		columns storage;
+		std::size_t count;
+
+		template<typename F>
+		static void allocate(std::shared_ptr<F[]>& column, std::size_t count)
+		{
+			if constexpr (std::is_trivially_destructible_v<F>)
+			{
+				if (F* elements = pebkac_region::allocate<F>(count))
+				{
+					column = std::shared_ptr<F[]>(std::shared_ptr<F[]>(), elements);
+					return;
+				}
+			}
+			column.reset(new F[count]);
+		}
+
+	public:
+		array() noexcept: storage(), count(0)
+		{ }
+
+		explicit array(std::size_t count): storage(), count(count)
+		{
+			if (count)
+				std::apply([count](auto&... column){ (allocate(column, count), ...); }, storage);
+		}
+
+		std::size_t size() const noexcept
+		{
+			return count;
+		}
+
+		T operator[](std::size_t i) const
+		{
+			return std::apply([i](const auto&... column){ return T(column[i]...); }, storage);
+		}
+
+		void set(std::size_t i, const T& value) const
+		{
+			T::pebkac_fields([&](auto... members){
+				std::apply([&](const auto&... column){ ((column[i] = value.*members), ...); }, storage);
+			});
+		}
+
+		void truncate(std::size_t count) noexcept
+		{
+			this->count = count;
+		}
+	};
+
+	// The empty literal, which becomes whatever array it is given to
+	struct empty
+	{
+		template<typename T>
+		operator array<T>() const noexcept
+		{
+			return array<T>();
+		}
+	};
+
+	inline empty of() noexcept
+	{
+		return empty();
+	}
+
+	template<typename... T>
+	auto of(const T&... values)
+	{
+		typedef element_t<std::common_type_t<T...>> E;
+		array<E> result(sizeof...(T));
+		if constexpr (is_columnar_v<E>)
+		{
+			std::size_t i = 0;
+			(result.set(i++, static_cast<E>(values)), ...);
+		}
+		else
+		{
+			E* out = result.data();
+			((*out++ = static_cast<E>(values)), ...);
+		}
+		return result;
+	}
+
+	// Smallest or largest of the elements and the initial value, which folds with min and max become
+	template<bool largest, typename T>
+	long long extreme(const array<T>& xs, long long initial)
+	{
+		const std::size_t n = xs.size();
+		std::size_t i = 0;
+	#if defined(__AVX2__) || defined(__SSE4_2__)
+		if constexpr (std::is_same_v<T, long long>)
+		{
+			const long long* in = xs.data();
+		#if defined(__AVX2__)
+			__m256i m = _mm256_set1_epi64x(initial);
+			for(; i + 4 <= n; i += 4)
+			{
+				const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+				m = _mm256_blendv_epi8(m, v, largest ? _mm256_cmpgt_epi64(v, m) : _mm256_cmpgt_epi64(m, v));
+			}
+			alignas(32) long long lanes[4];
+			_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), m);
+		#else
+			__m128i m = _mm_set1_epi64x(initial);
+			for(; i + 2 <= n; i += 2)
+			{
+				const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+				m = _mm_blendv_epi8(m, v, largest ? _mm_cmpgt_epi64(v, m) : _mm_cmpgt_epi64(m, v));
+			}
+			alignas(16) long long lanes[2];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), m);
+		#endif
+			for(const long long lane : lanes)
+				initial = largest ? std::max(initial, lane) : std::min(initial, lane);
+		}
+	#endif
+		for(; i < n; ++i)
+			initial = largest ? std::max(initial, static_cast<long long>(xs[i])) : std::min(initial, static_cast<long long>(xs[i]));
+		return initial;
+	}
+
+	template<typename T>
+	long long minimum(const array<T>& xs, long long initial)
+	{
+		return extreme<false>(xs, initial);
+	}
+
+	template<typename T>
+	long long maximum(const array<T>& xs, long long initial)
+	{
+		return extreme<true>(xs, initial);
+	}
+
+	// Sum of the elements and the initial value, which folds with + become
+	template<typename T>
+	long long sum(const array<T>& xs, long long initial)
+	{
+		const std::size_t n = xs.size();
+		std::size_t i = 0;
+	#if defined(__x86_64__) || defined(_M_X64)
+		if constexpr (std::is_same_v<T, long long>)
+		{
+			// Two accumulators, so each addition does not wait for the previous one
+			const long long* in = xs.data();
+		#if defined(__AVX2__)
+			__m256i a = _mm256_setzero_si256();
+			__m256i b = _mm256_setzero_si256();
+			for(; i + 8 <= n; i += 8)
+			{
+				a = _mm256_add_epi64(a, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)));
+				b = _mm256_add_epi64(b, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 4)));
+			}
+			a = _mm256_add_epi64(a, b);
+			const __m128i c = _mm_add_epi64(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+		#else
+			__m128i a = _mm_setzero_si128();
+			__m128i b = _mm_setzero_si128();
+			for(; i + 4 <= n; i += 4)
+			{
+				a = _mm_add_epi64(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+				b = _mm_add_epi64(b, _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 2)));
+			}
+			const __m128i c = _mm_add_epi64(a, b);
+		#endif
+			initial += _mm_cvtsi128_si64(c) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(c, c));
+		}
+	#endif
+		for(; i < n; ++i)
+			initial += static_cast<long long>(xs[i]);
+		return initial;
+	}
+
+	// Sum of the elements and the initial value, which folds adding floating-point numbers become with --fast-math.
+	// Eight partial sums take every eighth element, so they vectorize without the compiler reordering anything.
+	template<typename T, typename A>
+	A reassociated_sum(const array<T>& xs, A initial)
+	{
+		const std::size_t n = xs.size();
+		const T* in = xs.data();
+		A partial[8] = { };
+		std::size_t i = 0;
+		for(; i + 8 <= n; i += 8)
+		{
+			for(std::size_t j = 0; j < 8; ++j)
+				partial[j] += static_cast<A>(in[i + j]);
+		}
+
+		for(const A p : partial)
+			initial += p;
+		for(; i < n; ++i)
+			initial += static_cast<A>(in[i]);
+		return initial;
+	}
+}
+
+template<typename T>
+long long length(const pebkac_array::array<T>& xs) noexcept
+{
+	return static_cast<long long>(xs.size());
+}
+
+inline pebkac_array::array<long long> range(long long begin, long long end)
+{
+	pebkac_array::array<long long> result(end > begin ? static_cast<std::size_t>(end - begin) : 0);
+	long long* out = result.data();
+	for(std::size_t i = 0, n = result.size(); i < n; ++i)
+		out[i] = begin + static_cast<long long>(i);
+	return result;
+}
+
+// The loops below read and write separate buffers, and call the function directly, so that compilers can vectorize them.
+// Arrays stored by field are read and written an element at a time, which still only touches the fields used.
+template<typename T, typename F>
+auto map(const pebkac_array::array<T>& xs, const F& f)
+{
+	typedef pebkac_array::element_t<decltype(f(std::declval<const T&>()))> R;
+	pebkac_array::array<R> result(xs.size());
+	if constexpr (pebkac_array::is_columnar_v<T> || pebkac_array::is_columnar_v<R>)
+	{
+		for(std::size_t i = 0, n = xs.size(); i < n; ++i)
+			result.set(i, f(xs[i]));
+	}
+	else
+	{
+		const T* in = xs.data();
+		R* __restrict out = result.data();
+		for(std::size_t i = 0, n = xs.size(); i < n; ++i)
+			out[i] = f(in[i]);
+	}
+	return result;
+}
+
+template<typename T, typename U, typename F>
+auto zip(const pebkac_array::array<T>& xs, const pebkac_array::array<U>& ys, const F& f)
+{
+	typedef pebkac_array::element_t<decltype(f(std::declval<const T&>(), std::declval<const U&>()))> R;
+	pebkac_array::array<R> result(std::min(xs.size(), ys.size()));
+	if constexpr (pebkac_array::is_columnar_v<T> || pebkac_array::is_columnar_v<U> || pebkac_array::is_columnar_v<R>)
+	{
+		for(std::size_t i = 0, n = result.size(); i < n; ++i)
+			result.set(i, f(xs[i], ys[i]));
+	}
+	else
+	{
+		const T* a = xs.data();
+		const U* b = ys.data();
+		R* __restrict out = result.data();
+		for(std::size_t i = 0, n = result.size(); i < n; ++i)
+			out[i] = f(a[i], b[i]);
+	}
+	return result;
+}
+
+template<typename T, typename F>
+pebkac_array::array<T> filter(const pebkac_array::array<T>& xs, const F& f)
+{
+	pebkac_array::array<T> result(xs.size());
+	std::size_t count = 0;
+	if constexpr (pebkac_array::is_columnar_v<T>)
+	{
+		for(std::size_t i = 0, n = xs.size(); i < n; ++i)
+		{
+			const T x = xs[i];
+			result.set(count, x);
+			count += f(x) ? 1 : 0;
+		}
+	}
+	else
+	{
+		const T* in = xs.data();
+		T* __restrict out = result.data();
+		for(std::size_t i = 0, n = xs.size(); i < n; ++i)
+		{
+			// Copying every element, and only counting those kept, avoids a branch per element
+			if constexpr (std::is_trivially_copyable_v<T>)
+			{
+				out[count] = in[i];
+				count += f(in[i]) ? 1 : 0;
+			}
+			else if (f(in[i]))
+				out[count++] = in[i];
+		}
+	}
+	result.truncate(count);
+	return result;
+}
+
+template<typename T, typename A, typename F>
+auto fold(const pebkac_array::array<T>& xs, const A& initial, const F& f)
+{
+	typedef pebkac_array::element_t<decltype(f(initial, std::declval<const T&>()))> R;
+	R result = initial;
+	if constexpr (pebkac_array::is_columnar_v<T>)
+	{
+		for(std::size_t i = 0, n = xs.size(); i < n; ++i)
+			result = f(result, xs[i]);
+	}
+	else
+	{
+		const T* in = xs.data();
+		for(std::size_t i = 0, n = xs.size(); i < n; ++i)
+			result = f(result, in[i]);
+	}
+	return result;
+}
+
+)";
+}
+
+
+std::string runtime::get_persistent()
+{
+	return R"(#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <functional>
+
+namespace pebkac_persistent
+{
+	// Nodes have up to 32 entries or children, indexed by 5 bits of a hash or an index at a time
+	constexpr unsigned bits = 5;
+	constexpr unsigned width = 1u << bits;
+	constexpr unsigned mask = width - 1;
+
+	// Every transient gets a token no other one ever gets, and marks the nodes it creates with it. It changes those in
+	// place and copies the others, so nodes shared with a persistent collection never change. Nodes of persistent
+	// collections have the token 0, and once a transient is made persistent, nothing uses its token anymore.
+	inline std::uint64_t next_token() noexcept
+	{
+		static std::atomic<std::uint64_t> last(0);
+		return last.fetch_add(1, std::memory_order_relaxed) + 1;
+	}
+
+	template<typename N>
+	std::shared_ptr<N> editable(const std::shared_ptr<N>& n, std::uint64_t token)
+	{
+		if (token && n->token == token)
+			return n;
+		auto copy = std::make_shared<N>(*n);
+		copy->token = token;
+		return copy;
+	}
+
+	inline unsigned popcount(std::uint32_t x) noexcept
+	{
+	#if defined(__GNUC__)
+		return static_cast<unsigned>(__builtin_popcount(x));
+	#else
+		x = x - ((x >> 1) & 0x55555555u);
+		x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+		return (((x + (x >> 4)) & 0x0f0f0f0fu) * 0x01010101u) >> 24;
+	#endif
+	}
+
+	// Hash array mapped trie node. Entries and children are ordered by the 5 bits of their hash that select their bit
+	// in datamap or nodemap. Past the 64 bits of the hash, a node holds every entry whose hash collides, unordered.
+	template<typename K, typename V>
+	struct hamt_node
+	{
+		std::uint64_t token = 0;
+		std::uint32_t datamap = 0;
+		std::uint32_t nodemap = 0;
+		std::vector<std::pair<K, V>> entries;
+		std::vector<std::shared_ptr<hamt_node>> children;
+	};
+
+	// Immutable hash map, whose updates copy the path to one entry and share everything else
+	template<typename K, typename V>
+	class map
+	{
+		typedef hamt_node<K, V> node;
+
+		std::shared_ptr<node> root;
+		std::size_t count;
+
+		map(const std::shared_ptr<node>& root, std::size_t count) noexcept: root(root), count(count)
+		{ }
+
+		// std::hash of integers is the identity, mixing it spreads keys differing only in their high bits
+		static std::uint64_t hash(const K& key) noexcept
+		{
+			std::uint64_t h = static_cast<std::uint64_t>(std::hash<K>()(key));
+			h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdull;
+			h = (h ^ (h >> 33)) * 0xc4ceb9fe1a85ec53ull;
+			return h ^ (h >> 33);
+		}
+
+		static unsigned index(std::uint32_t bitmap, std::uint32_t bit) noexcept
+		{
+			return popcount(bitmap & (bit - 1));
+		}
+
+		static const V* lookup(const node* n, std::uint64_t h, const K& key)
+		{
+			for(unsigned shift = 0; n; shift += bits)
+			{
+				if (shift >= 64)
+				{
+					for(const auto& entry : n->entries)
+					{
+						if (entry.first == key)
+							return &entry.second;
+					}
+					return nullptr;
+				}
+
+				const std::uint32_t bit = 1u << ((h >> shift) & mask);
+				if (n->datamap & bit)
+				{
+					const auto& entry = n->entries[index(n->datamap, bit)];
+					return entry.first == key ? &entry.second : nullptr;
+				}
+				n = n->nodemap & bit ? n->children[index(n->nodemap, bit)].get() : nullptr;
+			}
+			return nullptr;
+		}
+
+		// Node holding two entries whose hashes agree below the shift
+		static std::shared_ptr<node> split(const std::pair<K, V>& a, std::uint64_t ha, const std::pair<K, V>& b, std::uint64_t hb, unsigned shift, std::uint64_t token)
+		{
+			auto result = std::make_shared<node>();
+			result->token = token;
+			if (shift >= 64)
+			{
+				result->entries = {a, b};
+				return result;
+			}
+
+			const unsigned da = (ha >> shift) & mask;
+			const unsigned db = (hb >> shift) & mask;
+			if (da == db)
+			{
+				result->nodemap = 1u << da;
+				result->children.push_back(split(a, ha, b, hb, shift + bits, token));
+			}
+			else
+			{
+				result->datamap = (1u << da) | (1u << db);
+				result->entries = da < db ? std::vector<std::pair<K, V>>{a, b} : std::vector<std::pair<K, V>>{b, a};
+			}
+			return result;
+		}
+
+		static std::shared_ptr<node> insert(const std::shared_ptr<node>& n, std::uint64_t h, unsigned shift, const K& key, const V& value, std::uint64_t token, bool& added)
+		{
+			if (shift >= 64)
+			{
+				auto result = editable(n, token);
+				for(auto& entry : result->entries)
+				{
+					if (entry.first == key)
+					{
+						entry.second = value;
+						return result;
+					}
+				}
+				result->entries.emplace_back(key, value);
+				added = true;
+				return result;
+			}
+
+			const std::uint32_t bit = 1u << ((h >> shift) & mask);
+			if (n->datamap & bit)
+			{
+				const unsigned i = index(n->datamap, bit);
+				auto result = editable(n, token);
+				if (n->entries[i].first == key)
+				{
+					result->entries[i].second = value;
+					return result;
+				}
+
+				// Another key with the same bits so far, both go down to a new node
+				const auto other = result->entries[i];
+				result->entries.erase(result->entries.begin() + i);
+				result->datamap ^= bit;
+				result->nodemap |= bit;
+				result->children.insert(result->children.begin() + index(result->nodemap, bit), split(other, hash(other.first), {key, value}, h, shift + bits, token));
+				added = true;
+				return result;
+			}
+			else if (n->nodemap & bit)
+			{
+				const unsigned i = index(n->nodemap, bit);
+				auto child = insert(n->children[i], h, shift + bits, key, value, token, added);
+				if (child == n->children[i])
+					return n;
+				auto result = editable(n, token);
+				result->children[i] = std::move(child);
+				return result;
+			}
+
+			auto result = editable(n, token);
+			result->entries.insert(result->entries.begin() + index(n->datamap, bit), {key, value});
+			result->datamap |= bit;
+			added = true;
+			return result;
+		}
+
+		static std::shared_ptr<node> erase(const std::shared_ptr<node>& n, std::uint64_t h, unsigned shift, const K& key, std::uint64_t token, bool& removed)
+		{
+			if (shift >= 64)
+			{
+				for(std::size_t i = 0; i < n->entries.size(); ++i)
+				{
+					if (n->entries[i].first == key)
+					{
+						auto result = editable(n, token);
+						result->entries.erase(result->entries.begin() + i);
+						removed = true;
+						return result;
+					}
+				}
+				return n;
+			}
+
+			const std::uint32_t bit = 1u << ((h >> shift) & mask);
+			if (n->datamap & bit)
+			{
+				const unsigned i = index(n->datamap, bit);
+				if (!(n->entries[i].first == key))
+					return n;
+				auto result = editable(n, token);
+				result->entries.erase(result->entries.begin() + i);
+				result->datamap ^= bit;
+				removed = true;
+				return result;
+			}
+			else if (n->nodemap & bit)
+			{
+				const unsigned i = index(n->nodemap, bit);
+				auto child = erase(n->children[i], h, shift + bits, key, token, removed);
+				if (!removed)
+					return n;
+
+				// A child left with a single entry gives it back, so the same keys always make the same trie
+				auto result = editable(n, token);
+				if (child->children.empty() && child->entries.size() <= 1)
+				{
+					result->children.erase(result->children.begin() + i);
+					result->nodemap ^= bit;
+					if (!child->entries.empty())
+					{
+						result->datamap |= bit;
+						result->entries.insert(result->entries.begin() + index(result->datamap, bit), child->entries.front());
+					}
+				}
+				else
+					result->children[i] = std::move(child);
+				return result;
+			}
+			return n;
+		}
+
+		template<typename F>
+		static void for_each(const node& n, const F& f)
+		{
+			for(const auto& entry : n.entries)
+				f(entry.first, entry.second);
+			for(const auto& child : n.children)
+				for_each(*child, f);
+		}
+
+	public:
+		typedef K key_type;
+		typedef V mapped_type;
+
+		map() noexcept: root(nullptr), count(0)
+		{ }
+
+		// The empty array literal also stands for the empty map
+		map(pebkac_array::empty) noexcept: map()
+		{ }
+
+		std::size_t size() const noexcept
+		{
+			return count;
+		}
+
+		// The value of a key, or null if the map does not have it
+		const V* find(const K& key) const
+		{
+			return lookup(root.get(), hash(key), key);
+		}
+
+		map set(const K& key, const V& value) const
+		{
+			bool added = false;
+			auto result = insert(root ? root : std::make_shared<node>(), hash(key), 0, key, value, 0, added);
+			return map(result, count + (added ? 1 : 0));
+		}
+
+		map erase(const K& key) const
+		{
+			bool removed = false;
+			auto result = root ? erase(root, hash(key), 0, key, 0, removed) : root;
+			return removed ? map(result, count - 1) : *this;
+		}
+
+		// Calls f(key, value) for every entry, in no particular order
+		template<typename F>
+		void for_each(const F& f) const
+		{
+			if (root)
+				for_each(*root, f);
+		}
+
+		// Map changing in place, for batches of updates that only need the result. It shares nothing with the maps
+		// made from it until it is made persistent.
+		class transient
+		{
+			std::shared_ptr<node> root;
+			std::size_t count;
+			std::uint64_t token;
+
+		public:
+			explicit transient(const map& m): root(m.root), count(m.count), token(next_token())
+			{ }
+
+			void set(const K& key, const V& value)
+			{
+				bool added = false;
+				root = insert(root ? root : std::make_shared<node>(), hash(key), 0, key, value, token, added);
+				count += added ? 1 : 0;
+			}
+
+			void erase(const K& key)
+			{
+				bool removed = false;
+				if (root)
+					root = map::erase(root, hash(key), 0, key, token, removed);
+				count -= removed ? 1 : 0;
+			}
+
+			// Gives up the token, so nothing changes the nodes anymore
+			map persistent() noexcept
+			{
+				token = next_token();
+				return map(root, count);
+			}
+		};
+	};
+
+	// Relaxed radix balanced tree node. Leaves hold up to 32 elements, and inner nodes up to 32 children. Children of
+	// a balanced node are all full but the last, so an index gives the child by its bits. Concatenation leaves nodes
+	// that are not full in the middle, whose parents are relaxed, and keep the number of elements up to each child.
+	template<typename T>
+	struct rrb_node
+	{
+		std::uint64_t token = 0;
+		std::vector<T> elements;
+		std::vector<std::shared_ptr<rrb_node>> children;
+		std::vector<std::size_t> sizes;
+	};
+
+	// Immutable vector, whose updates copy the path to one element, and whose concatenation copies the nodes along
+	// the seam, sharing everything else
+	template<typename T>
+	class vector
+	{
+		typedef rrb_node<T> node;
+
+		// Children of a node at shift s hold at most 1 << s elements each, and leaves are at shift 0
+		std::shared_ptr<node> root;
+		unsigned shift;
+		std::size_t count;
+
+		vector(const std::shared_ptr<node>& root, unsigned shift, std::size_t count) noexcept: root(root), shift(shift), count(count)
+		{ }
+
+		static std::size_t size_of(const node& n, unsigned s) noexcept
+		{
+			if (s == 0)
+				return n.elements.size();
+			if (!n.sizes.empty())
+				return n.sizes.back();
+			return ((n.children.size() - 1) << s) + size_of(*n.children.back(), s - bits);
+		}
+
+		// Keeps the number of elements up to each child, once one before the last is not full
+		static void relax(node& n, unsigned s)
+		{
+			n.sizes.clear();
+			std::size_t total = 0;
+			for(const auto& child : n.children)
+				n.sizes.push_back(total += size_of(*child, s - bits));
+		}
+
+		static std::shared_ptr<node> inner(std::vector<std::shared_ptr<node>> children, unsigned s, std::uint64_t token)
+		{
+			auto result = std::make_shared<node>();
+			result->token = token;
+			result->children = std::move(children);
+			relax(*result, s);
+			return result;
+		}
+
+		// Child holding an index, which becomes the index in that child. Children hold at most 1 << s elements, so
+		// the child is never before the one a balanced node would have.
+		static std::size_t child(const node& n, unsigned s, std::size_t& i) noexcept
+		{
+			std::size_t c = i >> s;
+			if (n.sizes.empty())
+			{
+				i -= c << s;
+				return c;
+			}
+			while (n.sizes[c] <= i)
+				++c;
+			if (c)
+				i -= n.sizes[c - 1];
+			return c;
+		}
+
+		// Single element at the bottom of single children, down from shift s
+		static std::shared_ptr<node> path(unsigned s, const T& value, std::uint64_t token)
+		{
+			auto result = std::make_shared<node>();
+			result->token = token;
+			if (s == 0)
+				result->elements.push_back(value);
+			else
+				result->children.push_back(path(s - bits, value, token));
+			return result;
+		}
+
+		static std::shared_ptr<node> assign(const std::shared_ptr<node>& n, unsigned s, std::size_t i, const T& value, std::uint64_t token)
+		{
+			auto result = editable(n, token);
+			if (s == 0)
+				result->elements[i] = value;
+			else
+			{
+				const std::size_t c = child(*n, s, i);
+				result->children[c] = assign(n->children[c], s - bits, i, value, token);
+			}
+			return result;
+		}
+
+		// Appends below a node, or returns null when its rightmost path has no room left
+		static std::shared_ptr<node> append(const std::shared_ptr<node>& n, unsigned s, const T& value, std::uint64_t token)
+		{
+			if (s == 0)
+			{
+				if (n->elements.size() == width)
+					return nullptr;
+				auto result = editable(n, token);
+				result->elements.push_back(value);
+				return result;
+			}
+
+			if (auto last = append(n->children.back(), s - bits, value, token))
+			{
+				auto result = editable(n, token);
+				result->children.back() = std::move(last);
+				if (!result->sizes.empty())
+					++result->sizes.back();
+				return result;
+			}
+			if (n->children.size() == width)
+				return nullptr;
+
+			auto result = editable(n, token);
+			if (result->sizes.empty() && size_of(*n->children.back(), s - bits) != (std::size_t(1) << s))
+				relax(*result, s);
+			result->children.push_back(path(s - bits, value, token));
+			if (!result->sizes.empty())
+				result->sizes.push_back(result->sizes.back() + 1);
+			return result;
+		}
+
+		static void push(std::shared_ptr<node>& root, unsigned& shift, std::size_t& count, const T& value, std::uint64_t token)
+		{
+			if (!root)
+				root = path(0, value, token);
+			else if (auto result = append(root, shift, value, token))
+				root = std::move(result);
+			else
+			{
+				// The tree is full up to its root, which becomes the first child of a new one
+				const bool full = size_of(*root, shift) == (std::size_t(1) << (shift + bits));
+				auto parent = std::make_shared<node>();
+				parent->token = token;
+				parent->children = {root, path(shift, value, token)};
+				shift += bits;
+				if (!full)
+					relax(*parent, shift);
+				root = std::move(parent);
+			}
+			++count;
+		}
+
+		// Two trees with their roots at the same shift, as one or two nodes at that shift. The nodes left of the seam
+		// are merged and refilled, so concatenating small vectors one after the other keeps the tree shallow.
+		static std::vector<std::shared_ptr<node>> merge(const node& a, const node& b, unsigned s)
+		{
+			if (s == 0)
+			{
+				std::vector<T> elements = a.elements;
+				elements.insert(elements.end(), b.elements.begin(), b.elements.end());
+
+				std::vector<std::shared_ptr<node>> result = {std::make_shared<node>()};
+				if (elements.size() > width)
+				{
+					result.push_back(std::make_shared<node>());
+					result[1]->elements.assign(elements.begin() + width, elements.end());
+					elements.resize(width);
+				}
+				result[0]->elements = std::move(elements);
+				return result;
+			}
+
+			std::vector<std::shared_ptr<node>> children(a.children.begin(), a.children.end() - 1);
+			const auto seam = merge(*a.children.back(), *b.children.front(), s - bits);
+			children.insert(children.end(), seam.begin(), seam.end());
+			children.insert(children.end(), b.children.begin() + 1, b.children.end());
+
+			if (children.size() <= width)
+				return {inner(std::move(children), s, 0)};
+			std::vector<std::shared_ptr<node>> rest(children.begin() + width, children.end());
+			children.resize(width);
+			return {inner(std::move(children), s, 0), inner(std::move(rest), s, 0)};
+		}
+
+		// The same tree with its root at a higher shift, below single children
+		static std::shared_ptr<node> raise(std::shared_ptr<node> n, unsigned from, unsigned to)
+		{
+			for(; from < to; from += bits)
+			{
+				auto parent = std::make_shared<node>();
+				parent->children.push_back(std::move(n));
+				n = std::move(parent);
+			}
+			return n;
+		}
+
+		template<typename F>
+		static void for_each(const node& n, const F& f)
+		{
+			for(const auto& element : n.elements)
+				f(element);
+			for(const auto& child : n.children)
+				for_each(*child, f);
+		}
+
+	public:
+		typedef T value_type;
+
+		vector() noexcept: root(nullptr), shift(0), count(0)
+		{ }
+
+		// The empty array literal also stands for the empty vector
+		vector(pebkac_array::empty) noexcept: vector()
+		{ }
+
+		std::size_t size() const noexcept
+		{
+			return count;
+		}
+
+		const T& operator[](std::size_t i) const noexcept
+		{
+			const node* n = root.get();
+			for(unsigned s = shift; s > 0; s -= bits)
+				n = n->children[child(*n, s, i)].get();
+			return n->elements[i];
+		}
+
+		vector set(std::size_t i, const T& value) const
+		{
+			return vector(assign(root, shift, i, value, 0), shift, count);
+		}
+
+		vector push(const T& value) const
+		{
+			vector result = *this;
+			push(result.root, result.shift, result.count, value, 0);
+			return result;
+		}
+
+		vector concat(const vector& other) const
+		{
+			if (!count)
+				return other;
+			if (!other.count)
+				return *this;
+
+			const unsigned s = std::max(shift, other.shift);
+			const auto seam = merge(*raise(root, shift, s), *raise(other.root, other.shift, s), s);
+			if (seam.size() == 1)
+				return vector(seam[0], s, count + other.count);
+			return vector(inner(seam, s + bits, 0), s + bits, count + other.count);
+		}
+
+		// Calls f(element) for every element, in order
+		template<typename F>
+		void for_each(const F& f) const
+		{
+			if (root)
+				for_each(*root, f);
+		}
+
+		// Vector changing in place, for batches of updates that only need the result
+		class transient
+		{
+			std::shared_ptr<node> root;
+			unsigned shift;
+			std::size_t count;
+			std::uint64_t token;
+
+		public:
+			explicit transient(const vector& v): root(v.root), shift(v.shift), count(v.count), token(next_token())
+			{ }
+
+			void set(std::size_t i, const T& value)
+			{
+				root = assign(root, shift, i, value, token);
+			}
+
+			void push(const T& value)
+			{
+				vector::push(root, shift, count, value, token);
+			}
+
+			vector persistent() noexcept
+			{
+				token = next_token();
+				return vector(root, shift, count);
+			}
+		};
+	};
+}
+
+template<typename K, typename V>
+V get(const pebkac_persistent::map<K, V>& m, const typename pebkac_persistent::map<K, V>::key_type& key, const typename pebkac_persistent::map<K, V>::mapped_type& otherwise)
+{
+	const V* value = m.find(key);
+	return value ? *value : otherwise;
+}
+
+template<typename K, typename V>
+bool has(const pebkac_persistent::map<K, V>& m, const typename pebkac_persistent::map<K, V>::key_type& key)
+{
+	return m.find(key) != nullptr;
+}
+
+template<typename K, typename V>
+pebkac_persistent::map<K, V> put(const pebkac_persistent::map<K, V>& m, const typename pebkac_persistent::map<K, V>::key_type& key, const typename pebkac_persistent::map<K, V>::mapped_type& value)
+{
+	return m.set(key, value);
+}
+
+template<typename K, typename V>
+pebkac_persistent::map<K, V> remove(const pebkac_persistent::map<K, V>& m, const typename pebkac_persistent::map<K, V>::key_type& key)
+{
+	return m.erase(key);
+}
+
+template<typename K, typename V>
+long long length(const pebkac_persistent::map<K, V>& m) noexcept
+{
+	return static_cast<long long>(m.size());
+}
+
+template<typename K, typename V>
+pebkac_array::array<K> keys(const pebkac_persistent::map<K, V>& m)
+{
+	pebkac_array::array<K> result(m.size());
+	std::size_t i = 0;
+	m.for_each([&](const K& key, const V&){ result.set(i++, key); });
+	return result;
+}
+
+template<typename K, typename V>
+pebkac_array::array<V> values(const pebkac_persistent::map<K, V>& m)
+{
+	pebkac_array::array<V> result(m.size());
+	std::size_t i = 0;
+	m.for_each([&](const K&, const V& value){ result.set(i++, value); });
+	return result;
+}
+
+// Later keys replace the values of earlier ones
+template<typename K, typename V>
+pebkac_persistent::map<K, V> to_map(const pebkac_array::array<K>& ks, const pebkac_array::array<V>& vs)
+{
+	typename pebkac_persistent::map<K, V>::transient result{pebkac_persistent::map<K, V>()};
+	for(std::size_t i = 0, n = std::min(ks.size(), vs.size()); i < n; ++i)
+		result.set(ks[i], vs[i]);
+	return result.persistent();
+}
+
+template<typename T>
+T get(const pebkac_persistent::vector<T>& v, long long i, const typename pebkac_persistent::vector<T>::value_type& otherwise)
+{
+	return i >= 0 && static_cast<std::size_t>(i) < v.size() ? v[static_cast<std::size_t>(i)] : otherwise;
+}
+
+// Putting an element right after the last one appends it
+template<typename T>
+pebkac_persistent::vector<T> put(const pebkac_persistent::vector<T>& v, long long i, const typename pebkac_persistent::vector<T>::value_type& value)
+{
+	if (i < 0 || static_cast<std::size_t>(i) > v.size())
+		throw std::out_of_range("put: index " + std::to_string(i) + " is out of range");
+	return static_cast<std::size_t>(i) == v.size() ? v.push(value) : v.set(static_cast<std::size_t>(i), value);
+}
+
+template<typename T>
+pebkac_persistent::vector<T> push(const pebkac_persistent::vector<T>& v, const typename pebkac_persistent::vector<T>::value_type& value)
+{
+	return v.push(value);
+}
+
+template<typename T>
+pebkac_persistent::vector<T> concat(const pebkac_persistent::vector<T>& a, const pebkac_persistent::vector<T>& b)
+{
+	return a.concat(b);
+}
+
+template<typename T>
+long long length(const pebkac_persistent::vector<T>& v) noexcept
+{
+	return static_cast<long long>(v.size());
+}
+
+template<typename T>
+pebkac_persistent::vector<T> to_vector(const pebkac_array::array<T>& xs)
+{
+	typename pebkac_persistent::vector<T>::transient result{pebkac_persistent::vector<T>()};
+	for(std::size_t i = 0, n = xs.size(); i < n; ++i)
+		result.push(xs[i]);
+	return result.persistent();
+}
+
+template<typename T>
+pebkac_array::array<T> to_array(const pebkac_persistent::vector<T>& v)
+{
+	pebkac_array::array<T> result(v.size());
+	std::size_t i = 0;
+	v.for_each([&](const T& x){ result.set(i++, x); });
+	return result;
+}
+
+)";
+}
+
+
+std::string runtime::get_parallel(size_t chunk_size)
+{
+	return "#include <mutex>\n#include <deque>\n#include <atomic>\n#include <thread>\n#include <vector>\n#include <cstdlib>\n#include <optional>\n#include <exception>\n#include <condition_variable>\n\n"
+		"namespace pebkac_parallel\n{\n"
+		"\t// Elements per task. Chunks do not depend on the number of threads, so neither do the results of reductions.\n"
+		"\tconstexpr std::size_t chunk_size = " + std::to_string(chunk_size ? chunk_size : 1) + ";\n"
+		R"(
+	// A loop over chunks, which every thread taking one of its tasks helps run
+	struct job
+	{
+		void (*const run)(const void* body, std::size_t chunk);
+		const void* const body;
+		std::atomic<std::size_t> pending;
+		std::atomic<bool> failed;
+		std::exception_ptr error;
+
+		job(void (*run)(const void*, std::size_t), const void* body, std::size_t chunks) noexcept:
+			run(run),
+			body(body),
+			pending(chunks),
+			failed(false),
+			error(nullptr)
+		{ }
+	};
+
+	// The chunks [begin, end) of a job, split in halves as threads take them
+	struct task
+	{
+		job* owner;
+		std::size_t begin;
+		std::size_t end;
+	};
+
+	class pool
+	{
+		// Every thread pushes and pops at the back of its own queue, and steals from the front of the others, where
+		// the largest ranges are
+		struct queue
+		{
+			std::mutex mutex;
+			std::deque<task> tasks;
+		};
+
+		// Threads running tasks, the calling one included, which is fixed before any worker starts
+		const std::size_t count;
+		std::unique_ptr<queue[]> queues;
+		std::vector<std::thread> workers;
+
+		// Tasks in all the queues, which idle workers sleep until there are
+		std::atomic<std::size_t> queued;
+		std::mutex sleep;
+		std::condition_variable wake;
+		bool stopping;
+
+		// Queue of the calling thread. Threads outside the pool share the first one.
+		static std::size_t& self() noexcept
+		{
+			thread_local std::size_t index = 0;
+			return index;
+		}
+
+		void push(const task& t)
+		{
+			queued.fetch_add(1);
+			{
+				std::lock_guard<std::mutex> lock(queues[self()].mutex);
+				queues[self()].tasks.push_back(t);
+			}
+			// Taking the lock makes sure a worker about to sleep either sees the task or gets the notification
+			{
+				std::lock_guard<std::mutex> lock(sleep);
+			}
+			wake.notify_one();
+		}
+
+		bool pop(task& t)
+		{
+			for(std::size_t k = 0; k < count; ++k)
+			{
+				queue& q = queues[(self() + k) % count];
+				std::lock_guard<std::mutex> lock(q.mutex);
+				if (q.tasks.empty())
+					continue;
+
+				if (k == 0)
+				{
+					t = q.tasks.back();
+					q.tasks.pop_back();
+				}
+				else
+				{
+					t = q.tasks.front();
+					q.tasks.pop_front();
+				}
+				queued.fetch_sub(1);
+				return true;
+			}
+			return false;
+		}
+
+		void run(task t)
+		{
+			// Keep the first chunk, and leave the rest for other threads to steal
+			while (t.end - t.begin > 1)
+			{
+				const std::size_t middle = t.begin + (t.end - t.begin) / 2;
+				push({t.owner, middle, t.end});
+				t.end = middle;
+			}
+
+			job& j = *t.owner;
+			if (!j.failed.load(std::memory_order_relaxed))
+			{
+				try
+				{
+					// The task may belong to a job started outside of the region this thread is in
+					pebkac_region::suspend outside;
+					j.run(j.body, t.begin);
+				}
+				catch(...)
+				{
+					if (!j.failed.exchange(true))
+						j.error = std::current_exception();
+				}
+			}
+			// The job is gone once the last chunk is counted
+			j.pending.fetch_sub(1, std::memory_order_acq_rel);
+		}
+
+		void work(std::size_t index)
+		{
+			self() = index;
+			task t;
+			for(;;)
+			{
+				if (pop(t))
+				{
+					run(t);
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock(sleep);
+				wake.wait(lock, [this]{ return stopping || queued.load() > 0; });
+				if (stopping)
+					return;
+			}
+		}
+
+		// One thread per core unless PEBKAC_THREADS says otherwise
+		static std::size_t threads() noexcept
+		{
+			std::size_t result = std::thread::hardware_concurrency();
+			if (const char* value = std::getenv("PEBKAC_THREADS"))
+				result = std::strtoul(value, nullptr, 10);
+			return std::max<std::size_t>(result, 1);
+		}
+
+	public:
+		pool():
+			count(threads()),
+			queues(new queue[count]),
+			queued(0),
+			stopping(false)
+		{
+			for(std::size_t i = 1; i < count; ++i)
+				workers.emplace_back(&pool::work, this, i);
+		}
+
+		~pool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleep);
+				stopping = true;
+			}
+			wake.notify_all();
+			for(auto& worker : workers)
+				worker.join();
+		}
+
+		static pool& get()
+		{
+			static pool instance;
+			return instance;
+		}
+
+		// Calls body(chunk) for every chunk below the count, and returns once all are done. The calling thread runs
+		// tasks while it waits, which may belong to other jobs, so that nested loops cannot deadlock.
+		template<typename F>
+		void for_each(std::size_t chunks, const F& body)
+		{
+			if (count == 1)
+			{
+				for(std::size_t c = 0; c < chunks; ++c)
+					body(c);
+				return;
+			}
+
+			job j([](const void* b, std::size_t c){ (*static_cast<const F*>(b))(c); }, &body, chunks);
+			run({&j, 0, chunks});
+
+			task t;
+			while (j.pending.load(std::memory_order_acquire) != 0)
+			{
+				if (pop(t))
+					run(t);
+				else
+					std::this_thread::yield();
+			}
+
+			if (j.error)
+				std::rethrow_exception(j.error);
+		}
+	};
+
+	// Calls body(begin, end) for the bounds of every chunk of count elements, in parallel if there is more than one
+	template<typename F>
+	void for_chunks(std::size_t count, const F& body)
+	{
+		const std::size_t chunks = (count + chunk_size - 1) / chunk_size;
+		const auto chunk = [&](std::size_t c){ body(c * chunk_size, std::min(count, (c + 1) * chunk_size)); };
+		if (chunks <= 1)
+		{
+			for(std::size_t c = 0; c < chunks; ++c)
+				chunk(c);
+		}
+		else
+			pool::get().for_each(chunks, chunk);
+	}
+}
+
+template<typename T, typename F>
+auto pmap(const pebkac_array::array<T>& xs, const F& f)
+{
+	typedef pebkac_array::element_t<decltype(f(std::declval<const T&>()))> R;
+	pebkac_array::array<R> result(xs.size());
+	if constexpr (pebkac_array::is_columnar_v<T> || pebkac_array::is_columnar_v<R>)
+	{
+		pebkac_parallel::for_chunks(xs.size(), [&](std::size_t begin, std::size_t end)
+		{
+			for(std::size_t i = begin; i < end; ++i)
+				result.set(i, f(xs[i]));
+		});
+	}
+	else
+	{
+		const T* in = xs.data();
+		R* out = result.data();
+		pebkac_parallel::for_chunks(xs.size(), [&](std::size_t begin, std::size_t end)
+		{
+			R* __restrict o = out;
+			for(std::size_t i = begin; i < end; ++i)
+				o[i] = f(in[i]);
+		});
+	}
+	return result;
+}
+
+// Every chunk is folded from its first element, and the results folded in order from the initial value, which only
+// gives the same result as fold for associative functions, but always the same one
+template<typename T, typename A, typename F>
+auto preduce(const pebkac_array::array<T>& xs, const A& initial, const F& f)
+{
+	typedef pebkac_array::element_t<decltype(f(initial, std::declval<const T&>()))> R;
+	std::vector<std::optional<R>> partials((xs.size() + pebkac_parallel::chunk_size - 1) / pebkac_parallel::chunk_size);
+	pebkac_parallel::for_chunks(xs.size(), [&](std::size_t begin, std::size_t end)
+	{
+		R partial = xs[begin];
+		for(std::size_t i = begin + 1; i < end; ++i)
+			partial = f(partial, xs[i]);
+		partials[begin / pebkac_parallel::chunk_size].emplace(std::move(partial));
+	});
+
+	R result = initial;
+	for(auto& partial : partials)
+		result = f(result, *partial);
+	return result;
+}
+
+)";
+}
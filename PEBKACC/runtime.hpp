@@ -0,0 +1,104 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief C++ support code pasted into generated programs, for the features that need more than plain expressions
+ */
+namespace pebkac::runtime
+{
+	/**
+	 * @brief Returns the basic definitions every generated program starts with
+	 */
+	std::string get_prelude();
+
+	/**
+	 * @brief Returns a profiler counting the calls and time spent in each function, and printing a summary on exit
+	 * @param functions Names of the profiled functions, indexed by the ids given to pebkac_profile::scope
+	 *
+	 * Counters are thread-local, and merged when their thread exits. Time is measured with the time stamp counter
+	 * where available, and only counts the outermost call of recursive functions.
+	 */
+	std::string get_profiler(const std::vector<std::string>& functions);
+
+	/**
+	 * @brief Returns pebkac_closure::function_ref, which borrows a function value instead of copying it like std::function
+	 *
+	 * It is two pointers wide, never allocates, and only works while the function it refers to is alive.
+	 */
+	std::string get_closures();
+
+	/**
+	 * @brief Returns pebkac_lazy::thunk, which computes the value of a lazy let the first time it is called
+	 *
+	 * Thunks compute their value only once, even when called from several threads at the same time, and compute it
+	 * again on the next call if it threw. Shared thunks are copied by escaping lambdas, and all copies share the value.
+	 */
+	std::string get_lazy();
+
+	/**
+	 * @brief Returns the fixed-width integer types i8 to u64, their checked conversions, and printing u64
+	 *
+	 * Conversions throw std::range_error rather than wrap around when the value does not fit.
+	 */
+	std::string get_fixed_width();
+
+	/**
+	 * @brief Returns bigint, the integer type of any size, and printing it
+	 *
+	 * Values that fit in a long long are kept in one, and their arithmetic only checks for overflow with the compiler's
+	 * builtins. Larger values are stored as 32-bit limbs, multiplied with Karatsuba's method once both are long.
+	 */
+	std::string get_bigint();
+
+	/**
+	 * @brief Returns pebkac_float::fmod, which the % of programs using floats or doubles becomes, and printing them
+	 *
+	 * fmod is constexpr, unlike std::fmod, so that constants can still take remainders.
+	 */
+	std::string get_floating_point();
+
+	/**
+	 * @brief Returns the pragmas letting the C++ compiler reorder and contract floating-point arithmetic in everything
+	 * after them
+	 */
+	std::string get_fast_math();
+
+	/**
+	 * @brief Returns pebkac_region::scope, which has the rest of a function call allocate from a bump arena freed when
+	 * it returns
+	 *
+	 * Regions free their memory without running destructors, so only arrays of elements that need none use them. Their
+	 * chunks go back to a per-thread pool, and are reused by the next region.
+	 */
+	std::string get_regions();
+
+	/**
+	 * @brief Returns pebkac_array::array, and the builtins working on arrays: map, filter, fold, zip, length and range
+	 *
+	 * Needs the region runtime. Arrays are immutable and contiguous, and copying one only shares its elements. The
+	 * builtins run plain loops over raw pointers, which compilers can vectorize, and the reductions folds are lowered
+	 * to use SIMD instructions.
+	 */
+	std::string get_arrays();
+
+	/**
+	 * @brief Returns pebkac_persistent::map and vector, and the builtins working on them: get, put, has, remove, push,
+	 * concat, keys, values, to_map, to_vector and to_array
+	 *
+	 * Needs the array runtime. Maps are hash array mapped tries and vectors relaxed radix balanced trees, so updates
+	 * copy O(log n) nodes and share the rest. The builtins making a collection from an array use a transient, which
+	 * changes the nodes only it has in place.
+	 */
+	std::string get_persistent();
+
+	/**
+	 * @brief Returns pmap and preduce, which work on chunks of an array in parallel, on a work-stealing thread pool
+	 * @param chunk_size Number of elements each task works on
+	 *
+	 * Needs the array runtime. Chunks are the same whatever the number of threads, so reductions always combine the
+	 * same elements in the same order. The pool starts on first use, with a thread per core, or PEBKAC_THREADS.
+	 */
+	std::string get_parallel(size_t chunk_size);
+}
@@ -1,5 +1,28 @@
 #include "serialization.hpp"
 
+#include <cmath>
+#include <cstdio>
+
+
+std::string escape(const std::string& s)
+{
+	std::string result = "";
+	for(char c : s)
+	{
+		if (c == '"' || c == '\\')
+			result += '\\';
+		if (static_cast<unsigned char>(c) < 0x20)
+		{
+			char buffer[8];
+			std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+			result += buffer;
+			continue;
+		}
+		result += c;
+	}
+	return result;
+}
+
 
 serialized_object::serialized_object() noexcept
 { }
@@ -17,6 +40,12 @@ void serialized_object::operator+= (const std::pair<std::string, long long>& oth
 }
 
 
+void serialized_object::operator+= (const std::pair<std::string, double>& other)
+{
+	elements.push_back({other.first, std::make_shared<serialized_literal_double>(other.second)});
+}
+
+
 void serialized_object::operator+= (const std::pair<std::string, const std::string&>& other)
 {
 	elements.push_back({other.first, std::make_shared<serialized_literal_string>(other.second)});
@@ -150,6 +179,23 @@ std::string serialized_literal_long_long::to_json() const
 }
 
 
+serialized_literal_double::serialized_literal_double(double value) noexcept:
+	serialized_literal(value)
+{ }
+
+
+std::string serialized_literal_double::to_json() const
+{
+	// JSON has no infinities or NaN
+	if (!std::isfinite(value))
+		return "null";
+
+	char buffer[32];
+	std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+	return buffer;
+}
+
+
 serialized_literal_string::serialized_literal_string(const std::string& value) noexcept:
 	serialized_literal(value)
 { }
@@ -5,6 +5,10 @@
 #include <vector>
 
 
+// Escapes a string to be put between the quotes of a JSON string
+std::string escape(const std::string& s);
+
+
 class serialized
 {
 public:
@@ -55,6 +59,7 @@ public:
 
 	void operator+= (const std::pair<std::string, bool>& other);
 	void operator+= (const std::pair<std::string, long long>& other);
+	void operator+= (const std::pair<std::string, double>& other);
 	void operator+= (const std::pair<std::string, const std::string&>& other);
 	void operator+= (const std::pair<std::string, std::shared_ptr<serializable>>& other);
 
@@ -110,6 +115,17 @@ public:
 };
 
 
+class serialized_literal_double: public serialized_literal<double>
+{
+public:
+	serialized_literal_double(
+		double value
+	) noexcept;
+
+	std::string to_json() const;
+};
+
+
 class serialized_literal_string: public serialized_literal<std::string>
 {
 public:
@@ -0,0 +1,217 @@
+#include "server.hpp"
+#include "codegen.hpp"
+
+#include <thread>
+#include <stdexcept>
+#include <filesystem>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+#endif
+
+using namespace pebkac;
+using namespace pebkac::server;
+
+
+cache_entry::cache_entry(
+	const std::string& source,
+	const driver::options& opts) noexcept:
+	source(source),
+	opts(opts)
+{ }
+
+
+const std::string& cache_entry::get_source() const noexcept
+{
+	return source;
+}
+
+
+std::string cache_entry::get_output(driver::output_type type)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto& output = outputs[static_cast<size_t>(type)];
+	if (output)
+		return *output;
+
+	if (!tokens)
+	{
+		trace::scope event(opts.tracer, "phase", "tokenize", opts.source_name);
+		tokens = lexing::tokenize(source);
+	}
+
+	if (type == driver::output_type::TOKENS)
+		return *(output = driver::serialize_tokens(*tokens));
+
+	if (!statements)
+	{
+		trace::scope event(opts.tracer, "phase", "parse", opts.source_name);
+		statements = driver::parse(source, *tokens, nullptr, opts.tracer);
+	}
+
+	if (type == driver::output_type::AST)
+		return *(output = driver::serialize_ast(*statements));
+
+	std::vector<std::shared_ptr<ast::statement_node>> optimized = { };
+	{
+		trace::scope event(opts.tracer, "phase", "optimize", opts.source_name);
+		optimized = driver::optimize(*statements, opts);
+	}
+
+	trace::scope event(opts.tracer, "phase", "codegen", opts.source_name);
+	const lexing::line_table lines(source);
+	codegen::generator g(optimized, driver::get_codegen_options(opts, lines));
+	return *(output = g.get_cpp());
+}
+
+
+compile_server::compile_server(
+	const std::string& socket_path,
+	const driver::options& opts) noexcept:
+	socket_path(socket_path),
+	opts(opts)
+{ }
+
+
+std::shared_ptr<cache_entry> compile_server::get_entry(const std::string& path)
+{
+	const std::string key = std::filesystem::absolute(path).lexically_normal().string();
+
+	// Always re-read the file, it is much cheaper than lexing and parsing it again
+	const std::string source = driver::read_file(path);
+
+	driver::options entry_opts = opts;
+	entry_opts.source_name = path;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto& entry = cache[key];
+	if (!entry || entry->get_source() != source)
+		entry = std::make_shared<cache_entry>(source, entry_opts);
+
+	return entry;
+}
+
+
+std::pair<bool, std::string> compile_server::handle(const std::string& request)
+{
+	if (request == "trace")
+	{
+		if (!opts.tracer)
+			return {false, "Tracing is disabled, start the server with --trace-buffer=<events>."};
+		return {true, opts.tracer->to_json()};
+	}
+
+	trace::scope event(opts.tracer, "request", request);
+	const size_t space = request.find(' ');
+	if (space == std::string::npos)
+		return {false, "Malformed request, expected \"<output_type> <source_path>\"."};
+
+	try
+	{
+		const driver::output_type type = driver::to_output_type(std::string_view(request).substr(0, space));
+		return {true, get_entry(request.substr(space + 1))->get_output(type)};
+	}
+	catch(const std::exception& e)
+	{
+		return {false, e.what()};
+	}
+}
+
+
+#ifndef _WIN32
+
+bool send_all(int fd, const std::string& data)
+{
+	for(size_t sent = 0; sent < data.size();)
+	{
+		const ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+		if (n <= 0)
+			return false;
+		sent += n;
+	}
+	return true;
+}
+
+
+void compile_server::serve(int connection)
+{
+	std::string buffer = "";
+	char chunk[4096];
+
+	while(true)
+	{
+		// Answer every complete line received so far
+		size_t newline;
+		while((newline = buffer.find('\n')) != std::string::npos)
+		{
+			std::string request = buffer.substr(0, newline);
+			buffer.erase(0, newline + 1);
+			if (!request.empty() && request.back() == '\r')
+				request.pop_back();
+
+			const auto [success, body] = handle(request);
+			if (!send_all(connection, (success?"OK ":"ERROR ") + std::to_string(body.size()) + "\n" + body))
+			{
+				::close(connection);
+				return;
+			}
+		}
+
+		const ssize_t n = ::recv(connection, chunk, sizeof(chunk), 0);
+		if (n <= 0)
+			break;
+		buffer.append(chunk, n);
+	}
+
+	::close(connection);
+}
+
+
+void compile_server::run()
+{
+	sockaddr_un address = { };
+	address.sun_family = AF_UNIX;
+	if (socket_path.size() >= sizeof(address.sun_path))
+		throw std::runtime_error("Socket path is too long: \"" + socket_path + "\"");
+	socket_path.copy(address.sun_path, socket_path.size());
+
+	const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0)
+		throw std::runtime_error("Cannot create socket.");
+
+	// A stale socket file left behind by a previous server would make bind() fail
+	::unlink(socket_path.c_str());
+	if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, SOMAXCONN) != 0)
+	{
+		::close(listener);
+		throw std::runtime_error("Cannot listen on \"" + socket_path + "\"");
+	}
+
+	while(true)
+	{
+		const int connection = ::accept(listener, nullptr, nullptr);
+		if (connection < 0)
+			continue;
+
+		// Clients tend to keep their connection open, so each one gets its own thread
+		std::thread(&compile_server::serve, this, connection).detach();
+	}
+}
+
+#else
+
+void compile_server::serve(int connection)
+{
+	throw std::runtime_error("Server mode requires Unix domain sockets.");
+}
+
+
+void compile_server::run()
+{
+	throw std::runtime_error("Server mode requires Unix domain sockets.");
+}
+
+#endif
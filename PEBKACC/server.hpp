@@ -0,0 +1,81 @@
+#pragma once
+
+#include "driver.hpp"
+#include "lexing.hpp"
+#include "nodes.hpp"
+
+#include <array>
+#include <mutex>
+#include <queue>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace pebkac::server
+{
+	/**
+	 * @brief Warm per-file compiler state, reused as long as the file contents do not change
+	 */
+	class cache_entry
+	{
+	public:
+		cache_entry(const std::string& source, const driver::options& opts) noexcept;
+
+		const std::string& get_source() const noexcept;
+
+		/**
+		 * @brief Returns the requested output, running only the pipeline stages that are not cached yet
+		 */
+		std::string get_output(driver::output_type type);
+
+	private:
+		const std::string source;
+		const driver::options opts;
+
+		std::mutex mutex;
+		std::optional<std::queue<lexing::token>> tokens;
+		std::optional<std::vector<std::shared_ptr<ast::statement_node>>> statements;
+		std::array<std::optional<std::string>, 3> outputs;
+	};
+
+
+	class compile_server
+	{
+	public:
+		/**
+		 * @param socket_path Path of the Unix domain socket to listen on
+		 * @param opts Compilation options, used for every request
+		 */
+		compile_server(
+			const std::string& socket_path,
+			const driver::options& opts = { }
+		) noexcept;
+
+		/**
+		 * @brief Listens on the Unix domain socket and serves requests until the process is killed
+		 *
+		 * Every request is a single line, "<output_type> <source_path>". Every response is a line,
+		 * "OK <length>" or "ERROR <length>", followed by exactly <length> bytes of output or error message.
+		 * A client may send any number of requests over the same connection. When tracing is enabled, the request
+		 * "trace" returns the recorded trace events in Chrome's trace_event format.
+		 */
+		void run();
+
+		/**
+		 * @brief Answers a single request line, from the cache whenever possible
+		 * @return Whether the request succeeded, and the output or error message
+		 */
+		std::pair<bool, std::string> handle(const std::string& request);
+
+	private:
+		const std::string socket_path;
+		const driver::options opts;
+
+		std::mutex mutex;
+		std::unordered_map<std::string, std::shared_ptr<cache_entry>> cache;
+
+		std::shared_ptr<cache_entry> get_entry(const std::string& path);
+		void serve(int connection);
+	};
+}
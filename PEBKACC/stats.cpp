@@ -0,0 +1,214 @@
+#include "stats.hpp"
+#include "serialization.hpp"
+
+#include <new>
+#include <ctime>
+#include <atomic>
+#include <cstdlib>
+#include <sstream>
+#include <iomanip>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#else
+#include <malloc.h>
+#endif
+
+using namespace pebkac;
+using namespace pebkac::stats;
+
+
+// Every thread counts its own allocations, so that concurrent batch compilations do not pollute each other's stats
+namespace
+{
+	thread_local size_t allocation_count = 0;
+	thread_local size_t allocated_bytes = 0;
+
+	// Off unless statistics were requested, so that other compilations only pay for a load
+	std::atomic<bool> counting(false);
+
+	void* allocate(std::size_t size) noexcept
+	{
+		if (counting.load(std::memory_order_relaxed))
+		{
+			++allocation_count;
+			allocated_bytes += size;
+		}
+		return std::malloc(size ? size : 1);
+	}
+
+	void* allocate(std::size_t size, std::align_val_t alignment) noexcept
+	{
+		if (counting.load(std::memory_order_relaxed))
+		{
+			++allocation_count;
+			allocated_bytes += size;
+		}
+
+		const std::size_t align = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+		return ::_aligned_malloc(size ? size : 1, align);
+#else
+		// aligned_alloc takes sizes that are multiples of the alignment
+		return std::aligned_alloc(align, size ? (size + align - 1) / align * align : align);
+#endif
+	}
+
+	void deallocate(void* p, std::align_val_t) noexcept
+	{
+#ifdef _WIN32
+		::_aligned_free(p);
+#else
+		std::free(p);
+#endif
+	}
+
+	void* allocate_or_throw(std::size_t size)
+	{
+		if (void* p = allocate(size))
+			return p;
+		throw std::bad_alloc();
+	}
+
+	void* allocate_or_throw(std::size_t size, std::align_val_t alignment)
+	{
+		if (void* p = allocate(size, alignment))
+			return p;
+		throw std::bad_alloc();
+	}
+}
+
+
+// Every replaceable form of new and delete is replaced, so that memory never goes back to an allocator other than
+// the one it came from
+void* operator new(std::size_t size) { return allocate_or_throw(size); }
+void* operator new[](std::size_t size) { return allocate_or_throw(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return allocate_or_throw(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return allocate_or_throw(size, alignment); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocate(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocate(size, alignment); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t alignment) noexcept { deallocate(p, alignment); }
+void operator delete[](void* p, std::align_val_t alignment) noexcept { deallocate(p, alignment); }
+void operator delete(void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept { deallocate(p, alignment); }
+void operator delete[](void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept { deallocate(p, alignment); }
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept { deallocate(p, alignment); }
+void operator delete[](void* p, std::size_t, std::align_val_t alignment) noexcept { deallocate(p, alignment); }
+
+
+void stats::count_allocations() noexcept
+{
+	counting.store(true, std::memory_order_relaxed);
+}
+
+
+size_t stats::get_peak_rss() noexcept
+{
+#ifndef _WIN32
+	rusage usage = { };
+	if (::getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+
+#ifdef __APPLE__
+	return usage.ru_maxrss;
+#else
+	return usage.ru_maxrss * 1024;
+#endif
+#else
+	return 0;
+#endif
+}
+
+
+report::report() noexcept:
+	source_bytes(0),
+	tokens(0),
+	nodes(0)
+{ }
+
+
+const std::vector<phase>& report::get_phases() const noexcept
+{
+	return phases;
+}
+
+
+double get_cpu_time() noexcept
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	timespec t = { };
+	if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t) == 0)
+		return t.tv_sec + t.tv_nsec / 1e9;
+#endif
+	return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+}
+
+
+report::snapshot report::take_snapshot() noexcept
+{
+	return {std::chrono::steady_clock::now(), get_cpu_time(), allocation_count, allocated_bytes};
+}
+
+
+void report::record(const std::string& name, const snapshot& start)
+{
+	const snapshot end = take_snapshot();
+	phases.push_back({
+		name,
+		std::chrono::duration<double>(end.wall - start.wall).count(),
+		end.cpu - start.cpu,
+		end.allocations - start.allocations,
+		end.allocated_bytes - start.allocated_bytes,
+		get_peak_rss(),
+	});
+}
+
+
+std::string report::to_text() const
+{
+	std::ostringstream result;
+	result << source_bytes << " bytes, " << tokens << " tokens, " << nodes << " AST nodes" << std::endl;
+	result << std::left << std::setw(12) << "phase" << std::right
+		<< std::setw(12) << "wall ms" << std::setw(12) << "cpu ms"
+		<< std::setw(12) << "allocs" << std::setw(14) << "alloc bytes" << std::setw(14) << "peak rss" << std::endl;
+
+	for(const auto& p : phases)
+	{
+		result << std::left << std::setw(12) << p.name << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(12) << p.wall_seconds * 1000 << std::setw(12) << p.cpu_seconds * 1000
+			<< std::setw(12) << p.allocations << std::setw(14) << p.allocated_bytes << std::setw(14) << p.peak_rss_bytes << std::endl;
+	}
+
+	return result.str();
+}
+
+
+std::string report::to_json() const
+{
+	std::ostringstream result;
+	result << std::setprecision(9)
+		<< "{\"source_bytes\": " << source_bytes << ", \"tokens\": " << tokens << ", \"nodes\": " << nodes << ", \"phases\": [";
+
+	for(size_t i = 0; i < phases.size(); ++i)
+	{
+		const auto& p = phases[i];
+		result << (i?", ":"")
+			<< "{\"name\": \"" << escape(p.name) << "\""
+			<< ", \"wall_seconds\": " << p.wall_seconds
+			<< ", \"cpu_seconds\": " << p.cpu_seconds
+			<< ", \"allocations\": " << p.allocations
+			<< ", \"allocated_bytes\": " << p.allocated_bytes
+			<< ", \"peak_rss_bytes\": " << p.peak_rss_bytes << "}";
+	}
+
+	result << "]}";
+	return result.str();
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace pebkac::stats
+{
+	enum class format
+	{
+		NONE,
+		TEXT,
+		JSON,
+	};
+
+
+	struct phase
+	{
+		std::string name;
+		double wall_seconds;
+
+		// CPU time of the thread running the phase, where the platform can tell
+		double cpu_seconds;
+
+		// Heap allocations made by the thread running the phase
+		size_t allocations;
+		size_t allocated_bytes;
+
+		// Peak resident set size of the whole process, at the end of the phase
+		size_t peak_rss_bytes;
+	};
+
+
+	/**
+	 * @brief Where a compilation spent its time and memory
+	 */
+	class report
+	{
+	public:
+		report() noexcept;
+
+		/**
+		 * @brief Runs a phase of the compilation, and records its timings and allocations
+		 * @param name Name of the phase
+		 * @param f Function running the phase
+		 * @return Whatever the function returns
+		 */
+		template<class F>
+		auto measure(const std::string& name, F&& f)
+		{
+			const snapshot start = take_snapshot();
+			struct recorder
+			{
+				report& r;
+				const std::string& name;
+				const snapshot& start;
+
+				// Record the phase even if it throws, so that failing inputs can be diagnosed too
+				~recorder() { r.record(name, start); }
+			} rec = {*this, name, start};
+
+			return f();
+		}
+
+		const std::vector<phase>& get_phases() const noexcept;
+
+		size_t source_bytes;
+		size_t tokens;
+		size_t nodes;
+
+		std::string to_text() const;
+		std::string to_json() const;
+
+	private:
+		struct snapshot
+		{
+			std::chrono::steady_clock::time_point wall;
+			double cpu;
+			size_t allocations;
+			size_t allocated_bytes;
+		};
+
+		std::vector<phase> phases;
+
+		static snapshot take_snapshot() noexcept;
+		void record(const std::string& name, const snapshot& start);
+	};
+
+
+	/**
+	 * @brief Starts counting the heap allocations of every thread, which reports record per phase
+	 *
+	 * Until then, phases report no allocations, and allocating costs no more than malloc.
+	 */
+	void count_allocations() noexcept;
+
+	/**
+	 * @brief Returns the peak resident set size of the process so far, or 0 where it is unknown
+	 */
+	size_t get_peak_rss() noexcept;
+}
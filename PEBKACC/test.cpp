@@ -0,0 +1,1153 @@
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <utility>
+#include <iostream>
+#include <stdexcept>
+#include <filesystem>
+#include <functional>
+
+#include <sys/wait.h>
+
+#include "lexing.hpp"
+#include "ast.hpp"
+#include "codegen.hpp"
+#include "driver.hpp"
+#include "incremental.hpp"
+#include "server.hpp"
+#include "trace.hpp"
+#include "serialization.hpp"
+
+using namespace pebkac;
+
+
+// Tests of the compiler, grouped by feature. Each test throws a failure as soon as one of its checks does not hold.
+// Tests running the generated C++ build it with the compiler in $PEBKAC_TEST_CXX, or c++ by default. Tests of the
+// command line run the pebkacc next to the tests.
+
+class failure: public std::runtime_error
+{
+public:
+	using std::runtime_error::runtime_error;
+};
+
+
+void check(bool condition, const std::string& message)
+{
+	if (!condition)
+		throw failure(message);
+}
+
+
+void check_equal(const std::string& actual, const std::string& expected)
+{
+	if (actual != expected)
+		throw failure("Expected:\n" + expected + "\nGot:\n" + actual);
+}
+
+
+bool contains(const std::string& s, const std::string& part)
+{
+	return s.find(part) != std::string::npos;
+}
+
+
+size_t count(const std::string& s, const std::string& part)
+{
+	size_t result = 0;
+	for(size_t i = s.find(part); i != std::string::npos; i = s.find(part, i + part.size()))
+		++result;
+	return result;
+}
+
+
+// Directory holding the files tests write, removed once every test ran
+std::filesystem::path scratch;
+
+std::string scratch_file(const std::string& name, const std::string& contents)
+{
+	const std::filesystem::path path = scratch / name;
+	std::filesystem::create_directories(path.parent_path());
+	driver::write_file(path.string(), contents);
+	return path.string();
+}
+
+
+std::string compile(const std::string& source, const driver::options& opts = { })
+{
+	return driver::compile(source, driver::output_type::CPP, opts);
+}
+
+
+// Returns the syntax and semantic errors of a source, and none if it compiles
+std::vector<ast::diagnostic> diagnose(const std::string& source)
+{
+	try
+	{
+		driver::compile(source, driver::output_type::AST);
+	}
+	catch(const driver::compilation_error& e)
+	{
+		return e.get_diagnostics();
+	}
+	return { };
+}
+
+
+std::string describe(const std::vector<ast::diagnostic>& diagnostics)
+{
+	std::string result = "";
+	for(const auto& d : diagnostics)
+		result += std::to_string(d.position.line) + ":" + std::to_string(d.position.column) + " " + d.message + "\n";
+	return result;
+}
+
+
+/**
+ * @brief Compiles a source with a main into a program, runs it and returns what it prints
+ * @param failed If not null, receives whether the program exited with an error. Otherwise an error fails the test.
+ * @param errors If not null, receives what the program prints on stderr
+ */
+std::string run(const std::string& source, const driver::options& opts = { }, bool* failed = nullptr, std::string* errors = nullptr)
+{
+	// The generated main returns an integer, C++ wants it to return an int
+	std::string cpp = compile(source, opts);
+	const size_t main = cpp.find("const integer main()");
+	check(main != std::string::npos, "The program has no main");
+	cpp.replace(main, 20, "const integer pebkac_main()");
+	cpp += "\nint main()\n{\n\treturn pebkac_main();\n}\n";
+
+	static size_t programs = 0;
+	const std::string name = "program" + std::to_string(programs++);
+	const std::string path = scratch_file(name + ".cpp", cpp);
+	const std::string binary = (scratch / name).string();
+	const std::string output = binary + ".out";
+
+	const char* cxx = std::getenv("PEBKAC_TEST_CXX");
+	const std::string build = std::string(cxx ? cxx : "c++") + " --std=c++17 -pthread -w -O1 " + path + " -o " + binary + " 2> " + output;
+	if (std::system(build.c_str()) != 0)
+		throw failure("The generated C++ does not build:\n" + driver::read_file(output));
+
+	const int status = std::system((binary + " > " + output + " 2> " + binary + ".err").c_str());
+	const bool error = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+	if (failed)
+		*failed = error;
+	else
+		check(!error, "The program exited with an error");
+	if (errors)
+		*errors = driver::read_file(binary + ".err");
+
+	return driver::read_file(output);
+}
+
+
+/**
+ * @brief Runs pebkacc with the given arguments, and returns what it prints on stdout and stderr
+ * @param status Receives the exit status
+ */
+std::string pebkacc(const std::string& arguments, int& status)
+{
+	const std::string output = (scratch / "pebkacc.out").string();
+	const int result = std::system(("./pebkacc " + arguments + " > " + output + " 2>&1").c_str());
+	status = WIFEXITED(result) ? WEXITSTATUS(result) : -1;
+	return driver::read_file(output);
+}
+
+
+// Batch compilation
+
+void test_batch_outputs()
+{
+	const std::string a = scratch_file("batch/a.pebkac", "let x = 1;\n");
+	const std::string b = scratch_file("batch/b.pebkac", "let y = ;\n");
+	const std::string c = scratch_file("batch/c.pebkac", "fun f(a: integer): integer = a + 1;\n");
+
+	std::filesystem::create_directories(scratch / "batch_out");
+	const auto results = driver::compile_batch({ a, b, c }, driver::output_type::CPP, (scratch / "batch_out").string(), 2);
+	check(results.size() == 3, "Every source has a result");
+	check(results[0].success && results[2].success, "Valid sources compile");
+	check(!results[1].success && !results[1].message.empty(), "A broken source fails with a message");
+	check_equal(results[0].source, a);
+	check_equal(results[2].output, (scratch / "batch_out" / "c.cpp").string());
+	check(contains(driver::read_file(results[2].output), "integer f("), "Outputs are written");
+}
+
+
+void test_batch_output_collision()
+{
+	const std::string a = scratch_file("collision/one/f.pebkac", "let x = 1;\n");
+	const std::string b = scratch_file("collision/two/f.pebkac", "let y = 2;\n");
+	const std::string c = scratch_file("collision/g.pebkac", "let z = 3;\n");
+
+	std::filesystem::create_directories(scratch / "collision_out");
+	const auto results = driver::compile_batch({ a, b, c }, driver::output_type::AST, (scratch / "collision_out").string(), 0);
+	check(!results[0].success && contains(results[0].message, b), "Sources with the same output fail, naming the other");
+	check(!results[1].success && contains(results[1].message, a), "Sources with the same output fail, naming the other");
+	check(results[2].success, "Other sources still compile");
+	check(!std::filesystem::exists(results[0].output), "Colliding outputs are not written");
+
+	// The same source listed twice, however it is spelled, is no collision
+	const std::string d = scratch_file("collision/h.pebkac", "let w = 4;\n");
+	const std::string e = (scratch / "collision" / "." / "h.pebkac").string();
+	const auto duplicates = driver::compile_batch({ d, e, d }, driver::output_type::AST, (scratch / "collision_out").string(), 0);
+	for(size_t i = 0; i < duplicates.size(); ++i)
+		check(duplicates[i].success, "A duplicate source compiles: " + duplicates[i].message);
+	check_equal(duplicates[1].source, e);
+	check(std::filesystem::exists(duplicates[0].output), "A duplicate source is written once");
+}
+
+
+void test_manifest()
+{
+	const std::string manifest = scratch_file("manifest.txt", "# Sources\n\n  a.pebkac  \r\nb.pebkac\n");
+	const auto sources = driver::read_manifest(manifest);
+	check(sources.size() == 2, "Comments and blank lines are skipped");
+	check_equal(sources[0], "a.pebkac");
+	check_equal(sources[1], "b.pebkac");
+}
+
+
+// Profiling
+
+void test_profile_instrumentation()
+{
+	const std::string source =
+		"fun used(x: integer): integer = x + 1;\n"
+		"fun twice(x: integer): integer = used(used(x));\n"
+		"fun main(): integer {\n"
+		"\tprint(twice(1) + used(0));\n"
+		"\treturn 0;\n"
+		"}\n";
+	driver::options opts;
+	opts.profile = true;
+	check(count(compile(source, opts), "pebkac_profile::scope pebkac_profile_scope(") == 3, "Every function is instrumented");
+
+	// The summary counts the calls of every function, and is printed on exit
+	std::string errors = "";
+	check_equal(run(source, opts, nullptr, &errors), "4\n");
+	check(contains(errors, "calls") && contains(errors, "ns/call"), "The summary has a header:\n" + errors);
+	for(const std::string& row : {"main ", "twice ", "used "})
+		check(contains(errors, "\n" + row), "The summary has a row for " + row + ":\n" + errors);
+	check(contains(errors.substr(errors.find("\nused ")), " 3 "), "Calls are counted:\n" + errors);
+}
+
+
+// Compile-time evaluation
+
+void test_constexpr()
+{
+	const std::string source =
+		"fun square(x: integer): integer = x * x;\n"
+		"fun fact(n: integer): integer = if (n < 2) 1 else n * fact(n - 1);\n"
+		"let table = square(12) + 1;\n"
+		"let big = fact(10);\n"
+		"io fun shout(x: integer): integer {\n"
+		"\tprint(x);\n"
+		"\treturn x;\n"
+		"}\n"
+		"fun main(): integer {\n"
+		"\tprint(table);\n"
+		"\tprint(big);\n"
+		"\tprint(shout(3));\n"
+		"\treturn 0;\n"
+		"}\n";
+	driver::options opts;
+	opts.inline_budget = 0;
+	const std::string cpp = compile(source, opts);
+	check(contains(cpp, "constexpr integer square(") && contains(cpp, "constexpr integer fact("), "Pure functions are constexpr:\n" + cpp);
+	check(contains(cpp, "constexpr auto table = "), "Constant lets are constexpr:\n" + cpp);
+	check(contains(cpp, "\nconst auto big = "), "Lets calling recursive functions are left to run time:\n" + cpp);
+	check(!contains(cpp, "constexpr integer shout("), "io functions are not constexpr:\n" + cpp);
+	check_equal(run(source, opts), "145\n3628800\n3\n3\n");
+
+	opts.constant_evaluation = false;
+	check(!contains(compile(source, opts), "constexpr"), "--no-constexpr turns it all off");
+}
+
+
+// Common subexpressions
+
+void test_common_subexpressions()
+{
+	const std::string source =
+		"fun f(x: integer): integer = x * 3 + 1;\n"
+		"fun g(x: integer): integer = f(x) + f(x);\n"
+		"fun count(n: integer, k: integer, acc: integer): integer = if (n == 0) acc else count(n - 1, k, acc + f(k) * 2);\n"
+		"io fun shout(x: integer): integer {\n"
+		"\tprint(x);\n"
+		"\treturn x;\n"
+		"}\n"
+		"fun main(): integer {\n"
+		"\tprint(g(2));\n"
+		"\tprint(count(5, 4, 0));\n"
+		"\tprint(shout(1) + shout(1));\n"
+		"\treturn 0;\n"
+		"}\n";
+	driver::options opts;
+	opts.inline_budget = 0;
+	const std::string cpp = compile(source, opts);
+	check(count(cpp, "f(x)") == 1 && contains(cpp, "pebkac_common_0+pebkac_common_0"), "Repeated calls are computed once:\n" + cpp);
+	check(contains(cpp, "pebkac_count_loop_0(n, k, acc, f(k)*2)"), "Loop invariants are computed before the loop:\n" + cpp);
+	check(count(cpp, "shout(1)") == 2, "io calls are never merged:\n" + cpp);
+	check_equal(run(source, opts), "14\n130\n1\n1\n2\n");
+
+	opts.common_subexpressions = false;
+	check(!contains(compile(source, opts), "pebkac_common_"), "--no-cse turns it off");
+}
+
+
+// Closures
+
+void test_closure_conversion()
+{
+	const std::string source =
+		"fun apply(f: (integer) -> integer, x: integer): integer = f(x);\n"
+		"fun adder(k: integer): (integer) -> integer = { x: integer -> return x + k; };\n"
+		"fun main(): integer {\n"
+		"\tlet k = 10;\n"
+		"\tprint(apply({ x: integer -> return x + k; }, 1));\n"
+		"\tlet add = adder(5);\n"
+		"\tprint(add(1));\n"
+		"\treturn 0;\n"
+		"}\n";
+	driver::options opts;
+	opts.specialization_budget = 0;
+	opts.inline_budget = 0;
+	const std::string cpp = compile(source, opts);
+	check(contains(cpp, "apply(const pebkac_closure::function_ref<const integer(const integer)>& f"), "Parameters only called borrow their function:\n" + cpp);
+	check(contains(cpp, "return [=](const integer& x)"), "Lambdas outliving their function copy what they use:\n" + cpp);
+	check(contains(cpp, "print(apply([&](const integer& x)"), "Other lambdas refer to what they use:\n" + cpp);
+	check_equal(run(source, opts), "11\n6\n");
+
+	opts.closure_conversion = false;
+	const std::string converted = compile(source, opts);
+	check(!contains(converted, "function_ref") && contains(converted, "apply(const std::function<"), "--no-closure-conversion passes std::functions:\n" + converted);
+	check(contains(converted, "return [&](const integer& x)"), "--no-closure-conversion has every lambda refer to what it uses:\n" + converted);
+}
+
+
+// Arrays
+
+void test_arrays()
+{
+	const std::string source =
+		"fun main(): integer {\n"
+		"\tlet xs = [1, 2, 3, 4, 5];\n"
+		"\tlet squares = map(xs, { x: integer -> return x * x; });\n"
+		"\tlet odd = filter(squares, { x: integer -> return x % 2 == 1; });\n"
+		"\tprint(fold(odd, 0, { a: integer, b: integer -> return a + b; }));\n"
+		"\tprint(length(filter(range(0, 100), { x: integer -> return x % 7 == 0; })));\n"
+		"\tprint(fold(zip(xs, range(10, 13), { a: integer, b: integer -> return a * b; }), 0, { a: integer, b: integer -> return a + b; }));\n"
+		"\tlet bytes: [u8] = [200u8, 100u8];\n"
+		"\tprint(fold(bytes, 0, { a: integer, b: u8 -> return a + b; }));\n"
+		"\tprint(length(range(5, 1)));\n"
+		"\treturn 0;\n"
+		"}\n";
+	const std::string cpp = compile(source);
+	check(contains(cpp, "pebkac_array::of(1, 2, 3, 4, 5)"), "Array literals are contiguous arrays:\n" + cpp);
+	check(contains(cpp, "print(pebkac_array::sum(odd, 0))"), "Folds adding integers are SIMD reductions:\n" + cpp);
+	check_equal(run(source), "35\n15\n68\n300\n0\n");
+
+	driver::options opts;
+	opts.simd_reductions = false;
+	check(!contains(compile(source, opts), "pebkac_array::sum("), "--no-simd-reductions calls the function of every fold");
+	check_equal(run(source, opts), "35\n15\n68\n300\n0\n");
+}
+
+
+void test_parallel_arrays()
+{
+	const std::string source =
+		"fun main(): integer {\n"
+		"\tlet big = range(0, 100000);\n"
+		"\tprint(fold(pmap(big, { x: integer -> return x * 2; }), 0, { a: integer, b: integer -> return a + b; }));\n"
+		"\tprint(preduce(big, 0, { a: integer, b: integer -> return a + b; }));\n"
+		"\tprint(preduce(big, 1000000, { a: integer, b: integer -> return if (a < b) a else b; }));\n"
+		"\tprint(length(pmap(range(0, 3), { x: integer -> return x; })));\n"
+		"\treturn 0;\n"
+		"}\n";
+	check(contains(compile(source), "namespace pebkac_parallel"), "Programs using pmap and preduce get a thread pool");
+
+	// Results depend neither on the size of the chunks nor on the number of threads
+	for(const size_t chunk : {1, 1000, 4096})
+	{
+		driver::options opts;
+		opts.parallel_chunk = chunk;
+		check_equal(run(source, opts), "9999900000\n4999950000\n0\n3\n");
+	}
+}
+
+
+// Floating-point numbers
+
+void test_floating_point()
+{
+	const std::string source =
+		"fun main(): integer {\n"
+		"\tlet a = 1.5;\n"
+		"\tlet b: float = 0.25f;\n"
+		"\tprint(a * 2.0 + 2e-1);\n"
+		"\tprint(double(b) + 1.0);\n"
+		"\tprint(7.5 % 2.0);\n"
+		"\tprint(integer(a * 3.0));\n"
+		"\tlet xs = [0.5, 1.5, 2.0];\n"
+		"\tprint(fold(xs, 0.0, { s: double, x: double -> return s + x; }));\n"
+		"\treturn 0;\n"
+		"}\n";
+	check(contains(driver::compile(source, driver::output_type::AST), "{\"node\":\"floating_literal\",\"value\":0.25,\"suffix\":\"f\"}"),
+		"Literals with a decimal point are floating-point numbers, and floats end with f");
+	const std::string cpp = compile(source);
+	check(contains(cpp, "pebkac_float::fmod(7.5, 2.0)") && !contains(cpp, "#pragma GCC optimize"), "% is fmod, without reordering:\n" + cpp);
+	check_equal(run(source), "3.2\n1.25\n1.5\n4\n4\n");
+
+	// Fast math reorders sums, which gives the same result for these exact values
+	driver::options opts;
+	opts.fast_math = true;
+	const std::string fast = compile(source, opts);
+	check(contains(fast, "#pragma GCC optimize(\"fast-math\")") && contains(fast, "pebkac_array::reassociated_sum(xs, double(0.0))"),
+		"--fast-math reassociates the generated functions and sums:\n" + fast);
+	check_equal(run(source, opts), "3.2\n1.25\n1.5\n4\n4\n");
+}
+
+
+// Lazy lets
+
+void test_lazy_let()
+{
+	const std::string source =
+		"io fun noisy(x: integer): integer {\n"
+		"\tprint(x);\n"
+		"\treturn x;\n"
+		"}\n"
+		"fun pick(c: boolean): integer {\n"
+		"\tlazy let expensive = noisy(42);\n"
+		"\treturn if (c) expensive + expensive else 0;\n"
+		"}\n"
+		"fun later(x: integer): () -> integer {\n"
+		"\tlazy let value = noisy(x);\n"
+		"\treturn { -> return value * 2; };\n"
+		"}\n"
+		"fun main(): integer {\n"
+		"\tprint(pick(false));\n"
+		"\tprint(pick(true));\n"
+		"\tlet f = later(7);\n"
+		"\tprint(f() + f());\n"
+		"\treturn 0;\n"
+		"}\n";
+	check(contains(compile(source), "pebkac_lazy::make("), "Lazy lets are thunks");
+
+	// Unused values are never computed, and used ones only once, even by a lambda outliving their let
+	check_equal(run(source), "0\n42\n84\n7\n28\n");
+}
+
+
+// Records
+
+void test_records()
+{
+	const std::string source =
+		"record point(x: double, y: double, weight: integer = 1);\n"
+		"fun main(): integer {\n"
+		"\tlet p = point(1.0, 2.0);\n"
+		"\tprint(p.x + p.y);\n"
+		"\tprint(p.weight);\n"
+		"\tlet ps = [point(1.0, 2.0, 3), point(4.0, 5.0)];\n"
+		"\tprint(fold(map(ps, { q: point -> return q.x; }), 0.0, { a: double, b: double -> return a + b; }));\n"
+		"\tprint(fold(ps, 0, { a: integer, q: point -> return a + q.weight; }));\n"
+		"\treturn 0;\n"
+		"}\n";
+	const std::string cpp = compile(source);
+	check(contains(cpp, "struct point\n{\n\tdouble x;\n\tdouble y;\n\tinteger weight;\n"), "Records are plain structs:\n" + cpp);
+	check(!contains(cpp, "static auto pebkac_fields("), "Arrays of records are arrays of structs by default");
+	check_equal(run(source), "3\n1\n5\n4\n");
+
+	// Storing arrays of records as one array per field gives the same results
+	driver::options opts;
+	opts.columnar_records = true;
+	check(contains(compile(source, opts), "return visit(&point::x, &point::y, &point::weight);"), "--soa-records lists the fields of records");
+	check_equal(run(source, opts), "3\n1\n5\n4\n");
+}
+
+
+// Persistent maps and vectors
+
+void test_persistent_collections()
+{
+	// Updates leave the old collections as they were
+	const std::string source =
+		"fun fill(m: [integer: integer], i: integer, n: integer): [integer: integer] = if (i == n) m else fill(put(m, i, i * i), i + 1, n);\n"
+		"fun main(): integer {\n"
+		"\tlet empty: [integer: integer] = [];\n"
+		"\tlet m = fill(empty, 0, 1000);\n"
+		"\tlet m2 = remove(put(m, 5, -1), 7);\n"
+		"\tprint(get(m, 5, 0));\n"
+		"\tprint(get(m2, 5, 0));\n"
+		"\tprint(has(m, 7));\n"
+		"\tprint(has(m2, 7));\n"
+		"\tprint(length(m2));\n"
+		"\tprint(fold(keys(m), 0, { a: integer, b: integer -> return a + b; }));\n"
+		"\tlet none: <integer> = [];\n"
+		"\tlet v = to_vector(range(0, 100));\n"
+		"\tlet w = push(put(v, 0, 42), 100);\n"
+		"\tprint(get(v, 0, -1));\n"
+		"\tprint(get(w, 0, -1));\n"
+		"\tprint(length(concat(v, w)));\n"
+		"\tprint(get(concat(v, w), 150, -1));\n"
+		"\tprint(fold(to_array(w), 0, { a: integer, b: integer -> return a + b; }));\n"
+		"\tprint(length(none));\n"
+		"\tprint(get(to_map([1, 2], [true, false]), 2, true));\n"
+		"\treturn 0;\n"
+		"}\n";
+	check_equal(run(source), "25\n-1\n1\n0\n999\n499500\n0\n42\n201\n50\n5092\n0\n0\n");
+}
+
+
+// Regions
+
+void test_regions()
+{
+	const std::string source =
+		"fun total(n: integer): integer {\n"
+		"\tlet xs = range(0, n);\n"
+		"\tlet ys = map(xs, { x: integer -> return x * 2; });\n"
+		"\treturn fold(ys, 0, { a: integer, b: integer -> return a + b; });\n"
+		"}\n"
+		"fun keep(n: integer): [integer] = range(0, n);\n"
+		"fun lengths(n: integer): integer = if (n == 0) 0 else length(range(0, n)) + lengths(n - 1);\n"
+		"fun main(): integer {\n"
+		"\tprint(total(1000));\n"
+		"\tprint(total(10));\n"
+		"\tprint(length(keep(5)));\n"
+		"\tprint(lengths(100));\n"
+		"\treturn 0;\n"
+		"}\n";
+
+	// Arrays returned, or made by recursive calls, are not bounded by a call
+	const std::string cpp = compile(source);
+	check(count(cpp, "pebkac_region::scope pebkac_region_scope;") == 1
+		&& contains(cpp, "const integer total(const integer& n)\n{\n\tpebkac_region::scope pebkac_region_scope;"),
+		"Only functions making a bounded number of arrays that do not escape use a region:\n" + cpp);
+	check_equal(run(source), "999000\n90\n5\n5050\n");
+
+	driver::options opts;
+	opts.regions = false;
+	check(!contains(compile(source, opts), "pebkac_region_scope"), "--no-regions allocates every array on the heap");
+	check_equal(run(source, opts), "999000\n90\n5\n5050\n");
+}
+
+
+// Compile server
+
+void test_server_requests()
+{
+	const std::string path = scratch_file("served.pebkac", "let x = 1;\n");
+	trace::buffer tracer;
+	driver::options opts;
+	opts.tracer = &tracer;
+	server::compile_server s((scratch / "socket").string(), opts);
+
+	const auto [success, cpp] = s.handle("cpp " + path);
+	check(success, "A request compiles its source: " + cpp);
+	check_equal(cpp, driver::compile("let x = 1;\n", driver::output_type::CPP));
+
+	// Repeated requests come from the cache, even for another output of the same file
+	const auto tokenized = [&tracer]{
+		size_t result = 0;
+		for(const auto& e : tracer.get_events())
+			result += e.name == "tokenize";
+		return result;
+	};
+	check(s.handle("cpp " + path).second == cpp && s.handle("ast " + path).first, "Repeated requests succeed");
+	check(tokenized() == 1, "Repeated requests do not tokenize again");
+
+	// Changed files are compiled again
+	scratch_file("served.pebkac", "let y = 2;\n");
+	check(contains(s.handle("cpp " + path).second, "y = 2"), "Changed files are compiled again");
+	check(tokenized() == 2, "Changed files are tokenized again");
+
+	check(!s.handle("cpp").first, "Malformed requests fail");
+	check(!s.handle("cpp " + (scratch / "missing.pebkac").string()).first, "Missing files fail");
+	check(s.handle("tokens " + scratch_file("broken.pebkac", "let = ;\n")).first, "Tokenizing needs no valid syntax");
+	check(!s.handle("cpp " + (scratch / "broken.pebkac").string()).first, "Syntax errors fail");
+	check(contains(s.handle("trace").second, "\"traceEvents\""), "A traced server answers trace requests");
+	check(!server::compile_server((scratch / "socket").string()).handle("trace").first, "An untraced server has no trace");
+}
+
+
+// Source locations
+
+void test_source_spans()
+{
+	const std::string source = "let a = 1;\r\nfun f(x: integer): integer {\n\treturn x * 2;\n}\n";
+	const lexing::line_table lines(source);
+	check(lines.get_position(0).line == 1 && lines.get_position(0).column == 1, "Offsets start at line 1, column 1");
+	const auto position = lines.get_position(source.find("return"));
+	check(position.line == 3 && position.column == 2, "Positions count lines and columns from 1");
+
+	// Spans cover the whole of their node, and the spans of two nodes cover both
+	const auto statements = ast::parser(lexing::tokenize(source)).parse_statements();
+	const auto span = statements[1]->get_span();
+	check_equal(source.substr(span.offset, span.length), source.substr(source.find("fun"), source.size() - source.find("fun") - 1));
+	const auto both = statements[0]->get_span() | statements[1]->get_span();
+	check(both.offset == 0 && both.get_end() == span.get_end(), "Joined spans cover both spans");
+
+	driver::options opts;
+	opts.line_directives = true;
+	opts.source_name = "located.pebkac";
+	const std::string cpp = compile(source, opts);
+	check(contains(cpp, "#line 2 \"located.pebkac\"") && contains(cpp, "#line 3 \"located.pebkac\""), "Statements get #line directives:\n" + cpp);
+	check(!contains(compile(source), "#line"), "Only --line-directives emits #line directives");
+}
+
+
+// Deep nesting, shaped like the benchmark's programs
+
+void test_deep_nesting()
+{
+	std::string expression = "a";
+	long long expected = 5;
+	// Shallower than the benchmark's, so that the products do not overflow
+	for(size_t depth = 0; depth < 24; ++depth)
+	{
+		expression = "(" + expression + (depth%3==0 ? " + " : depth%3==1 ? " * " : " - ") + std::to_string(depth) + ")";
+		expected = depth%3==0 ? expected + depth : depth%3==1 ? expected * depth : expected - depth;
+	}
+
+	std::string lambda = "x0 + 1";
+	std::string call = "l";
+	for(size_t depth = 16; depth > 0; --depth)
+	{
+		lambda = "{ x" + std::to_string(depth - 1) + ": integer -> return " + lambda + "; }";
+		call += "(" + std::to_string(depth) + ")";
+	}
+
+	const std::string source =
+		"/*\n * A long comment\n */\n// And another one\n"
+		"fun deep(a: integer): integer = " + expression + ";\n"
+		"fun main(): integer {\n"
+		"\tlet l = " + lambda + ";\n"
+		"\tprint(deep(5));\n"
+		"\tprint(" + call + ");\n"
+		"\treturn 0;\n"
+		"}\n";
+	check_equal(run(source), std::to_string(expected) + "\n17\n");
+
+	check(diagnose("let a = " + std::string(256, '(') + "1" + std::string(256, ')') + ";\n").empty(), "Deep groups parse");
+	check(diagnose("let a = 1;\n" + std::string(4096, '/') + "\n/*" + std::string(4096, '*') + "*/\nlet b = a;\n").empty(), "Long comments are skipped");
+}
+
+
+// Incremental parsing
+
+std::string parse_whole(const std::string& source)
+{
+	return driver::serialize_ast(ast::parser(lexing::tokenize(source)).parse_statements());
+}
+
+
+// Checks that a document holds what parsing its source from scratch gives
+void check_document(const incremental::document& d)
+{
+	check(d.is_valid(), "The document parses");
+	check_equal(driver::serialize_ast(d.get_statements()), parse_whole(d.get_source()));
+	check_equal(driver::serialize_tokens(d.get_tokens()), driver::serialize_tokens(lexing::tokenize(d.get_source())));
+}
+
+
+std::string numbered_functions(size_t count)
+{
+	std::string result = "";
+	for(size_t i = 0; i < count; ++i)
+		result += "fun f" + std::to_string(i) + "(a: integer): integer {\n\treturn a + " + std::to_string(i) + ";\n}\n\n";
+	return result;
+}
+
+
+void test_incremental_edits()
+{
+	incremental::document d("let a = 1;\nlet b = 2;\n\nfun f(x: integer): integer = x;\n");
+	check_document(d);
+
+	d.edit(8, 1, "10 + 4");
+	check_document(d);
+
+	d.edit(d.get_source().find("let b"), 0, "// Comment\nlet c = 3;\n");
+	check_document(d);
+	check(d.get_statements().size() == 4, "Inserted statements become statements of their own");
+
+	// Spans are relative to their statement's segment
+	const auto offsets = d.get_statement_offsets();
+	const auto statements = d.get_statements();
+	for(size_t i = 0; i < statements.size(); ++i)
+	{
+		const size_t begin = offsets[i] + statements[i]->get_span().offset;
+		check_equal(d.get_source().substr(begin, 3), i == 3 ? "fun" : "let");
+	}
+}
+
+
+void test_incremental_broken_edit()
+{
+	incremental::document d("let a = 1;\nlet b = 2;\nlet c = 3;\n");
+
+	bool thrown = false;
+	try
+	{
+		d.edit(d.get_source().find("2"), 1, "");
+	}
+	catch(const std::exception&)
+	{
+		thrown = true;
+	}
+	check(thrown && !d.is_valid(), "Broken edits throw");
+	check(d.get_statements().size() == 2, "Statements around a broken one keep their AST");
+
+	d.edit(d.get_source().find("= ;"), 2, "= 5");
+	check_document(d);
+}
+
+
+void test_incremental_unclosed_brace()
+{
+	// An unclosed brace leaves only its own function broken, however long the document
+	const std::string source = numbered_functions(200);
+	incremental::document d(source);
+
+	bool thrown = false;
+	try
+	{
+		d.edit(source.find("return a + 10;"), 0, "if (a) {\n");
+	}
+	catch(const std::exception&)
+	{
+		thrown = true;
+	}
+	check(thrown && !d.is_valid(), "Unclosed braces throw");
+	check(d.get_statements().size() == 199, "Only the edited function is broken");
+
+	// Closing it inside a later function makes the document whole again, as a single function
+	d.edit(d.get_source().find("return a + 150;"), 0, "return 1; }\n");
+	check_document(d);
+	check(d.get_statements().size() == 60, "Braces join the functions in between");
+}
+
+
+// Tracing
+
+void test_trace_phases_and_functions()
+{
+	trace::buffer tracer;
+	driver::options opts;
+	opts.tracer = &tracer;
+	opts.source_name = "traced.pebkac";
+	compile("fun f(a: integer): integer = a;\nfun g(a: integer): integer = f(a) + 1;\n", opts);
+
+	std::string names = "";
+	for(const auto& e : tracer.get_events())
+		names += e.category + ":" + e.name + " ";
+	for(const std::string& expected : {"phase:tokenize", "phase:parse", "phase:optimize", "phase:codegen", "parse:f", "parse:g", "codegen:g"})
+		check(contains(names, expected), "Missing trace event " + expected + " in " + names);
+
+	const std::string json = tracer.to_json();
+	check(contains(json, "\"traceEvents\"") && contains(json, "\"detail\": \"traced.pebkac\""), "Traces are in trace_event format");
+}
+
+
+void test_trace_ring_buffer()
+{
+	trace::buffer tracer(3);
+	for(size_t i = 0; i < 10; ++i)
+		tracer.record({"e" + std::to_string(i), "test", "", static_cast<double>(i), 1, 0});
+
+	const auto events = tracer.get_events();
+	check(events.size() == 3, "A bounded buffer keeps its capacity of events");
+	check_equal(events[0].name + events[1].name + events[2].name, "e7e8e9");
+}
+
+
+void test_trace_command_line()
+{
+	const std::string source = scratch_file("traced.pebkac", "let x = 1;\n");
+	const std::string trace = (scratch / "trace.json").string();
+
+	int status = 0;
+	pebkacc("--trace=" + trace + " " + source + " cpp", status);
+	check(status == 0 && contains(driver::read_file(trace), "\"name\": \"codegen\""), "--trace writes a trace file");
+
+	// A server never exits to write its trace, so only a bounded buffer can trace it
+	const std::string output = pebkacc("--trace=" + trace + " --server " + (scratch / "socket").string(), status);
+	check(status != 0 && contains(output, "--trace-buffer"), "--trace is rejected in server mode: " + output);
+}
+
+
+// Statistics
+
+void test_stats_report()
+{
+	const std::string source = scratch_file("say \"hi\".pebkac", "let x = 1;\n");
+
+	int status = 0;
+	const std::string json = pebkacc("--stats=json '" + source + "' cpp", status);
+	check(status == 0 && contains(json, "{\"source\": \"" + escape(source) + "\", \"stats\": {\"source_bytes\": 11, \"tokens\": 5"),
+		"--stats=json escapes the source: " + json);
+	check(count(json, "{\"name\": ") == 4, "--stats=json reports every phase: " + json);
+
+	const std::string text = pebkacc("--stats '" + source + "' cpp", status);
+	check(status == 0 && contains(text, source + ": 11 bytes, 5 tokens, 2 AST nodes") && contains(text, "\ncodegen "),
+		"--stats reports phases as text: " + text);
+}
+
+
+// Bigints and literals
+
+void test_bigint_literals_of_any_size()
+{
+	check_equal(run(
+		"fun fact(n: bigint): bigint = if (n < 2n) 1n else n * fact(n - 1n);\n"
+		"fun main(): integer {\n"
+		"\tlet a: bigint = 123456789012345678901234567890n;\n"
+		"\tprint(a);\n"
+		"\tprint(a - 123456789012345678901234567889n);\n"
+		"\tprint(-340282366920938463463374607431768211456n);\n"
+		"\tprint(18446744073709551615n + 1n);\n"
+		"\tprint(fact(30n) == 265252859812191058636308480000000n);\n"
+		"\tprint(000000000000000000000000000042n);\n"
+		"\treturn 0;\n"
+		"}\n"), "123456789012345678901234567890\n1\n-340282366920938463463374607431768211456\n18446744073709551616\n1\n42\n");
+
+	check(contains(driver::compile("let a = 18446744073709551616n;", driver::output_type::AST), "\"limbs\":[0,0,1]"),
+		"Bigint literals larger than 64 bits keep their limbs");
+}
+
+
+void test_smallest_signed_literals()
+{
+	// One past the largest value of a signed type fits it once negated
+	check_equal(run(
+		"fun main(): integer {\n"
+		"\tprint(-128i8 + 0i8);\n"
+		"\tprint(-9223372036854775808);\n"
+		"\tprint(0 - -9223372036854775807);\n"
+		"\tprint(match (-9223372036854775807 - 1) { -9223372036854775808 -> 1; else -> 2; });\n"
+		"\treturn 0;\n"
+		"}\n"), "-128\n-9223372036854775808\n9223372036854775807\n1\n");
+
+	check(diagnose("let a = - 128i8;\nlet b = -32768i16;\n").empty(), "The smallest signed values are literals");
+	check_equal(describe(diagnose("let a = -(128i8);\nlet b = -256u8;\n")),
+		"1:11 Numeric literal 128i8 is out of range\n2:10 Numeric literal 256u8 is out of range\n");
+}
+
+
+void test_literals_out_of_range()
+{
+	// Errors name the literal, rather than repeating what the standard library says
+	const auto diagnostics = diagnose("let a = 9223372036854775808;\nlet b = 1e999;\nlet c = 1e39f;\nlet d = 1e-999;\n");
+	check(diagnostics.size() == 3, "Literals too large are errors:\n" + describe(diagnostics));
+	check_equal(diagnostics[0].message, "Numeric literal 9223372036854775808 is out of range");
+	check_equal(diagnostics[1].message, "Numeric literal 1e999 is out of range");
+	check_equal(diagnostics[2].message, "Numeric literal 1e39f is out of range");
+
+	// They are reported at the literal, not at what follows it
+	check_equal(describe(diagnose("let a =\n\t300u8\n\t+ 1;\nlet b = 128i8;\n")),
+		"2:2 Numeric literal 300u8 is out of range\n4:9 Numeric literal 128i8 is out of range\n");
+
+	int status = 0;
+	const std::string output = pebkacc("--inline-budget=lots x.pebkac cpp", status);
+	check(status != 0 && contains(output, "--inline-budget expects a number, got \"lots\""), "Options check their numbers: " + output);
+}
+
+
+// Error recovery
+
+void test_recovery_reports_every_error()
+{
+	const auto diagnostics = diagnose(
+		"let a = ;\n"
+		"fun f(x: integer): integer = x +;\n"
+		"let b = 1;\n"
+		"let c = (2;\n");
+	check_equal(describe(diagnostics),
+		"1:9 Malformed expression\n"
+		"2:33 Postfix operator detected.\n"
+		"4:11 Unexpected token type: expected: \"BRACKET\", got: \"SYNTATIC_ELEMENT\".\n");
+}
+
+
+void test_recovery_consecutive_broken_functions()
+{
+	// Each missing ";" consumes the "}" closing the function, which must not swallow the next function
+	const auto diagnostics = diagnose(
+		"fun f(): integer {\n\treturn 1\n}\n"
+		"fun g(): integer {\n\treturn 2\n}\n"
+		"fun h(): integer {\n\treturn 3\n}\n"
+		"let x = ;\n");
+	check(diagnostics.size() == 4, "Every broken function is reported:\n" + describe(diagnostics));
+	check(diagnostics[0].position.line == 3 && diagnostics[1].position.line == 6 && diagnostics[2].position.line == 9,
+		"Errors are reported at the closing braces:\n" + describe(diagnostics));
+	check(diagnostics[3].position.line == 10, "Statements after the broken functions are parsed");
+}
+
+
+void test_recovery_nested_blocks()
+{
+	const auto diagnostics = diagnose(
+		"fun f(a: integer): integer {\n"
+		"\tlet g = { x: integer -> return x };\n"
+		"\tif (a > 0) {\n\t\treturn 1\n\t}\n"
+		"\treturn a;\n"
+		"}\n"
+		"}\n"
+		"let y = 1 +;\n");
+	check_equal(describe(diagnostics),
+		"2:35 Unexpected token type: expected: \"SYNTATIC_ELEMENT\", got: \"BRACKET\".\n"
+		"5:2 Unexpected token type: expected: \"SYNTATIC_ELEMENT\", got: \"BRACKET\".\n"
+		"8:1 Unexpected \"}\".\n"
+		"9:12 Postfix operator detected.\n");
+}
+
+
+// Parsing and inlining
+
+void test_operator_precedence()
+{
+	check_equal(driver::compile("let x = 1 - 2 * 3 - 4;", driver::output_type::AST),
+		"[{\"node\":\"let\",\"name\":\"x\",\"type\":null,\"value\":{\"node\":\"operator\",\"operation\":\"SUBTRACT\","
+		"\"operand_a\":{\"node\":\"operator\",\"operation\":\"SUBTRACT\",\"operand_a\":{\"node\":\"numeric_literal\",\"value\":1},"
+		"\"operand_b\":{\"node\":\"operator\",\"operation\":\"MULTIPLY\",\"operand_a\":{\"node\":\"numeric_literal\",\"value\":2},"
+		"\"operand_b\":{\"node\":\"numeric_literal\",\"value\":3}}},\"operand_b\":{\"node\":\"numeric_literal\",\"value\":4}},"
+		"\"lazy\":false}]");
+
+	check_equal(run(
+		"fun main(): integer {\n"
+		"\tprint(1 + 2 * 3);\n"
+		"\tprint(10 - 4 - 3);\n"
+		"\tprint(100 / 10 / 5);\n"
+		"\tprint(2 * 7 % 4);\n"
+		"\tprint(1 + 2 < 4 == true);\n"
+		"\tprint(true || false && false);\n"
+		"\tprint(-2 * -3 - -1);\n"
+		"\treturn 0;\n"
+		"}\n"), "7\n3\n2\n2\n1\n1\n7\n");
+}
+
+
+void test_nested_unary_operators()
+{
+	// Adjacent signs must not merge into C++'s -- and ++, neither as written nor once calls are inlined
+	const std::string source =
+		"fun neg(x: integer): integer = -x;\n"
+		"fun main(): integer {\n"
+		"\tlet a = 5;\n"
+		"\tlet b = 3;\n"
+		"\tprint(a - -b);\n"
+		"\tprint(- -a);\n"
+		"\tprint(+ +a);\n"
+		"\tprint(a + +b);\n"
+		"\tprint(a - - - b);\n"
+		"\tprint(a - neg(-b));\n"
+		"\tprint(-neg(a));\n"
+		"\treturn 0;\n"
+		"}\n";
+	const std::string expected = "8\n5\n5\n8\n2\n2\n5\n";
+	check_equal(run(source), expected);
+
+	driver::options opts;
+	opts.inline_budget = 0;
+	opts.common_subexpressions = false;
+	check_equal(run(source, opts), expected);
+}
+
+
+void test_inlining()
+{
+	const std::string source =
+		"fun square(x: integer): integer = x * x;\n"
+		"fun main(): integer {\n"
+		"\tlet a = 4;\n"
+		"\tprint(square(a) + square(a + 1));\n"
+		"\tprint({ y: integer -> return y - 1; }(a));\n"
+		"\treturn 0;\n"
+		"}\n";
+	const std::string cpp = compile(source);
+	check(contains(cpp, "print((integer(a)*integer(a))+"), "Calls to small functions are inlined:\n" + cpp);
+	check(contains(cpp, "square(a+1)"), "Arguments are not computed twice by inlining:\n" + cpp);
+	check(!contains(cpp, "[&]") && contains(cpp, "(integer(a)-1)"), "Applied lambdas are inlined:\n" + cpp);
+	check_equal(run(source), "41\n3\n");
+
+	driver::options opts;
+	opts.inline_budget = 0;
+	check(contains(compile(source, opts), "square(a)+"), "A budget of 0 disables inlining");
+}
+
+
+// Specialization
+
+void test_specialization_clones_for_lambdas()
+{
+	const std::string source =
+		"fun twice(f: (integer) -> integer, x: integer): integer = f(f(x));\n"
+		"fun main(): integer {\n"
+		"\tlet k = 3;\n"
+		"\tprint(twice({ a: integer -> return a + k; }, 1));\n"
+		"\tprint(twice({ a: integer -> return a * 2; }, 5));\n"
+		"\treturn 0;\n"
+		"}\n";
+	check(contains(compile(source), "pebkac_twice_0("), "A lambda using no locals gets its own clone");
+
+	driver::options opts;
+	opts.specialization_budget = 0;
+	check(!contains(compile(source, opts), "pebkac_twice_0("), "A budget of 0 disables specialization");
+
+	check_equal(run(source), "7\n20\n");
+}
+
+
+// Matching
+
+void test_match_cases_and_ranges()
+{
+	const std::string source =
+		"fun kind(x: integer): integer = match (x) { 1, 2 -> 10; 3..9 -> 20; -5 -> 30; -9..-7, 100..200 -> 40; else -> 50; };\n"
+		"fun main(): integer {\n"
+		"\tprint(kind(2));\n"
+		"\tprint(kind(9));\n"
+		"\tprint(kind(-5));\n"
+		"\tprint(kind(-8));\n"
+		"\tprint(kind(150));\n"
+		"\tprint(kind(0));\n"
+		"\treturn 0;\n"
+		"}\n";
+	check(contains(compile(source), "switch ("), "Matches compile to a switch");
+	check_equal(run(source), "10\n20\n30\n40\n40\n50\n");
+}
+
+
+void test_match_errors()
+{
+	// Empty ranges are reported where they are, not at what follows them
+	check_equal(describe(diagnose("let a = 1;\nlet b = match (a) {\n\t1 -> 2;\n\t5..3 -> 4;\n\telse -> 0;\n};\n")),
+		"4:2 Range 5..3 matches nothing\n");
+	check_equal(describe(diagnose("let a = 1.5;\nlet b = match (a) { 1 -> 2; else -> 0; };\n")),
+		"2:16 Cannot match values of type double, only integers\n");
+	check_equal(describe(diagnose("let a = 1;\nlet b = match (a) { -1.5 -> 2; else -> 0; };\n")),
+		"2:21 Cannot match -1.5, patterns are integer literals\n");
+}
+
+
+// Dead code elimination
+
+void test_dead_code_elimination()
+{
+	const std::string source =
+		"fun unused(x: integer): integer = x * 3;\n"
+		"fun used(x: integer): integer = x + 1;\n"
+		"fun main(): integer {\n"
+		"\tlet dead = used(41);\n"
+		"\tlet alive = used(1);\n"
+		"\tprint(alive);\n"
+		"\treturn 0;\n"
+		"}\n";
+	driver::options opts;
+	opts.inline_budget = 0;
+	const std::string cpp = compile(source, opts);
+	check(!contains(cpp, "unused(") && !contains(cpp, "dead"), "Unreachable functions and unused lets are left out:\n" + cpp);
+	check(contains(cpp, "used(1)"), "Used lets are kept:\n" + cpp);
+	check_equal(run(source, opts), "2\n");
+
+	opts.dead_code_elimination = false;
+	check(contains(compile(source, opts), "unused("), "--no-dce keeps everything");
+
+	// Profiles list the functions as they were written
+	driver::options profiled;
+	profiled.profile = true;
+	const std::string profiled_cpp = compile(source, profiled);
+	check(contains(profiled_cpp, "const integer unused(") && contains(profiled_cpp, "dead = used(41)"), "--profile disables every optimization");
+
+	int status = 0;
+	check(contains(pebkacc("--help", status), "--profile") && contains(pebkacc("--help", status), "disabling every optimization"),
+		"--help says that --profile disables optimizations");
+}
+
+
+const std::vector<std::pair<std::string, std::function<void()>>> tests = {
+	{ "batch_outputs", test_batch_outputs },
+	{ "batch_output_collision", test_batch_output_collision },
+	{ "manifest", test_manifest },
+	{ "profile_instrumentation", test_profile_instrumentation },
+	{ "constexpr", test_constexpr },
+	{ "common_subexpressions", test_common_subexpressions },
+	{ "closure_conversion", test_closure_conversion },
+	{ "arrays", test_arrays },
+	{ "parallel_arrays", test_parallel_arrays },
+	{ "floating_point", test_floating_point },
+	{ "lazy_let", test_lazy_let },
+	{ "records", test_records },
+	{ "persistent_collections", test_persistent_collections },
+	{ "regions", test_regions },
+	{ "server_requests", test_server_requests },
+	{ "source_spans", test_source_spans },
+	{ "deep_nesting", test_deep_nesting },
+	{ "incremental_edits", test_incremental_edits },
+	{ "incremental_broken_edit", test_incremental_broken_edit },
+	{ "incremental_unclosed_brace", test_incremental_unclosed_brace },
+	{ "trace_phases_and_functions", test_trace_phases_and_functions },
+	{ "trace_ring_buffer", test_trace_ring_buffer },
+	{ "trace_command_line", test_trace_command_line },
+	{ "stats_report", test_stats_report },
+	{ "bigint_literals_of_any_size", test_bigint_literals_of_any_size },
+	{ "smallest_signed_literals", test_smallest_signed_literals },
+	{ "literals_out_of_range", test_literals_out_of_range },
+	{ "recovery_reports_every_error", test_recovery_reports_every_error },
+	{ "recovery_consecutive_broken_functions", test_recovery_consecutive_broken_functions },
+	{ "recovery_nested_blocks", test_recovery_nested_blocks },
+	{ "operator_precedence", test_operator_precedence },
+	{ "nested_unary_operators", test_nested_unary_operators },
+	{ "inlining", test_inlining },
+	{ "specialization_clones_for_lambdas", test_specialization_clones_for_lambdas },
+	{ "match_cases_and_ranges", test_match_cases_and_ranges },
+	{ "match_errors", test_match_errors },
+	{ "dead_code_elimination", test_dead_code_elimination },
+};
+
+
+int main(int argc, const char** argv)
+{
+	try
+	{
+		// pebkacc_test [name_prefix]
+		const std::string prefix = argc > 1 ? argv[1] : "";
+
+		scratch = std::filesystem::temp_directory_path() / ("pebkac_test_" + std::to_string(std::random_device()()));
+		std::filesystem::create_directories(scratch);
+
+		size_t passed = 0;
+		size_t failed = 0;
+		for(const auto& [name, test] : tests)
+		{
+			if (name.compare(0, prefix.size(), prefix) != 0)
+				continue;
+
+			try
+			{
+				test();
+				++passed;
+			}
+			catch(const std::exception& e)
+			{
+				std::cout << "FAIL " << name << ": " << e.what() << std::endl;
+				++failed;
+			}
+		}
+
+		std::filesystem::remove_all(scratch);
+
+		std::cout << passed << " passed, " << failed << " failed" << std::endl;
+		return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
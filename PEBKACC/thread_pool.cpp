@@ -0,0 +1,86 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+using namespace pebkac;
+
+
+thread_pool::thread_pool(
+	size_t threads)
+{
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	for(size_t i = 0; i < threads; ++i)
+		workers.emplace_back(&thread_pool::work, this);
+}
+
+
+thread_pool::~thread_pool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	job_available.notify_all();
+
+	for(auto& w : workers)
+		w.join();
+}
+
+
+void thread_pool::submit(const std::function<void()>& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push(job);
+	}
+	job_available.notify_one();
+}
+
+
+void thread_pool::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	jobs_done.wait(lock, [this]{ return jobs.empty() && running == 0; });
+}
+
+
+size_t thread_pool::get_size() const noexcept
+{
+	return workers.size();
+}
+
+
+void thread_pool::work()
+{
+	while(true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			job_available.wait(lock, [this]{ return stopping || !jobs.empty(); });
+
+			if (jobs.empty())
+				return;
+
+			job = std::move(jobs.front());
+			jobs.pop();
+			++running;
+		}
+
+		// Jobs are expected to report their own errors, a stray exception must not kill the worker
+		try
+		{
+			job();
+		}
+		catch(...)
+		{ }
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--running;
+		}
+		jobs_done.notify_all();
+	}
+}
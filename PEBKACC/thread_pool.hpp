@@ -0,0 +1,50 @@
+#pragma once
+
+#include <queue>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+namespace pebkac
+{
+	class thread_pool
+	{
+	public:
+		/**
+		 * @brief Starts a fixed number of worker threads
+		 * @param threads Number of workers, 0 picks the hardware concurrency
+		 */
+		thread_pool(size_t threads);
+		~thread_pool();
+
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator = (const thread_pool&) = delete;
+
+		/**
+		 * @brief Queues a job to be run by the next idle worker
+		 */
+		void submit(const std::function<void()>& job);
+
+		/**
+		 * @brief Blocks until every submitted job has finished running
+		 */
+		void wait();
+
+		size_t get_size() const noexcept;
+
+	private:
+		std::vector<std::thread> workers;
+		std::queue<std::function<void()>> jobs;
+
+		std::mutex mutex;
+		std::condition_variable job_available;
+		std::condition_variable jobs_done;
+
+		size_t running = 0;
+		bool stopping = false;
+
+		void work();
+	};
+}
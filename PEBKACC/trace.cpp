@@ -0,0 +1,124 @@
+#include "trace.hpp"
+#include "serialization.hpp"
+
+#include <atomic>
+#include <sstream>
+#include <iomanip>
+
+using namespace pebkac;
+using namespace pebkac::trace;
+
+
+// Small sequential thread ids read much better than std::thread::id hashes in trace viewers
+std::uint32_t get_thread_number() noexcept
+{
+	static std::atomic<std::uint32_t> next = 0;
+	thread_local const std::uint32_t number = next++;
+	return number;
+}
+
+
+buffer::buffer(
+	size_t capacity) noexcept:
+	capacity(capacity),
+	start(std::chrono::steady_clock::now()),
+	events({ }),
+	head(0)
+{ }
+
+
+double buffer::get_time() const noexcept
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+void buffer::record(event e)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (capacity == 0 || events.size() < capacity)
+	{
+		events.push_back(std::move(e));
+	}
+	else
+	{
+		events[head] = std::move(e);
+		head = (head + 1) % capacity;
+	}
+}
+
+
+std::vector<event> buffer::get_events() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::vector<event> result = { };
+	result.reserve(events.size());
+	result.insert(result.end(), events.begin() + head, events.end());
+	result.insert(result.end(), events.begin(), events.begin() + head);
+	return result;
+}
+
+
+std::string buffer::to_json() const
+{
+	std::ostringstream result;
+	result << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+	bool first = true;
+	for(const auto& e : get_events())
+	{
+		result << (first?"":",") << "\n{\"name\": \"" << escape(e.name) << "\", \"cat\": \"" << escape(e.category)
+			<< "\", \"ph\": \"X\", \"ts\": " << e.begin << ", \"dur\": " << e.duration << ", \"pid\": 1, \"tid\": " << e.thread;
+		if (!e.detail.empty())
+			result << ", \"args\": {\"detail\": \"" << escape(e.detail) << "\"}";
+		result << "}";
+		first = false;
+	}
+
+	result << "\n]}";
+	return result.str();
+}
+
+
+scope::scope(
+	buffer* target,
+	const char* category,
+	const std::string& name,
+	const std::string& detail):
+	target(target)
+{
+	if (!target)
+		return;
+
+	e.name = name;
+	e.category = category;
+	e.detail = detail;
+	e.thread = get_thread_number();
+	e.begin = target->get_time();
+}
+
+
+scope::~scope()
+{
+	if (!target)
+		return;
+
+	e.duration = target->get_time() - e.begin;
+	try
+	{
+		target->record(std::move(e));
+	}
+	catch(const std::exception&)
+	{
+		// Losing an event is better than terminating
+	}
+}
+
+
+void scope::set_name(const std::string& name)
+{
+	if (target)
+		e.name = name;
+}
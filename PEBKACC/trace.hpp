@@ -0,0 +1,95 @@
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace pebkac::trace
+{
+	struct event
+	{
+		std::string name;
+		std::string category;
+
+		// Extra information shown alongside the event, such as a file name
+		std::string detail;
+
+		// Microseconds since the buffer was created
+		double begin;
+		double duration;
+
+		std::uint32_t thread;
+	};
+
+
+	/**
+	 * @brief Collects trace events from any number of threads
+	 *
+	 * An unbounded buffer keeps every event. A bounded buffer is a ring, keeping only the most recent
+	 * events, so that it can stay enabled in long-running processes at a fixed memory cost.
+	 */
+	class buffer
+	{
+	public:
+		/**
+		 * @param capacity Maximum number of events kept, 0 keeps them all
+		 */
+		buffer(
+			size_t capacity = 0
+		) noexcept;
+
+		void record(event e);
+
+		/**
+		 * @brief Returns the events currently kept, oldest first
+		 */
+		std::vector<event> get_events() const;
+
+		/**
+		 * @brief Returns the events in Chrome's trace_event format, as read by chrome://tracing and Perfetto
+		 */
+		std::string to_json() const;
+
+		double get_time() const noexcept;
+
+	private:
+		const size_t capacity;
+		const std::chrono::steady_clock::time_point start;
+
+		mutable std::mutex mutex;
+		std::vector<event> events;
+
+		// Index of the oldest event, once a bounded buffer is full
+		size_t head;
+	};
+
+
+	/**
+	 * @brief Records the lifetime of this object as a trace event. Does nothing when the buffer is null.
+	 */
+	class scope
+	{
+	public:
+		scope(
+			buffer* target,
+			const char* category,
+			const std::string& name,
+			const std::string& detail = ""
+		);
+		~scope();
+
+		scope(const scope&) = delete;
+		scope& operator = (const scope&) = delete;
+
+		/**
+		 * @brief Renames the event, for names only known halfway through
+		 */
+		void set_name(const std::string& name);
+
+	private:
+		buffer* const target;
+		event e;
+	};
+}